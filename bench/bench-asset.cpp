@@ -0,0 +1,58 @@
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include <benchmark/benchmark.h>
+
+#include "asset.hpp"
+
+namespace {
+
+constexpr int num_files = 16;
+
+/// Write files of 256 KiB, like texture tiles, to a temporary directory.
+std::filesystem::path write_files() {
+  auto dir = std::filesystem::temp_directory_path() / "bench-asset";
+  std::filesystem::create_directories(dir);
+  std::string data(256 << 10, 'x');
+  for (int i = 0; i < num_files; i++) {
+    std::ofstream os(dir / (std::to_string(i) + ".bin"), std::ios::binary);
+    os << data;
+  }
+  return dir;
+}
+
+/// Read a batch of files in the background on each kind of storage. The
+/// time is how long a streaming system would wait for all of them.
+void BM_AssetReadAsync(benchmark::State &state) {
+  const char *names[] = {"none", "hdd", "sd_card", "network"};
+  StorageProfile storage;
+  StorageProfile::named(names[state.range(0)], storage);
+  state.SetLabel(names[state.range(0)]);
+  auto dir = write_files();
+  AssetSystem assets;
+  assets.add_directory(0, dir.string().c_str());
+  assets.throttle(0, storage);
+  for (auto _ : state) {
+    std::atomic<int> done = 0;
+    for (int i = 0; i < num_files; i++) {
+      std::string key = std::to_string(i) + ".bin";
+      assets.read_async(key.c_str(), 0,
+                        [&](std::unique_ptr<uint8_t[]>, size_t) { done++; });
+    }
+    while (done < num_files)
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+  state.SetBytesProcessed(state.iterations() * num_files * (256 << 10));
+  std::filesystem::remove_all(dir);
+}
+BENCHMARK(BM_AssetReadAsync)
+    ->DenseRange(0, 3)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime()
+    ->Iterations(3);
+
+} // namespace
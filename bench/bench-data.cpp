@@ -0,0 +1,83 @@
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "data.hpp"
+#include "json.hpp"
+
+namespace {
+
+const char schema_text[] = R"({
+  "id": 1,
+  "root": "Entities",
+  "tables": {
+    "Entities": {"items": "[Entity]"},
+    "Entity": {"id": "int32", "name": "string", "x": "float", "y": "float",
+               "health": "int32", "boss": "bool"}
+  }
+})";
+
+/// About 10 MiB of JSON entity records.
+std::string make_json() {
+  std::string text = "{\"items\": [\n";
+  char buffer[256];
+  for (int i = 0; text.size() < (10 << 20); i++) {
+    snprintf(buffer, sizeof(buffer),
+             "  {\"id\": %d, \"name\": \"entity %d\", \"x\": %d.5, "
+             "\"y\": %d.25, \"health\": 100, \"boss\": %s},\n",
+             i, i, i % 1000, i % 700, i % 100 ? "false" : "true");
+    text += buffer;
+  }
+  text += "  {}\n]}";
+  return text;
+}
+
+/// Parse the JSON and read every field.
+void BM_DataFromJson(benchmark::State &state) {
+  std::string text = make_json();
+  JsonDocument doc;
+  for (auto _ : state) {
+    doc.parse(text.c_str(), text.size());
+    double sum = 0;
+    for (JsonValue entity : doc.root()["items"].items()) {
+      JsonValue value;
+      if (entity.find("id", value))
+        sum += value.as_int() + entity["health"].as_int();
+      if (entity.find("x", value))
+        sum += value.as_number() + entity["y"].as_number();
+      if (entity.find("name", value))
+        sum += value.as_string().size() + entity["boss"].as_bool();
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+}
+BENCHMARK(BM_DataFromJson)->Unit(benchmark::kMillisecond);
+
+/// Read every field of the same records compiled ahead of time.
+void BM_DataCompiled(benchmark::State &state) {
+  std::string text = make_json();
+  JsonDocument doc;
+  doc.parse(text.c_str(), text.size());
+  std::string schema_json = schema_text;
+  JsonDocument schema_doc;
+  schema_doc.parse(schema_json.c_str(), schema_json.size());
+  ByteWriter file = DataSchema::parse(schema_doc.root()).compile(doc.root());
+  auto copy = std::make_unique<uint64_t[]>(file.size() / 8 + 1);
+  memcpy(copy.get(), file.data(), file.size());
+  for (auto _ : state) {
+    DataList items = DataTable::root(copy.get(), file.size(), 1).list(0);
+    double sum = 0;
+    for (size_t i = 0; i < items.size(); i++) {
+      DataTable entity = items.table(i);
+      sum += entity.get<int32_t>(0) + entity.get<int32_t>(4);
+      sum += entity.get<float>(2) + entity.get<float>(3);
+      sum += entity.string(1).size() + entity.get<bool>(5);
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+}
+BENCHMARK(BM_DataCompiled)->Unit(benchmark::kMillisecond);
+
+} // namespace
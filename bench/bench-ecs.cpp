@@ -0,0 +1,101 @@
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "ecs.hpp"
+#include "job.hpp"
+
+namespace {
+
+struct Position {
+  float x, y, z;
+};
+
+struct Velocity {
+  float x, y, z;
+};
+
+struct Health {
+  int value;
+};
+
+void populate(World &world, int64_t num) {
+  for (int64_t i = 0; i < num; i++) {
+    // Spread entities over a few archetypes like a real game would.
+    if (i % 4)
+      world.create(Position{0, 0, 0}, Velocity{1, 2, 3});
+    else
+      world.create(Position{0, 0, 0}, Velocity{1, 2, 3}, Health{100});
+  }
+}
+
+void BM_QueryEach(benchmark::State &state) {
+  World world;
+  populate(world, state.range(0));
+  for (auto _ : state) {
+    world.query<Position, const Velocity>().each(
+        [](Position &p, const Velocity &v) {
+          p.x += v.x;
+          p.y += v.y;
+          p.z += v.z;
+        });
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_QueryEach)->Arg(100000)->Arg(1000000);
+
+void BM_QueryParallel(benchmark::State &state) {
+  World world;
+  JobPool pool;
+  populate(world, state.range(0));
+  for (auto _ : state) {
+    world.query<Position, const Velocity>().parallel_each(
+        pool, [](Position &p, const Velocity &v) {
+          p.x += v.x;
+          p.y += v.y;
+          p.z += v.z;
+        });
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_QueryParallel)->Arg(100000)->Arg(1000000);
+
+void BM_CreateDestroy(benchmark::State &state) {
+  World world;
+  std::vector<Entity> list(state.range(0));
+  for (auto _ : state) {
+    for (auto &e : list)
+      e = world.create(Position{0, 0, 0}, Velocity{1, 2, 3});
+    for (auto &e : list)
+      world.destroy(e);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CreateDestroy)->Arg(100000);
+
+void BM_CommandBuffer(benchmark::State &state) {
+  World world;
+  populate(world, state.range(0));
+  CommandBuffer cmd;
+  bool add = true;
+  for (auto _ : state) {
+    // Toggle a component on every entity through the deferred path.
+    world.query<const Position>().each_chunk(
+        [&](uint32_t n, const Entity *e, const Position *) {
+          for (uint32_t i = 0; i < n; i++) {
+            if (add)
+              cmd.add(e[i], Health{1});
+            else
+              cmd.remove<Health>(e[i]);
+          }
+        });
+    cmd.apply(world);
+    add = !add;
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CommandBuffer)->Arg(100000);
+
+} // namespace
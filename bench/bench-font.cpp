@@ -0,0 +1,90 @@
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "asset.hpp"
+#include "font.hpp"
+#include "test-font.hpp"
+#include "util.hpp"
+
+namespace {
+
+/// Labels like those of a screen of UI, with the characters of the test font.
+const char *const labels[] = {
+    "Vamos",
+    "Samba: 10%",
+    "A BAB",
+    "Mass 0.01",
+    "Bass 100%",
+    "Amsa Vas",
+    "S\xc3\xa9same",
+    "AVA: 1.0",
+    "Ms Baa 01:10",
+    "VAMB sam",
+};
+
+/// Load the font named by DGENRS_BENCH_FONT, or the test font.
+std::optional<Font> load_font(benchmark::State &state) {
+  const char *path = std::getenv("DGENRS_BENCH_FONT");
+  if (!path)
+    return test_font(16);
+  std::ifstream is(path, std::ios::binary);
+  if (!is.good()) {
+    state.SkipWithError("Can't open DGENRS_BENCH_FONT");
+    return std::nullopt;
+  }
+  try {
+    size_t num;
+    std::unique_ptr<uint8_t[]> file = read_stream(num, is);
+    return Font(std::move(file), num, 16);
+  } catch (FatalError) {
+    state.SkipWithError("Can't load font");
+    return std::nullopt;
+  }
+}
+
+/// Measure labels, which is laid out from tables for simple text.
+void BM_FontMeasure(benchmark::State &state) {
+  std::optional<Font> font = load_font(state);
+  if (!font)
+    return;
+  for (auto _ : state)
+    for (const char *label : labels)
+      benchmark::DoNotOptimize(font->measure(label));
+  state.SetItemsProcessed(state.iterations() * std::size(labels));
+}
+BENCHMARK(BM_FontMeasure);
+
+/// Measure labels by shaping them with HarfBuzz.
+void BM_FontMeasureFull(benchmark::State &state) {
+  std::optional<Font> font = load_font(state);
+  if (!font)
+    return;
+  std::vector<Font::Placement> out;
+  for (auto _ : state)
+    for (const char *label : labels)
+      benchmark::DoNotOptimize(font->shape_full(label, out));
+  state.SetItemsProcessed(state.iterations() * std::size(labels));
+}
+BENCHMARK(BM_FontMeasureFull);
+
+/// Lay out labels with glyph positions.
+void BM_FontShape(benchmark::State &state) {
+  std::optional<Font> font = load_font(state);
+  if (!font)
+    return;
+  std::vector<Font::Placement> out;
+  for (auto _ : state)
+    for (const char *label : labels)
+      benchmark::DoNotOptimize(font->shape(label, out));
+  state.SetItemsProcessed(state.iterations() * std::size(labels));
+}
+BENCHMARK(BM_FontShape);
+
+} // namespace
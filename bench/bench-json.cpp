@@ -0,0 +1,61 @@
+#include <random>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "json.hpp"
+
+namespace {
+
+/// A data file of about 40 MiB: an array of entity records.
+std::string make_data() {
+  std::mt19937 prand(1);
+  std::uniform_real_distribution<double> coord(-1000, 1000);
+  std::string text = "[\n";
+  char buffer[256];
+  for (int i = 0; text.size() < (40 << 20); i++) {
+    snprintf(buffer, sizeof(buffer),
+             "  {\"id\": %d, \"name\": \"entity %d\", \"tags\": [\"enemy\", "
+             "\"flying\"], \"position\": {\"x\": %.3f, \"y\": %.3f}, "
+             "\"health\": 100, \"boss\": %s, \"note\": \"line\\nbreak\"},\n",
+             i, i, coord(prand), coord(prand), i % 100 ? "false" : "true");
+    text += buffer;
+  }
+  text += "  null\n]";
+  return text;
+}
+
+void BM_JsonParse(benchmark::State &state) {
+  std::string text = make_data();
+  JsonDocument doc;
+  for (auto _ : state) {
+    doc.parse(text.c_str(), text.size());
+    benchmark::DoNotOptimize(doc.root().size());
+  }
+  state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_JsonParse)->Unit(benchmark::kMillisecond);
+
+/// Parse, then read every field.
+void BM_JsonRead(benchmark::State &state) {
+  std::string text = make_data();
+  JsonDocument doc;
+  for (auto _ : state) {
+    doc.parse(text.c_str(), text.size());
+    double sum = 0;
+    for (JsonValue entity : doc.root().items()) {
+      if (entity.is_null())
+        continue;
+      sum += entity["id"].as_int() + entity["health"].as_int();
+      sum += entity["position"]["x"].as_number();
+      sum += entity["position"]["y"].as_number();
+      sum += entity["name"].as_string().size() + entity["tags"].size();
+      sum += entity["boss"].as_bool() + entity["note"].as_string().size();
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_JsonRead)->Unit(benchmark::kMillisecond);
+
+} // namespace
@@ -0,0 +1,58 @@
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "localize.hpp"
+
+namespace {
+
+constexpr int num_strings = 20000;
+
+std::vector<std::pair<std::string, std::string>> make_strings() {
+  std::vector<std::pair<std::string, std::string>> strings;
+  for (int i = 0; i < num_strings; i++)
+    strings.emplace_back("menu.item." + std::to_string(i),
+                         "Translated text for item " + std::to_string(i));
+  return strings;
+}
+
+void BM_StringTableCompile(benchmark::State &state) {
+  auto strings = make_strings();
+  for (auto _ : state)
+    benchmark::DoNotOptimize(StringTable::compile(strings).size());
+}
+BENCHMARK(BM_StringTableCompile)->Unit(benchmark::kMillisecond);
+
+void BM_StringTableFind(benchmark::State &state) {
+  auto strings = make_strings();
+  ByteWriter file = StringTable::compile(strings);
+  auto copy = std::make_unique<uint8_t[]>(file.size());
+  memcpy(copy.get(), file.data(), file.size());
+  StringTable table(AssetMapping(std::move(copy), file.size()));
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(table.get(strings[i].first).size());
+    i = (i + 7919) % num_strings;
+  }
+}
+BENCHMARK(BM_StringTableFind);
+
+/// The same lookups in a hash map built at load time, for comparison.
+void BM_StringMapFind(benchmark::State &state) {
+  auto strings = make_strings();
+  std::unordered_map<std::string, std::string> map(strings.begin(),
+                                                   strings.end());
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(map.find(strings[i].first)->second.size());
+    i = (i + 7919) % num_strings;
+  }
+}
+BENCHMARK(BM_StringMapFind);
+
+} // namespace
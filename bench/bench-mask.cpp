@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <random>
+
+#include <benchmark/benchmark.h>
+
+#include "image.hpp"
+#include "mask.hpp"
+
+namespace {
+
+/// A 64×64 RGBA sprite shaped like a disc.
+Image disc() {
+  Image image(ImageType::RGBA, 64, 64);
+  for (unsigned y = 0; y < 64; y++) {
+    for (unsigned x = 0; x < 64; x++) {
+      int dx = int(x) - 32, dy = int(y) - 32;
+      uint8_t *p = image.pixel(x, y);
+      p[0] = p[1] = p[2] = 255;
+      p[3] = dx * dx + dy * dy < 30 * 30 ? 255 : 0;
+    }
+  }
+  return image;
+}
+
+/// Test two sprites by their alpha channels, for comparison.
+void BM_AlphaOverlap(benchmark::State &state) {
+  Image a = disc(), b = disc();
+  std::mt19937 prand(1);
+  std::uniform_int_distribution<int> offset(-63, 63);
+  for (auto _ : state) {
+    int dx = offset(prand), dy = offset(prand);
+    size_t n = 0;
+    for (int y = std::max(0, dy); y < std::min(64, 64 + dy); y++)
+      for (int x = std::max(0, dx); x < std::min(64, 64 + dx); x++)
+        n += a.pixel(x, y)[3] >= 128 && b.pixel(x - dx, y - dy)[3] >= 128;
+    benchmark::DoNotOptimize(n);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AlphaOverlap);
+
+void BM_MaskOverlap(benchmark::State &state) {
+  BitMask a = BitMask::from_alpha(disc()), b = a;
+  std::mt19937 prand(1);
+  std::uniform_int_distribution<int> offset(-63, 63);
+  for (auto _ : state) {
+    int dx = offset(prand), dy = offset(prand);
+    benchmark::DoNotOptimize(a.overlap(b, dx, dy));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MaskOverlap);
+
+void BM_MaskOverlaps(benchmark::State &state) {
+  BitMask a = BitMask::from_alpha(disc()), b = a;
+  std::mt19937 prand(1);
+  std::uniform_int_distribution<int> offset(-63, 63);
+  for (auto _ : state) {
+    int dx = offset(prand), dy = offset(prand);
+    benchmark::DoNotOptimize(a.overlaps(b, dx, dy));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MaskOverlaps);
+
+void BM_FromAlpha(benchmark::State &state) {
+  Image atlas(ImageType::RGBA, 1024, 1024);
+  std::mt19937 prand(1);
+  for (unsigned y = 0; y < 1024; y++)
+    for (unsigned x = 0; x < 1024; x++)
+      atlas.pixel(x, y)[3] = prand();
+  for (auto _ : state)
+    benchmark::DoNotOptimize(BitMask::from_alpha(atlas));
+  state.SetBytesProcessed(state.iterations() * 1024 * 1024 * 4);
+}
+BENCHMARK(BM_FromAlpha);
+
+} // namespace
@@ -0,0 +1,32 @@
+#include <benchmark/benchmark.h>
+
+#include "job.hpp"
+#include "particle.hpp"
+#include "render.hpp"
+
+namespace {
+
+/// Simulate and record a frame of particles spread over a few emitters.
+void BM_ParticlesPerFrame(benchmark::State &state) {
+  JobPool pool;
+  ParticleSystem particles;
+  EmitterParams p;
+  p.min_speed = 10;
+  p.max_speed = 100;
+  p.spread = 6.3f;
+  p.gravity_y = 50;
+  // Particles live long enough to survive the whole benchmark.
+  p.min_life = p.max_life = 1e9f;
+  for (int i = 0; i < 8; i++)
+    particles.burst(particles.add(p), state.range(0) / 8);
+  RenderQueue queue;
+  for (auto _ : state) {
+    particles.update(1.0f / 60, pool);
+    particles.draw(queue, pool);
+    queue.clear();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ParticlesPerFrame)->Arg(100000)->Arg(1000000)->UseRealTime();
+
+} // namespace
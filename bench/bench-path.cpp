@@ -0,0 +1,106 @@
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "job.hpp"
+#include "path.hpp"
+
+namespace {
+
+/// A square map with scattered walls, built once per size.
+struct Map {
+  std::unique_ptr<Pathfinder> grid;
+  std::vector<PathQuery> queries;
+
+  explicit Map(unsigned size) : grid(new Pathfinder(size, size, {})) {
+    std::mt19937 prand(1);
+    std::uniform_int_distribution<unsigned> pos(0, size - 1);
+    std::uniform_int_distribution<unsigned> length(4, 40);
+    std::bernoulli_distribution vertical;
+    // Walls cover roughly a tenth of the map.
+    for (size_t n = size_t(size) * size / 200; n; n--) {
+      unsigned x = pos(prand), y = pos(prand), len = length(prand);
+      bool v = vertical(prand);
+      for (unsigned i = 0; i < len; i++) {
+        unsigned wx = v ? x : x + i, wy = v ? y + i : y;
+        if (wx < size && wy < size)
+          grid->set_blocked(wx, wy, true);
+      }
+    }
+    JobPool pool;
+    grid->update(&pool);
+    // Random endpoints are mostly far apart, across many clusters.
+    while (queries.size() < 256) {
+      GridPoint a = {int32_t(pos(prand)), int32_t(pos(prand))};
+      GridPoint b = {int32_t(pos(prand)), int32_t(pos(prand))};
+      if (!grid->blocked(a.x, a.y) && !grid->blocked(b.x, b.y))
+        queries.push_back({a, b});
+    }
+  }
+};
+
+Map &map(unsigned size) {
+  static Map small(1024), large(4096);
+  return size == 1024 ? small : large;
+}
+
+void BM_JumpPointSearch(benchmark::State &state) {
+  Map &m = map(state.range(0));
+  PathSearch search;
+  std::vector<GridPoint> path;
+  size_t i = 0;
+  for (auto _ : state) {
+    const PathQuery &q = m.queries[i++ % m.queries.size()];
+    benchmark::DoNotOptimize(m.grid->find_jps(q.start, q.goal, search, path));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_JumpPointSearch)->Arg(1024)->Arg(4096);
+
+void BM_Hierarchical(benchmark::State &state) {
+  Map &m = map(state.range(0));
+  PathSearch search;
+  std::vector<GridPoint> path;
+  size_t i = 0;
+  for (auto _ : state) {
+    const PathQuery &q = m.queries[i++ % m.queries.size()];
+    benchmark::DoNotOptimize(m.grid->find(q.start, q.goal, search, path));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Hierarchical)->Arg(1024)->Arg(4096);
+
+void BM_Batch(benchmark::State &state) {
+  Map &m = map(state.range(0));
+  JobPool pool;
+  std::vector<PathResult> results(m.queries.size());
+  for (auto _ : state)
+    m.grid->find_batch(m.queries.data(), m.queries.size(), results.data(),
+                       pool);
+  state.SetItemsProcessed(state.iterations() * m.queries.size());
+}
+BENCHMARK(BM_Batch)->Arg(1024)->Arg(4096)->UseRealTime();
+
+void BM_Build(benchmark::State &state) {
+  for (auto _ : state) {
+    Map m(state.range(0));
+    benchmark::DoNotOptimize(m.grid->nodes());
+  }
+}
+BENCHMARK(BM_Build)->Arg(1024)->Arg(4096)->UseRealTime();
+
+/// Open and close a door on a cluster border.
+void BM_Change(benchmark::State &state) {
+  Map &m = map(state.range(0));
+  bool closed = m.grid->blocked(64, 100);
+  for (auto _ : state) {
+    closed = !closed;
+    m.grid->set_blocked(64, 100, closed);
+    m.grid->update();
+  }
+}
+BENCHMARK(BM_Change)->Arg(1024)->Arg(4096);
+
+} // namespace
@@ -0,0 +1,72 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "input.hpp"
+#include "replay.hpp"
+
+namespace {
+
+/// Record a minute at 60 frames/s of moving the mouse and pressing keys.
+std::vector<char> make_session() {
+  ReplayRecorder recorder;
+  std::mt19937 prand(1);
+  uint64_t time = 1000000000;
+  for (int i = 0; i < 3600; i++) {
+    for (unsigned n = prand() % 4; n--;) {
+      SDL_Event e;
+      memset(&e, 0, sizeof e);
+      time += prand() % 4000000;
+      e.common.timestamp = time;
+      if (prand() % 8) {
+        e.type = SDL_EVENT_MOUSE_MOTION;
+        e.motion.x = float(prand() % 1280);
+        e.motion.y = float(prand() % 720);
+        e.motion.xrel = float(prand() % 7) - 3;
+        e.motion.yrel = float(prand() % 7) - 3;
+      } else {
+        e.type = prand() % 2 ? SDL_EVENT_KEY_DOWN : SDL_EVENT_KEY_UP;
+        e.key.scancode = SDL_Scancode(SDL_SCANCODE_A + prand() % 26);
+        e.key.down = e.type == SDL_EVENT_KEY_DOWN;
+      }
+      recorder.event(e);
+    }
+    recorder.frame(1 / 60.0f, prand());
+  }
+  auto p = reinterpret_cast<const char *>(recorder.data().data());
+  return std::vector<char>(p, p + recorder.data().size());
+}
+
+/// Play the replay named by DGENRS_BENCH_REPLAY, or a generated one, back to
+/// back: decode each step and apply its input, as headless playback does.
+void BM_Replay(benchmark::State &state) {
+  std::vector<char> data;
+  if (const char *path = std::getenv("DGENRS_BENCH_REPLAY")) {
+    std::ifstream is(path, std::ios::binary);
+    data.assign(std::istreambuf_iterator<char>(is), {});
+  } else {
+    data = make_session();
+  }
+  size_t frames = 0;
+  for (auto _ : state) {
+    ReplayPlayer player(data.data(), data.size());
+    InputSampler input({});
+    ReplayFrame frame;
+    while (player.next(frame)) {
+      input.begin(0);
+      for (const SDL_Event &e : frame.events)
+        input.add(e);
+      benchmark::DoNotOptimize(input.state().mouse_x);
+    }
+    frames += player.frames();
+  }
+  state.SetItemsProcessed(frames);
+}
+BENCHMARK(BM_Replay)->Unit(benchmark::kMicrosecond);
+
+} // namespace
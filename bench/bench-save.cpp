@@ -0,0 +1,79 @@
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "job.hpp"
+#include "save.hpp"
+
+namespace {
+
+struct Transform {
+  float x, y, z, rx, ry, rz, sx, sy, sz;
+};
+
+struct Body {
+  float vx, vy, vz, mass;
+  uint32_t flags;
+};
+
+struct Health {
+  int value;
+};
+
+SaveSchema make_schema() {
+  SaveSchema schema(1);
+  schema.add<Transform>(1);
+  schema.add<Body>(2);
+  schema.add<Health>(3);
+  return schema;
+}
+
+void populate(World &world, int64_t num) {
+  for (int64_t i = 0; i < num; i++) {
+    float f = float(i);
+    if (i % 4)
+      world.create(Transform{f, f, 0, 0, 0, 0, 1, 1, 1},
+                   Body{1, 2, 3, 1, uint32_t(i)});
+    else
+      world.create(Transform{f, f, 0, 0, 0, 0, 1, 1, 1},
+                   Body{1, 2, 3, 1, uint32_t(i)}, Health{100});
+  }
+}
+
+/// Time the main thread spends copying the World.
+void BM_Snapshot(benchmark::State &state) {
+  SaveSchema schema = make_schema();
+  World world;
+  populate(world, state.range(0));
+  for (auto _ : state) {
+    WorldSnapshot snapshot(world, schema);
+    benchmark::DoNotOptimize(&snapshot);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Snapshot)->Arg(1000000)->Unit(benchmark::kMillisecond);
+
+/// Load a save of about 100 MiB (uncompressed).
+void BM_Load(benchmark::State &state) {
+  SaveSchema schema = make_schema();
+  JobPool pool;
+  ByteWriter file;
+  {
+    World world;
+    populate(world, state.range(0));
+    ByteWriter raw;
+    WorldSnapshot(world, schema).write(raw);
+    compress_blocks(raw.data(), raw.size(), file, pool);
+    state.counters["raw_bytes"] = raw.size();
+    state.counters["file_bytes"] = file.size();
+  }
+  for (auto _ : state) {
+    World world;
+    load_save(world, schema, file.data(), file.size(), pool);
+    benchmark::DoNotOptimize(world.size());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Load)->Arg(1500000)->Unit(benchmark::kMillisecond);
+
+} // namespace
@@ -0,0 +1,77 @@
+#include <cmath>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "job.hpp"
+#include "spatial.hpp"
+
+namespace {
+
+/// Objects wandering around a square world at a density like a busy level.
+struct Scene {
+  std::vector<Aabb> boxes;
+  std::vector<std::pair<float, float>> velocity;
+  SpatialHash grid{16};
+
+  explicit Scene(int64_t num) {
+    std::mt19937 prand(1);
+    float extent = std::sqrt(float(num)) * 24;
+    std::uniform_real_distribution<float> pos(0, extent);
+    std::uniform_real_distribution<float> speed(-2, 2);
+    for (int64_t i = 0; i < num; i++) {
+      float x = pos(prand), y = pos(prand);
+      boxes.push_back({x, y, x + 8, y + 8});
+      velocity.emplace_back(speed(prand), speed(prand));
+      grid.insert(boxes.back());
+    }
+  }
+
+  void step() {
+    for (uint32_t i = 0; i < boxes.size(); i++) {
+      auto [vx, vy] = velocity[i];
+      Aabb &b = boxes[i];
+      b = {b.min_x + vx, b.min_y + vy, b.max_x + vx, b.max_y + vy};
+      grid.update(i, b);
+    }
+  }
+};
+
+void BM_Update(benchmark::State &state) {
+  Scene scene(state.range(0));
+  for (auto _ : state)
+    scene.step();
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Update)->Arg(50000);
+
+void BM_Pairs(benchmark::State &state) {
+  Scene scene(state.range(0));
+  JobPool pool;
+  std::vector<std::pair<uint32_t, uint32_t>> pairs;
+  for (auto _ : state) {
+    scene.grid.pairs(pairs, pool);
+    benchmark::DoNotOptimize(pairs.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Pairs)->Arg(50000);
+
+void BM_BatchQuery(benchmark::State &state) {
+  Scene scene(state.range(0));
+  JobPool pool;
+  std::vector<Circle> circles;
+  for (auto &b : scene.boxes)
+    circles.push_back({b.min_x, b.min_y, 32});
+  std::vector<uint32_t> offsets, ids;
+  for (auto _ : state) {
+    scene.grid.query(circles.data(), circles.size(), offsets, ids, pool);
+    benchmark::DoNotOptimize(ids.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BatchQuery)->Arg(50000);
+
+} // namespace
@@ -0,0 +1,40 @@
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "image.hpp"
+#include "job.hpp"
+#include "sprite.hpp"
+
+namespace {
+
+/// Draw a frame of 32x32 sprites on a 1080p target.
+void BM_SpritesPerFrame(benchmark::State &state) {
+  JobPool pool;
+  SpriteRenderer renderer(pool);
+  Image atlas(ImageType::RGBA, 256, 256);
+  for (unsigned y = 0; y < 256; y++)
+    for (unsigned x = 0; x < 256; x++)
+      for (int c = 0; c < 4; c++)
+        atlas.pixel(x, y)[c] = x ^ y ^ c;
+  Image target(ImageType::RGBA, 1920, 1080);
+  std::mt19937 prand(1);
+  std::uniform_real_distribution<float> x(-16, 1920), y(-16, 1080);
+  std::uniform_int_distribution<unsigned> cell(0, 7);
+  std::vector<Sprite> sprites;
+  for (int64_t i = 0; i < state.range(0); i++)
+    sprites.push_back({0, cell(prand) * 32, cell(prand) * 32, 32, 32, x(prand),
+                       y(prand), 32, 32, {255, 255, 255, 255}});
+  ConstImageView atlases[] = {atlas};
+  for (auto _ : state) {
+    renderer.draw(target, atlases, sprites.data(), sprites.size());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.counters["frames"] = benchmark::Counter(
+      state.iterations(), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_SpritesPerFrame)->Arg(1000)->Arg(10000)->Arg(50000);
+
+} // namespace
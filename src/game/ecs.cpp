@@ -0,0 +1,279 @@
+#include "ecs.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <new>
+
+#include "util.hpp"
+
+namespace detail::ecs {
+
+namespace {
+
+/// Chunks are aligned to cache lines.
+constexpr size_t chunk_align = 64;
+
+struct ComponentInfo {
+  size_t size;
+  size_t align;
+};
+
+// Registered types are never removed, so a fixed array can be read without
+// locking once the count has been published.
+std::array<ComponentInfo, max_components> registry;
+std::atomic<unsigned> registry_size = 0;
+std::mutex registry_lock;
+
+size_t align_up(size_t n, size_t align) {
+  return (n + align - 1) / align * align;
+}
+
+} // namespace
+
+unsigned register_component(size_t size, size_t align) {
+  std::lock_guard<std::mutex> guard(registry_lock);
+  unsigned id = registry_size;
+  if (max_components <= id) {
+    log_crit("Too many component types: %u", id + 1);
+    throw FatalError::ResourceLimit;
+  }
+  if (chunk_size / 4 < size) {
+    log_crit("Component is too large: %zu bytes", size);
+    throw FatalError::ResourceLimit;
+  }
+  registry[id] = {size, align};
+  registry_size = id + 1;
+  return id;
+}
+
+size_t component_size(unsigned id) {
+  assert(id < registry_size);
+  return registry[id].size;
+}
+
+void ChunkDeleter::operator()(uint8_t *p) const {
+  ::operator delete(p, std::align_val_t(chunk_align));
+}
+
+Archetype::Archetype(ComponentMask m) : mask(m) {
+  offset.fill(0);
+  add_edge.fill(-1);
+  remove_edge.fill(-1);
+  // Start with an upper bound on capacity and shrink it until the arrays (plus
+  // alignment padding) fit in one chunk.
+  size_t row_size = sizeof(Entity);
+  for (unsigned id = 0; id < max_components; id++)
+    if (mask >> id & 1)
+      row_size += registry[id].size;
+  for (capacity = chunk_size / row_size; capacity; capacity--) {
+    size_t end = capacity * sizeof(Entity);
+    for (unsigned id = 0; id < max_components; id++) {
+      if (mask >> id & 1) {
+        end = align_up(end, registry[id].align);
+        offset[id] = end;
+        end += capacity * registry[id].size;
+      }
+    }
+    if (end <= chunk_size)
+      return;
+  }
+  log_crit("Components don't fit in a chunk: %zu bytes", row_size);
+  throw FatalError::ResourceLimit;
+}
+
+uint32_t Archetype::push(Entity e) {
+  if (size == chunks.size() * capacity) {
+    auto p = static_cast<uint8_t *>(
+        ::operator new(chunk_size, std::align_val_t(chunk_align)));
+    chunks.emplace_back(p);
+  }
+  uint32_t row = size++;
+  entities(row / capacity)[row % capacity] = e;
+  return row;
+}
+
+Entity Archetype::swap_remove(uint32_t row) {
+  assert(row < size);
+  uint32_t last = --size;
+  Entity moved = entities(last / capacity)[last % capacity];
+  if (row != last) {
+    entities(row / capacity)[row % capacity] = moved;
+    for (unsigned id = 0; id < max_components; id++) {
+      if (mask >> id & 1) {
+        size_t n = registry[id].size;
+        memcpy(at(row, id, n), at(last, id, n), n);
+      }
+    }
+  }
+  // Release the last chunk as soon as it's empty.
+  if (size == (chunks.size() - 1) * capacity)
+    chunks.pop_back();
+  return moved;
+}
+
+} // namespace detail::ecs
+
+using namespace detail::ecs;
+
+World::World() { archetype(0); }
+World::~World() = default;
+
+Entity World::create_raw(ComponentMask mask, const void *const *src) {
+  uint32_t index;
+  if (m_free.empty()) {
+    index = m_records.size();
+    m_records.push_back({0, 0, 0, false});
+  } else {
+    index = m_free.back();
+    m_free.pop_back();
+  }
+  Record &r = m_records[index];
+  Entity e = {index, r.generation};
+  r.archetype = archetype(mask);
+  Archetype &a = *m_archetypes[r.archetype];
+  r.row = a.push(e);
+  r.alive = true;
+  for (unsigned id = 0; id < max_components; id++)
+    if (mask >> id & 1)
+      memcpy(a.at(r.row, id, component_size(id)), src[id], component_size(id));
+  return e;
+}
+
+void World::destroy(Entity e) {
+  if (!alive(e))
+    return;
+  Record &r = m_records[e.index];
+  Entity moved = m_archetypes[r.archetype]->swap_remove(r.row);
+  m_records[moved.index].row = r.row;
+  r.alive = false;
+  r.generation++;
+  m_free.push_back(e.index);
+}
+
+void World::add_raw(Entity e, unsigned id, const void *src) {
+  if (!alive(e))
+    return;
+  Record &r = m_records[e.index];
+  Archetype *a = m_archetypes[r.archetype].get();
+  if (!(a->mask >> id & 1)) {
+    int32_t &edge = a->add_edge[id];
+    if (edge < 0)
+      edge = archetype(a->mask | ComponentMask(1) << id);
+    move(e, edge);
+    a = m_archetypes[r.archetype].get();
+  }
+  memcpy(a->at(r.row, id, component_size(id)), src, component_size(id));
+}
+
+void World::remove_raw(Entity e, unsigned id) {
+  if (!alive(e))
+    return;
+  Record &r = m_records[e.index];
+  Archetype *a = m_archetypes[r.archetype].get();
+  if (a->mask >> id & 1) {
+    int32_t &edge = a->remove_edge[id];
+    if (edge < 0)
+      edge = archetype(a->mask & ~(ComponentMask(1) << id));
+    move(e, edge);
+  }
+}
+
+uint32_t World::archetype(ComponentMask mask) {
+  auto it = m_archetype_index.find(mask);
+  if (it != m_archetype_index.end())
+    return it->second;
+  uint32_t index = m_archetypes.size();
+  m_archetypes.push_back(std::make_unique<Archetype>(mask));
+  m_archetype_index.emplace(mask, index);
+  return index;
+}
+
+void World::move(Entity e, uint32_t dst) {
+  Record &r = m_records[e.index];
+  Archetype &from = *m_archetypes[r.archetype];
+  Archetype &to = *m_archetypes[dst];
+  uint32_t row = to.push(e);
+  ComponentMask shared = from.mask & to.mask;
+  for (unsigned id = 0; id < max_components; id++) {
+    if (shared >> id & 1) {
+      size_t n = component_size(id);
+      memcpy(to.at(row, id, n), from.at(r.row, id, n), n);
+    }
+  }
+  Entity moved = from.swap_remove(r.row);
+  m_records[moved.index].row = r.row;
+  r.archetype = dst;
+  r.row = row;
+}
+
+const std::vector<World::Archetype *> &World::matches(ComponentMask mask) {
+  std::lock_guard<std::mutex> guard(m_query_lock);
+  QueryCache &q = m_queries[mask];
+  // Only archetypes created since the last call need to be checked.
+  for (; q.seen < m_archetypes.size(); q.seen++)
+    if ((m_archetypes[q.seen]->mask & mask) == mask)
+      q.matches.push_back(m_archetypes[q.seen].get());
+  return q.matches;
+}
+
+void CommandBuffer::apply(World &world) {
+  size_t off = 0;
+  while (off < m_data.size()) {
+    Header h;
+    memcpy(&h, m_data.data() + off, sizeof h);
+    off += (sizeof h + 7) / 8 * 8;
+    const uint8_t *payload = m_data.data() + off;
+    switch (h.op) {
+    case Op::Create: {
+      std::array<const void *, max_components> src = {};
+      for (unsigned id = 0; id < max_components; id++) {
+        if (h.mask >> id & 1) {
+          src[id] = m_data.data() + off;
+          off += (component_size(id) + 7) / 8 * 8;
+        }
+      }
+      world.create_raw(h.mask, src.data());
+      break;
+    }
+    case Op::Destroy:
+      world.destroy(h.entity);
+      break;
+    case Op::Add:
+      world.add_raw(h.entity, h.id, payload);
+      off += (component_size(h.id) + 7) / 8 * 8;
+      break;
+    case Op::Remove:
+      world.remove_raw(h.entity, h.id);
+      break;
+    }
+  }
+  m_data.clear();
+}
+
+void Schedule::add(const char *name, Access a, System fn) {
+  if (m_stages.empty() || a.conflicts(m_last_stage)) {
+    m_stages.push_back(m_systems.size());
+    m_last_stage = Access();
+  }
+  m_last_stage.reads |= a.reads;
+  m_last_stage.writes |= a.writes;
+  m_systems.push_back({name, a, std::move(fn), {}});
+}
+
+void Schedule::run(World &world, JobPool &pool) {
+  for (size_t s = 0; s < m_stages.size(); s++) {
+    size_t begin = m_stages[s];
+    size_t end = s + 1 < m_stages.size() ? m_stages[s + 1] : m_systems.size();
+    pool.run(end - begin, [&](size_t i) {
+      Entry &sys = m_systems[begin + i];
+      try {
+        sys.fn(world, sys.commands);
+      } catch (FatalError) {
+        log_crit("System failed: %s", sys.name);
+        throw;
+      }
+    });
+  }
+  for (auto &sys : m_systems)
+    sys.commands.apply(world);
+}
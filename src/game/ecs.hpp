@@ -0,0 +1,476 @@
+/**
+ * \file
+ * \brief Entity component system with archetype storage.
+ *
+ * Entities with the same set of components share an archetype. Each archetype
+ * stores its entities in fixed-size chunks, and each chunk stores one array per
+ * component (struct of arrays). Systems iterate whole arrays at a time.
+ *
+ * Components must be plain data (trivially copyable). There can be at most 64
+ * component types per program.
+ */
+
+#ifndef ECS_HPP
+#define ECS_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "job.hpp"
+
+class CommandBuffer;
+class WorldSnapshot;
+
+/// A handle to an entity. It becomes invalid when the entity is destroyed.
+struct Entity {
+  uint32_t index;      ///< Slot in the entity table.
+  uint32_t generation; ///< Incremented each time a slot is reused.
+
+  bool operator==(Entity rhs) const {
+    return index == rhs.index && generation == rhs.generation;
+  }
+  bool operator!=(Entity rhs) const { return !(*this == rhs); }
+};
+
+/// A set of component types (one bit per type).
+using ComponentMask = uint64_t;
+
+/// Components that a system reads and writes.
+struct Access {
+  ComponentMask reads = 0;  ///< Read-only components.
+  ComponentMask writes = 0; ///< Components that are modified.
+
+  /// Check if two systems can't run at the same time.
+  bool conflicts(const Access &other) const {
+    return (writes & (other.reads | other.writes)) ||
+           (other.writes & (reads | writes));
+  }
+};
+
+namespace detail::ecs {
+
+/// Maximum number of component types.
+constexpr unsigned max_components = 64;
+
+/// Bytes of storage in each chunk.
+constexpr size_t chunk_size = 16384;
+
+/**
+ * \internal
+ * \brief Assign an ID to a new component type.
+ * \throw FatalError::ResourceLimit if there are too many component types
+ */
+unsigned register_component(size_t size, size_t align);
+
+/// \internal Get the size in bytes of the given component type.
+size_t component_size(unsigned id);
+
+/// \internal Free chunk memory with the matching alignment.
+struct ChunkDeleter {
+  void operator()(uint8_t *p) const;
+};
+
+/**
+ * \internal
+ * \brief Storage for all entities that have the same set of components.
+ *
+ * Entity rows are dense. Row r lives in chunk r / capacity. All chunks except
+ * the last are always full.
+ */
+class Archetype {
+public:
+  ComponentMask mask;
+  uint32_t capacity; ///< Entities per chunk.
+  uint32_t size = 0; ///< Total number of entities.
+  /// Byte offset of each component's array within a chunk.
+  std::array<uint16_t, max_components> offset;
+  std::vector<std::unique_ptr<uint8_t[], ChunkDeleter>> chunks;
+  /// Cached archetype index after adding or removing a component (or -1).
+  std::array<int32_t, max_components> add_edge, remove_edge;
+
+  explicit Archetype(ComponentMask m);
+
+  /// Get the number of entities in the given chunk.
+  uint32_t chunk_count(size_t chunk) const {
+    return std::min<uint32_t>(capacity, size - chunk * capacity);
+  }
+
+  /// Get the array of entity handles in the given chunk.
+  Entity *entities(size_t chunk) const {
+    return reinterpret_cast<Entity *>(chunks[chunk].get());
+  }
+
+  /// Get the array of component values in the given chunk.
+  void *column(size_t chunk, unsigned id) const {
+    return chunks[chunk].get() + offset[id];
+  }
+
+  /// Get a pointer to one component value.
+  void *at(uint32_t row, unsigned id, size_t elem_size) const {
+    return static_cast<uint8_t *>(column(row / capacity, id)) +
+           (row % capacity) * elem_size;
+  }
+
+  /// Append an entity with uninitialized components. Return its row.
+  uint32_t push(Entity e);
+
+  /**
+   * \brief Remove a row by moving the last row into it.
+   * \return the entity that moved into the row (or the removed entity if it
+   *         was already the last row)
+   */
+  Entity swap_remove(uint32_t row);
+};
+
+} // namespace detail::ecs
+
+/// Get the ID of a component type.
+template <typename T> unsigned component_id() {
+  if constexpr (std::is_const_v<T>) {
+    return component_id<std::remove_const_t<T>>();
+  } else {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "Components must be plain data");
+    static const unsigned id =
+        detail::ecs::register_component(sizeof(T), alignof(T));
+    return id;
+  }
+}
+
+/// Get the set of component types in a parameter pack.
+template <typename... T> ComponentMask component_mask() {
+  return (ComponentMask(0) | ... | (ComponentMask(1) << component_id<T>()));
+}
+
+/**
+ * \brief Get the access pattern for a list of component types.
+ *
+ * Const types are read-only. Other types are written.
+ */
+template <typename... T> Access access() {
+  Access a;
+  ((a.reads |= std::is_const_v<T> ? component_mask<T>() : 0), ...);
+  ((a.writes |= std::is_const_v<T> ? 0 : component_mask<T>()), ...);
+  return a;
+}
+
+template <typename... T> class Query;
+
+/**
+ * \brief Container for all entities and their components.
+ *
+ * Functions that add or remove entities or components are "structural
+ * changes". They are not thread-safe, and they invalidate component pointers.
+ * Use a CommandBuffer to make structural changes from a system.
+ */
+class World {
+  friend class CommandBuffer;
+  friend class WorldSnapshot;
+  template <typename... T> friend class Query;
+  using Archetype = detail::ecs::Archetype;
+
+  /// Location of an entity's data.
+  struct Record {
+    uint32_t archetype;
+    uint32_t row;
+    uint32_t generation;
+    bool alive;
+  };
+
+  std::vector<Record> m_records;
+  std::vector<uint32_t> m_free;
+  std::vector<std::unique_ptr<Archetype>> m_archetypes;
+  std::unordered_map<ComponentMask, uint32_t> m_archetype_index;
+
+  /// Cached list of archetypes that match a query.
+  struct QueryCache {
+    std::vector<Archetype *> matches;
+    size_t seen = 0; ///< Number of archetypes that were checked.
+  };
+
+  std::mutex m_query_lock;
+  std::unordered_map<ComponentMask, QueryCache> m_queries;
+
+public:
+  World();
+  World(const World &other) = delete;
+  World &operator=(const World &other) = delete;
+  ~World();
+
+  /// Create an entity with no components.
+  Entity create() { return create_raw(0, nullptr); }
+
+  /// Create an entity with the given component values.
+  template <typename... T> Entity create(const T &...values) {
+    static_assert(sizeof...(T) < detail::ecs::max_components);
+    std::array<const void *, detail::ecs::max_components> src = {};
+    ((src[component_id<T>()] = &values), ...);
+    return create_raw(component_mask<T...>(), src.data());
+  }
+
+  /// Destroy an entity. Does nothing if the handle is stale.
+  void destroy(Entity e);
+
+  /// Check if an entity handle refers to a live entity.
+  bool alive(Entity e) const {
+    return e.index < m_records.size() && m_records[e.index].alive &&
+           m_records[e.index].generation == e.generation;
+  }
+
+  /// Get the number of live entities.
+  size_t size() const { return m_records.size() - m_free.size(); }
+
+  /// Add a component to an entity, or overwrite the existing value.
+  template <typename T> void add(Entity e, const T &value) {
+    add_raw(e, component_id<T>(), &value);
+  }
+
+  /// Remove a component from an entity if it has one.
+  template <typename T> void remove(Entity e) {
+    remove_raw(e, component_id<T>());
+  }
+
+  /// Check if an entity has a component.
+  template <typename T> bool has(Entity e) const {
+    if (!alive(e))
+      return false;
+    ComponentMask mask = m_archetypes[m_records[e.index].archetype]->mask;
+    return mask & ComponentMask(1) << component_id<T>();
+  }
+
+  /// Get a pointer to an entity's component, or null if it doesn't have one.
+  template <typename T> T *get(Entity e) {
+    if (!has<T>(e))
+      return nullptr;
+    const Record &r = m_records[e.index];
+    return static_cast<T *>(
+        m_archetypes[r.archetype]->at(r.row, component_id<T>(), sizeof(T)));
+  }
+
+  /// Create a query for entities that have all the given components.
+  template <typename... T> Query<T...> query() { return Query<T...>(*this); }
+
+private:
+  Entity create_raw(ComponentMask mask, const void *const *src);
+  void add_raw(Entity e, unsigned id, const void *src);
+  void remove_raw(Entity e, unsigned id);
+
+  /// Find or create the archetype with the given components.
+  uint32_t archetype(ComponentMask mask);
+
+  /// Move an entity to another archetype, keeping the shared components.
+  void move(Entity e, uint32_t dst);
+
+  /// Get the archetypes that have all the given components.
+  const std::vector<Archetype *> &matches(ComponentMask mask);
+};
+
+/**
+ * \brief Iterate over all entities with a set of components.
+ *
+ * Matching archetypes are cached, so it's cheap to create a query each frame.
+ * Const component types are read-only.
+ */
+template <typename... T> class Query {
+  World &m_world;
+  ComponentMask m_mask;
+
+public:
+  explicit Query(World &world)
+      : m_world(world), m_mask(component_mask<T...>()) {}
+
+  /// Get the access pattern of this query for scheduling.
+  static Access access() { return ::access<T...>(); }
+
+  /// Count the matching entities.
+  size_t size() const {
+    size_t n = 0;
+    for (auto *a : m_world.matches(m_mask))
+      n += a->size;
+    return n;
+  }
+
+  /**
+   * \brief Call a function once per chunk with the component arrays.
+   * \param fn called with (count, entities, T *arrays...)
+   */
+  template <typename F> void each_chunk(F &&fn) {
+    for (auto *a : m_world.matches(m_mask))
+      for (size_t c = 0; c < a->chunks.size(); c++)
+        fn(a->chunk_count(c), const_cast<const Entity *>(a->entities(c)),
+           static_cast<T *>(a->column(c, component_id<T>()))...);
+  }
+
+  /// Call a function with references to each entity's components.
+  template <typename F> void each(F &&fn) {
+    each_chunk([&](uint32_t n, const Entity *, T *...arrays) {
+      for (uint32_t i = 0; i < n; i++)
+        fn(arrays[i]...);
+    });
+  }
+
+  /**
+   * \brief Like each_chunk() but chunks are processed in parallel.
+   *
+   * The function must be safe to call from several threads at once.
+   */
+  template <typename F> void parallel_each_chunk(JobPool &pool, F &&fn);
+
+  /// Like each() but chunks are processed in parallel.
+  template <typename F> void parallel_each(JobPool &pool, F &&fn) {
+    parallel_each_chunk(pool, [&](uint32_t n, const Entity *, T *...arrays) {
+      for (uint32_t i = 0; i < n; i++)
+        fn(arrays[i]...);
+    });
+  }
+};
+
+/**
+ * \brief Record structural changes to apply to a World later.
+ *
+ * Each system gets its own command buffer, so systems that run in parallel
+ * don't need to synchronize with each other.
+ */
+class CommandBuffer {
+  enum class Op : uint8_t { Create, Destroy, Add, Remove };
+
+  /// Fixed-size part of each recorded command.
+  struct Header {
+    Op op;
+    uint8_t id;
+    Entity entity;
+    ComponentMask mask;
+  };
+
+  std::vector<uint8_t> m_data;
+
+public:
+  /// Check if there are no commands.
+  bool empty() const { return m_data.empty(); }
+
+  /// Record the creation of an entity with the given component values.
+  template <typename... T> void create(const T &...values) {
+    push({Op::Create, 0, {}, component_mask<T...>()});
+    // Values are stored in component ID order, like World::create_raw().
+    std::array<std::pair<unsigned, const void *>, sizeof...(T)> src = {
+        std::make_pair(component_id<T>(), &values)...};
+    std::sort(src.begin(), src.end(),
+              [](auto &a, auto &b) { return a.first < b.first; });
+    for (auto &[id, p] : src)
+      append(p, detail::ecs::component_size(id));
+  }
+
+  /// Record the destruction of an entity.
+  void destroy(Entity e) { push({Op::Destroy, 0, e, 0}); }
+
+  /// Record adding or overwriting a component.
+  template <typename T> void add(Entity e, const T &value) {
+    unsigned id = component_id<T>();
+    push({Op::Add, uint8_t(id), e, 0});
+    append(&value, sizeof(T));
+  }
+
+  /// Record removing a component.
+  template <typename T> void remove(Entity e) {
+    push({Op::Remove, uint8_t(component_id<T>()), e, 0});
+  }
+
+  /**
+   * \brief Apply all commands in the order they were recorded, then clear.
+   *
+   * Commands that refer to destroyed entities are ignored.
+   */
+  void apply(World &world);
+
+private:
+  void push(const Header &h) { append(&h, sizeof h); }
+
+  /// Append bytes, padded to keep the next command aligned.
+  void append(const void *p, size_t n) {
+    size_t off = m_data.size();
+    m_data.resize(off + (n + 7) / 8 * 8);
+    memcpy(m_data.data() + off, p, n);
+  }
+};
+
+/**
+ * \brief A list of systems that run in order, in parallel where possible.
+ *
+ * Systems are grouped into stages. Systems in the same stage don't conflict
+ * (no system writes a component that another one reads or writes), so they run
+ * at the same time. The stages run in order. A system never moves to an
+ * earlier stage than a system that was added before it, so conflicting
+ * systems always run in the order they were added.
+ */
+class Schedule {
+public:
+  /// A system reads and writes components, and records structural changes.
+  using System = std::function<void(World &, CommandBuffer &)>;
+
+private:
+  struct Entry {
+    const char *name;
+    Access access;
+    System fn;
+    CommandBuffer commands;
+  };
+
+  std::vector<Entry> m_systems;
+  /// Index of the first system of each stage.
+  std::vector<size_t> m_stages;
+  Access m_last_stage;
+
+public:
+  /**
+   * \brief Add a system.
+   * \param name label for logging
+   * \param a components that the system uses
+   * \param fn the system
+   */
+  void add(const char *name, Access a, System fn);
+
+  /// Add a system whose access pattern is given by the type list.
+  template <typename... T> void add(const char *name, System fn) {
+    add(name, access<T...>(), std::move(fn));
+  }
+
+  /// Get the number of stages.
+  size_t stages() const { return m_stages.size(); }
+
+  /**
+   * \brief Run all systems once, then apply their structural changes.
+   *
+   * Command buffers are applied in the order the systems were added.
+   */
+  void run(World &world, JobPool &pool);
+};
+
+template <typename... T>
+template <typename F>
+void Query<T...>::parallel_each_chunk(JobPool &pool, F &&fn) {
+  struct Task {
+    detail::ecs::Archetype *archetype;
+    size_t chunk;
+  };
+  std::vector<Task> tasks;
+  for (auto *a : m_world.matches(m_mask))
+    for (size_t c = 0; c < a->chunks.size(); c++)
+      tasks.push_back({a, c});
+  pool.run(tasks.size(), [&](size_t i) {
+    auto [a, c] = tasks[i];
+    fn(a->chunk_count(c), const_cast<const Entity *>(a->entities(c)),
+       static_cast<T *>(a->column(c, component_id<T>()))...);
+  });
+}
+
+#endif
@@ -0,0 +1,137 @@
+#include "input.hpp"
+
+#include <algorithm>
+
+#include <SDL3/SDL_timer.h>
+
+namespace {
+
+/// Check if an event comes from an input device.
+bool is_input(uint32_t type) {
+  switch (type) {
+  case SDL_EVENT_KEY_DOWN:
+  case SDL_EVENT_KEY_UP:
+  case SDL_EVENT_TEXT_INPUT:
+  case SDL_EVENT_MOUSE_MOTION:
+  case SDL_EVENT_MOUSE_BUTTON_DOWN:
+  case SDL_EVENT_MOUSE_BUTTON_UP:
+  case SDL_EVENT_MOUSE_WHEEL:
+  case SDL_EVENT_GAMEPAD_AXIS_MOTION:
+  case SDL_EVENT_GAMEPAD_BUTTON_DOWN:
+  case SDL_EVENT_GAMEPAD_BUTTON_UP:
+    return true;
+  default:
+    return false;
+  }
+}
+
+} // namespace
+
+const std::vector<SDL_Event> &InputSampler::sample() {
+  if (uint64_t wait = delay(now()))
+    SDL_DelayPrecise(wait);
+  begin(now());
+  SDL_Event e;
+  while (SDL_PollEvent(&e))
+    add(e);
+  return m_events;
+}
+
+void InputSampler::add(const SDL_Event &e) {
+  switch (e.type) {
+  case SDL_EVENT_KEY_DOWN:
+  case SDL_EVENT_KEY_UP:
+    if (e.key.scancode < SDL_SCANCODE_COUNT)
+      m_state.keys[e.key.scancode] = e.key.down;
+    break;
+  case SDL_EVENT_MOUSE_MOTION:
+    m_state.mouse_x = e.motion.x;
+    m_state.mouse_y = e.motion.y;
+    m_state.mouse_dx += e.motion.xrel;
+    m_state.mouse_dy += e.motion.yrel;
+    break;
+  case SDL_EVENT_MOUSE_BUTTON_DOWN:
+  case SDL_EVENT_MOUSE_BUTTON_UP: {
+    SDL_MouseButtonFlags mask = SDL_BUTTON_MASK(e.button.button);
+    m_state.buttons = e.button.down ? m_state.buttons | mask
+                                    : m_state.buttons & ~mask;
+    break;
+  }
+  case SDL_EVENT_MOUSE_WHEEL:
+    m_state.wheel_x += e.wheel.x;
+    m_state.wheel_y += e.wheel.y;
+    break;
+  }
+  if (is_input(e.type)) {
+    uint64_t time = e.common.timestamp ? e.common.timestamp : m_sampled;
+    if (!m_oldest || time < m_oldest)
+      m_oldest = time;
+  }
+
+  // Motion can arrive at 1000 Hz, which is more than anyone needs to handle
+  // one by one.
+  SDL_Event *last = m_events.empty() ? nullptr : &m_events.back();
+  if (e.type == SDL_EVENT_MOUSE_MOTION && last &&
+      last->type == SDL_EVENT_MOUSE_MOTION &&
+      last->motion.windowID == e.motion.windowID &&
+      last->motion.which == e.motion.which &&
+      last->motion.state == e.motion.state) {
+    last->motion.timestamp = e.motion.timestamp;
+    last->motion.x = e.motion.x;
+    last->motion.y = e.motion.y;
+    last->motion.xrel += e.motion.xrel;
+    last->motion.yrel += e.motion.yrel;
+    return;
+  }
+  m_events.push_back(e);
+}
+
+InputSampler::Latency InputSampler::latency() const {
+  Latency l;
+  l.frames = std::min(m_latency_count, history);
+  if (!l.frames)
+    return l;
+  l.last = m_latency[(m_latency_count - 1) % history];
+  for (size_t i = 0; i < l.frames; i++) {
+    l.mean += m_latency[i];
+    l.max = std::max(l.max, m_latency[i]);
+  }
+  l.mean /= l.frames;
+  return l;
+}
+
+uint64_t InputSampler::delay(uint64_t time) const {
+  if (m_params.refresh_rate <= 0 || !m_present)
+    return 0;
+  uint64_t period = uint64_t(1e9 / m_params.refresh_rate);
+  uint64_t start = m_present + period - std::min(period, m_work) -
+                   std::min(period, m_params.margin);
+  // Waiting more than a refresh interval would only add latency.
+  return start > time ? std::min(start - time, period) : 0;
+}
+
+void InputSampler::begin(uint64_t time) {
+  m_events.clear();
+  m_oldest = 0;
+  m_sampled = time;
+  m_state.mouse_dx = m_state.mouse_dy = 0;
+  m_state.wheel_x = m_state.wheel_y = 0;
+}
+
+void InputSampler::submit(uint64_t time) {
+  // React to slow frames at once, but trust fast frames only gradually, so
+  // that a single hitch doesn't make the next frame miss the refresh.
+  uint64_t work = time - m_sampled;
+  if (m_work < work)
+    m_work = work;
+  else
+    m_work -= (m_work - work) / 16;
+}
+
+void InputSampler::presented(uint64_t time) {
+  m_present = time;
+  if (m_oldest && m_oldest <= time)
+    m_latency[m_latency_count++ % history] = time - m_oldest;
+}
+
+uint64_t InputSampler::now() { return SDL_GetTicksNS(); }
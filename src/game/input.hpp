@@ -0,0 +1,120 @@
+/**
+ * \file
+ * \brief Sample input late in the frame and measure input latency.
+ */
+
+#ifndef INPUT_HPP
+#define INPUT_HPP
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <SDL3/SDL_events.h>
+
+/// Input devices as of the last sample.
+struct InputState {
+  std::bitset<SDL_SCANCODE_COUNT> keys; ///< Keys that are held.
+  float mouse_x = 0, mouse_y = 0;       ///< Cursor position in the window.
+  float mouse_dx = 0, mouse_dy = 0;     ///< Motion since the last sample.
+  float wheel_x = 0, wheel_y = 0;       ///< Scrolling since the last sample.
+  SDL_MouseButtonFlags buttons = 0;     ///< Mouse buttons that are held.
+};
+
+/**
+ * \brief Collect input for each frame and measure how old it is when shown.
+ *
+ * With vsync, a frame that starts right after the previous present waits most
+ * of a refresh interval before it's shown, and its input is that much older.
+ * sample() instead sleeps until just enough time is left to simulate and
+ * render before the next refresh, then reads the events. The time that
+ * leaves is estimated from recent frames.
+ *
+ * Latency is measured from the timestamp of the oldest event in a frame to
+ * the moment SDL_RenderPresent() returns, which doesn't include the display's
+ * own delay.
+ */
+class InputSampler {
+public:
+  /// Tuning parameters.
+  struct Params {
+    /// Display refresh rate in Hz, or 0 to sample as soon as possible.
+    float refresh_rate = 0;
+    /// Extra time to leave before the refresh, in nanoseconds.
+    uint64_t margin = 1000000;
+  };
+
+  /// Latency statistics over recent frames, in nanoseconds.
+  struct Latency {
+    uint64_t last = 0; ///< Latest frame that had input.
+    uint64_t mean = 0;
+    uint64_t max = 0;
+    size_t frames = 0; ///< Number of frames that had input.
+  };
+
+private:
+  /// Frames of latency history.
+  static constexpr size_t history = 128;
+
+  Params m_params;
+  std::vector<SDL_Event> m_events;
+  InputState m_state;
+  uint64_t m_oldest = 0;  ///< Timestamp of the oldest event, or 0.
+  uint64_t m_sampled = 0; ///< Time of the last sample().
+  uint64_t m_work = 0;    ///< Estimated time from sample to present.
+  uint64_t m_present = 0; ///< Time of the last present.
+  std::array<uint64_t, history> m_latency = {};
+  size_t m_latency_count = 0;
+
+public:
+  explicit InputSampler(const Params &params) : m_params(params) {}
+
+  /// Change the refresh rate, e.g. when the window moves to another display.
+  void set_refresh_rate(float hz) { m_params.refresh_rate = hz; }
+
+  /**
+   * \brief Wait until it's time to start the next frame, then read events.
+   * \return this frame's events, with mouse motion merged
+   */
+  const std::vector<SDL_Event> &sample();
+
+  /**
+   * \brief Add an event to the current frame.
+   *
+   * Consecutive motion events from the same mouse are merged into one, with
+   * the total relative motion and the latest position.
+   */
+  void add(const SDL_Event &e);
+
+  /// Get the events of the current frame.
+  const std::vector<SDL_Event> &events() const { return m_events; }
+
+  /// Get the state of the input devices after the current frame's events.
+  const InputState &state() const { return m_state; }
+
+  /// Call right before SDL_RenderPresent(), to measure the frame's work.
+  void submit() { submit(now()); }
+
+  /// Call right after SDL_RenderPresent(), to measure latency.
+  void presented() { presented(now()); }
+
+  /// Get latency statistics over the last 128 frames that had input.
+  Latency latency() const;
+
+  /// Get the time to wait before sampling, in nanoseconds.
+  uint64_t delay(uint64_t time) const;
+
+  /// Like sample() but without waiting or reading events, for testing.
+  void begin(uint64_t time);
+  /// Like submit() with a given time in nanoseconds.
+  void submit(uint64_t time);
+  /// Like presented() with a given time in nanoseconds.
+  void presented(uint64_t time);
+
+private:
+  static uint64_t now();
+};
+
+#endif
@@ -0,0 +1,279 @@
+#include "label.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+#include <SDL3/SDL_error.h>
+
+#include "render.hpp"
+#include "util.hpp"
+
+namespace {
+
+/// Shelf heights are rounded up to a multiple of this, so that blocks of
+/// similar height share shelves.
+constexpr unsigned shelf_step = 8;
+
+uint64_t hash_key(const LabelCache::Key &key) {
+  uint64_t h = 0xcbf29ce484222325; // FNV-1a
+  auto add = [&](const void *data, size_t size) {
+    for (size_t i = 0; i < size; i++)
+      h = (h ^ static_cast<const uint8_t *>(data)[i]) * 0x100000001b3;
+  };
+  add(key.text.data(), key.text.size());
+  add(&key.font, sizeof key.font);
+  add(&key.align, sizeof key.align);
+  add(&key.width, sizeof key.width);
+  // Spread the bits, since nearby keys differ in few of them (MurmurHash3
+  // fmix64).
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccd;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53;
+  h ^= h >> 33;
+  return h;
+}
+
+} // namespace
+
+LabelCache::LabelCache(const Params &params) : m_params(params) {}
+
+LabelCache::~LabelCache() {
+  if (m_texture)
+    SDL_DestroyTexture(m_texture);
+}
+
+void LabelCache::begin_frame() { m_frame++; }
+
+const LabelCache::Block &LabelCache::get(SDL_Renderer *renderer,
+                                         const Key &key) {
+  uint64_t h = hash_key(key);
+  auto it = m_entries.find(h);
+  if (it != m_entries.end()) {
+    Entry &e = it->second;
+    if (e.text == key.text && e.font == key.font && e.align == key.align &&
+        e.width == key.width) {
+      if (e.block.w)
+        m_shelves[e.shelf].used = m_frame;
+      return e.block;
+    }
+    // Another key has the same hash, so replace it.
+    if (e.block.w) {
+      std::vector<uint64_t> &entries = m_shelves[e.shelf].entries;
+      entries.erase(std::find(entries.begin(), entries.end(), h));
+    }
+    m_entries.erase(it);
+  }
+
+  if (!m_texture) {
+    m_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32,
+                                  SDL_TEXTUREACCESS_STATIC,
+                                  m_params.atlas_size, m_params.atlas_size);
+    if (!m_texture) {
+      log_crit("SDL_CreateTexture: %s", SDL_GetError());
+      throw FatalError::Platform;
+    }
+  }
+  Block block = rasterize(key);
+  uint32_t index = 0;
+  if (block.w) {
+    // The image has a transparent border, so that filtering doesn't pick up
+    // the blocks next to it.
+    index = allocate(m_staging.width(), m_staging.height());
+    Shelf &shelf = m_shelves[index];
+    SDL_Rect rect = {int(shelf.x), int(shelf.y), int(m_staging.width()),
+                     int(m_staging.height())};
+    if (!SDL_UpdateTexture(m_texture, &rect, m_staging.pixel(0, 0),
+                           m_staging.stride())) {
+      log_crit("SDL_UpdateTexture: %s", SDL_GetError());
+      throw FatalError::Platform;
+    }
+    block.x = shelf.x + 1;
+    block.y = shelf.y + 1;
+    shelf.x += m_staging.width();
+    shelf.used = m_frame;
+    shelf.entries.push_back(h);
+  }
+  Entry &e = m_entries[h];
+  e = {std::string(key.text), key.font, key.align, key.width, block, index};
+  return e.block;
+}
+
+const LabelCache::Block &LabelCache::draw(SDL_Renderer *renderer,
+                                          RenderQueue &queue, const Key &key,
+                                          float x, float y, uint8_t layer,
+                                          SDL_FColor color) {
+  const Block &block = get(renderer, key);
+  if (!block.w)
+    return block;
+  uint64_t sort =
+      sort_key(layer, queue.texture(m_texture), BlendMode::Blend, 0);
+  float size = m_params.atlas_size;
+  SDL_FRect dst = {std::round(x) + block.left, std::round(y) + block.top,
+                   float(block.w), float(block.h)};
+  SDL_FRect uv = {block.x / size, block.y / size, block.w / size,
+                  block.h / size};
+  queue.quad(sort, dst, uv, color);
+  return block;
+}
+
+void LabelCache::clear() {
+  m_entries.clear();
+  m_shelves.clear();
+  m_shelf_end = 0;
+}
+
+void LabelCache::wrap(Font &font, std::string_view text, float width,
+                      std::vector<std::string_view> &lines) {
+  lines.clear();
+  for (size_t start = 0;;) {
+    size_t end = std::min(text.find('\n', start), text.size());
+    std::string_view paragraph = text.substr(start, end - start);
+    if (width <= 0) {
+      lines.push_back(paragraph);
+    } else {
+      // Add words while the line fits. fit is the end of the last word on
+      // the line, or 0 before the first word.
+      size_t line = 0, fit = 0;
+      for (size_t pos = 0;;) {
+        size_t word = paragraph.find_first_not_of(' ', pos);
+        if (word == std::string_view::npos)
+          break;
+        pos = std::min(paragraph.find(' ', word), paragraph.size());
+        if (fit && width < font.measure(paragraph.substr(line, pos - line))) {
+          lines.push_back(paragraph.substr(line, fit - line));
+          line = word;
+        }
+        fit = pos;
+      }
+      lines.push_back(paragraph.substr(line, fit - line));
+    }
+    if (end == text.size())
+      break;
+    start = end + 1;
+  }
+}
+
+LabelCache::Block LabelCache::rasterize(const Key &key) {
+  Font &font = *key.font;
+  std::vector<std::string_view> lines;
+  wrap(font, key.text, key.width, lines);
+
+  // Glyphs are placed on whole pixels, like the text of PerfOverlay.
+  struct Ink {
+    const Font::Glyph *glyph;
+    long x, y;
+  };
+  std::vector<Ink> ink;
+  std::vector<size_t> line_end; ///< End of each line's glyphs in ink.
+  std::vector<float> widths;
+  std::vector<Font::Placement> placements;
+  float line_h = std::ceil(font.line_height());
+  float baseline = std::round(font.ascent());
+  float box_w = 0;
+  for (std::string_view line : lines) {
+    float width = font.shape(line, placements);
+    for (const Font::Placement &p : placements) {
+      const Font::Glyph &g = font.glyph(p.glyph);
+      if (g.w)
+        ink.push_back({&g, std::lround(p.x) + g.left,
+                       std::lround(baseline + p.y) - g.top});
+    }
+    line_end.push_back(ink.size());
+    widths.push_back(width);
+    box_w = std::max(box_w, width);
+    baseline += line_h;
+  }
+  if (0 < key.width)
+    box_w = key.width;
+
+  // Align the lines, and find the area that has ink.
+  Block block = {box_w, lines.size() * line_h, 0, 0, 0, 0, 0, 0};
+  long x0 = LONG_MAX, y0 = LONG_MAX, x1 = LONG_MIN, y1 = LONG_MIN;
+  size_t i = 0;
+  for (size_t line = 0; line < lines.size(); line++) {
+    float space = box_w - widths[line];
+    long offset = key.align == Align::Center  ? std::lround(space / 2)
+                  : key.align == Align::Right ? std::lround(space)
+                                              : 0;
+    for (; i < line_end[line]; i++) {
+      Ink &k = ink[i];
+      k.x += offset;
+      x0 = std::min(x0, k.x);
+      y0 = std::min(y0, k.y);
+      x1 = std::max(x1, k.x + k.glyph->w);
+      y1 = std::max(y1, k.y + k.glyph->h);
+    }
+  }
+  if (ink.empty())
+    return block;
+  unsigned w = x1 - x0, h = y1 - y0;
+  if (m_params.atlas_size < w + 2 || m_params.atlas_size < h + 2) {
+    log_crit("Label is too large for the atlas: %u by %u", w, h);
+    throw FatalError::ResourceLimit;
+  }
+  block.left = int16_t(x0);
+  block.top = int16_t(y0);
+  block.w = uint16_t(w);
+  block.h = uint16_t(h);
+
+  // Draw white with coverage as alpha, with a border of one pixel.
+  m_staging = Image(ImageType::RGBA, w + 2, h + 2);
+  for (unsigned y = 0; y < h + 2; y++) {
+    uint8_t *dst = m_staging.pixel(0, y);
+    for (unsigned x = 0; x < w + 2; x++, dst += 4) {
+      dst[0] = dst[1] = dst[2] = 255;
+      dst[3] = 0;
+    }
+  }
+  ConstImageView atlas = font.atlas();
+  for (const Ink &k : ink) {
+    const Font::Glyph &g = *k.glyph;
+    for (unsigned gy = 0; gy < g.h; gy++) {
+      const uint8_t *src = atlas.pixel(g.x, g.y + gy);
+      uint8_t *dst = m_staging.pixel(k.x - x0 + 1, k.y - y0 + gy + 1);
+      for (unsigned gx = 0; gx < g.w; gx++, dst += 4)
+        dst[3] = div255(255 * src[gx] + dst[3] * (255 - src[gx]));
+    }
+  }
+  return block;
+}
+
+uint32_t LabelCache::allocate(unsigned w, unsigned h) {
+  unsigned size = m_params.atlas_size;
+  unsigned shelf_h = (h + shelf_step - 1) / shelf_step * shelf_step;
+  shelf_h = std::min(shelf_h, size);
+  for (uint32_t i = 0; i < m_shelves.size(); i++)
+    if (m_shelves[i].h == shelf_h && m_shelves[i].x + w <= size)
+      return i;
+  if (m_shelf_end + shelf_h <= size) {
+    m_shelves.push_back({m_shelf_end, shelf_h, 0, 0, {}});
+    m_shelf_end += shelf_h;
+    return m_shelves.size() - 1;
+  }
+
+  // Empty the least recently used shelf that's tall enough, preferring
+  // shorter ones. Shelves drawn from this frame are still in the queue.
+  Shelf *lru = nullptr;
+  for (Shelf &shelf : m_shelves) {
+    if (shelf.h < h || shelf.used == m_frame)
+      continue;
+    if (!lru || shelf.used < lru->used ||
+        (shelf.used == lru->used && shelf.h < lru->h))
+      lru = &shelf;
+  }
+  if (!lru) {
+    log_crit("Label atlas is full");
+    throw FatalError::ResourceLimit;
+  }
+  evict(*lru);
+  return uint32_t(lru - m_shelves.data());
+}
+
+void LabelCache::evict(Shelf &shelf) {
+  for (uint64_t hash : shelf.entries)
+    m_entries.erase(hash);
+  shelf.entries.clear();
+  shelf.x = 0;
+}
@@ -0,0 +1,169 @@
+/**
+ * \file
+ * \brief Draw text that rarely changes from a cache of rendered blocks.
+ */
+
+#ifndef LABEL_HPP
+#define LABEL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <SDL3/SDL_render.h>
+
+#include "font.hpp"
+#include "image.hpp"
+
+class RenderQueue;
+
+/**
+ * \brief Draws blocks of text such as menus, item names and tooltips as one
+ * quad each.
+ *
+ * The first time a block is drawn, it's laid out, wrapped to a width, and
+ * rasterized into an atlas texture. Until it's evicted, drawing it again
+ * takes one quad from the atlas instead of one per glyph. All blocks share
+ * the texture, so they're batched into one draw call.
+ *
+ * Blocks are identified by their text, font, alignment and wrap width. The
+ * atlas holds white with coverage as alpha, and the color is given as the
+ * vertex color, so one block can be drawn in any color. Fonts are identified
+ * by address, so call clear() before destroying a font that has been used.
+ *
+ * The atlas is split into shelves, rows of blocks of similar height. When a
+ * new block doesn't fit, the least recently used shelf that hasn't been drawn
+ * from since begin_frame() is emptied for it.
+ */
+class LabelCache {
+public:
+  /// Horizontal alignment of the lines of a block.
+  enum class Align : uint8_t { Left, Center, Right };
+
+  /// Identifies a block of text.
+  struct Key {
+    std::string_view text; ///< UTF-8, with lines separated by '\n'.
+    Font *font;
+    Align align = Align::Left;
+    float width = 0; ///< Width to wrap lines at, or 0 not to wrap them.
+  };
+
+  /// A block of text in the atlas.
+  struct Block {
+    /// Size of the laid out text: the wrap width, or the width of the
+    /// longest line if it isn't wrapped, by the height of the lines.
+    float width, height;
+    int16_t left, top;   ///< Offset of the image from the top left corner.
+    uint16_t x, y, w, h; ///< Image in the atlas (0 by 0 if it's blank).
+  };
+
+  /// Tuning parameters.
+  struct Params {
+    unsigned atlas_size = 1024; ///< Width and height of the atlas texture.
+  };
+
+private:
+  struct Entry {
+    std::string text;
+    Font *font;
+    Align align;
+    float width;
+    Block block;
+    uint32_t shelf; ///< Shelf holding the image, if it isn't blank.
+  };
+
+  struct Shelf {
+    unsigned y, h;                 ///< Rows of the atlas.
+    unsigned x = 0;                ///< Start of the free space.
+    uint64_t used = 0;             ///< Last frame that drew from it.
+    std::vector<uint64_t> entries; ///< Blocks in it, by hash.
+  };
+
+  Params m_params;
+  SDL_Texture *m_texture = nullptr;
+  std::unordered_map<uint64_t, Entry> m_entries; ///< By hash of the key.
+  std::vector<Shelf> m_shelves;
+  unsigned m_shelf_end = 0; ///< Top of the space below the shelves.
+  uint64_t m_frame = 1;     ///< Number of calls to begin_frame(), plus 1.
+  Image m_staging;          ///< Image of the last block rasterized.
+
+public:
+  explicit LabelCache(const Params &params);
+
+  /// Destroy the texture. Call before destroying the renderer.
+  ~LabelCache();
+
+  LabelCache(const LabelCache &other) = delete;
+  LabelCache &operator=(const LabelCache &other) = delete;
+
+  /**
+   * \brief Start a frame.
+   *
+   * Blocks drawn after this aren't evicted until the next call, since the
+   * queue still refers to them.
+   */
+  void begin_frame();
+
+  /**
+   * \brief Get a block, rasterizing it into the atlas if it isn't cached.
+   *
+   * The reference is valid until the next call to get(), draw() or clear().
+   *
+   * \param renderer renderer that the atlas texture is made for
+   * \throw FatalError::ResourceLimit if the block doesn't fit in the atlas,
+   * or its glyphs don't fit in the font's atlas
+   * \throw FatalError::Platform if the texture can't be created or updated
+   */
+  const Block &get(SDL_Renderer *renderer, const Key &key);
+
+  /**
+   * \brief Record a block of text as one quad.
+   *
+   * The block is drawn with a blend mode of BlendMode::Blend.
+   *
+   * \param renderer renderer that the queue is flushed to
+   * \param x, y top left corner in render coordinates
+   * \param layer sort key layer, see sort_key()
+   * \param color text color
+   * \return the block, for its size
+   * \throw see get()
+   */
+  const Block &draw(SDL_Renderer *renderer, RenderQueue &queue,
+                    const Key &key, float x, float y, uint8_t layer,
+                    SDL_FColor color);
+
+  /// Get the number of blocks in the cache.
+  size_t size() const { return m_entries.size(); }
+
+  /// Evict every block, such as when a font is destroyed.
+  void clear();
+
+  /// Get the image of the last block rasterized, as it was copied into the
+  /// atlas. It has a transparent border of one pixel.
+  ConstImageView staged() const { return m_staging; }
+
+  /**
+   * \brief Break text into lines.
+   *
+   * Lines end at each '\n', and between words where the next word would make
+   * the line wider than the wrap width. Words wider than the wrap width get a
+   * line of their own.
+   *
+   * \param width width to wrap lines at, or 0 not to wrap them
+   * \param[out] lines parts of the text (replaced)
+   */
+  static void wrap(Font &font, std::string_view text, float width,
+                   std::vector<std::string_view> &lines);
+
+private:
+  /// Lay out and rasterize a block into m_staging.
+  Block rasterize(const Key &key);
+  /// Find space for an image of a block, evicting other blocks if needed.
+  uint32_t allocate(unsigned w, unsigned h);
+  void evict(Shelf &shelf);
+};
+
+#endif
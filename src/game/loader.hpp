@@ -0,0 +1,161 @@
+/**
+ * \file
+ * \brief Read and decode asset files in the background.
+ */
+
+#ifndef LOADER_HPP
+#define LOADER_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "asset.hpp"
+#include "job.hpp"
+#include "util.hpp"
+
+/**
+ * \brief Files that are read by an AssetSystem and decoded on a JobPool.
+ *
+ * Requests are identified by a key that the owner picks, such as the
+ * coordinates of a tile. Results are picked up with take() on the owner's
+ * thread, so the owner never waits on the disk or the decoder. A request is
+ * pending from request() until the owner calls done() with its key, usually
+ * once it has used the result.
+ */
+template <typename T> class AsyncLoader {
+public:
+  /**
+   * \brief Decode a file. Runs on the job pool.
+   * \param data file contents (null-terminated)
+   * \param num file size
+   * \throw FatalError::Decode if the file is invalid
+   */
+  using Decoder =
+      std::function<std::unique_ptr<T>(const uint8_t *data, size_t num)>;
+
+  /// A finished request.
+  struct Loaded {
+    uint64_t key;
+    std::unique_ptr<T> value; ///< Null if the file is missing or invalid.
+  };
+
+private:
+  AssetSystem &m_assets;
+  JobPool &m_pool;
+  std::unordered_map<uint64_t, uint64_t> m_pending; ///< Key to request ID.
+
+  // Results from the loading thread and the job pool.
+  std::mutex m_lock;
+  std::condition_variable m_posted;
+  std::vector<Loaded> m_loaded;
+  size_t m_in_flight = 0; ///< Requests that haven't posted a result.
+
+public:
+  AsyncLoader(AssetSystem &assets, JobPool &pool)
+      : m_assets(assets), m_pool(pool) {}
+
+  /// Cancel pending requests and wait for the ones already in progress.
+  ~AsyncLoader() {
+    std::unique_lock<std::mutex> guard(m_lock);
+    for (auto [key, id] : m_pending)
+      if (m_assets.cancel(id))
+        m_in_flight--;
+    m_posted.wait(guard, [this]() { return !m_in_flight; });
+  }
+
+  AsyncLoader(const AsyncLoader &other) = delete;
+  AsyncLoader &operator=(const AsyncLoader &other) = delete;
+
+  /**
+   * \brief Read and decode a file in the background.
+   * \param key identifies the request, which must not be pending
+   * \param name asset file name
+   * \param priority see AssetSystem::read_async()
+   * \param decode turns the file into a result
+   */
+  void request(uint64_t key, const std::string &name, unsigned priority,
+               Decoder decode) {
+    {
+      std::lock_guard<std::mutex> guard(m_lock);
+      m_in_flight++;
+    }
+    m_pending[key] = m_assets.read_async(
+        name.c_str(), priority,
+        [this, key, name, decode = std::move(decode)](
+            std::unique_ptr<uint8_t[]> data, size_t num) {
+          if (!data) {
+            post(key, nullptr);
+            return;
+          }
+          // Jobs must be copyable, so share the buffer.
+          std::shared_ptr<uint8_t[]> buffer(std::move(data));
+          m_pool.submit([this, key, name, decode, buffer, num]() {
+            std::unique_ptr<T> value;
+            try {
+              value = decode(buffer.get(), num);
+            } catch (FatalError) {
+              log_warn("Can't decode %s", name.c_str());
+            }
+            post(key, std::move(value));
+          });
+        });
+  }
+
+  /// Get the requests that finished since the last call. They're still
+  /// pending until done().
+  std::vector<Loaded> take() {
+    std::vector<Loaded> loaded;
+    std::lock_guard<std::mutex> guard(m_lock);
+    loaded.swap(m_loaded);
+    return loaded;
+  }
+
+  /// Return a result to the next take(), e.g. if there's no room for it yet.
+  void defer(Loaded loaded) {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_loaded.push_back(std::move(loaded));
+  }
+
+  /// Finish with a request, so that its key can be requested again.
+  void done(uint64_t key) { m_pending.erase(key); }
+
+  /// Withdraw requests that are no longer wanted, if they haven't started.
+  void withdraw(const std::unordered_set<uint64_t> &wanted) {
+    for (auto it = m_pending.begin(); it != m_pending.end();) {
+      if (!wanted.count(it->first) && m_assets.cancel(it->second)) {
+        {
+          std::lock_guard<std::mutex> guard(m_lock);
+          m_in_flight--;
+        }
+        it = m_pending.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  /// Check if a request is pending.
+  bool pending(uint64_t key) const { return m_pending.count(key); }
+
+  /// Get the number of pending requests.
+  size_t pending() const { return m_pending.size(); }
+
+private:
+  void post(uint64_t key, std::unique_ptr<T> value) {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_loaded.push_back({key, std::move(value)});
+    m_in_flight--;
+    m_posted.notify_all();
+  }
+};
+
+#endif
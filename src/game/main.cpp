@@ -0,0 +1,294 @@
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <string>
+
+#include <SDL3/SDL_init.h>
+#include <SDL3/SDL_render.h>
+#include <SDL3/SDL_stdinc.h>
+#include <SDL3/SDL_surface.h>
+#include <SDL3/SDL_timer.h>
+#include <SDL3/SDL_video.h>
+
+#include "asset.hpp"
+#include "input.hpp"
+#include "overlay.hpp"
+#include "profile.hpp"
+#include "render.hpp"
+#include "replay.hpp"
+#include "util.hpp"
+#include "version.hpp"
+
+namespace {
+
+/// Log input latency and frame times this often, in nanoseconds.
+constexpr uint64_t report_interval = 5000000000;
+
+/// Get the refresh rate of the display that shows a window, or 0.
+float refresh_rate(SDL_Window *window) {
+  const SDL_DisplayMode *mode =
+      SDL_GetCurrentDisplayMode(SDL_GetDisplayForWindow(window));
+  return mode ? mode->refresh_rate : 0;
+}
+
+/// Pixel size of the performance overlay's text.
+constexpr unsigned overlay_font_size = 14;
+
+/// Write a hitch trace to the working directory.
+void save_trace(const std::string &trace) {
+  static unsigned count = 0;
+  std::string name = "hitch-" + std::to_string(count++) + ".json";
+  std::ofstream out(name, std::ios::binary);
+  out << trace;
+  log_info("Saved %s", name.c_str());
+}
+
+/**
+ * \brief Hash the simulation state, so that playback can tell where a replay
+ * diverges.
+ *
+ * Until there's a game to simulate, the state is the input.
+ */
+uint64_t checksum(const InputState &state) {
+  uint64_t h = 14695981039346656037u;
+  auto mix = [&](uint64_t v) { h = (h ^ v) * 1099511628211u; };
+  for (size_t i = 0; i < state.keys.size(); i++)
+    if (state.keys[i])
+      mix(i);
+  for (float v : {state.mouse_x, state.mouse_y, state.wheel_x, state.wheel_y}) {
+    uint32_t bits;
+    memcpy(&bits, &v, 4);
+    mix(bits);
+  }
+  mix(state.buttons);
+  return h;
+}
+
+/// Simulate and draw a frame. Until there's a game to simulate, draw the
+/// cursor so that lag is easy to see.
+void draw_frame(SDL_Renderer *renderer, const InputState &state) {
+  SDL_SetRenderDrawColor(renderer, 0, 0, 0, SDL_ALPHA_OPAQUE);
+  SDL_RenderClear(renderer);
+  SDL_FRect cursor = {state.mouse_x - 8, state.mouse_y - 8, 16, 16};
+  SDL_SetRenderDrawColor(renderer, 255, 255, 255, SDL_ALPHA_OPAQUE);
+  SDL_RenderFillRect(renderer, &cursor);
+}
+
+/**
+ * \brief Play a replay back to back without a window or vsync, and log the
+ * frame rate.
+ *
+ * Frames are drawn with the software renderer, and hitches are traced like
+ * in a normal run, so a reported hitch can be reproduced under a profiler.
+ *
+ * \return exit status
+ */
+int play(const char *path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    log_crit("Can't open replay: %s", path);
+    return 1;
+  }
+  SDL_Surface *surface = SDL_CreateSurface(1280, 720, SDL_PIXELFORMAT_RGBA32);
+  SDL_Renderer *renderer =
+      surface ? SDL_CreateSoftwareRenderer(surface) : nullptr;
+  if (!renderer) {
+    log_crit("SDL_CreateSoftwareRenderer: %s", SDL_GetError());
+    SDL_DestroySurface(surface);
+    return 1;
+  }
+  int status = 0;
+  try {
+    size_t num;
+    std::unique_ptr<uint8_t[]> data = read_stream(num, file);
+    ReplayPlayer player(data.get(), num);
+    InputSampler input({});
+    FrameProfiler::Params params;
+    params.dump = save_trace;
+    FrameProfiler profiler(params);
+    unsigned sample = profiler.phase("input");
+    unsigned render = profiler.phase("render");
+    ReplayFrame frame;
+    size_t diverged = 0;
+    uint64_t start = SDL_GetTicksNS();
+    while (player.next(frame)) {
+      profiler.begin_frame();
+      {
+        FrameProfiler::Scope scope(profiler, sample);
+        input.begin(0);
+        for (const SDL_Event &e : frame.events)
+          input.add(e);
+      }
+      {
+        FrameProfiler::Scope scope(profiler, render);
+        draw_frame(renderer, input.state());
+        SDL_FlushRenderer(renderer);
+      }
+      profiler.end_frame();
+      if (!diverged && frame.checksum &&
+          frame.checksum != checksum(input.state()))
+        diverged = player.frames();
+    }
+    double seconds = (SDL_GetTicksNS() - start) * 1e-9;
+    log_info("Replayed %zu frames in %.2f s: %.0f frames/s", player.frames(),
+             seconds, player.frames() / seconds);
+    FrameProfiler::Stats s = profiler.stats(0);
+    log_info("Frame time: %.3f ms median, %.3f ms p99, %.3f ms max",
+             s.p50 * 1e-6, s.p99 * 1e-6, s.max * 1e-6);
+    if (diverged) {
+      log_warn("Replay diverges at frame %zu", diverged);
+      status = 1;
+    }
+  } catch (FatalError) {
+    status = 1;
+  }
+  SDL_DestroyRenderer(renderer);
+  SDL_DestroySurface(surface);
+  return status;
+}
+
+void run(SDL_Window *window, SDL_Renderer *renderer) {
+  InputSampler input({refresh_rate(window)});
+  FrameProfiler::Params params;
+  params.dump = save_trace;
+  FrameProfiler profiler(params);
+  unsigned wait = profiler.phase("wait");
+  unsigned sample = profiler.phase("input");
+  unsigned render = profiler.phase("render");
+  unsigned present = profiler.phase("present");
+  uint64_t next_report = SDL_GetTicksNS() + report_interval;
+
+  // The overlay is optional, since there's no font to show it without.
+  AssetSystem assets;
+  RenderQueue queue;
+  std::optional<PerfOverlay> overlay;
+  try {
+    assets.add_directory(0, "data");
+    // Simulate slow storage, to see how loading copes without the hardware.
+    if (const char *name = SDL_getenv("DGENRS_STORAGE")) {
+      StorageProfile storage;
+      if (StorageProfile::named(name, storage))
+        assets.throttle(0, storage);
+      else
+        log_warn("Unknown storage profile: %s", name);
+    }
+    size_t num;
+    std::unique_ptr<uint8_t[]> file =
+        read_stream(num, *assets.open("overlay.ttf"));
+    overlay.emplace(Font(std::move(file), num, overlay_font_size), profiler,
+                    PerfOverlay::Params());
+    overlay->add("input latency", "%.1f ms",
+                 [&]() { return input.latency().mean * 1e-6; });
+    overlay->add("asset reads", "%.0f",
+                 [&]() { return double(assets.pending()); });
+    overlay->add("draw calls", "%.0f",
+                 [&]() { return double(queue.draw_calls()); });
+  } catch (FatalError) {
+    log_warn("Performance overlay disabled");
+  }
+
+  // Record a replay of the session, to play back with DGENRS_REPLAY.
+  const char *record = SDL_getenv("DGENRS_RECORD");
+  std::optional<ReplayRecorder> recorder;
+  if (record)
+    recorder.emplace();
+  uint64_t seed = SDL_GetTicksNS(), last_sample = 0;
+
+  for (bool quit = false; !quit;) {
+    profiler.begin_frame();
+    {
+      FrameProfiler::Scope scope(profiler, wait);
+      if (uint64_t time = input.delay(SDL_GetTicksNS()))
+        SDL_DelayPrecise(time);
+    }
+    float dt;
+    {
+      FrameProfiler::Scope scope(profiler, sample);
+      for (const SDL_Event &e : input.sample()) {
+        if (e.type == SDL_EVENT_QUIT)
+          quit = true;
+        if (e.type == SDL_EVENT_WINDOW_DISPLAY_CHANGED)
+          input.set_refresh_rate(refresh_rate(window));
+        if (overlay)
+          overlay->handle(e);
+        if (recorder)
+          recorder->event(e);
+      }
+      uint64_t now = SDL_GetTicksNS();
+      dt = last_sample ? (now - last_sample) * 1e-9f : 0;
+      last_sample = now;
+    }
+
+    {
+      FrameProfiler::Scope scope(profiler, render);
+      draw_frame(renderer, input.state());
+      if (overlay)
+        overlay->draw(renderer, queue, SDL_GetTicksNS());
+      queue.flush(renderer);
+    }
+
+    {
+      FrameProfiler::Scope scope(profiler, present);
+      input.submit();
+      SDL_RenderPresent(renderer);
+      input.presented();
+    }
+    profiler.end_frame();
+    if (recorder)
+      recorder->frame(dt, seed++, checksum(input.state()));
+
+    if (uint64_t now = SDL_GetTicksNS(); next_report <= now) {
+      next_report = now + report_interval;
+      InputSampler::Latency l = input.latency();
+      if (l.frames)
+        log_info("Input latency: %.1f ms mean, %.1f ms max", l.mean * 1e-6,
+                 l.max * 1e-6);
+      FrameProfiler::Stats s = profiler.stats(0);
+      log_info("Frame time: %.1f ms median, %.1f ms p99, %.1f ms max",
+               s.p50 * 1e-6, s.p99 * 1e-6, s.max * 1e-6);
+    }
+  }
+
+  if (recorder) {
+    std::ofstream out(record, std::ios::binary);
+    out.write(reinterpret_cast<const char *>(recorder->data().data()),
+              recorder->data().size());
+    if (out)
+      log_info("Saved a replay of %zu frames to %s", recorder->frames(),
+               record);
+    else
+      log_warn("Can't write replay: %s", record);
+  }
+}
+
+} // namespace
+
+int main(int, char **) {
+  log_info("dgenrs %.*s", int(DGENRS_VERSION.size()), DGENRS_VERSION.data());
+  if (const char *path = SDL_getenv("DGENRS_REPLAY"))
+    return play(path);
+  if (!SDL_Init(SDL_INIT_VIDEO | SDL_INIT_GAMEPAD)) {
+    log_crit("SDL_Init: %s", SDL_GetError());
+    return 1;
+  }
+  SDL_Window *window;
+  SDL_Renderer *renderer;
+  if (!SDL_CreateWindowAndRenderer("dgenrs", 1280, 720, SDL_WINDOW_RESIZABLE,
+                                   &window, &renderer)) {
+    log_crit("SDL_CreateWindowAndRenderer: %s", SDL_GetError());
+    SDL_Quit();
+    return 1;
+  }
+  if (!SDL_SetRenderVSync(renderer, 1))
+    log_warn("SDL_SetRenderVSync: %s", SDL_GetError());
+  int status = 0;
+  try {
+    run(window, renderer);
+  } catch (FatalError) {
+    status = 1;
+  }
+  SDL_DestroyRenderer(renderer);
+  SDL_DestroyWindow(window);
+  SDL_Quit();
+  return status;
+}
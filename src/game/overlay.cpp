@@ -0,0 +1,199 @@
+#include "overlay.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <string_view>
+
+#include <SDL3/SDL_error.h>
+#include <SDL3/SDL_stdinc.h>
+
+#include "profile.hpp"
+#include "render.hpp"
+#include "util.hpp"
+
+namespace {
+
+/// Space around the graph and text, in pixels.
+constexpr float padding = 4;
+
+constexpr SDL_FColor background = {0, 0, 0, 0.6f};
+constexpr SDL_FColor text_color = {1, 1, 1, 1};
+constexpr SDL_FColor budget_color = {1, 1, 1, 0.25f};
+constexpr SDL_FColor fast_color = {0.3f, 0.9f, 0.3f, 1};
+constexpr SDL_FColor slow_color = {0.9f, 0.8f, 0.2f, 1};
+constexpr SDL_FColor hitch_color = {0.9f, 0.2f, 0.2f, 1};
+
+/// Check that a printf format has one conversion, and that it's for a double.
+bool formats_double(std::string_view format) {
+  int conversions = 0;
+  for (size_t i = 0; i < format.size(); i++) {
+    if (format[i] != '%')
+      continue;
+    if (++i < format.size() && format[i] == '%')
+      continue;
+    // Flags, width and precision, but not '*' or length modifiers.
+    i = format.find_first_not_of("-+ #0123456789.", i);
+    if (i == format.npos ||
+        std::string_view("aAeEfFgG").find(format[i]) == format.npos)
+      return false;
+    conversions++;
+  }
+  return conversions == 1;
+}
+
+} // namespace
+
+PerfOverlay::PerfOverlay(Font font, const FrameProfiler &profiler,
+                         const Params &params)
+    : m_params(params), m_font(std::move(font)), m_profiler(profiler) {}
+
+PerfOverlay::~PerfOverlay() {
+  if (m_texture)
+    SDL_DestroyTexture(m_texture);
+}
+
+void PerfOverlay::add(std::string label, std::string format, Probe probe) {
+  if (!formats_double(format)) {
+    log_crit("Overlay format isn't for one number: %s", format.c_str());
+    throw FatalError::Initialize;
+  }
+  m_rows.push_back({std::move(label), std::move(format), std::move(probe)});
+}
+
+void PerfOverlay::set_visible(bool visible) {
+  m_visible = visible;
+  m_next_refresh = 0;
+}
+
+bool PerfOverlay::handle(const SDL_Event &e) {
+  if (e.type != SDL_EVENT_KEY_DOWN || e.key.scancode != m_params.key ||
+      e.key.repeat)
+    return false;
+  set_visible(!m_visible);
+  return true;
+}
+
+void PerfOverlay::draw(SDL_Renderer *renderer, RenderQueue &queue,
+                       uint64_t time) {
+  if (!m_visible)
+    return;
+  if (m_next_refresh <= time) {
+    m_next_refresh = time + m_params.refresh;
+    refresh();
+  }
+  upload(renderer);
+
+  // Everything shares one key, so it's drawn in recording order in one call.
+  uint64_t key =
+      sort_key(m_params.layer, queue.texture(m_texture), BlendMode::Blend, 0);
+  float size = m_font.atlas().width();
+  // The atlas has an opaque 2×2 block in the corner. Sampling its middle
+  // gives solid color even with linear filtering.
+  SDL_FRect solid = {0.5f / size, 0.5f / size, 1 / size, 1 / size};
+
+  float graph_w = m_params.graph_frames, graph_h = m_params.graph_height;
+  float line_h = std::ceil(m_font.line_height());
+  float w = std::max(graph_w, std::ceil(m_text_width)) + 2 * padding;
+  float h = graph_h + m_lines.size() * line_h + 3 * padding;
+  queue.quad(key, {m_params.x, m_params.y, w, h}, solid, background);
+
+  // Frame times, newest on the right. The budget is at half height.
+  float left = m_params.x + padding, bottom = m_params.y + padding + graph_h;
+  float scale = graph_h / (2 * double(m_params.budget));
+  size_t frames = std::min<size_t>(m_profiler.frames(), m_params.graph_frames);
+  for (size_t age = 0; age < frames; age++) {
+    uint64_t t = m_profiler.recent(0, age);
+    float bar = std::min(graph_h, std::max(1.0f, t * scale));
+    SDL_FColor color = t <= m_params.budget       ? fast_color
+                       : t <= 2 * m_params.budget ? slow_color
+                                                  : hitch_color;
+    queue.quad(key, {left + graph_w - 1 - age, bottom - bar, 1, bar}, solid,
+               color);
+  }
+  queue.quad(key, {left, bottom - graph_h / 2, graph_w, 1}, solid,
+             budget_color);
+
+  float baseline = bottom + padding + std::round(m_font.ascent());
+  for (const Line &line : m_lines) {
+    for (const Font::Placement &p : line.glyphs) {
+      const Font::Glyph &g = m_font.glyph(p.glyph);
+      if (!g.w)
+        continue;
+      SDL_FRect dst = {std::round(left + p.x) + g.left,
+                       std::round(baseline + p.y) - g.top, float(g.w),
+                       float(g.h)};
+      SDL_FRect uv = {g.x / size, g.y / size, g.w / size, g.h / size};
+      queue.quad(key, dst, uv, text_color);
+    }
+    baseline += line_h;
+  }
+}
+
+std::vector<std::string> PerfOverlay::text() const {
+  std::vector<std::string> result;
+  for (const Line &line : m_lines)
+    result.push_back(line.text);
+  return result;
+}
+
+void PerfOverlay::refresh() {
+  std::vector<std::string> text;
+  char buffer[256];
+  for (unsigned i = 0; i < m_profiler.phases(); i++) {
+    FrameProfiler::Stats s = m_profiler.stats(i);
+    SDL_snprintf(buffer, sizeof buffer, "%s: %.2f / %.2f / %.2f ms",
+                 m_profiler.name(i).c_str(), s.p50 * 1e-6, s.p99 * 1e-6,
+                 s.max * 1e-6);
+    text.emplace_back(buffer);
+  }
+  SDL_snprintf(buffer, sizeof buffer, "hitches: %llu",
+               (unsigned long long)m_profiler.hitches());
+  text.emplace_back(buffer);
+  for (const Row &row : m_rows) {
+    SDL_snprintf(buffer, sizeof buffer, row.format.c_str(), row.probe());
+    text.push_back(row.label + ": " + buffer);
+  }
+
+  m_lines.resize(text.size());
+  m_text_width = 0;
+  for (size_t i = 0; i < text.size(); i++) {
+    Line &line = m_lines[i];
+    line.text = std::move(text[i]);
+    float width = m_font.shape(line.text, line.glyphs);
+    m_text_width = std::max(m_text_width, width);
+    // Rasterize now, so that the atlas is complete before it's uploaded.
+    for (const Font::Placement &p : line.glyphs)
+      m_font.glyph(p.glyph);
+  }
+}
+
+void PerfOverlay::upload(SDL_Renderer *renderer) {
+  ConstImageView atlas = m_font.atlas();
+  if (!m_texture) {
+    m_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32,
+                                  SDL_TEXTUREACCESS_STATIC, atlas.width(),
+                                  atlas.height());
+    if (!m_texture) {
+      log_crit("SDL_CreateTexture: %s", SDL_GetError());
+      throw FatalError::Platform;
+    }
+    m_staging = Image(ImageType::RGBA, atlas.width(), atlas.height());
+    m_texture_version = m_font.atlas_version() + 1;
+  }
+  if (m_texture_version == m_font.atlas_version())
+    return;
+  m_texture_version = m_font.atlas_version();
+  for (unsigned y = 0; y < atlas.height(); y++) {
+    const uint8_t *src = atlas.pixel(0, y);
+    uint8_t *dst = m_staging.pixel(0, y);
+    for (unsigned x = 0; x < atlas.width(); x++, dst += 4) {
+      dst[0] = dst[1] = dst[2] = 255;
+      dst[3] = src[x];
+    }
+  }
+  if (!SDL_UpdateTexture(m_texture, nullptr, m_staging.pixel(0, 0),
+                         m_staging.stride())) {
+    log_crit("SDL_UpdateTexture: %s", SDL_GetError());
+    throw FatalError::Platform;
+  }
+}
@@ -0,0 +1,134 @@
+/**
+ * \file
+ * \brief Show performance numbers on top of the game.
+ */
+
+#ifndef OVERLAY_HPP
+#define OVERLAY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <SDL3/SDL_events.h>
+#include <SDL3/SDL_render.h>
+
+#include "font.hpp"
+#include "image.hpp"
+
+class FrameProfiler;
+class RenderQueue;
+
+/**
+ * \brief Toggleable overlay with a frame time graph and live statistics.
+ *
+ * The overlay shows a bar graph of recent frame times, percentiles for each
+ * profiler phase, and a line for each probe. Probes are functions that report
+ * one number, such as the depth of the asset I/O queue, a cache hit rate or
+ * the memory used by a subsystem.
+ *
+ * Everything is drawn from one texture, a copy of the font's glyph atlas, so
+ * the overlay costs one draw call on its own layer. The texture is only
+ * uploaded again when new glyphs are rasterized. Text is shaped a few times a
+ * second rather than every frame, which also keeps the numbers readable.
+ */
+class PerfOverlay {
+public:
+  /// Report a value to show.
+  using Probe = std::function<double()>;
+
+  /// Layout and behavior.
+  struct Params {
+    float x = 8, y = 8;           ///< Top left corner in render coordinates.
+    unsigned graph_frames = 240;  ///< Frames in the graph, one pixel each.
+    float graph_height = 64;      ///< Height of the graph in pixels.
+    uint64_t budget = 16666667;   ///< Frame time in ns at half graph height.
+    uint64_t refresh = 250000000; ///< Time in ns between text updates.
+    uint8_t layer = 255;          ///< Sort key layer, see sort_key().
+    SDL_Scancode key = SDL_SCANCODE_F3; ///< Key that toggles the overlay.
+  };
+
+private:
+  struct Row {
+    std::string label;
+    std::string format;
+    Probe probe;
+  };
+
+  /// A line of text, shaped at the last refresh.
+  struct Line {
+    std::string text;
+    std::vector<Font::Placement> glyphs;
+  };
+
+  Params m_params;
+  Font m_font;
+  const FrameProfiler &m_profiler;
+  std::vector<Row> m_rows;
+  std::vector<Line> m_lines;
+  float m_text_width = 0;
+  bool m_visible = false;
+  uint64_t m_next_refresh = 0;
+
+  SDL_Texture *m_texture = nullptr;
+  uint64_t m_texture_version = 0;
+  Image m_staging; ///< Atlas converted to white RGBA with coverage as alpha.
+
+public:
+  /**
+   * \brief Create a hidden overlay.
+   * \param font font for the text, which the overlay takes over
+   * \param profiler profiler of the main loop, which must outlive the overlay
+   */
+  PerfOverlay(Font font, const FrameProfiler &profiler, const Params &params);
+
+  /// Destroy the texture. Call before destroying the renderer.
+  ~PerfOverlay();
+
+  PerfOverlay(const PerfOverlay &other) = delete;
+  PerfOverlay &operator=(const PerfOverlay &other) = delete;
+
+  /**
+   * \brief Add a line showing a value.
+   * \param label text before the value
+   * \param format printf format for the value, e.g. "%.1f MiB", with one
+   * conversion for a double (a, e, f or g) and no '*' or length modifier
+   * \param probe called on the main thread at each text update
+   * \throw FatalError::Initialize if the format isn't for one double
+   */
+  void add(std::string label, std::string format, Probe probe);
+
+  /// Check if the overlay is shown.
+  bool visible() const { return m_visible; }
+
+  /// Show or hide the overlay.
+  void set_visible(bool visible);
+
+  /**
+   * \brief Toggle the overlay when its key is pressed.
+   * \return true if the event was used
+   */
+  bool handle(const SDL_Event &e);
+
+  /**
+   * \brief Record the overlay's draw commands if it's visible.
+   *
+   * Updates the text if it's due, and uploads the glyph atlas if it changed.
+   *
+   * \param renderer renderer that the queue is flushed to
+   * \param time current time in nanoseconds
+   * \throw FatalError::Platform if the texture can't be created
+   */
+  void draw(SDL_Renderer *renderer, RenderQueue &queue, uint64_t time);
+
+  /// Get the text shown at the last update, one string per line.
+  std::vector<std::string> text() const;
+
+private:
+  void refresh();
+  void upload(SDL_Renderer *renderer);
+};
+
+#endif
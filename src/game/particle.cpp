@@ -0,0 +1,183 @@
+#include "particle.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "job.hpp"
+#include "render.hpp"
+
+namespace {
+
+/// Particles per block of parallel work.
+constexpr uint32_t block_size = 16384;
+
+/// Scramble a seed so that nearby seeds give unrelated states.
+uint64_t splitmix64(uint64_t x) {
+  x += 0x9e3779b97f4a7c15;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+  return x ^ (x >> 31);
+}
+
+/// Get a random number in [0, 1) from an xorshift64* generator.
+float uniform(uint64_t &state) {
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+  return float((state * 0x2545f4914f6cdd1d) >> 40) * 0x1p-24f;
+}
+
+float lerp(float a, float b, float t) { return a + (b - a) * t; }
+
+} // namespace
+
+unsigned ParticleSystem::add(const EmitterParams &params) {
+  Emitter &e = m_emitters.emplace_back();
+  e.params = params;
+  e.prand = splitmix64(m_emitters.size()) | 1;
+  return m_emitters.size() - 1;
+}
+
+void ParticleSystem::burst(unsigned emitter, size_t num) {
+  spawn(m_emitters[emitter], num);
+}
+
+void ParticleSystem::clear(unsigned emitter) {
+  Emitter &e = m_emitters[emitter];
+  for (auto *v : {&e.x, &e.y, &e.vx, &e.vy, &e.age, &e.age_rate})
+    v->clear();
+}
+
+size_t ParticleSystem::size() const {
+  size_t n = 0;
+  for (auto &e : m_emitters)
+    n += e.x.size();
+  return n;
+}
+
+void ParticleSystem::update(float dt, JobPool &pool) {
+  m_blocks.clear();
+  for (uint32_t i = 0; i < m_emitters.size(); i++)
+    for (uint32_t j = 0; j < m_emitters[i].x.size(); j += block_size)
+      m_blocks.emplace_back(i, j);
+  pool.run(m_blocks.size(), [&](size_t b) {
+    auto [i, begin] = m_blocks[b];
+    Emitter &e = m_emitters[i];
+    uint32_t end = std::min<size_t>(begin + block_size, e.x.size());
+    float gx = e.params.gravity_x * dt, gy = e.params.gravity_y * dt;
+    float *x = e.x.data(), *y = e.y.data(), *vx = e.vx.data(),
+          *vy = e.vy.data(), *age = e.age.data();
+    const float *age_rate = e.age_rate.data();
+    uint32_t k = begin;
+#ifdef __SSE2__
+    __m128 dt4 = _mm_set1_ps(dt), gx4 = _mm_set1_ps(gx),
+           gy4 = _mm_set1_ps(gy);
+    for (; k + 4 <= end; k += 4) {
+      __m128 vx4 = _mm_add_ps(_mm_loadu_ps(vx + k), gx4);
+      __m128 vy4 = _mm_add_ps(_mm_loadu_ps(vy + k), gy4);
+      _mm_storeu_ps(vx + k, vx4);
+      _mm_storeu_ps(vy + k, vy4);
+      _mm_storeu_ps(x + k,
+                    _mm_add_ps(_mm_loadu_ps(x + k), _mm_mul_ps(vx4, dt4)));
+      _mm_storeu_ps(y + k,
+                    _mm_add_ps(_mm_loadu_ps(y + k), _mm_mul_ps(vy4, dt4)));
+      _mm_storeu_ps(age + k, _mm_add_ps(_mm_loadu_ps(age + k),
+                                        _mm_mul_ps(_mm_loadu_ps(age_rate + k),
+                                                   dt4)));
+    }
+#endif
+    for (; k < end; k++) {
+      vx[k] += gx;
+      vy[k] += gy;
+      x[k] += vx[k] * dt;
+      y[k] += vy[k] * dt;
+      age[k] += age_rate[k] * dt;
+    }
+  });
+  pool.run(m_emitters.size(), [&](size_t i) {
+    Emitter &e = m_emitters[i];
+    compact(e);
+    e.pending += e.params.rate * dt;
+    auto num = size_t(e.pending);
+    e.pending -= num;
+    if (e.params.max_particles) {
+      size_t room = e.params.max_particles -
+                    std::min(e.x.size(), e.params.max_particles);
+      num = std::min(num, room);
+    }
+    spawn(e, num);
+  });
+}
+
+void ParticleSystem::draw(RenderQueue &queue, JobPool &pool) const {
+  for (auto &e : m_emitters) {
+    size_t n = e.x.size();
+    if (!n)
+      continue;
+    // Pushing moves the arrays, so each command is filled before the next.
+    RenderQueue::Geometry g = queue.push(e.params.key, n * 4, n * 6);
+    pool.parallel_for(n, block_size, [&](size_t begin, size_t end) {
+      const EmitterParams &p = e.params;
+      const SDL_FColor &c0 = p.start_color, &c1 = p.end_color;
+      for (size_t k = begin; k < end; k++) {
+        float t = std::min(e.age[k], 1.0f);
+        SDL_FColor color = {lerp(c0.r, c1.r, t), lerp(c0.g, c1.g, t),
+                            lerp(c0.b, c1.b, t), lerp(c0.a, c1.a, t)};
+        float half = lerp(p.start_size, p.end_size, t) * 0.5f;
+        float x0 = e.x[k] - half, x1 = e.x[k] + half;
+        float y0 = e.y[k] - half, y1 = e.y[k] + half;
+        SDL_Vertex *v = g.vertices + k * 4;
+        v[0] = {{x0, y0}, color, {0, 0}};
+        v[1] = {{x1, y0}, color, {1, 0}};
+        v[2] = {{x0, y1}, color, {0, 1}};
+        v[3] = {{x1, y1}, color, {1, 1}};
+        int base = k * 4;
+        int *idx = g.indices + k * 6;
+        idx[0] = base;
+        idx[1] = base + 1;
+        idx[2] = base + 2;
+        idx[3] = base + 2;
+        idx[4] = base + 1;
+        idx[5] = base + 3;
+      }
+    });
+  }
+}
+
+void ParticleSystem::spawn(Emitter &e, size_t num) {
+  const EmitterParams &p = e.params;
+  for (size_t i = 0; i < num; i++) {
+    float angle = p.direction + (uniform(e.prand) - 0.5f) * p.spread;
+    float speed = lerp(p.min_speed, p.max_speed, uniform(e.prand));
+    float life = lerp(p.min_life, p.max_life, uniform(e.prand));
+    e.x.push_back(p.x);
+    e.y.push_back(p.y);
+    e.vx.push_back(std::cos(angle) * speed);
+    e.vy.push_back(std::sin(angle) * speed);
+    e.age.push_back(0);
+    e.age_rate.push_back(0 < life ? 1 / life : INFINITY);
+  }
+}
+
+void ParticleSystem::compact(Emitter &e) {
+  size_t n = e.x.size();
+  for (size_t i = 0; i < n;) {
+    if (e.age[i] < 1) {
+      i++;
+      continue;
+    }
+    n--;
+    e.x[i] = e.x[n];
+    e.y[i] = e.y[n];
+    e.vx[i] = e.vx[n];
+    e.vy[i] = e.vy[n];
+    e.age[i] = e.age[n];
+    e.age_rate[i] = e.age_rate[n];
+  }
+  for (auto *v : {&e.x, &e.y, &e.vx, &e.vy, &e.age, &e.age_rate})
+    v->resize(n);
+}
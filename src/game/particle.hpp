@@ -0,0 +1,106 @@
+/**
+ * \file
+ * \brief Simulate and draw large numbers of particles.
+ */
+
+#ifndef PARTICLE_HPP
+#define PARTICLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <SDL3/SDL_pixels.h>
+
+class JobPool;
+class RenderQueue;
+
+/// How an emitter spawns and draws its particles.
+struct EmitterParams {
+  float x = 0, y = 0;                    ///< Spawn position.
+  float rate = 0;                        ///< Particles spawned per second.
+  float direction = 0, spread = 0;       ///< Launch angle and range (radians).
+  float min_speed = 0, max_speed = 0;    ///< Launch speed in pixels/second.
+  float min_life = 1, max_life = 1;      ///< Lifetime in seconds.
+  float gravity_x = 0, gravity_y = 0;    ///< Acceleration in pixels/second².
+  float start_size = 1, end_size = 1;    ///< Width and height of each quad.
+  SDL_FColor start_color = {1, 1, 1, 1}; ///< Color at birth.
+  SDL_FColor end_color = {1, 1, 1, 0};   ///< Color at death.
+  uint64_t key = 0;                      ///< Sort key, see sort_key().
+  size_t max_particles = 0; ///< Spawning stops at this count (0 is no limit).
+};
+
+/**
+ * \brief A set of particle emitters.
+ *
+ * Each emitter keeps its particles as separate arrays of positions, velocities
+ * and normalized ages, which are integrated four at a time with SSE. Dead
+ * particles are removed by moving the last particle into their place, so the
+ * arrays stay dense and particle order is not preserved.
+ *
+ * Emitters are independent, so they're spawned, integrated and drawn in
+ * parallel. Large emitters are also split into blocks.
+ */
+class ParticleSystem {
+  struct Emitter {
+    EmitterParams params;
+    uint64_t prand;    ///< Random number generator state.
+    float pending = 0; ///< Fractional particles to spawn later.
+    std::vector<float> x, y, vx, vy;
+    std::vector<float> age;      ///< 0 at birth, 1 at death.
+    std::vector<float> age_rate; ///< 1 / lifetime.
+  };
+
+  std::vector<Emitter> m_emitters;
+  /// Blocks of work as (emitter, first particle) pairs (reused).
+  std::vector<std::pair<uint32_t, uint32_t>> m_blocks;
+
+public:
+  /// Add an emitter and get its index.
+  unsigned add(const EmitterParams &params);
+
+  /// Get the number of emitters.
+  size_t emitters() const { return m_emitters.size(); }
+
+  /// Get an emitter's parameters so they can be changed, e.g. to move it.
+  EmitterParams &params(unsigned emitter) {
+    return m_emitters[emitter].params;
+  }
+
+  /// Spawn a number of particles at once, ignoring max_particles.
+  void burst(unsigned emitter, size_t num);
+
+  /// Remove all of an emitter's particles.
+  void clear(unsigned emitter);
+
+  /// Get the number of live particles of an emitter.
+  size_t size(unsigned emitter) const { return m_emitters[emitter].x.size(); }
+
+  /// Get the number of live particles of all emitters.
+  size_t size() const;
+
+  /**
+   * \brief Advance the simulation.
+   *
+   * Existing particles move and age, dead ones are removed, and then emitters
+   * spawn new particles.
+   *
+   * \param dt time step in seconds
+   */
+  void update(float dt, JobPool &pool);
+
+  /**
+   * \brief Record each emitter's particles as one command of untextured quads.
+   *
+   * Color and size are interpolated by age. The geometry is written straight
+   * into the queue's vertex arrays.
+   */
+  void draw(RenderQueue &queue, JobPool &pool) const;
+
+private:
+  void spawn(Emitter &e, size_t num);
+  void compact(Emitter &e);
+};
+
+#endif
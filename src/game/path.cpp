@@ -0,0 +1,610 @@
+#include "path.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+
+#include "job.hpp"
+
+namespace {
+
+constexpr float diagonal = 1.41421356f;
+
+/// Open runs along a cluster border at least this long get two entrances.
+constexpr int32_t wide_entrance = 6;
+
+/// Get the length of the shortest path between two cells with no obstacles.
+float octile(int32_t dx, int32_t dy) {
+  dx = std::abs(dx);
+  dy = std::abs(dy);
+  return std::max(dx, dy) + (diagonal - 1) * std::min(dx, dy);
+}
+
+int sign(int32_t v) { return (v > 0) - (v < 0); }
+
+/// Remove waypoints that lie on a straight line between their neighbors.
+void simplify(std::vector<GridPoint> &path) {
+  size_t n = 0;
+  for (GridPoint p : path) {
+    if (2 <= n) {
+      GridPoint a = path[n - 2], b = path[n - 1];
+      if (sign(b.x - a.x) == sign(p.x - b.x) &&
+          sign(b.y - a.y) == sign(p.y - b.y)) {
+        path[n - 1] = p;
+        continue;
+      }
+    }
+    path[n++] = p;
+  }
+  path.resize(n);
+}
+
+} // namespace
+
+void PathSearch::reset(size_t num) {
+  if (m_seen.size() < num) {
+    m_seen.resize(num);
+    m_closed.resize(num);
+    m_cost.resize(num);
+    m_parent.resize(num);
+  }
+  if (!++m_generation) {
+    std::fill(m_seen.begin(), m_seen.end(), 0);
+    std::fill(m_closed.begin(), m_closed.end(), 0);
+    m_generation = 1;
+  }
+  m_open.clear();
+}
+
+void PathSearch::relax(uint32_t node, float cost, float estimate,
+                       uint32_t parent) {
+  if (m_closed[node] == m_generation ||
+      (m_seen[node] == m_generation && m_cost[node] <= cost))
+    return;
+  m_seen[node] = m_generation;
+  m_cost[node] = cost;
+  m_parent[node] = parent;
+  m_open.push_back({cost + estimate, cost, node});
+  std::push_heap(m_open.begin(), m_open.end());
+}
+
+bool PathSearch::pop(uint32_t &node) {
+  while (!m_open.empty()) {
+    std::pop_heap(m_open.begin(), m_open.end());
+    uint32_t n = m_open.back().node;
+    m_open.pop_back();
+    // Nodes are added again when their cost drops. Skip the stale copies.
+    if (m_closed[n] != m_generation) {
+      m_closed[n] = m_generation;
+      node = n;
+      return true;
+    }
+  }
+  return false;
+}
+
+Pathfinder::Pathfinder(unsigned width, unsigned height, const Params &params)
+    : m_width(width), m_height(height), m_cluster_size(params.cluster_size),
+      m_weight(params.weight),
+      m_clusters_x((width + m_cluster_size - 1) / m_cluster_size),
+      m_clusters_y((height + m_cluster_size - 1) / m_cluster_size),
+      m_blocked(size_t(width) * height),
+      m_clusters(size_t(m_clusters_x) * m_clusters_y),
+      m_first(m_clusters.size() + 1) {
+  for (uint32_t i = 0; i < m_clusters.size(); i++)
+    m_dirty.push_back(i);
+}
+
+void Pathfinder::set_blocked(unsigned x, unsigned y, bool blocked) {
+  assert(x < m_width && y < m_height);
+  uint8_t &c = m_blocked[size_t(y) * m_width + x];
+  if (c == blocked)
+    return;
+  c = blocked;
+  // Cells on a border also change the neighbor's entrances.
+  unsigned cx = x / m_cluster_size, cy = y / m_cluster_size;
+  unsigned ix = x % m_cluster_size, iy = y % m_cluster_size;
+  mark(cx, cy);
+  if (!ix && cx)
+    mark(cx - 1, cy);
+  if (ix == m_cluster_size - 1 && cx + 1 < m_clusters_x)
+    mark(cx + 1, cy);
+  if (!iy && cy)
+    mark(cx, cy - 1);
+  if (iy == m_cluster_size - 1 && cy + 1 < m_clusters_y)
+    mark(cx, cy + 1);
+}
+
+void Pathfinder::update(JobPool *pool) {
+  if (m_dirty.empty())
+    return;
+  auto build_range = [this](size_t begin, size_t end) {
+    std::unique_ptr<PathSearch> search = acquire();
+    for (size_t i = begin; i < end; i++)
+      build(m_dirty[i], *search);
+    release(std::move(search));
+  };
+  if (pool)
+    pool->parallel_for(m_dirty.size(), 4, build_range);
+  else
+    build_range(0, m_dirty.size());
+
+  // Rebuilt clusters may have renumbered the entrances their neighbors link
+  // to.
+  for (uint32_t c : m_dirty) {
+    unsigned cx = c % m_clusters_x, cy = c / m_clusters_x;
+    link(c);
+    if (cx)
+      link(c - 1);
+    if (cx + 1 < m_clusters_x)
+      link(c + 1);
+    if (cy)
+      link(c - m_clusters_x);
+    if (cy + 1 < m_clusters_y)
+      link(c + m_clusters_x);
+  }
+  for (uint32_t c : m_dirty)
+    m_clusters[c].dirty = false;
+  m_dirty.clear();
+
+  m_owner.clear();
+  for (size_t c = 0; c < m_clusters.size(); c++) {
+    m_first[c] = m_owner.size();
+    m_owner.resize(m_owner.size() + m_clusters[c].entrances.size(), c);
+  }
+  m_first.back() = m_owner.size();
+}
+
+float Pathfinder::find(GridPoint start, GridPoint goal, PathSearch &search,
+                       std::vector<GridPoint> &path) const {
+  assert(m_dirty.empty());
+  path.clear();
+  if (blocked(start.x, start.y) || blocked(goal.x, goal.y))
+    return unreachable;
+  if (start == goal) {
+    path.push_back(start);
+    return 0;
+  }
+  unsigned sc = cluster_of(cell(start)), gc = cluster_of(cell(goal));
+  // Nearby goals are searched directly, since detours through entrances
+  // would be large compared to the length of the path.
+  Rect a = rect(sc), b = rect(gc);
+  if (std::abs(a.x0 - b.x0) <= int32_t(m_cluster_size) &&
+      std::abs(a.y0 - b.y0) <= int32_t(m_cluster_size)) {
+    path.push_back(start);
+    Rect both = {std::min(a.x0, b.x0), std::min(a.y0, b.y0),
+                 std::max(a.x1, b.x1), std::max(a.y1, b.y1)};
+    float cost = jps(both, start, goal, search, path);
+    if (cost != unreachable) {
+      simplify(path);
+      return cost;
+    }
+    // The way may lead out of the clusters and back in.
+    path.clear();
+  }
+
+  // Connect the start and goal to the entrances of their clusters, then
+  // search the abstract graph. The start and goal are extra nodes at the end.
+  costs(sc, start, search, search.m_start_cost);
+  costs(gc, goal, search, search.m_goal_cost);
+  uint32_t nodes = m_first.back(), first = nodes, last = nodes + 1;
+  auto estimate = [&](uint32_t c) {
+    GridPoint p = point(c);
+    return m_weight * octile(goal.x - p.x, goal.y - p.y);
+  };
+  search.reset(nodes + 2);
+  search.relax(first, 0, 0, first);
+  bool found = false;
+  uint32_t node;
+  while (search.pop(node)) {
+    if (node == last) {
+      found = true;
+      break;
+    }
+    float cost = search.m_cost[node];
+    if (node == first) {
+      const Cluster &s = m_clusters[sc];
+      for (size_t i = 0; i < s.entrances.size(); i++)
+        if (search.m_start_cost[i] != unreachable)
+          search.relax(m_first[sc] + i, cost + search.m_start_cost[i],
+                       estimate(s.entrances[i].cell), node);
+      continue;
+    }
+    unsigned c = m_owner[node];
+    size_t i = node - m_first[c];
+    const Cluster &cluster = m_clusters[c];
+    const Entrance &e = cluster.entrances[i];
+    if (c == gc && search.m_goal_cost[i] != unreachable)
+      search.relax(last, cost + search.m_goal_cost[i], 0, node);
+    search.relax(m_first[cluster_of(e.partner)] + e.link, cost + 1,
+                 estimate(e.partner), node);
+    size_t n = cluster.entrances.size();
+    for (size_t j = 0; j < n; j++) {
+      float step = cluster.cost[i * n + j];
+      if (j != i && step != unreachable)
+        search.relax(m_first[c] + j, cost + step,
+                     estimate(cluster.entrances[j].cell), node);
+    }
+  }
+  if (!found)
+    return unreachable;
+
+  // Refine the route. Steps between clusters are straight, and the rest is
+  // searched within one cluster at a time.
+  float cost = search.m_cost[last];
+  std::vector<uint32_t> &route = search.m_route;
+  route.clear();
+  route.push_back(cell(goal));
+  for (uint32_t n = search.m_parent[last]; n != first; n = search.m_parent[n])
+    route.push_back(m_clusters[m_owner[n]].entrances[n - m_first[m_owner[n]]]
+                        .cell);
+  path.push_back(start);
+  GridPoint from = start;
+  for (auto it = route.rbegin(); it != route.rend(); ++it) {
+    GridPoint to = point(*it);
+    if (to == from)
+      continue;
+    unsigned c = cluster_of(cell(from));
+    if (c == cluster_of(*it)) {
+      [[maybe_unused]] float step = jps(rect(c), from, to, search, path);
+      assert(step != unreachable);
+    } else {
+      path.push_back(to);
+    }
+    from = to;
+  }
+  simplify(path);
+  return cost;
+}
+
+float Pathfinder::find_jps(GridPoint start, GridPoint goal, PathSearch &search,
+                           std::vector<GridPoint> &path) const {
+  path.clear();
+  if (blocked(start.x, start.y) || blocked(goal.x, goal.y))
+    return unreachable;
+  path.push_back(start);
+  float cost = jps({0, 0, int32_t(m_width), int32_t(m_height)}, start, goal,
+                   search, path);
+  if (cost == unreachable)
+    path.clear();
+  simplify(path);
+  return cost;
+}
+
+void Pathfinder::find_batch(const PathQuery *queries, size_t num,
+                            PathResult *results, JobPool &pool) const {
+  pool.parallel_for(num, 8, [&](size_t begin, size_t end) {
+    std::unique_ptr<PathSearch> search = acquire();
+    for (size_t i = begin; i < end; i++)
+      results[i].cost = find(queries[i].start, queries[i].goal, *search,
+                             results[i].path);
+    release(std::move(search));
+  });
+}
+
+Pathfinder::Rect Pathfinder::rect(unsigned cluster) const {
+  int32_t x = cluster % m_clusters_x * m_cluster_size;
+  int32_t y = cluster / m_clusters_x * m_cluster_size;
+  return {x, y, std::min<int32_t>(x + m_cluster_size, m_width),
+          std::min<int32_t>(y + m_cluster_size, m_height)};
+}
+
+void Pathfinder::mark(unsigned cx, unsigned cy) {
+  unsigned c = cy * m_clusters_x + cx;
+  if (!m_clusters[c].dirty) {
+    m_clusters[c].dirty = true;
+    m_dirty.push_back(c);
+  }
+}
+
+void Pathfinder::build(unsigned cluster, PathSearch &search) {
+  Cluster &c = m_clusters[cluster];
+  const Rect r = rect(cluster);
+  c.entrances.clear();
+  // Walk along one border, from (x, y) in steps of (sx, sy). The cells on the
+  // other side are offset by (ox, oy). Both clusters see the same runs, so
+  // they agree on where the entrances are.
+  auto border = [&](int32_t x, int32_t y, int32_t sx, int32_t sy,
+                    int32_t len, int32_t ox, int32_t oy) {
+    int32_t run = 0;
+    auto add = [&](int32_t k) {
+      uint32_t cell = (y + k * sy) * m_width + x + k * sx;
+      c.entrances.push_back({cell, uint32_t(cell + oy * m_width + ox), 0});
+    };
+    for (int32_t k = 0; k <= len; k++) {
+      int32_t cx = x + k * sx, cy = y + k * sy;
+      if (k < len && !blocked(cx, cy) && !blocked(cx + ox, cy + oy)) {
+        run++;
+        continue;
+      }
+      if (wide_entrance <= run) {
+        add(k - run);
+        add(k - 1);
+      } else if (run) {
+        add(k - run + run / 2);
+      }
+      run = 0;
+    }
+  };
+  int32_t w = r.x1 - r.x0, h = r.y1 - r.y0;
+  c.sides[Left] = c.entrances.size();
+  if (r.x0 > 0)
+    border(r.x0, r.y0, 0, 1, h, -1, 0);
+  c.sides[Right] = c.entrances.size();
+  if (unsigned(r.x1) < m_width)
+    border(r.x1 - 1, r.y0, 0, 1, h, 1, 0);
+  c.sides[Top] = c.entrances.size();
+  if (r.y0 > 0)
+    border(r.x0, r.y0, 1, 0, w, 0, -1);
+  c.sides[Bottom] = c.entrances.size();
+  if (unsigned(r.y1) < m_height)
+    border(r.x0, r.y1 - 1, 1, 0, w, 0, 1);
+  c.sides[4] = c.entrances.size();
+
+  size_t n = c.entrances.size();
+  c.cost.resize(n * n);
+  bool empty = true;
+  for (int32_t y = r.y0; empty && y < r.y1; y++)
+    for (int32_t x = r.x0; x < r.x1; x++)
+      empty &= !m_blocked[size_t(y) * m_width + x];
+  if (empty) {
+    // Straight lines don't leave a rectangle, so open ground needs no search.
+    for (size_t i = 0; i < n; i++) {
+      GridPoint a = point(c.entrances[i].cell);
+      for (size_t j = 0; j < n; j++) {
+        GridPoint b = point(c.entrances[j].cell);
+        c.cost[i * n + j] = octile(b.x - a.x, b.y - a.y);
+      }
+    }
+    return;
+  }
+  for (size_t i = 0; i < n; i++) {
+    flood(r, point(c.entrances[i].cell), c.entrances, search);
+    for (size_t j = 0; j < n; j++) {
+      uint32_t node = local(r, point(c.entrances[j].cell));
+      c.cost[i * n + j] = search.m_closed[node] == search.m_generation
+                              ? search.m_cost[node]
+                              : unreachable;
+    }
+  }
+}
+
+void Pathfinder::link(unsigned cluster) {
+  // Both sides of a border list its entrances in the same order.
+  Cluster &c = m_clusters[cluster];
+  const int opposite[4] = {Right, Left, Bottom, Top};
+  const int offset[4] = {-1, 1, -int(m_clusters_x), int(m_clusters_x)};
+  for (int side = 0; side < 4; side++) {
+    uint32_t begin = c.sides[side], end = c.sides[side + 1];
+    if (begin == end)
+      continue;
+    const Cluster &other = m_clusters[cluster + offset[side]];
+    uint32_t first = other.sides[opposite[side]];
+    assert(other.sides[opposite[side] + 1] - first == end - begin);
+    for (uint32_t i = begin; i < end; i++) {
+      c.entrances[i].link = first + i - begin;
+      assert(other.entrances[c.entrances[i].link].cell ==
+             c.entrances[i].partner);
+    }
+  }
+}
+
+void Pathfinder::flood(const Rect &r, GridPoint source,
+                       const std::vector<Entrance> &targets,
+                       PathSearch &search) const {
+  // Copy the cells with a blocked border around them, so that neighbors need
+  // no bounds checks. Targets are marked so that the flood can stop once it
+  // has reached them all.
+  int32_t w = r.x1 - r.x0, h = r.y1 - r.y0, stride = w + 2;
+  std::vector<uint8_t> &grid = search.m_grid;
+  grid.assign(size_t(stride) * (h + 2), 1);
+  for (int32_t y = r.y0; y < r.y1; y++)
+    std::copy_n(&m_blocked[size_t(y) * m_width + r.x0], w,
+                &grid[local(r, {r.x0, y})]);
+  size_t remaining = 0;
+  for (const Entrance &e : targets) {
+    uint8_t &g = grid[local(r, point(e.cell))];
+    if (!g) {
+      g = 2;
+      remaining++;
+    }
+  }
+
+  // Steps cost at least 1 and less than 2, so with buckets one unit wide, a
+  // bucket's cells only add to the next two buckets, and the cells in a bucket
+  // are final once the buckets before it are done. That's Dijkstra's
+  // algorithm without a heap.
+  search.reset(grid.size());
+  auto &buckets = search.m_buckets;
+  for (auto &b : buckets)
+    b.clear();
+  auto relax = [&](uint32_t node, float cost) {
+    if (search.m_seen[node] == search.m_generation &&
+        search.m_cost[node] <= cost)
+      return;
+    search.m_seen[node] = search.m_generation;
+    search.m_cost[node] = cost;
+    buckets[size_t(cost) % 3].push_back(node);
+  };
+  relax(local(r, source), 0);
+  for (size_t k = 0, empty = 0; remaining && empty < 3; k++) {
+    std::vector<uint32_t> &bucket = buckets[k % 3];
+    empty = bucket.empty() ? empty + 1 : 0;
+    for (size_t b = 0; remaining && b < bucket.size(); b++) {
+      uint32_t node = bucket[b];
+      if (search.m_closed[node] == search.m_generation)
+        continue;
+      search.m_closed[node] = search.m_generation;
+      const uint8_t *g = &grid[node];
+      remaining -= *g == 2;
+      float straight = search.m_cost[node] + 1;
+      float diag = search.m_cost[node] + diagonal;
+      bool up = !(g[-stride] & 1), down = !(g[stride] & 1);
+      bool left = !(g[-1] & 1), right = !(g[1] & 1);
+      if (up)
+        relax(node - stride, straight);
+      if (down)
+        relax(node + stride, straight);
+      if (left)
+        relax(node - 1, straight);
+      if (right)
+        relax(node + 1, straight);
+      if (up && left && !(g[-stride - 1] & 1))
+        relax(node - stride - 1, diag);
+      if (up && right && !(g[-stride + 1] & 1))
+        relax(node - stride + 1, diag);
+      if (down && left && !(g[stride - 1] & 1))
+        relax(node + stride - 1, diag);
+      if (down && right && !(g[stride + 1] & 1))
+        relax(node + stride + 1, diag);
+    }
+    bucket.clear();
+  }
+}
+
+void Pathfinder::costs(unsigned cluster, GridPoint source, PathSearch &search,
+                       std::vector<float> &out) const {
+  const Rect r = rect(cluster);
+  const std::vector<Entrance> &entrances = m_clusters[cluster].entrances;
+  flood(r, source, entrances, search);
+  out.clear();
+  for (const Entrance &e : entrances) {
+    uint32_t node = local(r, point(e.cell));
+    out.push_back(search.m_closed[node] == search.m_generation
+                      ? search.m_cost[node]
+                      : unreachable);
+  }
+}
+
+bool Pathfinder::jump(const Rect &r, int32_t &x, int32_t &y, int dx, int dy,
+                      GridPoint goal) const {
+  for (;; x += dx, y += dy) {
+    if (!open(r, x, y))
+      return false;
+    if (x == goal.x && y == goal.y)
+      return true;
+    if (dx && dy) {
+      // A diagonal move stops where a straight move from it would find
+      // something.
+      int32_t hx = x + dx, hy = y, vx = x, vy = y + dy;
+      if (jump(r, hx, hy, dx, 0, goal) || jump(r, vx, vy, 0, dy, goal))
+        return true;
+      if (!open(r, x + dx, y) || !open(r, x, y + dy))
+        return false;
+    } else if (dx) {
+      // Stop next to the end of a wall, where a new way opens up.
+      if ((open(r, x, y - 1) && !open(r, x - dx, y - 1)) ||
+          (open(r, x, y + 1) && !open(r, x - dx, y + 1)))
+        return true;
+    } else {
+      if ((open(r, x - 1, y) && !open(r, x - 1, y - dy)) ||
+          (open(r, x + 1, y) && !open(r, x + 1, y - dy)))
+        return true;
+    }
+  }
+}
+
+float Pathfinder::jps(const Rect &r, GridPoint start, GridPoint goal,
+                      PathSearch &search, std::vector<GridPoint> &out) const {
+  int32_t w = r.x1 - r.x0;
+  auto index = [&](int32_t x, int32_t y) {
+    return uint32_t((y - r.y0) * w + x - r.x0);
+  };
+  search.reset(size_t(w) * (r.y1 - r.y0));
+  uint32_t first = index(start.x, start.y), last = index(goal.x, goal.y);
+  search.relax(first, 0, octile(goal.x - start.x, goal.y - start.y), first);
+  bool found = false;
+  uint32_t node;
+  while (search.pop(node)) {
+    if (node == last) {
+      found = true;
+      break;
+    }
+    int32_t x = r.x0 + node % w, y = r.y0 + node / w;
+    uint32_t parent = search.m_parent[node];
+    int32_t px = r.x0 + parent % w, py = r.y0 + parent / w;
+    int dx = sign(x - px), dy = sign(y - py);
+
+    // Prune the neighbors that are reached at least as cheaply without
+    // passing through this cell.
+    int dirs[8][2], num = 0;
+    auto add = [&](int ax, int ay) {
+      dirs[num][0] = ax;
+      dirs[num][1] = ay;
+      num++;
+    };
+    if (node == first) {
+      for (int ay = -1; ay <= 1; ay++)
+        for (int ax = -1; ax <= 1; ax++)
+          if ((ax || ay) &&
+              (!ax || !ay || (open(r, x + ax, y) && open(r, x, y + ay))))
+            add(ax, ay);
+    } else if (dx && dy) {
+      bool h = open(r, x + dx, y), v = open(r, x, y + dy);
+      if (h)
+        add(dx, 0);
+      if (v)
+        add(0, dy);
+      if (h && v)
+        add(dx, dy);
+    } else if (dx) {
+      bool ahead = open(r, x + dx, y);
+      bool up = open(r, x, y - 1), down = open(r, x, y + 1);
+      if (ahead) {
+        add(dx, 0);
+        if (up)
+          add(dx, -1);
+        if (down)
+          add(dx, 1);
+      }
+      if (up)
+        add(0, -1);
+      if (down)
+        add(0, 1);
+    } else {
+      bool ahead = open(r, x, y + dy);
+      bool left = open(r, x - 1, y), right = open(r, x + 1, y);
+      if (ahead) {
+        add(0, dy);
+        if (left)
+          add(-1, dy);
+        if (right)
+          add(1, dy);
+      }
+      if (left)
+        add(-1, 0);
+      if (right)
+        add(1, 0);
+    }
+
+    float cost = search.m_cost[node];
+    for (int i = 0; i < num; i++) {
+      int32_t jx = x + dirs[i][0], jy = y + dirs[i][1];
+      if (jump(r, jx, jy, dirs[i][0], dirs[i][1], goal))
+        search.relax(index(jx, jy), cost + octile(jx - x, jy - y),
+                     octile(goal.x - jx, goal.y - jy), node);
+    }
+  }
+  if (!found)
+    return unreachable;
+
+  size_t mark = out.size();
+  for (uint32_t n = last; n != first; n = search.m_parent[n])
+    out.push_back({int32_t(r.x0 + n % w), int32_t(r.y0 + n / w)});
+  std::reverse(out.begin() + mark, out.end());
+  return search.m_cost[last];
+}
+
+std::unique_ptr<PathSearch> Pathfinder::acquire() const {
+  std::lock_guard<std::mutex> guard(m_lock);
+  if (m_searches.empty())
+    return std::make_unique<PathSearch>();
+  std::unique_ptr<PathSearch> search = std::move(m_searches.back());
+  m_searches.pop_back();
+  return search;
+}
+
+void Pathfinder::release(std::unique_ptr<PathSearch> search) const {
+  std::lock_guard<std::mutex> guard(m_lock);
+  m_searches.push_back(std::move(search));
+}
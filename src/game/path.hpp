@@ -0,0 +1,253 @@
+/**
+ * \file
+ * \brief Find paths on large tile grids.
+ */
+
+#ifndef PATH_HPP
+#define PATH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class JobPool;
+
+/// A cell of a path grid.
+struct GridPoint {
+  int32_t x, y;
+
+  bool operator==(const GridPoint &rhs) const {
+    return x == rhs.x && y == rhs.y;
+  }
+  bool operator!=(const GridPoint &rhs) const { return !(*this == rhs); }
+};
+
+/// A path request for Pathfinder::find_batch().
+struct PathQuery {
+  GridPoint start, goal;
+};
+
+/// The answer to a PathQuery.
+struct PathResult {
+  std::vector<GridPoint> path; ///< Waypoints, see Pathfinder::find().
+  float cost;                  ///< Length, or Pathfinder::unreachable.
+};
+
+/**
+ * \brief Scratch space for path searches.
+ *
+ * The open list and the per-node arrays are kept from one search to the next,
+ * so searches don't allocate once they've grown to size. Nodes are marked
+ * with a generation number instead of clearing the arrays. Use one per thread.
+ */
+class PathSearch {
+  friend class Pathfinder;
+
+  struct Open {
+    float f, cost;
+    uint32_t node;
+
+    // Reversed so that the standard heap functions give the smallest f. Ties
+    // go to the node furthest along, which saves exploring many equally good
+    // paths on open ground.
+    bool operator<(const Open &rhs) const {
+      return rhs.f < f || (rhs.f == f && cost < rhs.cost);
+    }
+  };
+
+  std::vector<Open> m_open;
+  std::vector<uint32_t> m_buckets[3]; ///< Open list of floods.
+  std::vector<uint8_t> m_grid;        ///< Cells being flooded.
+  std::vector<uint32_t> m_seen, m_closed; ///< Generation stamps.
+  std::vector<float> m_cost;
+  std::vector<uint32_t> m_parent;
+  uint32_t m_generation = 0;
+
+  // Reused by Pathfinder::find().
+  std::vector<float> m_start_cost, m_goal_cost;
+  std::vector<uint32_t> m_route;
+
+  /// Start a search over nodes [0, num).
+  void reset(size_t num);
+  /// Lower a node's cost and add it to the open list.
+  void relax(uint32_t node, float cost, float estimate, uint32_t parent);
+  /// Close the open node with the smallest estimate.
+  bool pop(uint32_t &node);
+};
+
+/**
+ * \brief Shortest paths on a grid of open and blocked cells.
+ *
+ * Paths move between the eight neighbors of a cell. Straight steps cost 1 and
+ * diagonal steps cost √2. A diagonal step is only allowed if both cells next
+ * to it are open, so paths don't cut corners.
+ *
+ * find_jps() uses Jump Point Search, which finds optimal paths but visits a
+ * large part of the map when there's no straight route. find() uses HPA*,
+ * which searches an abstract graph of entrances between square clusters of
+ * cells, then refines the route with Jump Point Search inside each cluster.
+ * Its paths are close to optimal, and it only visits a few nodes per cluster
+ * along the way.
+ *
+ * The abstract graph is kept between queries. Changing a cell only marks its
+ * cluster (and the neighbor across a cluster border) out of date, and update()
+ * rebuilds just those clusters.
+ *
+ * Queries are const and thread-safe, as long as the grid doesn't change at
+ * the same time.
+ */
+class Pathfinder {
+public:
+  /// Cost of a path that doesn't exist.
+  static constexpr float unreachable = std::numeric_limits<float>::infinity();
+
+  /// Tuning parameters.
+  struct Params {
+    /// Width and height of the clusters used by find().
+    unsigned cluster_size = 32;
+    /**
+     * \brief Scale of the distance estimate in the abstract search.
+     *
+     * Above 1, the search heads for the goal more greedily. It visits far
+     * fewer entrances on maps with many walls, and finds paths at most this
+     * many times longer than the best route through the entrances.
+     */
+    float weight = 1.25f;
+  };
+
+private:
+  /// A cell pair where a path can cross a cluster border.
+  struct Entrance {
+    uint32_t cell;    ///< Cell index on this side.
+    uint32_t partner; ///< Cell index on the other side.
+    uint32_t link;    ///< Index of the partner's entrance in its cluster.
+  };
+
+  enum Side { Left, Right, Top, Bottom };
+
+  struct Cluster {
+    std::vector<Entrance> entrances;
+    /// Entrances on each side, as ranges starting at these indices.
+    uint32_t sides[5] = {};
+    /// Costs between entrances staying inside the cluster (row-major).
+    std::vector<float> cost;
+    bool dirty = true;
+  };
+
+  /// Cells [x0, x1) × [y0, y1).
+  struct Rect {
+    int32_t x0, y0, x1, y1;
+  };
+
+  unsigned m_width, m_height, m_cluster_size;
+  float m_weight;
+  unsigned m_clusters_x, m_clusters_y;
+  std::vector<uint8_t> m_blocked;
+  std::vector<Cluster> m_clusters;
+  std::vector<uint32_t> m_dirty;
+
+  // Numbering of abstract nodes, rebuilt by update().
+  std::vector<uint32_t> m_first; ///< First node of each cluster.
+  std::vector<uint32_t> m_owner; ///< Cluster of each node.
+
+  mutable std::mutex m_lock;
+  mutable std::vector<std::unique_ptr<PathSearch>> m_searches;
+
+public:
+  /**
+   * \brief Create a grid with all cells open.
+   * \param params tuning parameters
+   */
+  Pathfinder(unsigned width, unsigned height, const Params &params);
+
+  Pathfinder(const Pathfinder &other) = delete;
+  Pathfinder &operator=(const Pathfinder &other) = delete;
+
+  unsigned width() const { return m_width; }
+  unsigned height() const { return m_height; }
+
+  /// Check if a cell is blocked. Cells outside the grid are blocked.
+  bool blocked(int32_t x, int32_t y) const {
+    return x < 0 || y < 0 || unsigned(x) >= m_width ||
+           unsigned(y) >= m_height || m_blocked[size_t(y) * m_width + x];
+  }
+
+  /// Open or block a cell. Call update() before the next find().
+  void set_blocked(unsigned x, unsigned y, bool blocked);
+
+  /// Get the number of clusters that update() will rebuild.
+  size_t dirty() const { return m_dirty.size(); }
+
+  /// Get the number of nodes in the abstract graph.
+  size_t nodes() const { return m_first.back(); }
+
+  /**
+   * \brief Rebuild the clusters that changed since the last update.
+   * \param pool rebuilds clusters in parallel (optional)
+   */
+  void update(JobPool *pool = nullptr);
+
+  /**
+   * \brief Find a path with HPA*.
+   *
+   * The path is a list of waypoints from start to goal. Consecutive waypoints
+   * are joined by a horizontal, vertical or diagonal line. The grid must be
+   * up to date, see update().
+   *
+   * \param search scratch space
+   * \param[out] path waypoints (replaced), empty if there is no path
+   * \return length of the path, or unreachable
+   */
+  float find(GridPoint start, GridPoint goal, PathSearch &search,
+             std::vector<GridPoint> &path) const;
+
+  /// Find an optimal path with Jump Point Search over the whole grid.
+  float find_jps(GridPoint start, GridPoint goal, PathSearch &search,
+                 std::vector<GridPoint> &path) const;
+
+  /**
+   * \brief Answer many queries with find(), in parallel.
+   * \param[out] results one for each query
+   */
+  void find_batch(const PathQuery *queries, size_t num, PathResult *results,
+                  JobPool &pool) const;
+
+private:
+  unsigned cluster_of(uint32_t cell) const {
+    return cell / m_width / m_cluster_size * m_clusters_x +
+           cell % m_width / m_cluster_size;
+  }
+  GridPoint point(uint32_t cell) const {
+    return {int32_t(cell % m_width), int32_t(cell / m_width)};
+  }
+  uint32_t cell(GridPoint p) const { return p.y * m_width + p.x; }
+  Rect rect(unsigned cluster) const;
+  bool open(const Rect &r, int32_t x, int32_t y) const {
+    return r.x0 <= x && x < r.x1 && r.y0 <= y && y < r.y1 &&
+           !m_blocked[size_t(y) * m_width + x];
+  }
+
+  void mark(unsigned cx, unsigned cy);
+  void build(unsigned cluster, PathSearch &search);
+  void link(unsigned cluster);
+  /// Index of a cell in the grid copied by flood().
+  static uint32_t local(const Rect &r, GridPoint p) {
+    return (p.y - r.y0 + 1) * (r.x1 - r.x0 + 2) + p.x - r.x0 + 1;
+  }
+  void flood(const Rect &r, GridPoint source,
+             const std::vector<Entrance> &targets, PathSearch &search) const;
+  void costs(unsigned cluster, GridPoint source, PathSearch &search,
+             std::vector<float> &out) const;
+  bool jump(const Rect &r, int32_t &x, int32_t &y, int dx, int dy,
+            GridPoint goal) const;
+  float jps(const Rect &r, GridPoint start, GridPoint goal, PathSearch &search,
+            std::vector<GridPoint> &out) const;
+
+  std::unique_ptr<PathSearch> acquire() const;
+  void release(std::unique_ptr<PathSearch> search) const;
+};
+
+#endif
@@ -0,0 +1,182 @@
+#include "render.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+#include <utility>
+
+#include <SDL3/SDL_error.h>
+
+#include "util.hpp"
+
+namespace {
+
+SDL_BlendMode native_blend_mode(BlendMode mode) {
+  switch (mode) {
+  case BlendMode::None:
+    return SDL_BLENDMODE_NONE;
+  case BlendMode::Blend:
+    return SDL_BLENDMODE_BLEND;
+  case BlendMode::Add:
+    return SDL_BLENDMODE_ADD;
+  case BlendMode::Multiply:
+    return SDL_BLENDMODE_MUL;
+  }
+  assert(false);
+  return SDL_BLENDMODE_NONE;
+}
+
+} // namespace
+
+RenderQueue::RenderQueue() { clear_textures(); }
+
+uint16_t RenderQueue::texture(SDL_Texture *t) {
+  if (!t)
+    return 0;
+  auto it = m_texture_ids.find(t);
+  if (it != m_texture_ids.end())
+    return it->second;
+  if (UINT16_MAX < m_textures.size()) {
+    log_crit("Too many textures in the render queue");
+    throw FatalError::ResourceLimit;
+  }
+  uint16_t id = m_textures.size();
+  m_textures.push_back(t);
+  m_texture_ids.emplace(t, id);
+  return id;
+}
+
+void RenderQueue::clear_textures() {
+  m_textures.assign(1, nullptr);
+  m_texture_ids.clear();
+}
+
+RenderQueue::Geometry RenderQueue::push(uint64_t key, unsigned num_vertices,
+                                        unsigned num_indices) {
+  assert(num_indices % 3 == 0);
+  assert((key >> 40 & 0xffff) < m_textures.size());
+  Command c = {uint32_t(m_vertices.size()), num_vertices,
+               uint32_t(m_indices.size()), num_indices};
+  m_keys.push_back(key);
+  m_commands.push_back(c);
+  m_vertices.resize(m_vertices.size() + num_vertices);
+  m_indices.resize(m_indices.size() + num_indices);
+  return {m_vertices.data() + c.first_vertex,
+          m_indices.data() + c.first_index};
+}
+
+void RenderQueue::quad(uint64_t key, const SDL_FRect &dst, const SDL_FRect &uv,
+                       SDL_FColor color) {
+  Geometry g = push(key, 4, 6);
+  float x[2] = {dst.x, dst.x + dst.w}, y[2] = {dst.y, dst.y + dst.h};
+  float u[2] = {uv.x, uv.x + uv.w}, v[2] = {uv.y, uv.y + uv.h};
+  for (int i = 0; i < 4; i++)
+    g.vertices[i] = {{x[i & 1], y[i >> 1]}, color, {u[i & 1], v[i >> 1]}};
+  const int indices[] = {0, 1, 2, 2, 1, 3};
+  memcpy(g.indices, indices, sizeof indices);
+}
+
+void RenderQueue::flush(SDL_Renderer *renderer) {
+  m_draw_calls = 0;
+  sort();
+  const auto &keys = m_sort_keys[0];
+  const auto &order = m_sort_order[0];
+  size_t n = keys.size();
+  for (size_t i = 0; i < n;) {
+    // Merge the run of commands that share a texture and blend mode. Pass
+    // only the batch's vertices: SDL copies every vertex it's given.
+    uint64_t state = keys[i] >> 32 & 0xffffff;
+    size_t first = i;
+    uint32_t lo = UINT32_MAX, hi = 0, num_vertices = 0;
+    for (; i < n && (keys[i] >> 32 & 0xffffff) == state; i++) {
+      const Command &c = m_commands[order[i]];
+      lo = std::min(lo, c.first_vertex);
+      hi = std::max(hi, c.first_vertex + c.num_vertices);
+      num_vertices += c.num_vertices;
+    }
+    // If the batch's vertices are contiguous in the arena, as when commands
+    // are recorded in the order they're drawn, they're passed in place.
+    // Otherwise they're gathered.
+    bool gather = hi - lo != num_vertices;
+    const SDL_Vertex *vertices = m_vertices.data() + lo;
+    m_batch.clear();
+    m_batch_vertices.clear();
+    for (size_t k = first; k < i; k++) {
+      const Command &c = m_commands[order[k]];
+      const int *src = m_indices.data() + c.first_index;
+      int base = c.first_vertex - lo;
+      if (gather) {
+        base = m_batch_vertices.size();
+        m_batch_vertices.insert(m_batch_vertices.end(),
+                                m_vertices.begin() + c.first_vertex,
+                                m_vertices.begin() + c.first_vertex +
+                                    c.num_vertices);
+      }
+      for (uint32_t j = 0; j < c.num_indices; j++)
+        m_batch.push_back(base + src[j]);
+    }
+    if (gather)
+      vertices = m_batch_vertices.data();
+    SDL_Texture *texture = m_textures[state >> 8];
+    SDL_BlendMode mode = native_blend_mode(BlendMode(state & 0xff));
+    bool ok = texture ? SDL_SetTextureBlendMode(texture, mode)
+                      : SDL_SetRenderDrawBlendMode(renderer, mode);
+    ok = ok && SDL_RenderGeometry(renderer, texture, vertices, num_vertices,
+                                  m_batch.data(), m_batch.size());
+    if (!ok) {
+      log_crit("SDL_RenderGeometry: %s", SDL_GetError());
+      throw FatalError::Platform;
+    }
+    m_draw_calls++;
+  }
+  clear();
+}
+
+void RenderQueue::clear() {
+  m_keys.clear();
+  m_commands.clear();
+  m_vertices.clear();
+  m_indices.clear();
+}
+
+void RenderQueue::sort() {
+  size_t n = m_keys.size();
+  auto &keys = m_sort_keys;
+  auto &order = m_sort_order;
+  keys[0].assign(m_keys.begin(), m_keys.end());
+  keys[1].resize(n);
+  order[0].resize(n);
+  order[1].resize(n);
+  std::iota(order[0].begin(), order[0].end(), 0);
+  if (!n)
+    return;
+  // LSD radix sort, one byte at a time. It's stable, so commands with equal
+  // keys stay in recording order.
+  size_t counts[8][256] = {};
+  for (uint64_t k : m_keys)
+    for (int b = 0; b < 8; b++)
+      counts[b][k >> 8 * b & 255]++;
+  int src = 0;
+  for (int b = 0; b < 8; b++) {
+    const size_t *count = counts[b];
+    // Skip bytes that are the same in every key (e.g. unused layers).
+    if (count[m_keys[0] >> 8 * b & 255] == n)
+      continue;
+    size_t offset[256];
+    for (size_t d = 0, sum = 0; d < 256; d++) {
+      offset[d] = sum;
+      sum += count[d];
+    }
+    for (size_t i = 0; i < n; i++) {
+      uint64_t k = keys[src][i];
+      size_t o = offset[k >> 8 * b & 255]++;
+      keys[1 - src][o] = k;
+      order[1 - src][o] = order[src][i];
+    }
+    src = 1 - src;
+  }
+  if (src) {
+    std::swap(keys[0], keys[1]);
+    std::swap(order[0], order[1]);
+  }
+}
@@ -0,0 +1,148 @@
+/**
+ * \file
+ * \brief Sort and batch draw commands for the SDL renderer.
+ */
+
+#ifndef RENDER_HPP
+#define RENDER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include <SDL3/SDL_render.h>
+
+/// Blend modes that draw commands can use.
+enum class BlendMode : uint8_t {
+  None,     ///< Overwrite the target.
+  Blend,    ///< Alpha blending.
+  Add,      ///< Additive blending.
+  Multiply, ///< Color multiply.
+};
+
+/**
+ * \brief Build a 64-bit sort key.
+ *
+ * Commands are drawn in order of increasing key. The fields from most to least
+ * significant are layer, texture, blend mode and depth. Commands with equal
+ * keys are drawn in the order they were recorded.
+ *
+ * Because texture is more significant than depth, overlapping translucent
+ * sprites with different textures should be separated by layer.
+ *
+ * \param layer draw order of groups of commands
+ * \param texture ID from RenderQueue::texture()
+ * \param blend how to combine with the target
+ * \param depth draw order within a layer, texture and blend mode
+ */
+inline uint64_t sort_key(uint8_t layer, uint16_t texture, BlendMode blend,
+                         uint32_t depth) {
+  return uint64_t(layer) << 56 | uint64_t(texture) << 40 |
+         uint64_t(blend) << 32 | depth;
+}
+
+/// Map a float to a depth value that sorts in the same order.
+inline uint32_t depth_key(float depth) {
+  uint32_t bits;
+  memcpy(&bits, &depth, sizeof bits);
+  return bits & 0x80000000 ? ~bits : bits | 0x80000000;
+}
+
+/**
+ * \brief Collect draw commands for one frame and submit them in few calls.
+ *
+ * Once per frame, commands are radix-sorted by key. Consecutive commands with
+ * the same texture and blend mode are merged into one SDL_RenderGeometry()
+ * call. Vertex and index storage is reused from frame to frame, so recording
+ * doesn't allocate once the buffers have grown to the size of a frame.
+ */
+class RenderQueue {
+  struct Command {
+    uint32_t first_vertex;
+    uint32_t num_vertices;
+    uint32_t first_index;
+    uint32_t num_indices;
+  };
+
+  std::vector<SDL_Texture *> m_textures;
+  std::unordered_map<SDL_Texture *, uint16_t> m_texture_ids;
+
+  // Per-frame arenas. Each command's indices are relative to its first vertex.
+  std::vector<uint64_t> m_keys;
+  std::vector<Command> m_commands;
+  std::vector<SDL_Vertex> m_vertices;
+  std::vector<int> m_indices;
+
+  // Scratch space for sorting and merging.
+  std::vector<uint64_t> m_sort_keys[2];
+  std::vector<uint32_t> m_sort_order[2];
+  std::vector<int> m_batch;
+  std::vector<SDL_Vertex> m_batch_vertices;
+
+  size_t m_draw_calls = 0;
+
+public:
+  /// Space reserved for one command's geometry.
+  struct Geometry {
+    SDL_Vertex *vertices; ///< Vertices to fill in.
+    int *indices;         ///< Triangle list. Index 0 is the first vertex.
+  };
+
+  RenderQueue();
+
+  /**
+   * \brief Get the ID of a texture for use in sort keys.
+   *
+   * ID 0 means no texture. Textures keep their IDs until clear_textures().
+   *
+   * \throw FatalError::ResourceLimit if there are too many textures
+   */
+  uint16_t texture(SDL_Texture *t);
+
+  /// Forget all texture IDs, e.g. when textures are destroyed.
+  void clear_textures();
+
+  /**
+   * \brief Record a command and reserve space for its geometry.
+   *
+   * The pointers are valid until the next call to push() or flush().
+   *
+   * \param key see sort_key()
+   * \param num_vertices number of vertices
+   * \param num_indices number of indices (a multiple of 3)
+   */
+  Geometry push(uint64_t key, unsigned num_vertices, unsigned num_indices);
+
+  /**
+   * \brief Record a textured rectangle.
+   * \param key see sort_key()
+   * \param dst destination in render coordinates
+   * \param uv texture coordinates (0 to 1)
+   * \param color vertex color
+   */
+  void quad(uint64_t key, const SDL_FRect &dst, const SDL_FRect &uv,
+            SDL_FColor color);
+
+  /// Get the number of commands recorded since the last flush.
+  size_t size() const { return m_keys.size(); }
+
+  /// Get the number of SDL_RenderGeometry() calls made by the last flush.
+  size_t draw_calls() const { return m_draw_calls; }
+
+  /**
+   * \brief Sort, merge and draw all recorded commands, then clear them.
+   * \throw FatalError::Platform if the renderer fails
+   */
+  void flush(SDL_Renderer *renderer);
+
+  /// Discard all recorded commands without drawing them.
+  void clear();
+
+private:
+  /// Sort the command indices by key. The result is in m_sort_order[0].
+  void sort();
+};
+
+#endif
@@ -0,0 +1,210 @@
+#include "replay.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "util.hpp"
+
+namespace {
+
+/// Identifies a replay.
+constexpr uint32_t replay_magic = 0x31505244; // "DRP1"
+
+/// Check if an event is recorded.
+bool recorded(uint32_t type) {
+  switch (type) {
+  case SDL_EVENT_QUIT:
+  case SDL_EVENT_KEY_DOWN:
+  case SDL_EVENT_KEY_UP:
+  case SDL_EVENT_TEXT_INPUT:
+  case SDL_EVENT_MOUSE_MOTION:
+  case SDL_EVENT_MOUSE_BUTTON_DOWN:
+  case SDL_EVENT_MOUSE_BUTTON_UP:
+  case SDL_EVENT_MOUSE_WHEEL:
+  case SDL_EVENT_GAMEPAD_AXIS_MOTION:
+  case SDL_EVENT_GAMEPAD_BUTTON_DOWN:
+  case SDL_EVENT_GAMEPAD_BUTTON_UP:
+    return true;
+  default:
+    return false;
+  }
+}
+
+} // namespace
+
+ReplayRecorder::ReplayRecorder() { m_out.put(replay_magic); }
+
+void ReplayRecorder::event(const SDL_Event &e) {
+  if (!recorded(e.type))
+    return;
+  // Timestamps are stored as the time since the previous event, which is
+  // usually small.
+  uint64_t time = std::max(m_time, e.common.timestamp);
+  m_events.varint(e.type);
+  m_events.varint(time - m_time);
+  m_time = time;
+  switch (e.type) {
+  case SDL_EVENT_KEY_DOWN:
+  case SDL_EVENT_KEY_UP:
+    m_events.varint(e.key.windowID);
+    m_events.varint(e.key.which);
+    m_events.varint(e.key.scancode);
+    m_events.varint(e.key.key);
+    m_events.varint(e.key.mod);
+    m_events.varint(e.key.raw);
+    m_events.put(uint8_t(e.key.repeat));
+    break;
+  case SDL_EVENT_TEXT_INPUT:
+    // Include the terminator so playback can point into the replay.
+    m_events.varint(e.text.windowID);
+    m_events.string({e.text.text, strlen(e.text.text) + 1});
+    break;
+  case SDL_EVENT_MOUSE_MOTION:
+    m_events.varint(e.motion.windowID);
+    m_events.varint(e.motion.which);
+    m_events.varint(e.motion.state);
+    m_events.put(e.motion.x);
+    m_events.put(e.motion.y);
+    m_events.put(e.motion.xrel);
+    m_events.put(e.motion.yrel);
+    break;
+  case SDL_EVENT_MOUSE_BUTTON_DOWN:
+  case SDL_EVENT_MOUSE_BUTTON_UP:
+    m_events.varint(e.button.windowID);
+    m_events.varint(e.button.which);
+    m_events.put(e.button.button);
+    m_events.put(e.button.clicks);
+    m_events.put(e.button.x);
+    m_events.put(e.button.y);
+    break;
+  case SDL_EVENT_MOUSE_WHEEL:
+    m_events.varint(e.wheel.windowID);
+    m_events.varint(e.wheel.which);
+    m_events.varint(e.wheel.direction);
+    m_events.put(e.wheel.x);
+    m_events.put(e.wheel.y);
+    m_events.put(e.wheel.mouse_x);
+    m_events.put(e.wheel.mouse_y);
+    break;
+  case SDL_EVENT_GAMEPAD_AXIS_MOTION:
+    m_events.varint(e.gaxis.which);
+    m_events.put(e.gaxis.axis);
+    m_events.put(e.gaxis.value);
+    break;
+  case SDL_EVENT_GAMEPAD_BUTTON_DOWN:
+  case SDL_EVENT_GAMEPAD_BUTTON_UP:
+    m_events.varint(e.gbutton.which);
+    m_events.put(e.gbutton.button);
+    break;
+  }
+  m_num_events++;
+}
+
+void ReplayRecorder::frame(float dt, uint64_t seed, uint64_t checksum) {
+  m_out.put(dt);
+  m_out.put(seed);
+  m_out.varint(checksum);
+  m_out.varint(m_num_events);
+  m_out.write(m_events.data(), m_events.size());
+  m_events.clear();
+  m_num_events = 0;
+  m_frames++;
+}
+
+ReplayPlayer::ReplayPlayer(const void *data, size_t num) : m_in(data, num) {
+  if (m_in.remaining() < sizeof replay_magic ||
+      m_in.get<uint32_t>() != replay_magic) {
+    log_crit("Not a replay");
+    throw FatalError::Decode;
+  }
+}
+
+bool ReplayPlayer::next(ReplayFrame &frame) {
+  if (m_in.empty())
+    return false;
+  frame.dt = m_in.get<float>();
+  frame.seed = m_in.get<uint64_t>();
+  frame.checksum = m_in.varint();
+  size_t num = m_in.varint();
+  // Each event takes at least two bytes.
+  if (m_in.remaining() / 2 < num) {
+    log_crit("Replay is truncated");
+    throw FatalError::Decode;
+  }
+  frame.events.resize(num);
+  for (SDL_Event &e : frame.events) {
+    memset(&e, 0, sizeof e);
+    e.type = m_in.varint();
+    m_time += m_in.varint();
+    e.common.timestamp = m_time;
+    switch (e.type) {
+    case SDL_EVENT_QUIT:
+      break;
+    case SDL_EVENT_KEY_DOWN:
+    case SDL_EVENT_KEY_UP:
+      e.key.down = e.type == SDL_EVENT_KEY_DOWN;
+      e.key.windowID = m_in.varint();
+      e.key.which = m_in.varint();
+      e.key.scancode = SDL_Scancode(m_in.varint());
+      e.key.key = m_in.varint();
+      e.key.mod = m_in.varint();
+      e.key.raw = m_in.varint();
+      e.key.repeat = m_in.get<uint8_t>();
+      break;
+    case SDL_EVENT_TEXT_INPUT: {
+      e.text.windowID = m_in.varint();
+      std::string_view text = m_in.string();
+      if (text.empty() || text.back()) {
+        log_crit("Invalid text in replay");
+        throw FatalError::Decode;
+      }
+      e.text.text = text.data();
+      break;
+    }
+    case SDL_EVENT_MOUSE_MOTION:
+      e.motion.windowID = m_in.varint();
+      e.motion.which = m_in.varint();
+      e.motion.state = m_in.varint();
+      e.motion.x = m_in.get<float>();
+      e.motion.y = m_in.get<float>();
+      e.motion.xrel = m_in.get<float>();
+      e.motion.yrel = m_in.get<float>();
+      break;
+    case SDL_EVENT_MOUSE_BUTTON_DOWN:
+    case SDL_EVENT_MOUSE_BUTTON_UP:
+      e.button.down = e.type == SDL_EVENT_MOUSE_BUTTON_DOWN;
+      e.button.windowID = m_in.varint();
+      e.button.which = m_in.varint();
+      e.button.button = m_in.get<uint8_t>();
+      e.button.clicks = m_in.get<uint8_t>();
+      e.button.x = m_in.get<float>();
+      e.button.y = m_in.get<float>();
+      break;
+    case SDL_EVENT_MOUSE_WHEEL:
+      e.wheel.windowID = m_in.varint();
+      e.wheel.which = m_in.varint();
+      e.wheel.direction = SDL_MouseWheelDirection(m_in.varint());
+      e.wheel.x = m_in.get<float>();
+      e.wheel.y = m_in.get<float>();
+      e.wheel.mouse_x = m_in.get<float>();
+      e.wheel.mouse_y = m_in.get<float>();
+      break;
+    case SDL_EVENT_GAMEPAD_AXIS_MOTION:
+      e.gaxis.which = m_in.varint();
+      e.gaxis.axis = m_in.get<uint8_t>();
+      e.gaxis.value = m_in.get<int16_t>();
+      break;
+    case SDL_EVENT_GAMEPAD_BUTTON_DOWN:
+    case SDL_EVENT_GAMEPAD_BUTTON_UP:
+      e.gbutton.down = e.type == SDL_EVENT_GAMEPAD_BUTTON_DOWN;
+      e.gbutton.which = m_in.varint();
+      e.gbutton.button = m_in.get<uint8_t>();
+      break;
+    default:
+      log_crit("Unknown event in replay: 0x%x", unsigned(e.type));
+      throw FatalError::Decode;
+    }
+  }
+  m_frames++;
+  return true;
+}
@@ -0,0 +1,103 @@
+/**
+ * \file
+ * \brief Record input so a play session can be replayed exactly.
+ *
+ * A replay stores, for each simulation step, the step's duration, the seed
+ * for its random numbers and the input events that it handled. As long as the
+ * simulation only depends on those (and not on the wall clock or on
+ * unseeded random numbers), playing the replay reproduces the session. Steps
+ * can be replayed back to back without rendering, which makes a reported
+ * hitch easy to reproduce under a profiler or to run as a benchmark.
+ */
+
+#ifndef REPLAY_HPP
+#define REPLAY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <SDL3/SDL_events.h>
+
+#include "serial.hpp"
+
+/// Everything a simulation step depends on.
+struct ReplayFrame {
+  float dt = 0;          ///< Duration of the step in seconds.
+  uint64_t seed = 0;     ///< Seed for the step's random numbers.
+  uint64_t checksum = 0; ///< Simulation state after the step (0 is none).
+  std::vector<SDL_Event> events; ///< Input handled by the step.
+};
+
+/**
+ * \brief Write a replay to memory.
+ *
+ * Only events that can affect the simulation are recorded: keyboard, text,
+ * mouse, gamepad and quit events. Other events are ignored. Each event takes
+ * 10 to 30 bytes, and each step a few bytes more.
+ */
+class ReplayRecorder {
+  ByteWriter m_out;
+  size_t m_frames = 0;
+  ByteWriter m_events; ///< Events of the current step.
+  size_t m_num_events = 0;
+  uint64_t m_time = 0; ///< Timestamp of the last event.
+
+public:
+  ReplayRecorder();
+
+  /**
+   * \brief Record an event for the current step.
+   *
+   * The event is encoded right away, so text pointers don't need to stay
+   * valid.
+   */
+  void event(const SDL_Event &e);
+
+  /**
+   * \brief Finish the current step.
+   * \param dt duration of the step in seconds
+   * \param seed seed that the step used
+   * \param checksum hash of the simulation state after the step, which lets
+   *                 playback detect when it diverges (optional)
+   */
+  void frame(float dt, uint64_t seed, uint64_t checksum = 0);
+
+  /// Get the number of steps recorded.
+  size_t frames() const { return m_frames; }
+
+  /// Get the replay, which can be saved to a file.
+  const ByteWriter &data() const { return m_out; }
+};
+
+/**
+ * \brief Read a replay one step at a time.
+ *
+ * The replay data must stay valid while the player is used, because the text
+ * of text input events points into it.
+ */
+class ReplayPlayer {
+  ByteReader m_in;
+  size_t m_frames = 0;
+  uint64_t m_time = 0; ///< Timestamp of the last event.
+
+public:
+  /**
+   * \brief Start reading a replay from ReplayRecorder::data().
+   * \throw FatalError::Decode if the data isn't a replay
+   */
+  ReplayPlayer(const void *data, size_t num);
+
+  /**
+   * \brief Read the next step.
+   * \param[out] frame the step
+   * \return false at the end of the replay
+   * \throw FatalError::Decode if the data is invalid
+   */
+  bool next(ReplayFrame &frame);
+
+  /// Get the number of steps read so far.
+  size_t frames() const { return m_frames; }
+};
+
+#endif
@@ -0,0 +1,237 @@
+#include "save.hpp"
+
+#include <algorithm>
+
+#include "util.hpp"
+
+using namespace detail::ecs;
+
+namespace {
+
+/// Identifies an uncompressed snapshot.
+constexpr uint32_t save_magic = 0x56415344; // "DSAV"
+
+/// Field tags at the top level.
+enum : uint32_t { EntitiesField = 1, TableField = 2 };
+
+/**
+ * \brief Split a range of archetype rows into runs that don't cross chunks.
+ * \param fn called with (first row, number of rows) for each run
+ */
+template <typename F>
+void each_run(const Archetype &a, uint32_t begin, uint32_t end, F &&fn) {
+  while (begin < end) {
+    uint32_t n = std::min(a.capacity - begin % a.capacity, end - begin);
+    fn(begin, n);
+    begin += n;
+  }
+}
+
+} // namespace
+
+const SaveSchema::Entry *SaveSchema::find_tag(uint32_t tag) const {
+  for (auto &e : m_entries)
+    if (e.tag == tag)
+      return &e;
+  return nullptr;
+}
+
+const SaveSchema::Entry *SaveSchema::find_id(unsigned id) const {
+  for (auto &e : m_entries)
+    if (e.id == id)
+      return &e;
+  return nullptr;
+}
+
+WorldSnapshot::WorldSnapshot(const World &world, const SaveSchema &schema)
+    : m_version(schema.version()), m_free(world.m_free) {
+  m_generations.reserve(world.m_records.size());
+  for (auto &r : world.m_records)
+    m_generations.push_back(r.generation);
+  for (auto &ap : world.m_archetypes) {
+    const Archetype &a = *ap;
+    if (!a.size)
+      continue;
+    Table &t = m_tables.emplace_back();
+    t.entities.resize(a.size);
+    each_run(a, 0, a.size, [&](uint32_t row, uint32_t n) {
+      const Entity *src = a.entities(row / a.capacity) + row % a.capacity;
+      memcpy(&t.entities[row], src, n * sizeof(Entity));
+    });
+    for (unsigned id = 0; id < max_components; id++) {
+      const SaveSchema::Entry *entry;
+      if (!(a.mask >> id & 1) || !(entry = schema.find_id(id)))
+        continue;
+      size_t size = entry->size;
+      Column &c = t.columns.emplace_back();
+      c.entry = entry;
+      c.data.reset(new uint8_t[a.size * size]);
+      each_run(a, 0, a.size, [&](uint32_t row, uint32_t n) {
+        memcpy(c.data.get() + row * size, a.at(row, id, size), n * size);
+      });
+    }
+  }
+}
+
+void WorldSnapshot::write(ByteWriter &out) const {
+  size_t total = 0;
+  for (auto &t : m_tables) {
+    total += t.entities.size() * (sizeof(Entity) + 64);
+    for (auto &c : t.columns)
+      total += t.entities.size() * c.entry->size;
+  }
+  out.reserve(total + m_generations.size() * 4 + m_free.size() * 4 + 256);
+  out.put(save_magic);
+  out.put(m_version);
+  out.begin(EntitiesField);
+  out.array(m_generations.data(), m_generations.size());
+  out.array(m_free.data(), m_free.size());
+  out.end();
+  for (auto &t : m_tables) {
+    out.begin(TableField);
+    out.array(t.entities.data(), t.entities.size());
+    for (auto &c : t.columns) {
+      out.begin(c.entry->tag);
+      out.varint(c.entry->version);
+      out.varint(c.entry->size);
+      out.array(c.data.get(), t.entities.size() * c.entry->size);
+      out.end();
+    }
+    out.end();
+  }
+}
+
+namespace {
+
+/// A component array read from a table.
+struct LoadColumn {
+  const SaveSchema::Entry *entry;
+  const uint8_t *data;
+  /// Upgraded values, if the saved version is old.
+  std::unique_ptr<uint8_t[]> upgraded;
+};
+
+[[noreturn]] void invalid(const char *what) {
+  log_crit("Invalid save: %s", what);
+  throw FatalError::Decode;
+}
+
+} // namespace
+
+void WorldSnapshot::load(World &world, const SaveSchema &schema,
+                         ByteReader in) {
+  if (!world.m_records.empty()) {
+    log_crit("Can't load a save into a World that has entities");
+    throw FatalError::Decode;
+  }
+  if (in.get<uint32_t>() != save_magic)
+    invalid("not a save file");
+  auto version = in.get<uint32_t>();
+  if (schema.version() < version) {
+    log_crit("Save version %u is newer than %u", version, schema.version());
+    throw FatalError::Decode;
+  }
+
+  // Records that haven't been placed in an archetype yet are marked dead.
+  uint32_t tag;
+  ByteReader body(nullptr, 0);
+  if (!in.field(tag, body) || tag != EntitiesField)
+    invalid("missing entity table");
+  auto generations = body.array<uint32_t>();
+  auto free = body.array<uint32_t>();
+  auto &records = world.m_records;
+  records.resize(generations.size);
+  for (size_t i = 0; i < generations.size; i++)
+    records[i] = {0, 0, generations[i], false};
+  for (uint32_t index : free)
+    if (records.size() <= index)
+      invalid("free entity out of range");
+  world.m_free.assign(free.begin(), free.end());
+
+  while (in.field(tag, body)) {
+    if (tag != TableField)
+      continue;
+    auto entities = body.array<Entity>();
+    std::vector<LoadColumn> columns;
+    ComponentMask mask = 0;
+    ByteReader sub(nullptr, 0);
+    while (body.field(tag, sub)) {
+      const SaveSchema::Entry *entry = schema.find_tag(tag);
+      if (!entry)
+        continue;
+      auto saved_version = sub.varint();
+      auto size = sub.varint();
+      auto data = sub.array<uint8_t>();
+      if (size == 0 || data.size / size != entities.size ||
+          data.size % size != 0)
+        invalid("component array has the wrong size");
+      if (mask >> entry->id & 1)
+        invalid("duplicate component");
+      LoadColumn &c = columns.emplace_back();
+      c.entry = entry;
+      c.data = data.data;
+      if (saved_version != entry->version || size != entry->size) {
+        if (entry->version <= saved_version || !entry->upgrade) {
+          log_crit("Can't load version %u of component %u",
+                   unsigned(saved_version), entry->tag);
+          throw FatalError::Decode;
+        }
+        c.upgraded.reset(new uint8_t[entities.size * entry->size]);
+        entry->upgrade(saved_version, data.data, size, entities.size,
+                       c.upgraded.get());
+        c.data = c.upgraded.get();
+      }
+      mask |= ComponentMask(1) << entry->id;
+    }
+
+    uint32_t index = world.archetype(mask);
+    Archetype &a = *world.m_archetypes[index];
+    uint32_t begin = a.size;
+    for (Entity e : entities) {
+      if (records.size() <= e.index || records[e.index].alive ||
+          records[e.index].generation != e.generation)
+        invalid("bad entity handle");
+      records[e.index] = {index, a.push(e), e.generation, true};
+    }
+    for (auto &c : columns) {
+      size_t size = c.entry->size;
+      each_run(a, begin, a.size, [&](uint32_t row, uint32_t n) {
+        memcpy(a.at(row, c.entry->id, size), c.data + (row - begin) * size,
+               n * size);
+      });
+    }
+  }
+
+  // Every entity must be either alive or free, but not both.
+  std::vector<bool> is_free(records.size());
+  for (uint32_t index : world.m_free) {
+    if (records[index].alive || is_free[index])
+      invalid("entity is both alive and free");
+    is_free[index] = true;
+  }
+  for (size_t i = 0; i < records.size(); i++)
+    if (!records[i].alive && !is_free[i])
+      invalid("entity is missing");
+}
+
+void save_async(const World &world, const SaveSchema &schema, JobPool &pool,
+                std::function<void(const ByteWriter &file)> done) {
+  auto snapshot = std::make_shared<WorldSnapshot>(world, schema);
+  pool.submit([snapshot, &pool, done = std::move(done)]() {
+    try {
+      ByteWriter raw, file;
+      snapshot->write(raw);
+      compress_blocks(raw.data(), raw.size(), file, pool);
+      done(file);
+    } catch (FatalError) {
+      log_warn("Failed to save the world");
+    }
+  });
+}
+
+void load_save(World &world, const SaveSchema &schema, const void *file,
+               size_t num, JobPool &pool) {
+  ByteWriter raw;
+  decompress_blocks(file, num, raw, pool);
+  WorldSnapshot::load(world, schema, ByteReader(raw.data(), raw.size()));
+}
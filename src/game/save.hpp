@@ -0,0 +1,145 @@
+/**
+ * \file
+ * \brief Save and load the entities of a World.
+ */
+
+#ifndef SAVE_HPP
+#define SAVE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "ecs.hpp"
+#include "serial.hpp"
+
+/**
+ * \brief The component types that are saved, and their versions.
+ *
+ * Component IDs depend on registration order, so save files identify each
+ * component type by a fixed tag instead. Components that aren't in the schema
+ * (e.g. caches) aren't saved. When loading, components with unknown tags are
+ * skipped.
+ */
+class SaveSchema {
+public:
+  /**
+   * \brief Convert an array of components saved by an older version.
+   * \param version version number in the save file
+   * \param src saved values
+   * \param size size of each saved value in bytes
+   * \param num number of values
+   * \param[out] dst values in the current layout
+   * \throw FatalError::Decode if the version is too old
+   */
+  using Upgrade = std::function<void(uint32_t version, const uint8_t *src,
+                                     size_t size, size_t num, void *dst)>;
+
+  /// A saved component type.
+  struct Entry {
+    uint32_t tag;
+    uint32_t version;
+    unsigned id;
+    size_t size;
+    Upgrade upgrade;
+  };
+
+private:
+  uint32_t m_version;
+  std::vector<Entry> m_entries;
+
+public:
+  /**
+   * \brief Create an empty schema.
+   * \param version version of the whole save format. Files with a newer
+   *                version are rejected.
+   */
+  explicit SaveSchema(uint32_t version) : m_version(version) {}
+
+  /// Get the version of the whole format.
+  uint32_t version() const { return m_version; }
+
+  /**
+   * \brief Save a component type.
+   * \param tag stable identifier (must be unique)
+   * \param version increase when the layout of T changes
+   * \param upgrade converts older versions (optional)
+   */
+  template <typename T>
+  void add(uint32_t tag, uint32_t version = 0, Upgrade upgrade = nullptr) {
+    m_entries.push_back(
+        {tag, version, component_id<T>(), sizeof(T), std::move(upgrade)});
+  }
+
+  /// Find a component type by tag, or return null.
+  const Entry *find_tag(uint32_t tag) const;
+
+  /// Find a component type by ID, or return null.
+  const Entry *find_id(unsigned id) const;
+};
+
+/**
+ * \brief A copy of a World's entities, taken to be saved later.
+ *
+ * Taking a snapshot only copies component arrays, so it's quick enough to do
+ * between frames. Writing it out can then happen on another thread while the
+ * game keeps changing the World.
+ */
+class WorldSnapshot {
+  struct Column {
+    const SaveSchema::Entry *entry;
+    std::unique_ptr<uint8_t[]> data;
+  };
+
+  struct Table {
+    std::vector<Entity> entities;
+    std::vector<Column> columns;
+  };
+
+  uint32_t m_version;
+  std::vector<uint32_t> m_generations;
+  std::vector<uint32_t> m_free;
+  std::vector<Table> m_tables;
+
+public:
+  /// Copy the saved components of all entities.
+  WorldSnapshot(const World &world, const SaveSchema &schema);
+
+  /// Serialize the snapshot. Safe to call on any thread.
+  void write(ByteWriter &out) const;
+
+  /**
+   * \brief Load entities into an empty World.
+   *
+   * Entity handles are the same as when the snapshot was taken, and so are
+   * the handles of entities created afterwards. If loading fails, the World is
+   * left partly loaded.
+   *
+   * \throw FatalError::Decode if the data is invalid or too new
+   */
+  static void load(World &world, const SaveSchema &schema, ByteReader in);
+};
+
+/**
+ * \brief Take a snapshot and compress it into a save file in the background.
+ *
+ * The snapshot is taken before returning. The schema must stay valid until
+ * the callback has run. If compression fails, the error is logged and the
+ * callback isn't called.
+ *
+ * \param done called on a pool thread with the file contents
+ */
+void save_async(const World &world, const SaveSchema &schema, JobPool &pool,
+                std::function<void(const ByteWriter &file)> done);
+
+/**
+ * \brief Load a save file from save_async() into an empty World.
+ * \see WorldSnapshot::load()
+ * \throw FatalError::Decode if the file is invalid or too new
+ */
+void load_save(World &world, const SaveSchema &schema, const void *file,
+               size_t num, JobPool &pool);
+
+#endif
@@ -0,0 +1,323 @@
+#include "spatial.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cmath>
+
+#include "job.hpp"
+
+bool Circle::overlaps(const Aabb &box) const {
+  float dx = std::max({box.min_x - x, 0.0f, x - box.max_x});
+  float dy = std::max({box.min_y - y, 0.0f, y - box.max_y});
+  return dx * dx + dy * dy <= radius * radius;
+}
+
+namespace {
+
+Aabb bounds_of(const Aabb &box) { return box; }
+Aabb bounds_of(const Circle &circle) { return circle.bounds(); }
+
+uint64_t cell_key(int32_t x, int32_t y) {
+  return uint64_t(uint32_t(x)) << 32 | uint32_t(y);
+}
+
+int32_t cell_x(uint64_t key) { return int32_t(uint32_t(key >> 32)); }
+int32_t cell_y(uint64_t key) { return int32_t(uint32_t(key)); }
+
+/// Convert a coordinate in cells to a cell index. Indices are clamped below
+/// INT32_MAX, so loops up to and including them end. NaN goes to the lowest.
+int32_t cell_index(float x) {
+  float cell = std::floor(x);
+  if (!(-2147483648.0f < cell))
+    return INT32_MIN;
+  if (2147483520.0f <= cell) // The largest float below 2^31.
+    return INT32_MAX - 1;
+  return int32_t(cell);
+}
+
+bool finite(const Aabb &box) {
+  return std::isfinite(box.min_x) && std::isfinite(box.min_y) &&
+         std::isfinite(box.max_x) && std::isfinite(box.max_y);
+}
+
+size_t hash(uint64_t key) {
+  // Mix all bits so nearby cells spread across the table (MurmurHash3 fmix64).
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccd;
+  key ^= key >> 33;
+  key *= 0xc4ceb9fe1a85ec53;
+  key ^= key >> 33;
+  return key;
+}
+
+} // namespace
+
+SpatialHash::SpatialHash(float cell_size)
+    : m_inverse_cell_size(1 / cell_size), m_table(64) {
+  assert(0 < cell_size);
+}
+
+uint32_t SpatialHash::insert(const Aabb &box) {
+  assert(finite(box));
+  uint32_t id;
+  if (m_free.empty()) {
+    id = m_alive.size();
+    m_min_x.push_back(box.min_x);
+    m_min_y.push_back(box.min_y);
+    m_max_x.push_back(box.max_x);
+    m_max_y.push_back(box.max_y);
+    m_cells_of.push_back({});
+    m_alive.push_back(true);
+  } else {
+    id = m_free.back();
+    m_free.pop_back();
+    m_min_x[id] = box.min_x;
+    m_min_y[id] = box.min_y;
+    m_max_x[id] = box.max_x;
+    m_max_y[id] = box.max_y;
+    m_alive[id] = true;
+  }
+  m_cells_of[id] = range(box);
+  link(id, m_cells_of[id], nullptr);
+  return id;
+}
+
+void SpatialHash::update(uint32_t id, const Aabb &box) {
+  assert(id < m_alive.size() && m_alive[id] && finite(box));
+  m_min_x[id] = box.min_x;
+  m_min_y[id] = box.min_y;
+  m_max_x[id] = box.max_x;
+  m_max_y[id] = box.max_y;
+  CellRange before = m_cells_of[id];
+  CellRange after = range(box);
+  if (before == after)
+    return;
+  // Only touch the cells that the object entered or left.
+  unlink(id, before, &after);
+  link(id, after, &before);
+  m_cells_of[id] = after;
+}
+
+void SpatialHash::remove(uint32_t id) {
+  assert(id < m_alive.size() && m_alive[id]);
+  unlink(id, m_cells_of[id], nullptr);
+  m_alive[id] = false;
+  m_free.push_back(id);
+}
+
+void SpatialHash::query(const Aabb &box, std::vector<uint32_t> &out) const {
+  query_one(box, out);
+}
+
+void SpatialHash::query(const Circle &circle,
+                        std::vector<uint32_t> &out) const {
+  query_one(circle, out);
+}
+
+void SpatialHash::query(const Aabb *boxes, size_t num,
+                        std::vector<uint32_t> &offsets,
+                        std::vector<uint32_t> &ids, JobPool &pool) const {
+  query_batch(boxes, num, offsets, ids, pool);
+}
+
+void SpatialHash::query(const Circle *circles, size_t num,
+                        std::vector<uint32_t> &offsets,
+                        std::vector<uint32_t> &ids, JobPool &pool) const {
+  query_batch(circles, num, offsets, ids, pool);
+}
+
+void SpatialHash::pairs(std::vector<std::pair<uint32_t, uint32_t>> &out,
+                        JobPool &pool) const {
+  size_t num = m_cell_key.size();
+  size_t slices = std::min<size_t>(num, pool.concurrency() * 4);
+  std::vector<std::vector<std::pair<uint32_t, uint32_t>>> found(slices);
+  pool.run(slices, [&](size_t s) {
+    auto &local = found[s];
+    for (size_t c = num * s / slices; c < num * (s + 1) / slices; c++) {
+      int32_t x = cell_x(m_cell_key[c]);
+      int32_t y = cell_y(m_cell_key[c]);
+      const auto &members = m_cell_members[c];
+      for (size_t i = 0; i < members.size(); i++) {
+        uint32_t a = members[i];
+        const CellRange &ra = m_cells_of[a];
+        for (size_t j = i + 1; j < members.size(); j++) {
+          uint32_t b = members[j];
+          const CellRange &rb = m_cells_of[b];
+          // A pair that shares several cells is only reported from the first
+          // cell of the intersection.
+          if (std::max(ra.x0, rb.x0) != x || std::max(ra.y0, rb.y0) != y)
+            continue;
+          if (m_min_x[a] <= m_max_x[b] && m_min_x[b] <= m_max_x[a] &&
+              m_min_y[a] <= m_max_y[b] && m_min_y[b] <= m_max_y[a])
+            local.emplace_back(std::min(a, b), std::max(a, b));
+        }
+      }
+    }
+  });
+  out.clear();
+  for (auto &local : found)
+    out.insert(out.end(), local.begin(), local.end());
+}
+
+SpatialHash::CellRange SpatialHash::range(const Aabb &box) const {
+  return {cell_index(box.min_x * m_inverse_cell_size),
+          cell_index(box.min_y * m_inverse_cell_size),
+          cell_index(box.max_x * m_inverse_cell_size),
+          cell_index(box.max_y * m_inverse_cell_size)};
+}
+
+size_t SpatialHash::slot(uint64_t key) const {
+  size_t mask = m_table.size() - 1;
+  size_t i = hash(key) & mask;
+  while (m_table[i].cell && m_table[i].key != key)
+    i = (i + 1) & mask;
+  return i;
+}
+
+int64_t SpatialHash::find(int32_t x, int32_t y) const {
+  return int64_t(m_table[slot(cell_key(x, y))].cell) - 1;
+}
+
+uint32_t SpatialHash::find_or_create(int32_t x, int32_t y) {
+  int64_t found = find(x, y);
+  if (0 <= found)
+    return found;
+  // Keep the table at most half full so probe sequences stay short.
+  if (m_table.size() < 2 * (m_cell_key.size() + 1)) {
+    m_table.assign(m_table.size() * 2, {0, 0});
+    for (uint32_t c = 0; c < m_cell_key.size(); c++)
+      place(m_cell_key[c], c);
+  }
+  uint32_t c = m_cell_key.size();
+  m_cell_key.push_back(cell_key(x, y));
+  m_cell_members.emplace_back();
+  place(m_cell_key[c], c);
+  return c;
+}
+
+void SpatialHash::place(uint64_t key, uint32_t cell) {
+  size_t mask = m_table.size() - 1;
+  size_t i = hash(key) & mask;
+  while (m_table[i].cell)
+    i = (i + 1) & mask;
+  m_table[i] = {key, cell + 1};
+}
+
+void SpatialHash::erase(uint32_t cell) {
+  // Remove the slot, then shift later slots of the same probe run back into
+  // the gap, so lookups never stop early at an empty slot.
+  size_t mask = m_table.size() - 1;
+  size_t i = slot(m_cell_key[cell]);
+  for (size_t j = (i + 1) & mask; m_table[j].cell; j = (j + 1) & mask) {
+    size_t home = hash(m_table[j].key) & mask;
+    if (((j - home) & mask) >= ((j - i) & mask)) {
+      m_table[i] = m_table[j];
+      i = j;
+    }
+  }
+  m_table[i] = {0, 0};
+
+  // Move the last cell into the erased one.
+  uint32_t last = m_cell_key.size() - 1;
+  if (cell != last) {
+    m_cell_key[cell] = m_cell_key[last];
+    m_cell_members[cell] = std::move(m_cell_members[last]);
+    m_table[slot(m_cell_key[cell])].cell = cell + 1;
+  }
+  m_cell_key.pop_back();
+  m_cell_members.pop_back();
+}
+
+void SpatialHash::link(uint32_t id, const CellRange &r, const CellRange *skip) {
+  for (int32_t y = r.y0; y <= r.y1; y++) {
+    for (int32_t x = r.x0; x <= r.x1; x++) {
+      if (skip && skip->x0 <= x && x <= skip->x1 && skip->y0 <= y &&
+          y <= skip->y1)
+        continue;
+      m_cell_members[find_or_create(x, y)].push_back(id);
+    }
+  }
+}
+
+void SpatialHash::unlink(uint32_t id, const CellRange &r,
+                         const CellRange *skip) {
+  for (int32_t y = r.y0; y <= r.y1; y++) {
+    for (int32_t x = r.x0; x <= r.x1; x++) {
+      if (skip && skip->x0 <= x && x <= skip->x1 && skip->y0 <= y &&
+          y <= skip->y1)
+        continue;
+      uint32_t c = find(x, y);
+      auto &members = m_cell_members[c];
+      auto it = std::find(members.begin(), members.end(), id);
+      assert(it != members.end());
+      *it = members.back();
+      members.pop_back();
+      // Erase empty cells, so objects that wander don't leave a trail of
+      // cells for pairs() and large queries to scan.
+      if (members.empty())
+        erase(c);
+    }
+  }
+}
+
+template <typename Shape>
+void SpatialHash::query_one(const Shape &shape,
+                            std::vector<uint32_t> &out) const {
+  CellRange q = range(bounds_of(shape));
+  auto visit = [&](int32_t x, int32_t y, const std::vector<uint32_t> &members) {
+    for (uint32_t id : members) {
+      // An object that spans several cells is only reported from the first
+      // cell that both it and the query touch.
+      const CellRange &r = m_cells_of[id];
+      if (std::max(r.x0, q.x0) != x || std::max(r.y0, q.y0) != y)
+        continue;
+      if (shape.overlaps(
+              {m_min_x[id], m_min_y[id], m_max_x[id], m_max_y[id]}))
+        out.push_back(id);
+    }
+  };
+  uint64_t area = uint64_t(int64_t(q.x1) - q.x0 + 1) *
+                  uint64_t(int64_t(q.y1) - q.y0 + 1);
+  if (area <= m_cell_key.size()) {
+    for (int32_t y = q.y0; y <= q.y1; y++) {
+      for (int32_t x = q.x0; x <= q.x1; x++) {
+        int64_t c = find(x, y);
+        if (0 <= c)
+          visit(x, y, m_cell_members[c]);
+      }
+    }
+  } else {
+    // Huge queries are faster if they scan the occupied cells instead.
+    for (size_t c = 0; c < m_cell_key.size(); c++) {
+      int32_t x = cell_x(m_cell_key[c]);
+      int32_t y = cell_y(m_cell_key[c]);
+      if (q.x0 <= x && x <= q.x1 && q.y0 <= y && y <= q.y1)
+        visit(x, y, m_cell_members[c]);
+    }
+  }
+}
+
+template <typename Shape>
+void SpatialHash::query_batch(const Shape *shapes, size_t num,
+                              std::vector<uint32_t> &offsets,
+                              std::vector<uint32_t> &ids,
+                              JobPool &pool) const {
+  size_t slices = std::min<size_t>(num, pool.concurrency() * 4);
+  std::vector<std::vector<uint32_t>> found(slices);
+  offsets.assign(num + 1, 0);
+  pool.run(slices, [&](size_t s) {
+    for (size_t i = num * s / slices; i < num * (s + 1) / slices; i++) {
+      query_one(shapes[i], found[s]);
+      offsets[i + 1] = found[s].size();
+    }
+  });
+  // Each slice counted from zero. Shift the counts to global offsets.
+  ids.clear();
+  for (size_t s = 0; s < slices; s++) {
+    uint32_t base = ids.size();
+    for (size_t i = num * s / slices; i < num * (s + 1) / slices; i++)
+      offsets[i + 1] += base;
+    ids.insert(ids.end(), found[s].begin(), found[s].end());
+  }
+}
@@ -0,0 +1,176 @@
+/**
+ * \file
+ * \brief Find nearby objects with a uniform grid.
+ */
+
+#ifndef SPATIAL_HPP
+#define SPATIAL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+class JobPool;
+
+/// Axis-aligned bounding box. The minimum and maximum are both inclusive.
+struct Aabb {
+  float min_x, min_y, max_x, max_y;
+
+  /// Check if two boxes overlap.
+  bool overlaps(const Aabb &other) const {
+    return min_x <= other.max_x && other.min_x <= max_x &&
+           min_y <= other.max_y && other.min_y <= max_y;
+  }
+};
+
+/// A circle for radius queries.
+struct Circle {
+  float x, y, radius;
+
+  /// Get the smallest box that contains the circle.
+  Aabb bounds() const {
+    return {x - radius, y - radius, x + radius, y + radius};
+  }
+
+  /// Check if the circle overlaps a box.
+  bool overlaps(const Aabb &box) const;
+};
+
+/**
+ * \brief Spatial hash broadphase.
+ *
+ * The plane is divided into square cells. Each object is listed in every cell
+ * its box touches, and only the occupied cells are stored. Choose a cell size
+ * around the size of a typical object.
+ *
+ * Object data is stored as separate arrays indexed by object ID. Queries are
+ * const and thread-safe, as long as nothing is inserted, updated or removed at
+ * the same time.
+ */
+class SpatialHash {
+  /// Range of cells touched by an object (inclusive).
+  struct CellRange {
+    int32_t x0, y0, x1, y1;
+
+    bool operator==(const CellRange &rhs) const {
+      return x0 == rhs.x0 && y0 == rhs.y0 && x1 == rhs.x1 && y1 == rhs.y1;
+    }
+  };
+
+  float m_inverse_cell_size;
+
+  // Object data (struct of arrays, indexed by ID).
+  std::vector<float> m_min_x, m_min_y, m_max_x, m_max_y;
+  std::vector<CellRange> m_cells_of;
+  std::vector<uint8_t> m_alive;
+  std::vector<uint32_t> m_free;
+
+  // Occupied cells, in no particular order.
+  std::vector<uint64_t> m_cell_key;
+  std::vector<std::vector<uint32_t>> m_cell_members;
+
+  /// Open addressing table entry. Key and value share a cache line.
+  struct Slot {
+    uint64_t key;
+    uint32_t cell; ///< Cell index plus one (0 means empty).
+  };
+
+  std::vector<Slot> m_table;
+
+public:
+  /// Create an empty spatial hash with the given cell size.
+  explicit SpatialHash(float cell_size);
+
+  /// Get one more than the largest object ID in use.
+  uint32_t capacity() const { return m_alive.size(); }
+
+  /// Get the number of occupied cells.
+  size_t cells() const { return m_cell_key.size(); }
+
+  /// Add an object and return its ID. IDs of removed objects are reused. The
+  /// box must be finite.
+  uint32_t insert(const Aabb &box);
+
+  /**
+   * \brief Move an object.
+   *
+   * Cell lists are only modified if the object touches a different range of
+   * cells than before, so small movements are cheap. The box must be
+   * finite.
+   */
+  void update(uint32_t id, const Aabb &box);
+
+  /// Remove an object.
+  void remove(uint32_t id);
+
+  /// Get an object's bounding box.
+  Aabb bounds(uint32_t id) const {
+    return {m_min_x[id], m_min_y[id], m_max_x[id], m_max_y[id]};
+  }
+
+  /// Append the IDs of objects that overlap a box to the output.
+  void query(const Aabb &box, std::vector<uint32_t> &out) const;
+
+  /// Append the IDs of objects that overlap a circle to the output.
+  void query(const Circle &circle, std::vector<uint32_t> &out) const;
+
+  /**
+   * \brief Run many box queries in parallel.
+   *
+   * Results for query i are ids[offsets[i]] through ids[offsets[i + 1] - 1].
+   *
+   * \param boxes array of query boxes
+   * \param num number of queries
+   * \param[out] offsets num + 1 offsets into ids
+   * \param[out] ids concatenated query results
+   * \param pool worker threads
+   */
+  void query(const Aabb *boxes, size_t num, std::vector<uint32_t> &offsets,
+             std::vector<uint32_t> &ids, JobPool &pool) const;
+
+  /// Run many radius queries in parallel. See the overload for boxes.
+  void query(const Circle *circles, size_t num,
+             std::vector<uint32_t> &offsets, std::vector<uint32_t> &ids,
+             JobPool &pool) const;
+
+  /**
+   * \brief Find every pair of overlapping objects.
+   *
+   * Each pair is reported once, with the smaller ID first. The order of pairs
+   * is unspecified.
+   */
+  void pairs(std::vector<std::pair<uint32_t, uint32_t>> &out,
+             JobPool &pool) const;
+
+private:
+  CellRange range(const Aabb &box) const;
+
+  /// Get the slot holding a key, or the empty slot that ends its probe run.
+  size_t slot(uint64_t key) const;
+
+  /// Look up a cell. Return its index, or -1 if it's not occupied.
+  int64_t find(int32_t x, int32_t y) const;
+
+  /// Look up a cell and create it if necessary.
+  uint32_t find_or_create(int32_t x, int32_t y);
+
+  /// Insert a cell into the table. There must be a free slot.
+  void place(uint64_t key, uint32_t cell);
+
+  /// Remove an empty cell. The last cell takes its index.
+  void erase(uint32_t cell);
+
+  void link(uint32_t id, const CellRange &r, const CellRange *skip);
+  void unlink(uint32_t id, const CellRange &r, const CellRange *skip);
+
+  template <typename Shape>
+  void query_one(const Shape &shape, std::vector<uint32_t> &out) const;
+
+  template <typename Shape>
+  void query_batch(const Shape *shapes, size_t num,
+                   std::vector<uint32_t> &offsets, std::vector<uint32_t> &ids,
+                   JobPool &pool) const;
+};
+
+#endif
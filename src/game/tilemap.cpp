@@ -0,0 +1,151 @@
+#include "tilemap.hpp"
+
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#include "util.hpp"
+
+namespace {
+
+constexpr unsigned chunk_area = Tilemap::chunk_tiles * Tilemap::chunk_tiles;
+
+uint64_t chunk_key(int32_t cx, int32_t cy) {
+  return uint64_t(uint32_t(cx)) << 32 | uint32_t(cy);
+}
+
+int32_t chunk_x(uint64_t key) { return int32_t(uint32_t(key >> 32)); }
+int32_t chunk_y(uint64_t key) { return int32_t(uint32_t(key)); }
+
+/// Divide rounding toward negative infinity.
+int32_t floor_div(int32_t a, int32_t b) {
+  return a / b - (a % b != 0 && (a < 0) != (b < 0));
+}
+
+/// Find a tile in its chunk's array.
+size_t tile_index(int32_t x, int32_t y, unsigned layer) {
+  const int32_t n = Tilemap::chunk_tiles;
+  return layer * chunk_area + (y - floor_div(y, n) * n) * n +
+         (x - floor_div(x, n) * n);
+}
+
+} // namespace
+
+Tilemap::Tilemap(ConstImageView tileset, unsigned tile_size, unsigned layers,
+                 SpriteRenderer &renderer)
+    : m_tileset(tileset), m_tile_size(tile_size), m_layers(layers),
+      m_renderer(renderer) {
+  assert(tileset.kind() == ImageType::RGBA);
+  assert(tile_size <= tileset.width() && 0 < layers);
+}
+
+TileId Tilemap::get(int32_t x, int32_t y, unsigned layer) {
+  assert(layer < m_layers);
+  Chunk &c = load(floor_div(x, chunk_tiles), floor_div(y, chunk_tiles));
+  if (!c.tiles)
+    return 0;
+  return c.tiles[tile_index(x, y, layer)];
+}
+
+void Tilemap::set(int32_t x, int32_t y, unsigned layer, TileId tile) {
+  assert(layer < m_layers);
+  Chunk &c = load(floor_div(x, chunk_tiles), floor_div(y, chunk_tiles));
+  if (!c.tiles) {
+    if (!tile)
+      return;
+    c.tiles = std::make_unique<TileId[]>(m_layers * chunk_area);
+  }
+  TileId &dst = c.tiles[tile_index(x, y, layer)];
+  if (dst != tile) {
+    dst = tile;
+    c.dirty = true;
+    c.modified = true;
+  }
+}
+
+void Tilemap::visible(const Aabb &camera, std::vector<Visible> &out) {
+  out.clear();
+  float span = float(chunk_tiles * m_tile_size);
+  auto x0 = int32_t(std::floor(camera.min_x / span));
+  auto y0 = int32_t(std::floor(camera.min_y / span));
+  auto x1 = int32_t(std::floor(camera.max_x / span));
+  auto y1 = int32_t(std::floor(camera.max_y / span));
+  for (int32_t cy = y0; cy <= y1; cy++) {
+    for (int32_t cx = x0; cx <= x1; cx++) {
+      Chunk &c = load(cx, cy);
+      if (!c.tiles)
+        continue;
+      if (c.dirty)
+        composite(c);
+      out.push_back({cx * span, cy * span, c.image});
+    }
+  }
+}
+
+void Tilemap::stream(const Aabb &camera, float margin) {
+  float span = float(chunk_tiles * m_tile_size);
+  Aabb keep = {camera.min_x - margin, camera.min_y - margin,
+               camera.max_x + margin, camera.max_y + margin};
+  for (auto it = m_chunks.begin(); it != m_chunks.end();) {
+    float x = chunk_x(it->first) * span, y = chunk_y(it->first) * span;
+    if (keep.overlaps({x, y, x + span, y + span})) {
+      ++it;
+    } else {
+      evict(it->first, it->second);
+      it = m_chunks.erase(it);
+    }
+  }
+}
+
+void Tilemap::flush() {
+  for (auto &[key, c] : m_chunks)
+    evict(key, c);
+  m_chunks.clear();
+}
+
+Tilemap::Chunk &Tilemap::load(int32_t cx, int32_t cy) {
+  auto [it, inserted] = m_chunks.try_emplace(chunk_key(cx, cy));
+  Chunk &c = it->second;
+  if (inserted && m_loader) {
+    c.tiles = std::make_unique<TileId[]>(m_layers * chunk_area);
+    if (!m_loader(cx, cy, c.tiles.get()))
+      c.tiles.reset();
+  }
+  return c;
+}
+
+void Tilemap::composite(Chunk &c) {
+  unsigned size = chunk_tiles * m_tile_size;
+  if (!c.image.width())
+    c.image = Image(ImageType::RGBA, size, size);
+  for (unsigned y = 0; y < size; y++)
+    memset(c.image.pixel(0, y), 0, size * 4);
+  // Each non-empty tile becomes a sprite. Layers are drawn in order.
+  unsigned columns = m_tileset.width() / m_tile_size;
+  unsigned count = columns * (m_tileset.height() / m_tile_size);
+  m_sprites.clear();
+  for (unsigned i = 0; i < m_layers * chunk_area; i++) {
+    TileId t = c.tiles[i];
+    if (!t)
+      continue;
+    if (count < t) {
+      log_warn("Tile %u isn't in the tileset", unsigned(t));
+      continue;
+    }
+    unsigned j = i % chunk_area;
+    float x = float(j % chunk_tiles * m_tile_size);
+    float y = float(j / chunk_tiles * m_tile_size);
+    unsigned sx = (t - 1) % columns * m_tile_size;
+    unsigned sy = (t - 1) / columns * m_tile_size;
+    float ts = float(m_tile_size);
+    m_sprites.push_back({0, sx, sy, m_tile_size, m_tile_size, x, y, ts, ts,
+                         {255, 255, 255, 255}});
+  }
+  m_renderer.draw(c.image, &m_tileset, m_sprites.data(), m_sprites.size());
+  c.dirty = false;
+}
+
+void Tilemap::evict(uint64_t key, Chunk &c) {
+  if (c.modified && m_saver)
+    m_saver(chunk_x(key), chunk_y(key), c.tiles.get());
+}
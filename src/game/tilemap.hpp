@@ -0,0 +1,128 @@
+/**
+ * \file
+ * \brief Large tile maps drawn as cached chunk images.
+ */
+
+#ifndef TILEMAP_HPP
+#define TILEMAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "image.hpp"
+#include "spatial.hpp"
+#include "sprite.hpp"
+
+/// Index of a tile in the tileset. Tile 0 is empty.
+using TileId = uint16_t;
+
+/**
+ * \brief A layered tile map divided into square chunks.
+ *
+ * All layers of a chunk are composited into one image, which is redrawn only
+ * after one of the chunk's tiles changes. A frame then draws a few chunk
+ * images instead of every tile. Content that changes every frame should be
+ * drawn separately.
+ *
+ * Chunks are loaded on demand and can be evicted when they're far from the
+ * camera, so the map can be larger than memory.
+ */
+class Tilemap {
+public:
+  /// Width and height of a chunk in tiles.
+  static constexpr unsigned chunk_tiles = 32;
+
+  /**
+   * \brief Read a chunk's tiles.
+   *
+   * Tiles are stored layer by layer, row by row. The array is zero-filled
+   * beforehand. Return false if the chunk is entirely empty.
+   */
+  using Loader = std::function<bool(int32_t cx, int32_t cy, TileId *tiles)>;
+
+  /// Write back a modified chunk before it's evicted.
+  using Saver =
+      std::function<void(int32_t cx, int32_t cy, const TileId *tiles)>;
+
+  /// A chunk image to draw.
+  struct Visible {
+    float x, y;           ///< World position of the top left corner.
+    ConstImageView image; ///< Composited layers.
+  };
+
+private:
+  struct Chunk {
+    std::unique_ptr<TileId[]> tiles; ///< Null if the chunk is empty.
+    Image image;
+    bool dirty = true;     ///< The image is out of date.
+    bool modified = false; ///< Tiles changed since the chunk was loaded.
+  };
+
+  ConstImageView m_tileset;
+  unsigned m_tile_size;
+  unsigned m_layers;
+  SpriteRenderer &m_renderer;
+  Loader m_loader;
+  Saver m_saver;
+  std::unordered_map<uint64_t, Chunk> m_chunks;
+  std::vector<Sprite> m_sprites;
+
+public:
+  /**
+   * \brief Create an empty map.
+   * \param tileset RGBA image with tiles in rows (tile 1 is the top left)
+   * \param tile_size width and height of each tile in pixels
+   * \param layers number of tile layers, drawn from first to last
+   * \param renderer draws the chunk images
+   */
+  Tilemap(ConstImageView tileset, unsigned tile_size, unsigned layers,
+          SpriteRenderer &renderer);
+
+  /// Set the function that reads chunks. By default chunks start empty.
+  void set_loader(Loader fn) { m_loader = std::move(fn); }
+
+  /// Set the function that writes back modified chunks.
+  void set_saver(Saver fn) { m_saver = std::move(fn); }
+
+  /// Get a tile. Loads its chunk if necessary.
+  TileId get(int32_t x, int32_t y, unsigned layer);
+
+  /// Set a tile. Loads its chunk if necessary. Tiles that aren't in the
+  /// tileset are drawn as empty, with a warning.
+  void set(int32_t x, int32_t y, unsigned layer, TileId tile);
+
+  /**
+   * \brief Get the chunks that overlap the camera.
+   *
+   * Chunks are loaded and composited as needed. Empty chunks are skipped.
+   * Images are valid until the next call to a non-const function.
+   *
+   * \param camera visible area in world pixels
+   * \param[out] out list of chunk images (cleared first)
+   */
+  void visible(const Aabb &camera, std::vector<Visible> &out);
+
+  /**
+   * \brief Evict chunks that are far from the camera.
+   * \param camera visible area in world pixels
+   * \param margin chunks are kept if they're at most this far from the camera
+   */
+  void stream(const Aabb &camera, float margin);
+
+  /// Get the number of chunks in memory.
+  size_t resident() const { return m_chunks.size(); }
+
+  /// Evict all chunks, saving the modified ones.
+  void flush();
+
+private:
+  Chunk &load(int32_t cx, int32_t cy);
+  void composite(Chunk &c);
+  void evict(uint64_t key, Chunk &c);
+};
+
+#endif
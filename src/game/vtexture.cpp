@@ -0,0 +1,215 @@
+#include "vtexture.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#include "util.hpp"
+
+namespace {
+
+uint64_t tile_key(unsigned level, unsigned tx, unsigned ty) {
+  return uint64_t(level) << 56 | uint64_t(tx) << 28 | ty;
+}
+
+std::string tile_name(const std::string &prefix, unsigned level, unsigned tx,
+                      unsigned ty) {
+  return prefix + "/" + std::to_string(level) + "/" + std::to_string(tx) +
+         "_" + std::to_string(ty) + ".png";
+}
+
+/// Get the width or height of a level, which is size / 2^level rounded up.
+unsigned level_size(unsigned size, unsigned level) {
+  return ((size - 1) >> level) + 1;
+}
+
+} // namespace
+
+VirtualTexture::VirtualTexture(AssetSystem &assets, JobPool &pool,
+                               std::string prefix, unsigned width,
+                               unsigned height, const Params &params)
+    : m_prefix(std::move(prefix)), m_params(params), m_width(width),
+      m_height(height), m_levels(1), m_pages(params.pages),
+      m_loader(assets, pool) {
+  assert(width && height && 2 <= params.pages);
+  unsigned t = params.tile_size;
+  while (t < level_size(width, m_levels - 1) ||
+         t < level_size(height, m_levels - 1))
+    m_levels++;
+  for (Page &page : m_pages)
+    page.image = Image(ImageType::RGBA, t, t);
+}
+
+void VirtualTexture::write_pyramid(ConstImageView image,
+                                   const std::string &prefix,
+                                   unsigned tile_size, const Writer &write) {
+  assert(image.kind() == ImageType::RGBA);
+  Image level;
+  ConstImageView src = image;
+  for (unsigned l = 0;; l++) {
+    unsigned w = src.width(), h = src.height();
+    for (unsigned y = 0; y < h; y += tile_size)
+      for (unsigned x = 0; x < w; x += tile_size)
+        write(tile_name(prefix, l, x / tile_size, y / tile_size),
+              src.subview(x, y, std::min(tile_size, w - x),
+                          std::min(tile_size, h - y)));
+    if (w <= tile_size && h <= tile_size)
+      break;
+    // Average 2×2 blocks. Odd sizes repeat the last row or column.
+    Image next(ImageType::RGBA, (w + 1) / 2, (h + 1) / 2);
+    for (unsigned y = 0; y < next.height(); y++) {
+      const uint8_t *r0 = src.pixel(0, 2 * y);
+      const uint8_t *r1 = src.pixel(0, std::min(2 * y + 1, h - 1));
+      uint8_t *out = next.pixel(0, y);
+      for (unsigned x = 0; x < next.width(); x++, out += 4) {
+        unsigned a = 8 * x, b = 4 * std::min(2 * x + 1, w - 1);
+        for (int c = 0; c < 4; c++)
+          out[c] = (r0[a + c] + r0[b + c] + r1[a + c] + r1[b + c] + 2) / 4;
+      }
+    }
+    level = std::move(next);
+    src = level;
+  }
+}
+
+void VirtualTexture::update(const Aabb &view, float scale) {
+  // Install finished loads.
+  for (auto &l : m_loader.take()) {
+    if (l.value && !install(l.key, *l.value) && m_wanted.count(l.key)) {
+      // Every page was drawn last frame. Keep the tile for the next frame
+      // rather than loading it again.
+      m_loader.defer(std::move(l));
+      continue;
+    }
+    m_loader.done(l.key);
+    if (!l.value)
+      m_missing.insert(l.key);
+  }
+  m_frame++;
+
+  // Use the finest level that has at least one pixel per screen pixel. The
+  // last level is a fallback for everything, so it's always wanted.
+  float fit = scale > 0 ? std::floor(-std::log2(scale)) : m_levels;
+  unsigned level = std::clamp<float>(fit, 0, m_levels - 1);
+  uint64_t root = tile_key(m_levels - 1, 0, 0);
+  m_wanted.clear();
+  m_wanted.insert(root);
+  if (!m_table.count(root) && !m_loader.pending(root) &&
+      !m_missing.count(root))
+    request(root, 0);
+  else if (m_table.count(root))
+    m_pages[m_table[root]].used = m_frame;
+
+  // Each visible tile keeps one page in use, and so does the last level. Use
+  // a coarser level if the visible tiles wouldn't leave a page to load into.
+  float x0, x1, y0, y1;
+  for (;; level++) {
+    float span = float(m_params.tile_size) * (1u << level);
+    unsigned tiles_x = (level_size(m_width, level) - 1) / m_params.tile_size;
+    unsigned tiles_y = (level_size(m_height, level) - 1) / m_params.tile_size;
+    x0 = std::max(0.0f, std::floor(view.min_x / span));
+    y0 = std::max(0.0f, std::floor(view.min_y / span));
+    x1 = std::min<float>(tiles_x, std::floor(view.max_x / span));
+    y1 = std::min<float>(tiles_y, std::floor(view.max_y / span));
+    float visible = std::max(0.0f, x1 - x0 + 1) * std::max(0.0f, y1 - y0 + 1);
+    if (visible + 2 <= m_pages.size() || level == m_levels - 1)
+      break;
+  }
+  m_pieces.clear();
+  for (unsigned ty = y0; y0 <= y1 && ty <= y1; ty++) {
+    for (unsigned tx = x0; x0 <= x1 && tx <= x1; tx++) {
+      uint64_t key = tile_key(level, tx, ty);
+      m_wanted.insert(key);
+      if (!m_table.count(key) && !m_loader.pending(key) &&
+          !m_missing.count(key) && pending() < m_params.max_pending)
+        request(key, 1);
+      unsigned found;
+      int32_t page = find(level, tx, ty, found);
+      if (page < 0)
+        continue;
+      m_pages[page].used = m_frame;
+      m_pieces.emplace_back();
+      lookup(level, tx, ty, m_pieces.back());
+    }
+  }
+
+  m_loader.withdraw(m_wanted);
+}
+
+bool VirtualTexture::lookup(unsigned level, unsigned tx, unsigned ty,
+                            Piece &piece) const {
+  unsigned found;
+  int32_t index = find(level, tx, ty, found);
+  if (index < 0)
+    return false;
+  const Page &page = m_pages[index];
+  float span = float(m_params.tile_size) * (1u << level);
+  piece.dst = {tx * span, ty * span, std::min<float>((tx + 1) * span, m_width),
+               std::min<float>((ty + 1) * span, m_height)};
+  // Map the area into the coarser tile's pixels.
+  float s = 1.0f / (1u << found);
+  float ox = float(tx >> (found - level)) * m_params.tile_size;
+  float oy = float(ty >> (found - level)) * m_params.tile_size;
+  piece.page = &page.image;
+  piece.src = {piece.dst.min_x * s - ox, piece.dst.min_y * s - oy,
+               std::min<float>(piece.dst.max_x * s - ox, page.w),
+               std::min<float>(piece.dst.max_y * s - oy, page.h)};
+  piece.level = found;
+  return true;
+}
+
+bool VirtualTexture::resident(unsigned level, unsigned tx, unsigned ty) const {
+  return m_table.count(tile_key(level, tx, ty));
+}
+
+int32_t VirtualTexture::find(unsigned level, unsigned tx, unsigned ty,
+                             unsigned &found) const {
+  for (unsigned l = level; l < m_levels; l++) {
+    unsigned d = l - level;
+    auto it = m_table.find(tile_key(l, tx >> d, ty >> d));
+    if (it != m_table.end()) {
+      found = l;
+      return it->second;
+    }
+  }
+  return -1;
+}
+
+void VirtualTexture::request(uint64_t key, unsigned priority) {
+  unsigned level = key >> 56, tx = key >> 28 & 0xfffffff, ty = key & 0xfffffff;
+  unsigned t = m_params.tile_size;
+  m_loader.request(
+      key, tile_name(m_prefix, level, tx, ty), priority,
+      [t](const uint8_t *data, size_t num) {
+        MemoryBuffer is(data, num);
+        auto image = std::make_unique<Image>(Image::read_png(is));
+        if (image->kind() != ImageType::RGBA || t < image->width() ||
+            t < image->height()) {
+          log_crit("Tile isn't RGBA or is larger than %u", t);
+          throw FatalError::Decode;
+        }
+        return image;
+      });
+}
+
+bool VirtualTexture::install(uint64_t key, ConstImageView image) {
+  // Replace the least recently used page, unless everything was drawn last
+  // frame. Then the tile would only push out another visible one.
+  auto lru = std::min_element(
+      m_pages.begin(), m_pages.end(),
+      [](const Page &a, const Page &b) { return a.used < b.used; });
+  if (m_frame && lru->used == m_frame)
+    return false;
+  if (lru->w)
+    m_table.erase(lru->key);
+  lru->key = key;
+  lru->w = image.width();
+  lru->h = image.height();
+  lru->used = m_frame;
+  for (unsigned y = 0; y < image.height(); y++)
+    memcpy(lru->image.pixel(0, y), image.pixel(0, y),
+           size_t(image.width()) * 4);
+  m_table[key] = lru - m_pages.begin();
+  return true;
+}
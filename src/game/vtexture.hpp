@@ -0,0 +1,139 @@
+/**
+ * \file
+ * \brief Stream tiles of images too large to keep in memory.
+ */
+
+#ifndef VTEXTURE_HPP
+#define VTEXTURE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "image.hpp"
+#include "loader.hpp"
+#include "spatial.hpp"
+
+/**
+ * \brief A huge image that is paged in one tile at a time.
+ *
+ * The image is stored as a pyramid of levels. Level 0 is the full image and
+ * each level after it is half the size of the one before, down to a level
+ * that fits in one tile. Each level is cut into square tiles, and each tile
+ * is a PNG file named `prefix/level/x_y.png` (see write_pyramid()). Tiles on
+ * the right and bottom edges are cropped to the image.
+ *
+ * Tiles are kept in a fixed number of pages, so memory use doesn't depend on
+ * the size of the image. update() picks the level that matches the view
+ * scale and requests the visible tiles that aren't resident, replacing the
+ * least recently used pages as they arrive. Tiles that haven't arrived yet
+ * are drawn from the nearest coarser level that is resident. The last level
+ * is always kept as a fallback for the whole image.
+ */
+class VirtualTexture {
+public:
+  /// Tuning parameters.
+  struct Params {
+    unsigned tile_size = 256; ///< Width and height of tiles in pixels.
+    /// Number of tiles kept in memory, at least 2. If the view needs more
+    /// tiles than fit, it's drawn from a coarser level.
+    unsigned pages = 64;
+    /// Tile loads in flight. Each holds a decoded tile until update().
+    unsigned max_pending = 16;
+  };
+
+  /// Part of the view and where to draw it from.
+  struct Piece {
+    Aabb dst;          ///< Area in level 0 pixels.
+    const Image *page; ///< RGBA tile.
+    Aabb src;          ///< Area of the page in pixels.
+    unsigned level;    ///< Level of the page (more than wanted if coarser).
+  };
+
+  /// Write one tile, see write_pyramid().
+  using Writer =
+      std::function<void(const std::string &name, ConstImageView tile)>;
+
+private:
+  struct Page {
+    Image image;
+    unsigned w = 0, h = 0; ///< Size of the tile in the page.
+    uint64_t key;          ///< Tile in the page, if any.
+    uint64_t used = 0;     ///< Last update() that drew from it.
+  };
+
+  std::string m_prefix;
+  Params m_params;
+  unsigned m_width, m_height, m_levels;
+  std::vector<Page> m_pages;
+  std::unordered_map<uint64_t, uint32_t> m_table; ///< Tile to page.
+  std::unordered_set<uint64_t> m_missing; ///< Tiles that failed to load.
+  std::unordered_set<uint64_t> m_wanted;
+  uint64_t m_frame = 0; ///< Number of calls to update().
+  std::vector<Piece> m_pieces;
+  AsyncLoader<Image> m_loader; ///< Tiles being loaded, by key.
+
+public:
+  /**
+   * \brief Start with no tiles loaded.
+   * \param assets source of tile files
+   * \param pool decodes tiles
+   * \param prefix folder of the pyramid in the assets
+   * \param width, height size of level 0 in pixels
+   * \param params tuning parameters
+   */
+  VirtualTexture(AssetSystem &assets, JobPool &pool, std::string prefix,
+                 unsigned width, unsigned height, const Params &params);
+
+  VirtualTexture(const VirtualTexture &other) = delete;
+  VirtualTexture &operator=(const VirtualTexture &other) = delete;
+
+  /**
+   * \brief Cut an image into a tile pyramid.
+   * \param image RGBA level 0
+   * \param prefix folder for the tiles
+   * \param tile_size width and height of tiles in pixels
+   * \param write called once for each tile
+   */
+  static void write_pyramid(ConstImageView image, const std::string &prefix,
+                            unsigned tile_size, const Writer &write);
+
+  /// Get the number of levels.
+  unsigned levels() const { return m_levels; }
+
+  /**
+   * \brief Install loaded tiles and request the ones needed for a view.
+   * \param view visible area in level 0 pixels
+   * \param scale screen pixels per level 0 pixel
+   */
+  void update(const Aabb &view, float scale);
+
+  /// Get what to draw for the view given to update(), in any order.
+  const std::vector<Piece> &pieces() const { return m_pieces; }
+
+  /**
+   * \brief Find the best resident tile for a tile of some level.
+   * \param[out] piece the tile's area, drawn from a resident page
+   * \return false if no level has the tile's area resident
+   */
+  bool lookup(unsigned level, unsigned tx, unsigned ty, Piece &piece) const;
+
+  /// Check if a tile is resident.
+  bool resident(unsigned level, unsigned tx, unsigned ty) const;
+
+  /// Get the number of tiles being loaded.
+  size_t pending() const { return m_loader.pending(); }
+
+private:
+  int32_t find(unsigned level, unsigned tx, unsigned ty,
+               unsigned &found) const;
+  void request(uint64_t key, unsigned priority);
+  /// Copy a tile into a page, or return false if every page is in use.
+  bool install(uint64_t key, ConstImageView image);
+};
+
+#endif
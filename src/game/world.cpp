@@ -0,0 +1,133 @@
+#include "world.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "job.hpp"
+
+namespace {
+
+uint64_t region_key(int32_t rx, int32_t ry) {
+  return uint64_t(uint32_t(rx)) << 32 | uint32_t(ry);
+}
+
+int32_t region_x(uint64_t key) { return int32_t(uint32_t(key >> 32)); }
+int32_t region_y(uint64_t key) { return int32_t(uint32_t(key)); }
+
+/**
+ * \brief Find when a moving point first enters a box.
+ * \param x, y start of the motion
+ * \param dx, dy change over the whole motion
+ * \return fraction of the motion in [0, 1], or a negative value if the point
+ *         never enters the box
+ */
+float entry_time(const Aabb &box, float x, float y, float dx, float dy) {
+  float t0 = 0, t1 = 1;
+  const float p[2] = {x, y}, d[2] = {dx, dy};
+  const float lo[2] = {box.min_x, box.min_y}, hi[2] = {box.max_x, box.max_y};
+  for (int i = 0; i < 2; i++) {
+    if (d[i] == 0) {
+      if (p[i] < lo[i] || hi[i] < p[i])
+        return -1;
+      continue;
+    }
+    float a = (lo[i] - p[i]) / d[i], b = (hi[i] - p[i]) / d[i];
+    t0 = std::max(t0, std::min(a, b));
+    t1 = std::min(t1, std::max(a, b));
+  }
+  return t0 <= t1 ? t0 : -1;
+}
+
+} // namespace
+
+WorldStreamer::WorldStreamer(AssetSystem &assets, JobPool &pool, Name name,
+                             Decoder decoder, const Params &params)
+    : m_pool(pool), m_name(std::move(name)), m_decoder(std::move(decoder)),
+      m_params(params), m_loader(assets, pool) {}
+
+void WorldStreamer::update(const Aabb &camera, float vx, float vy) {
+  // Install finished loads.
+  for (auto &[key, region] : m_loader.take()) {
+    m_loader.done(key);
+    m_bytes += region ? region->bytes : 0;
+    m_resident[key] = std::move(region);
+  }
+
+  // Find the regions that the view (plus margin) sweeps over as the camera
+  // moves during the lookahead time.
+  float size = m_params.region_size;
+  float x0 = (camera.min_x + camera.max_x) / 2;
+  float y0 = (camera.min_y + camera.max_y) / 2;
+  float dx = vx * m_params.lookahead, dy = vy * m_params.lookahead;
+  float half_w = (camera.max_x - camera.min_x) / 2 + m_params.margin;
+  float half_h = (camera.max_y - camera.min_y) / 2 + m_params.margin;
+  auto rx0 = int32_t(std::floor((std::min(x0, x0 + dx) - half_w) / size));
+  auto ry0 = int32_t(std::floor((std::min(y0, y0 + dy) - half_h) / size));
+  auto rx1 = int32_t(std::floor((std::max(x0, x0 + dx) + half_w) / size));
+  auto ry1 = int32_t(std::floor((std::max(y0, y0 + dy) + half_h) / size));
+  m_wanted.clear();
+  for (int32_t ry = ry0; ry <= ry1; ry++) {
+    for (int32_t rx = rx0; rx <= rx1; rx++) {
+      // The view overlaps the region when its center is in this box.
+      Aabb box = {rx * size - half_w, ry * size - half_h,
+                  (rx + 1) * size + half_w, (ry + 1) * size + half_h};
+      float t = entry_time(box, x0, y0, dx, dy);
+      if (t < 0)
+        continue;
+      uint64_t key = region_key(rx, ry);
+      m_wanted.insert(key);
+      // The priority is the number of milliseconds until the region comes
+      // into view, so regions ahead of the camera load in the order it
+      // reaches them.
+      if (!m_resident.count(key) && !m_loader.pending(key))
+        request(rx, ry, key, unsigned(t * m_params.lookahead * 1000));
+    }
+  }
+
+  m_loader.withdraw(m_wanted);
+
+  // Evict unneeded regions, farthest first, until under budget. Regions with
+  // no file are cheap to look up again, so they always go.
+  std::vector<std::pair<float, uint64_t>> candidates;
+  for (auto &[key, r] : m_resident) {
+    if (m_wanted.count(key))
+      continue;
+    float cx = (region_x(key) + 0.5f) * size - x0;
+    float cy = (region_y(key) + 0.5f) * size - y0;
+    candidates.emplace_back(r ? std::hypot(cx, cy) : INFINITY, key);
+  }
+  std::sort(candidates.begin(), candidates.end(), std::greater<>());
+  for (auto [distance, key] : candidates) {
+    if (m_bytes <= m_params.budget && distance != INFINITY)
+      break;
+    evict(key);
+  }
+}
+
+const WorldStreamer::Region *WorldStreamer::get(int32_t rx, int32_t ry) const {
+  auto it = m_resident.find(region_key(rx, ry));
+  return it != m_resident.end() ? it->second.get() : nullptr;
+}
+
+bool WorldStreamer::loaded(int32_t rx, int32_t ry) const {
+  return m_resident.count(region_key(rx, ry));
+}
+
+void WorldStreamer::request(int32_t rx, int32_t ry, uint64_t key,
+                            unsigned priority) {
+  m_loader.request(key, m_name(rx, ry), priority,
+                   [this, rx, ry](const uint8_t *data, size_t num) {
+                     return m_decoder(rx, ry, data, num);
+                   });
+}
+
+void WorldStreamer::evict(uint64_t key) {
+  auto it = m_resident.find(key);
+  if (it->second) {
+    m_bytes -= it->second->bytes;
+    // Large regions can take a while to free, so do it in the background.
+    std::shared_ptr<Region> garbage(std::move(it->second));
+    m_pool.submit([garbage = std::move(garbage)]() {});
+  }
+  m_resident.erase(it);
+}
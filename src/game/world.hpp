@@ -0,0 +1,115 @@
+/**
+ * \file
+ * \brief Load the parts of a large world that the camera is about to see.
+ */
+
+#ifndef WORLD_HPP
+#define WORLD_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "loader.hpp"
+#include "spatial.hpp"
+
+/**
+ * \brief Stream square regions of the world in and out around the camera.
+ *
+ * Each frame, update() works out which regions the camera needs: those near
+ * its view, and those along the path its velocity will take it over the next
+ * moments. Missing regions are requested from the AssetSystem, closest to the
+ * path first, and decoded on the job pool. Finished regions are picked up by
+ * a later update(), so loading never waits on the disk or the decoder.
+ *
+ * When resident regions use more memory than the budget, the ones farthest
+ * from the camera that aren't needed are evicted. They're freed on the job
+ * pool so that a large region doesn't stall the frame.
+ */
+class WorldStreamer {
+public:
+  /// Decoded contents of a region. Derive from this to add data.
+  struct Region {
+    virtual ~Region() = default;
+    size_t bytes = 0; ///< Memory used, counted against the budget.
+  };
+
+  /// Get the asset file name of a region.
+  using Name = std::function<std::string(int32_t rx, int32_t ry)>;
+
+  /**
+   * \brief Decode a region file. Runs on the job pool.
+   * \param data file contents (null-terminated)
+   * \param num file size
+   * \throw FatalError::Decode if the file is invalid
+   */
+  using Decoder = std::function<std::unique_ptr<Region>(
+      int32_t rx, int32_t ry, const uint8_t *data, size_t num)>;
+
+  /// Tuning parameters.
+  struct Params {
+    float region_size = 1024; ///< Width and height of a region in world units.
+    float margin = 512;       ///< Load regions this close to the view.
+    float lookahead = 1;      ///< Load along this many seconds of motion.
+    /// Memory for loaded regions in bytes.
+    size_t budget = size_t(256) << 20;
+  };
+
+private:
+  JobPool &m_pool;
+  Name m_name;
+  Decoder m_decoder;
+  Params m_params;
+  /// Loaded regions. Null if the region has no file.
+  std::unordered_map<uint64_t, std::unique_ptr<Region>> m_resident;
+  std::unordered_set<uint64_t> m_wanted;
+  size_t m_bytes = 0;
+  AsyncLoader<Region> m_loader; ///< Regions being loaded, by key.
+
+public:
+  /**
+   * \brief Create a streamer with no regions loaded.
+   * \param assets source of region files
+   * \param pool runs the decoder
+   * \param name maps region coordinates to file names
+   * \param decoder turns files into regions
+   * \param params tuning parameters
+   */
+  WorldStreamer(AssetSystem &assets, JobPool &pool, Name name,
+                Decoder decoder, const Params &params);
+
+  WorldStreamer(const WorldStreamer &other) = delete;
+  WorldStreamer &operator=(const WorldStreamer &other) = delete;
+
+  /**
+   * \brief Install finished loads, request new ones and evict old ones.
+   * \param camera current view in world units
+   * \param vx, vy camera velocity in world units per second
+   */
+  void update(const Aabb &camera, float vx, float vy);
+
+  /// Get a loaded region, or null if it's not loaded or has no file.
+  const Region *get(int32_t rx, int32_t ry) const;
+
+  /// Check if a region is loaded (possibly as empty).
+  bool loaded(int32_t rx, int32_t ry) const;
+
+  /// Get the number of loaded regions.
+  size_t resident() const { return m_resident.size(); }
+
+  /// Get the memory used by loaded regions in bytes.
+  size_t resident_bytes() const { return m_bytes; }
+
+  /// Get the number of regions being loaded.
+  size_t pending() const { return m_loader.pending(); }
+
+private:
+  void request(int32_t rx, int32_t ry, uint64_t key, unsigned priority);
+  void evict(uint64_t key);
+};
+
+#endif
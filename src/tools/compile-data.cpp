@@ -0,0 +1,66 @@
+/**
+ * \file
+ * \brief Compile a JSON data file for DataTable.
+ *
+ * Usage: `compile-data SCHEMA INPUT OUTPUT`, where SCHEMA describes the
+ * tables as in DataSchema, and INPUT is a value of its root table. Build
+ * rules call it through the compile_data() CMake function.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+
+#include "asset.hpp"
+#include "data.hpp"
+#include "json.hpp"
+#include "util.hpp"
+
+namespace {
+
+/**
+ * \brief Read and parse a JSON file.
+ * \param[out] text file contents, which the document refers to
+ * \throw FatalError::Decode if the file can't be read or parsed
+ */
+void read_json(const char *path, std::unique_ptr<uint8_t[]> &text,
+               JsonDocument &doc) {
+  std::ifstream is(path, std::ios::binary);
+  if (!is.good()) {
+    log_crit("Can't open %s", path);
+    throw FatalError::Decode;
+  }
+  size_t num;
+  text = read_stream(num, is);
+  doc.parse(reinterpret_cast<const char *>(text.get()), num);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc != 4) {
+    log_crit("Usage: compile-data SCHEMA INPUT OUTPUT");
+    return 2;
+  }
+  try {
+    std::unique_ptr<uint8_t[]> text;
+    JsonDocument doc;
+    read_json(argv[1], text, doc);
+    DataSchema schema = DataSchema::parse(doc.root());
+    read_json(argv[2], text, doc);
+    ByteWriter file = schema.compile(doc.root());
+    std::ofstream os(argv[3], std::ios::binary);
+    os.write(reinterpret_cast<const char *>(file.data()), file.size());
+    if (!os.good()) {
+      log_crit("Can't write %s", argv[3]);
+      os.close();
+      std::remove(argv[3]); // don't leave a partial file for the build
+      return 1;
+    }
+  } catch (FatalError) {
+    log_crit("Can't compile %s", argv[2]);
+    return 1;
+  }
+  return 0;
+}
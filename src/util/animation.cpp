@@ -0,0 +1,315 @@
+#include "animation.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iterator>
+
+#include <zlib.h>
+
+#include "util.hpp"
+
+namespace {
+
+const char signature[8] = {'\x89', 'P', 'N', 'G', '\r', '\n', '\x1a', '\n'};
+
+/// Largest width or height of a canvas.
+const unsigned max_side = 1000000;
+/// Largest size of a canvas in bytes. The canvas is allocated twice, and row
+/// offsets are unsigned.
+const uint64_t max_canvas = uint64_t(1) << 28;
+
+uint32_t be32(const char *p) {
+  auto b = reinterpret_cast<const uint8_t *>(p);
+  return uint32_t(b[0]) << 24 | uint32_t(b[1]) << 16 | uint32_t(b[2]) << 8 |
+         b[3];
+}
+
+uint16_t be16(const char *p) {
+  auto b = reinterpret_cast<const uint8_t *>(p);
+  return uint16_t(b[0] << 8 | b[1]);
+}
+
+void put32(std::string &out, uint32_t v) {
+  const char b[4] = {char(v >> 24), char(v >> 16), char(v >> 8), char(v)};
+  out.append(b, 4);
+}
+
+/// Append a PNG chunk with its length and CRC.
+void put_chunk(std::string &out, const char *type, const char *data,
+               size_t n) {
+  put32(out, n);
+  size_t start = out.size();
+  out.append(type, 4);
+  out.append(data, n);
+  put32(out, crc32(0, reinterpret_cast<const Bytef *>(&out[start]), n + 4));
+}
+
+/// Get the RGBA color of a pixel of any image type.
+void rgba(const uint8_t *p, ImageType kind, uint8_t out[4]) {
+  switch (kind) {
+  case ImageType::Luminance:
+    out[0] = out[1] = out[2] = p[0];
+    out[3] = 255;
+    break;
+  case ImageType::RGB:
+    memcpy(out, p, 3);
+    out[3] = 255;
+    break;
+  case ImageType::RGBA:
+    memcpy(out, p, 4);
+    break;
+  }
+}
+
+/// Copy a w × h block between images of the same type.
+void copy(ConstImageView src, ImageView dst) {
+  size_t n = size_t(src.width()) * bytes_per_pixel(src.kind());
+  for (unsigned y = 0; y < src.height(); y++)
+    memcpy(dst.pixel(0, y), src.pixel(0, y), n);
+}
+
+} // namespace
+
+Animation Animation::read_png(std::istream &is) {
+  Animation a;
+  a.m_data.assign(std::istreambuf_iterator<char>(is), {});
+  const std::string &data = a.m_data;
+  if (data.size() < 8 || memcmp(data.data(), signature, 8)) {
+    log_crit("Not a PNG file");
+    throw FatalError::Decode;
+  }
+  bool animated = false, image_data = false;
+  uint32_t declared = 0, sequence = 0;
+  // Chunks are read in file order. The frame that image data belongs to is
+  // always the last one described so far.
+  for (size_t pos = 8;;) {
+    if (data.size() - pos < 12) {
+      log_crit("PNG file is truncated");
+      throw FatalError::Decode;
+    }
+    uint32_t len = be32(&data[pos]);
+    std::string type = data.substr(pos + 4, 4);
+    const char *body = &data[pos + 8];
+    if (data.size() - pos - 12 < len) {
+      log_crit("PNG chunk %s is truncated", type.c_str());
+      throw FatalError::Decode;
+    }
+    // Frame data is copied into new chunks for libpng, which computes new
+    // CRCs, so check the original ones here.
+    auto crc = crc32(0, reinterpret_cast<const Bytef *>(&data[pos + 4]),
+                     len + 4);
+    if (crc != be32(body + len)) {
+      log_crit("PNG chunk %s has a bad CRC", type.c_str());
+      throw FatalError::Decode;
+    }
+    if ((type == "fcTL" || type == "fdAT") && 4 <= len &&
+        be32(body) != sequence++) {
+      log_crit("APNG chunk %s is out of order", type.c_str());
+      throw FatalError::Decode;
+    }
+    if (pos == 8 && (type != "IHDR" || len != 13)) {
+      log_crit("PNG file has no header");
+      throw FatalError::Decode;
+    }
+    if (type == "IEND")
+      break;
+    if (type == "IHDR") {
+      a.m_header = {pos, len + size_t(12)};
+      a.m_width = be32(body);
+      a.m_height = be32(body + 4);
+      if (!a.m_width || !a.m_height) {
+        log_crit("PNG file is empty");
+        throw FatalError::Decode;
+      }
+      if (max_side < a.m_width || max_side < a.m_height ||
+          max_canvas < uint64_t(a.m_width) * a.m_height * 4) {
+        log_crit("PNG image is too large: %u by %u", a.m_width, a.m_height);
+        throw FatalError::ResourceLimit;
+      }
+    } else if (type == "acTL" && len == 8 && !image_data) {
+      animated = true;
+      declared = be32(body);
+      a.m_plays = be32(body + 4);
+    } else if (type == "fcTL" && animated && len == 26) {
+      Frame f;
+      f.w = be32(body + 4);
+      f.h = be32(body + 8);
+      f.x = be32(body + 12);
+      f.y = be32(body + 16);
+      uint16_t num = be16(body + 20), den = be16(body + 22);
+      f.delay = float(num) / (den ? den : 100);
+      f.dispose = Dispose(body[24]);
+      f.blend = Blend(body[25]);
+      if (!f.w || !f.h || a.m_width < f.w || a.m_width - f.w < f.x ||
+          a.m_height < f.h || a.m_height - f.h < f.y ||
+          uint8_t(f.dispose) > uint8_t(Dispose::Previous) ||
+          uint8_t(f.blend) > uint8_t(Blend::Over)) {
+        log_crit("Invalid APNG frame %zu", a.m_frames.size());
+        throw FatalError::Decode;
+      }
+      a.m_frames.push_back(f);
+      a.m_chunks.emplace_back();
+    } else if (type == "IDAT") {
+      // Without acTL, this is a still image. Otherwise the default image is
+      // only part of the animation if a frame was described before it.
+      if (!animated && a.m_frames.empty()) {
+        a.m_frames.push_back({0, 0, a.m_width, a.m_height, 0, Dispose::None,
+                              Blend::Source});
+        a.m_chunks.emplace_back();
+      }
+      if (!a.m_frames.empty())
+        a.m_chunks.back().push_back({pos + 8, len});
+      image_data = true;
+    } else if (type == "fdAT" && 4 <= len && !a.m_frames.empty()) {
+      a.m_chunks.back().push_back({pos + 12, len - size_t(4)});
+    } else if (!image_data && type != "acTL" && type != "fcTL") {
+      // Palettes and color information apply to every frame.
+      a.m_shared.push_back({pos, len + size_t(12)});
+    }
+    pos += len + size_t(12);
+  }
+
+  if (a.m_frames.empty() ||
+      std::any_of(a.m_chunks.begin(), a.m_chunks.end(),
+                  [](const std::vector<Range> &c) { return c.empty(); })) {
+    log_crit("PNG file has a frame without image data");
+    throw FatalError::Decode;
+  }
+  if (animated && declared != a.m_frames.size())
+    log_warn("APNG file declares %u frames but has %zu", unsigned(declared),
+             a.m_frames.size());
+  a.m_canvas = Image(ImageType::RGBA, a.m_width, a.m_height);
+  a.m_previous = Image(ImageType::RGBA, a.m_width, a.m_height);
+  a.m_current = a.m_frames.size();
+  return a;
+}
+
+void Animation::set_cache(size_t frames) {
+  m_cache_size = frames;
+  if (m_cache.size() > frames) {
+    // Keep the most recently used ones.
+    std::sort(m_cache.begin(), m_cache.end(),
+              [](const Cached &a, const Cached &b) { return a.used > b.used; });
+    m_cache.resize(frames);
+  }
+}
+
+ConstImageView Animation::frame(size_t frame) {
+  assert(frame < m_frames.size());
+  if (m_current == frame)
+    return m_canvas;
+  // Continue from the canvas if it's before the frame, or from the latest
+  // cached frame that is. Frames that restore the previous canvas can't be
+  // continued from a cached copy, because the copy is of the finished frame.
+  Cached *start = nullptr;
+  for (Cached &c : m_cache) {
+    if (c.frame == frame) {
+      c.used = ++m_clock;
+      return c.canvas;
+    }
+    if (c.frame < frame && m_frames[c.frame].dispose != Dispose::Previous &&
+        (!start || start->frame < c.frame))
+      start = &c;
+  }
+  bool ahead = m_current < frame;
+  if (start && (!ahead || m_current < start->frame)) {
+    copy(start->canvas, m_canvas);
+    m_current = start->frame;
+    start->used = ++m_clock;
+  } else if (!ahead) {
+    m_current = m_frames.size();
+  }
+  while (m_current != frame)
+    step();
+  return m_canvas;
+}
+
+void Animation::step() {
+  size_t next = m_current + 1;
+  if (m_current == m_frames.size()) {
+    next = 0;
+    memset(m_canvas.pixel(0, 0), 0, size_t(m_canvas.stride()) * m_height);
+  } else {
+    const Frame &f = m_frames[m_current];
+    ImageView area = m_canvas.subview(f.x, f.y, f.w, f.h);
+    if (f.dispose == Dispose::Background) {
+      for (unsigned y = 0; y < f.h; y++)
+        memset(area.pixel(0, y), 0, size_t(f.w) * 4);
+    } else if (f.dispose == Dispose::Previous) {
+      copy(m_previous.subview(0, 0, f.w, f.h), area);
+    }
+  }
+
+  const Frame &f = m_frames[next];
+  ImageView area = m_canvas.subview(f.x, f.y, f.w, f.h);
+  if (f.dispose == Dispose::Previous) {
+    copy(area, m_previous.subview(0, 0, f.w, f.h));
+  }
+  Image src = decode(next);
+  if (src.width() != f.w || src.height() != f.h) {
+    log_crit("APNG frame %zu has the wrong size", next);
+    throw FatalError::Decode;
+  }
+  unsigned bpp = bytes_per_pixel(src.kind());
+  for (unsigned y = 0; y < f.h; y++) {
+    const uint8_t *s = src.pixel(0, y);
+    uint8_t *d = area.pixel(0, y);
+    for (unsigned x = 0; x < f.w; x++, s += bpp, d += 4) {
+      uint8_t c[4];
+      rgba(s, src.kind(), c);
+      unsigned sa = c[3], da = d[3];
+      if (f.blend == Blend::Source || sa == 255) {
+        memcpy(d, c, 4);
+      } else if (sa) {
+        // Straight alpha: weigh each color by its own alpha.
+        unsigned out = sa * 255 + da * (255 - sa);
+        for (int k = 0; k < 3; k++)
+          d[k] = (c[k] * sa * 255 + d[k] * da * (255 - sa) + out / 2) / out;
+        d[3] = (out + 127) / 255;
+      }
+    }
+  }
+  m_current = next;
+  if (m_cache_size)
+    store();
+}
+
+Image Animation::decode(size_t frame) {
+  // Each frame is stored like the image data of a PNG file with the frame's
+  // size. Wrap it in one and let libpng do the rest.
+  const Frame &f = m_frames[frame];
+  m_png.assign(signature, 8);
+  char header[13];
+  memcpy(header, &m_data[m_header.offset + 8], 13);
+  for (int i = 0; i < 4; i++) {
+    header[i] = char(f.w >> (24 - 8 * i));
+    header[4 + i] = char(f.h >> (24 - 8 * i));
+  }
+  put_chunk(m_png, "IHDR", header, 13);
+  for (const Range &r : m_shared)
+    m_png.append(m_data, r.offset, r.size);
+  for (const Range &r : m_chunks[frame])
+    put_chunk(m_png, "IDAT", &m_data[r.offset], r.size);
+  put_chunk(m_png, "IEND", "", 0);
+  MemoryBuffer is(m_png.data(), m_png.size());
+  return Image::read_png(is);
+}
+
+void Animation::store() {
+  for (const Cached &c : m_cache)
+    if (c.frame == m_current)
+      return;
+  Cached *slot;
+  if (m_cache.size() < m_cache_size) {
+    slot = &m_cache.emplace_back();
+    slot->canvas = Image(ImageType::RGBA, m_width, m_height);
+  } else {
+    slot = &*std::min_element(
+        m_cache.begin(), m_cache.end(),
+        [](const Cached &a, const Cached &b) { return a.used < b.used; });
+  }
+  slot->frame = m_current;
+  slot->used = ++m_clock;
+  copy(m_canvas, slot->canvas);
+}
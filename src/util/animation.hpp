@@ -0,0 +1,118 @@
+/**
+ * \file
+ * \brief Decode animated PNG (APNG) files one frame at a time.
+ */
+
+#ifndef ANIMATION_HPP
+#define ANIMATION_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "image.hpp"
+
+/**
+ * \brief An animated PNG, decoded on demand.
+ *
+ * Reading the file only indexes its chunks. Each frame is a rectangle of the
+ * canvas, stored as compressed data like a small PNG of its own. frame()
+ * decodes the frames it needs and draws them onto an RGBA canvas, so stepping
+ * forward decodes one frame at a time.
+ *
+ * Going back means starting over from the first frame. A cache of finished
+ * canvases, see set_cache(), lets random access start from the nearest
+ * earlier cached frame instead.
+ *
+ * A plain PNG reads as an animation with one frame.
+ */
+class Animation {
+public:
+  /// How a frame's rectangle is cleaned up before the next frame.
+  enum class Dispose : uint8_t {
+    None,       ///< Leave it as it is.
+    Background, ///< Clear it to transparent black.
+    Previous,   ///< Restore what was there before the frame.
+  };
+
+  /// How a frame's pixels are combined with the canvas.
+  enum class Blend : uint8_t {
+    Source, ///< Replace the canvas, alpha included.
+    Over,   ///< Alpha blend over the canvas.
+  };
+
+  /// Placement and timing of a frame.
+  struct Frame {
+    unsigned x, y, w, h; ///< Rectangle of the canvas that the frame covers.
+    float delay;         ///< Time to show the frame, in seconds.
+    Dispose dispose;
+    Blend blend;
+  };
+
+private:
+  struct Range {
+    size_t offset, size;
+  };
+
+  struct Cached {
+    size_t frame;
+    uint64_t used;
+    Image canvas;
+  };
+
+  std::string m_data; ///< The whole file.
+  unsigned m_width = 0, m_height = 0, m_plays = 0;
+  Range m_header = {};            ///< The IHDR chunk.
+  std::vector<Range> m_shared;    ///< Chunks like PLTE that all frames use.
+  std::vector<Frame> m_frames;
+  std::vector<std::vector<Range>> m_chunks; ///< Image data of each frame.
+
+  Image m_canvas, m_previous;
+  size_t m_current = 0; ///< Frame drawn on m_canvas, or frames() if none.
+  std::string m_png;    ///< Scratch space for decoding frames.
+
+  size_t m_cache_size = 0;
+  uint64_t m_clock = 0;
+  std::vector<Cached> m_cache;
+
+public:
+  /**
+   * \brief Read an APNG file and index its frames.
+   * \throw FatalError::Decode if the file is invalid
+   * \throw FatalError::ResourceLimit if the canvas is too large
+   */
+  static Animation read_png(std::istream &is);
+
+  /// Get the width of the canvas in pixels.
+  unsigned width() const { return m_width; }
+  /// Get the height of the canvas in pixels.
+  unsigned height() const { return m_height; }
+  /// Get the number of times to play the animation, or 0 to loop forever.
+  unsigned plays() const { return m_plays; }
+  /// Get the number of frames.
+  size_t frames() const { return m_frames.size(); }
+  /// Get the placement and timing of a frame without decoding it.
+  const Frame &info(size_t frame) const { return m_frames[frame]; }
+
+  /**
+   * \brief Keep finished canvases for random access.
+   * \param frames maximum number of canvases to keep (0 turns the cache off)
+   */
+  void set_cache(size_t frames);
+
+  /**
+   * \brief Get the canvas as it looks while a frame is shown.
+   * \return RGBA image, valid until the next call to frame()
+   * \throw FatalError::Decode if the frame data is invalid
+   */
+  ConstImageView frame(size_t frame);
+
+private:
+  void step();
+  Image decode(size_t frame);
+  void store();
+};
+
+#endif
@@ -2,10 +2,13 @@
 
 #include <algorithm>
 #include <cassert>
+#include <condition_variable>
 #include <cstring>
 #include <fstream>
 #include <map>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 #include <variant>
@@ -13,10 +16,19 @@
 #include <SDL3/SDL_endian.h>
 #include <SDL3/SDL_filesystem.h>
 #include <SDL3/SDL_stdinc.h>
+#include <SDL3/SDL_timer.h>
 #include <zlib.h>
 
 #include "util.hpp"
 
+#if defined(__unix__) || defined(__APPLE__)
+#define ASSET_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 std::unique_ptr<uint8_t[]> read_stream(size_t &num, std::istream &is) {
   is.seekg(0, std::ios::end);
   num = is.tellg();
@@ -25,16 +37,97 @@ std::unique_ptr<uint8_t[]> read_stream(size_t &num, std::istream &is) {
   auto mem = std::make_unique<uint8_t[]>(num + 1);
   is.seekg(0, std::ios::beg);
   is.read(reinterpret_cast<char *>(mem.get()), num);
+  if (size_t(is.gcount()) != num) {
+    log_crit("Stream ended after %zu of %zu bytes", size_t(is.gcount()), num);
+    throw FatalError::Decode;
+  }
   mem[num] = 0;
   return mem;
 }
 
+bool StorageProfile::named(std::string_view name, StorageProfile &out) {
+  if (name == "hdd")
+    out = hdd();
+  else if (name == "sd_card")
+    out = sd_card();
+  else if (name == "network")
+    out = network();
+  else
+    return false;
+  return true;
+}
+
+AssetMapping::AssetMapping(AssetMapping &&other) noexcept
+    : m_data(other.m_data), m_size(other.m_size),
+      m_copy(std::move(other.m_copy)), m_view(other.m_view),
+      m_view_size(other.m_view_size) {
+  other.m_data = nullptr;
+  other.m_size = 0;
+  other.m_view = nullptr;
+}
+
+AssetMapping &AssetMapping::operator=(AssetMapping &&other) noexcept {
+  if (this != &other) {
+    release();
+    m_data = std::exchange(other.m_data, nullptr);
+    m_size = std::exchange(other.m_size, 0);
+    m_copy = std::move(other.m_copy);
+    m_view = std::exchange(other.m_view, nullptr);
+    m_view_size = other.m_view_size;
+  }
+  return *this;
+}
+
+AssetMapping::~AssetMapping() { release(); }
+
+bool AssetMapping::map(const char *path, size_t offset, size_t size) {
+#ifdef ASSET_MMAP
+  // Mapped data must be as aligned as data that is read.
+  if (!size || offset % 8)
+    return false;
+  int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+  // Pages past the end of the file can't be read, so check the size.
+  struct stat st;
+  size_t start = offset / sysconf(_SC_PAGESIZE) * sysconf(_SC_PAGESIZE);
+  void *view = MAP_FAILED;
+  if (!fstat(fd, &st) && offset <= size_t(st.st_size) &&
+      size <= size_t(st.st_size) - offset)
+    view = mmap(nullptr, offset - start + size, PROT_READ, MAP_PRIVATE, fd,
+                start);
+  ::close(fd);
+  if (view == MAP_FAILED)
+    return false;
+  release();
+  m_view = view;
+  m_view_size = offset - start + size;
+  m_data = static_cast<const uint8_t *>(view) + (offset - start);
+  m_size = size;
+  return true;
+#else
+  (void)path, (void)offset, (void)size;
+  return false;
+#endif
+}
+
+void AssetMapping::release() {
+#ifdef ASSET_MMAP
+  if (m_view)
+    munmap(m_view, m_view_size);
+#endif
+  m_view = nullptr;
+  m_copy.reset();
+  m_data = nullptr;
+  m_size = 0;
+}
+
 class AssetSystem::Data {
   class DirectorySource {
     std::string m_path;
 
   public:
-    explicit DirectorySource(const char *path) {
+    explicit DirectorySource(const char *path) : m_path(path) {
       SDL_PathInfo info;
       if (!SDL_GetPathInfo(path, &info)) {
         log_crit("SDL_GetPathInfo: %s", SDL_GetError());
@@ -47,15 +140,49 @@ class AssetSystem::Data {
 
     std::unique_ptr<std::istream> open(const char *key) {
       char path[1024];
+      if (!full_path(key, path))
+        return nullptr;
+      auto is = std::make_unique<std::ifstream>(path, std::ios::binary);
+      return is->good() ? std::move(is) : nullptr;
+    }
+
+    bool map(const char *key, AssetMapping &out) {
+      char path[1024];
+      SDL_PathInfo info;
+      if (!full_path(key, path) || !SDL_GetPathInfo(path, &info) ||
+          info.type != SDL_PATHTYPE_FILE)
+        return false;
+      if (out.map(path, 0, info.size))
+        return true;
+      std::ifstream is(path, std::ios::binary);
+      if (!is.good())
+        return false;
+      size_t num;
+      std::unique_ptr<uint8_t[]> data = read_stream(num, is);
+      out = AssetMapping(std::move(data), num);
+      return true;
+    }
+
+    bool stamp(const char *key, AssetStamp &out) {
+      char path[1024];
+      SDL_PathInfo info;
+      if (!full_path(key, path) || !SDL_GetPathInfo(path, &info) ||
+          info.type != SDL_PATHTYPE_FILE)
+        return false;
+      out.size = info.size;
+      out.check = info.modify_time;
+      return true;
+    }
+
+  private:
+    bool full_path(const char *key, char (&path)[1024]) {
       int num = SDL_snprintf(path, sizeof path, "%s/%s", m_path.c_str(), key);
       assert(0 <= num); // internal error?
       if (sizeof path <= static_cast<unsigned>(num)) {
         log_warn("Full asset path is too long: %d bytes", num);
-        return nullptr;
-      } else {
-        auto is = std::make_unique<std::ifstream>(path, std::ios::binary);
-        return is->good() ? std::move(is) : nullptr;
+        return false;
       }
+      return true;
     }
   };
 
@@ -68,17 +195,32 @@ class AssetSystem::Data {
     ///
     std::istream &m_file;
 
+    /// Path of the zip file, if it was opened by path.
+    std::string m_path;
+
+    /// Streams of one zip file share its file position, so they take turns.
+    std::mutex m_lock;
+
+    /// A file's record in the central directory.
+    struct Record {
+      size_t offset;        ///< Start of the local file header.
+      uint32_t crc;         ///< CRC-32 of the uncompressed data.
+      uint32_t size;        ///< Compressed size.
+      uint32_t decode_size; ///< Uncompressed size.
+    };
+
     /**
      * \brief Store the result of reading the central directory.
      *
-     * Map file path (relative to zip root) to the offset of the corresponding
-     * local file header, which immediately precedes the compressed data.
+     * Map file path (relative to zip root) to its record. The local file
+     * header immediately precedes the compressed data.
      */
-    std::unordered_map<std::string, size_t> m_index;
+    std::unordered_map<std::string, Record> m_index;
 
   public:
     explicit ZipSource(const char *path)
-        : m_disk_file(path, std::ios::binary), m_file(m_disk_file) {
+        : m_disk_file(path, std::ios::binary), m_file(m_disk_file),
+          m_path(path) {
       if (!m_file.good()) {
         log_crit("Can't open zip file: %s", path);
         throw FatalError::Decode;
@@ -95,20 +237,24 @@ class AssetSystem::Data {
     class CatStream : public std::istream {
       class StreamBuffer : public std::streambuf {
         std::istream &m_data;
+        std::mutex &m_lock;
         pos_type m_off_beg;
         pos_type m_off_end;
         pos_type m_off_pos;
         char m_storage[4096];
 
       public:
-        StreamBuffer(std::istream &data, pos_type beg, pos_type end)
-            : m_data(data), m_off_beg(beg), m_off_end(end), m_off_pos(beg) {}
+        StreamBuffer(std::istream &data, std::mutex &lock, pos_type beg,
+                     pos_type end)
+            : m_data(data), m_lock(lock), m_off_beg(beg), m_off_end(end),
+              m_off_pos(beg) {}
 
         int_type underflow() override {
           if (m_off_end <= m_off_pos) {
             setg(nullptr, nullptr, nullptr);
             return traits_type::eof();
           }
+          std::lock_guard<std::mutex> guard(m_lock);
           m_data.seekg(m_off_pos, std::ios::beg);
           m_data.read(m_storage, // don't read past local file
                       std::min(m_off_end - m_off_pos,
@@ -159,8 +305,9 @@ class AssetSystem::Data {
       StreamBuffer m_underlying;
 
     public:
-      CatStream(std::istream &data, pos_type beg, pos_type end)
-          : m_underlying(data, beg, end) {
+      CatStream(std::istream &data, std::mutex &lock, pos_type beg,
+                pos_type end)
+          : m_underlying(data, lock, beg, end) {
         rdbuf(&m_underlying);
       }
     };
@@ -168,15 +315,22 @@ class AssetSystem::Data {
     class DeflateStream : public std::istream {
       class StreamBuffer : public std::streambuf {
         std::istream &m_data;
+        std::mutex &m_lock;
         pos_type m_off_beg;
         pos_type m_off_end;
         pos_type m_off_pos;
+        std::streamoff m_decode_size;
+        std::streamoff m_decoded = 0; ///< Output up to egptr().
+        bool m_done = false;          ///< Reached the end of the stream.
         z_stream m_zlib;
+        char m_input[4096]; ///< Compressed data not yet consumed by zlib.
         char m_storage[4096];
 
       public:
-        StreamBuffer(std::istream &data, pos_type beg, pos_type end)
-            : m_data(data), m_off_beg(beg), m_off_end(end), m_off_pos(beg) {
+        StreamBuffer(std::istream &data, std::mutex &lock, pos_type beg,
+                     pos_type end, std::streamoff decode_size)
+            : m_data(data), m_lock(lock), m_off_beg(beg), m_off_end(end),
+              m_off_pos(beg), m_decode_size(decode_size) {
           memset(&m_zlib, 0, sizeof m_zlib);
           int status = inflateInit2(&m_zlib, -MAX_WBITS); // raw deflate
           if (status != Z_OK) {
@@ -193,76 +347,183 @@ class AssetSystem::Data {
         ~StreamBuffer() { inflateEnd(&m_zlib); }
 
         int_type underflow() override {
-          if (m_off_end <= m_off_pos) {
-            setg(nullptr, nullptr, nullptr);
+          if (gptr() < egptr())
+            return traits_type::to_int_type(*gptr());
+          if (m_done)
             return traits_type::eof();
+          m_zlib.next_out = reinterpret_cast<unsigned char *>(m_storage);
+          m_zlib.avail_out = sizeof(m_storage);
+          // Inflate until there is some output, refilling the input as it
+          // runs out.
+          while (m_zlib.avail_out == sizeof(m_storage)) {
+            if (!m_zlib.avail_in && !fill())
+              break;
+            int status = inflate(&m_zlib, Z_NO_FLUSH);
+            if (status == Z_STREAM_END) {
+              m_done = true;
+              break;
+            }
+            if (status != Z_OK) {
+              if (m_zlib.msg)
+                log_crit("inflate: %s", m_zlib.msg);
+              else
+                log_crit("inflate: code %d", status);
+              m_done = true;
+              break;
+            }
           }
-          // Read compressed data into this temporary buffer.
-          char mem[4096];
-          m_data.seekg(m_off_pos, std::ios::beg);
-          m_data.read(
-              mem, // don't read past local file
-              std::min(m_off_end - m_off_pos, std::streamsize(sizeof(mem))));
-          if (!m_data.gcount()) {
+          size_t num = sizeof(m_storage) - m_zlib.avail_out;
+          if (!num) {
             setg(nullptr, nullptr, nullptr);
             return traits_type::eof();
           }
-          m_off_pos = m_data.tellg();
-          //TODO
-          m_zlib.next_in = reinterpret_cast<unsigned char *>(mem);
-          m_zlib.avail_in = m_data.gcount();
-          m_zlib.next_out = reinterpret_cast<unsigned char *>(m_storage);
-          m_zlib.avail_out = sizeof(m_storage);
-          int status = inflate(&m_zlib, Z_NO_FLUSH);
+          setg(m_storage, m_storage, m_storage + num);
+          m_decoded += num;
+          return traits_type::to_int_type(*gptr());
         }
 
-        // pos_type seekoff(off_type off, seekdir dir, openmode which) override
-        // {}
+        /// Positions are in the uncompressed data. Seeking backwards
+        /// restarts decoding, and seeking forwards decodes and discards.
+        pos_type seekoff(off_type off, seekdir dir, openmode which) override {
+          switch (dir) {
+          case cur:
+            return seekpos(off + m_decoded - (egptr() - gptr()), which);
+          case end:
+            return seekpos(off + m_decode_size, which);
+          default:
+            return seekpos(off, which);
+          }
+        }
 
-        // pos_type seekpos(pos_type pos, openmode which) override {}
+        pos_type seekpos(pos_type pos, openmode which) override {
+          (void)which;
+          std::streamoff req = pos;
+          if (req < 0 || m_decode_size < req)
+            return pos_type(off_type(-1));
+          std::streamoff here = m_decoded - (egptr() - gptr());
+          if (req == here)
+            return pos; // tellg() doesn't need to decode anything
+          if (req < m_decoded - (egptr() - eback())) {
+            inflateReset(&m_zlib);
+            m_zlib.avail_in = 0;
+            m_off_pos = m_off_beg;
+            m_decoded = 0;
+            m_done = false;
+            setg(nullptr, nullptr, nullptr);
+          }
+          // Skip forward to the requested position.
+          while (m_decoded < req) {
+            setg(nullptr, nullptr, nullptr);
+            if (traits_type::eq_int_type(underflow(), traits_type::eof()))
+              return pos_type(off_type(-1));
+          }
+          setg(eback(), egptr() - (m_decoded - req), egptr());
+          return pos;
+        }
+
+      private:
+        /// Read more compressed data for zlib, or return false at its end.
+        bool fill() {
+          if (m_off_end <= m_off_pos)
+            return false;
+          std::lock_guard<std::mutex> guard(m_lock);
+          m_data.seekg(m_off_pos, std::ios::beg);
+          m_data.read(m_input, // don't read past local file
+                      std::min(m_off_end - m_off_pos,
+                               std::streamsize(sizeof(m_input))));
+          if (!m_data.gcount())
+            return false;
+          m_off_pos += m_data.gcount();
+          m_zlib.next_in = reinterpret_cast<unsigned char *>(m_input);
+          m_zlib.avail_in = m_data.gcount();
+          return true;
+        }
       };
 
       StreamBuffer m_underlying;
 
     public:
-      DeflateStream(std::istream &data, pos_type beg, pos_type end)
-          : m_underlying(data, beg, end) {
+      DeflateStream(std::istream &data, std::mutex &lock, pos_type beg,
+                    pos_type end, std::streamoff decode_size)
+          : m_underlying(data, lock, beg, end, decode_size) {
         rdbuf(&m_underlying);
       }
     };
 
+    /// Where a file's data is, from its local header.
+    struct Entry {
+      uint16_t compression;
+      uint32_t size;        // compressed
+      uint32_t decode_size; // uncompressed
+      std::streamoff base;  // start of the data
+    };
+
   public:
     std::unique_ptr<std::istream> open(const char *key) {
-      auto it = m_index.find(key);
-      if (it == m_index.end())
+      Entry e;
+      if (!find(key, e))
         return nullptr;
-      //
-      uint16_t n; // file name length
-      uint16_t m; // extra field length
-      uint16_t compression;
-      uint32_t decode_size; // uncompressed
-      std::streamoff base = it->second;
-      m_file.seekg(base + 8, std::ios::beg);
-      read(compression, m_file);
-      m_file.seekg(base + 22, std::ios::beg);
-      read(decode_size, m_file);
-      m_file.seekg(base + 26, std::ios::beg);
-      read(n, m_file);
-      read(m, m_file);
-      base += 30 + n + m;
+      std::streamoff base = e.base;
+      uint32_t decode_size = e.decode_size;
+      uint16_t compression = e.compression;
       switch (compression) {
       case 0:
-        return std::make_unique<CatStream>(m_file, base, base + decode_size);
+        return std::make_unique<CatStream>(m_file, m_lock, base,
+                                           base + decode_size);
       case 8:
-        return std::make_unique<DeflateStream>(m_file, base,
-                                               base + decode_size);
+        return std::make_unique<DeflateStream>(m_file, m_lock, base,
+                                               base + e.size, decode_size);
       default:
         log_crit("Unsupported compression method: %u", compression);
         throw FatalError::Decode;
       }
     }
 
+    bool map(const char *key, AssetMapping &out) {
+      Entry e;
+      if (!find(key, e))
+        return false;
+      if (e.compression == 0 && !m_path.empty() &&
+          out.map(m_path.c_str(), e.base, e.decode_size))
+        return true;
+      std::unique_ptr<std::istream> is = open(key);
+      size_t num;
+      std::unique_ptr<uint8_t[]> data = read_stream(num, *is);
+      out = AssetMapping(std::move(data), num);
+      return true;
+    }
+
+    bool stamp(const char *key, AssetStamp &out) {
+      auto it = m_index.find(key);
+      if (it == m_index.end())
+        return false;
+      out.size = it->second.decode_size;
+      out.check = it->second.crc;
+      return true;
+    }
+
   private:
+    bool find(const char *key, Entry &e) {
+      auto it = m_index.find(key);
+      if (it == m_index.end())
+        return false;
+      std::lock_guard<std::mutex> guard(m_lock);
+      uint16_t n; // file name length
+      uint16_t m; // extra field length
+      e.base = it->second.offset;
+      // The sizes in the local header may be 0 if they follow the data, so
+      // use the ones from the central directory.
+      e.size = it->second.size;
+      e.decode_size = it->second.decode_size;
+      m_file.seekg(e.base + 8, std::ios::beg);
+      read(e.compression, m_file);
+      m_file.seekg(e.base + 26, std::ios::beg);
+      read(n, m_file);
+      read(m, m_file);
+      e.base += 30 + n + m;
+      return true;
+    }
+
     void init() {
       seek_end_of_central_directory(m_file);
       // Get the location of the central directory (list of all files).
@@ -279,7 +540,11 @@ class AssetSystem::Data {
         uint16_t n; // file name length
         uint16_t m; // extra field length
         uint16_t k; // comment length
-        m_file.seekg(base + 28, std::ios::beg);
+        uint32_t crc, compressed_size, decode_size;
+        m_file.seekg(base + 16, std::ios::beg);
+        read(crc, m_file);
+        read(compressed_size, m_file);
+        read(decode_size, m_file);
         read(n, m_file);
         read(m, m_file);
         read(k, m_file);
@@ -290,7 +555,8 @@ class AssetSystem::Data {
         // Read the variable-length file name.
         std::string name(n, '\0');
         m_file.read(name.data(), n);
-        m_index.emplace(std::move(name), off_file);
+        m_index.emplace(std::move(name),
+                        Record{off_file, crc, compressed_size, decode_size});
         // Advance to the next central directory record.
         base += 46 + n + m + k;
       }
@@ -337,11 +603,130 @@ class AssetSystem::Data {
     }
   };
 
+  /// Simulated storage for throttle().
+  class Device {
+    StorageProfile m_profile;
+    /// Held while waiting, so requests queue up.
+    std::mutex m_lock;
+    const void *m_reader = nullptr; ///< Stream of the last read.
+    uint64_t m_position = 0;        ///< Where the last read ended.
+
+  public:
+    explicit Device(const StorageProfile &profile) : m_profile(profile) {}
+
+    /// Wait to find a file.
+    void open() {
+      std::lock_guard<std::mutex> guard(m_lock);
+      SDL_DelayPrecise(m_profile.open);
+      m_reader = nullptr;
+    }
+
+    /// Wait to read part of a file.
+    void read(const void *reader, uint64_t position, uint64_t size) {
+      std::lock_guard<std::mutex> guard(m_lock);
+      uint64_t time = 0;
+      if (reader != m_reader || position != m_position)
+        time += m_profile.seek;
+      if (m_profile.bandwidth)
+        time += uint64_t(1e9 * double(size) / m_profile.bandwidth);
+      SDL_DelayPrecise(time);
+      m_reader = reader;
+      m_position = position + size;
+    }
+  };
+
+  /// A stream that reads from another at the speed of a Device.
+  class ThrottledStream : public std::istream {
+    class StreamBuffer : public std::streambuf {
+      std::unique_ptr<std::istream> m_data;
+      Device &m_device;
+      pos_type m_end = 0; ///< Position in m_data of the end of the buffer.
+      char m_storage[65536];
+
+    public:
+      StreamBuffer(std::unique_ptr<std::istream> data, Device &device)
+          : m_data(std::move(data)), m_device(device) {}
+
+      int_type underflow() override {
+        m_data->read(m_storage, sizeof m_storage);
+        std::streamsize num = m_data->gcount();
+        if (!num) {
+          setg(nullptr, nullptr, nullptr);
+          return traits_type::eof();
+        }
+        m_device.read(this, m_end, num);
+        m_end += num;
+        setg(m_storage, m_storage, m_storage + num);
+        return traits_type::to_int_type(m_storage[0]);
+      }
+
+      pos_type seekoff(off_type off, seekdir dir, openmode which) override {
+        (void)which;
+        if (dir == cur) {
+          off += m_end - off_type(egptr() - gptr());
+          dir = beg;
+        }
+        m_data->clear();
+        m_data->seekg(off, dir);
+        pos_type pos = m_data->tellg();
+        if (pos != pos_type(off_type(-1))) {
+          setg(nullptr, nullptr, nullptr);
+          m_end = pos;
+        }
+        return pos;
+      }
+
+      pos_type seekpos(pos_type pos, openmode which) override {
+        return seekoff(off_type(pos), beg, which);
+      }
+    };
+
+    StreamBuffer m_underlying;
+
+  public:
+    ThrottledStream(std::unique_ptr<std::istream> data, Device &device)
+        : m_underlying(std::move(data), device) {
+      rdbuf(&m_underlying);
+    }
+  };
+
   using AnySource = std::variant<DirectorySource, ZipSource>;
 
   std::multimap<unsigned, AnySource> m_search_path;
 
+  /// Storage to simulate, by priority.
+  std::map<unsigned, std::unique_ptr<Device>> m_devices;
+
+  struct Request {
+    std::string key;
+    ReadCallback done;
+  };
+
+  // Background reads, ordered by priority and then by ID.
+  std::mutex m_lock;
+  std::condition_variable m_wake;
+  std::map<std::pair<unsigned, uint64_t>, Request> m_requests;
+  std::unordered_map<uint64_t, unsigned> m_request_priority;
+  uint64_t m_next_request = 1;
+  bool m_reading = false; ///< A request is being served.
+  bool m_stop = false;
+  std::thread m_thread;
+
 public:
+  Data() = default;
+  Data(const Data &other) = delete;
+  Data &operator=(const Data &other) = delete;
+
+  ~Data() {
+    {
+      std::lock_guard<std::mutex> guard(m_lock);
+      m_stop = true;
+    }
+    m_wake.notify_one();
+    if (m_thread.joinable())
+      m_thread.join();
+  }
+
   void add_directory(unsigned p, const char *path) {
     m_search_path.emplace(
         std::piecewise_construct, std::forward_as_tuple(p),
@@ -357,16 +742,124 @@ public:
   }
 
   std::unique_ptr<std::istream> open(const char *key) {
+    std::unique_ptr<std::istream> result = find(key);
+    if (!result) {
+      log_crit("Asset file not found: %s", key);
+      throw FatalError::Decode;
+    }
+    return result;
+  }
+
+  void throttle(unsigned p, const StorageProfile &storage) {
+    m_devices[p] = std::make_unique<Device>(storage);
+  }
+
+  AssetMapping map(const char *key) {
+    AssetMapping result;
+    for (auto &[p, source] : m_search_path) {
+      if (std::visit([&](auto &resolve) { return resolve.map(key, result); },
+                     source)) {
+        if (Device *device = find_device(p)) {
+          // Mapped pages would be read as they're touched, which can't be
+          // slowed down, so wait for the whole file up front.
+          device->open();
+          device->read(&result, 0, result.size());
+        }
+        return result;
+      }
+    }
+    log_crit("Asset file not found: %s", key);
+    throw FatalError::Decode;
+  }
+
+  bool stamp(const char *key, AssetStamp &out) {
+    for (auto &[p, source] : m_search_path) {
+      if (std::visit([&](auto &resolve) { return resolve.stamp(key, out); },
+                     source)) {
+        if (Device *device = find_device(p))
+          device->open();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  uint64_t read_async(const char *key, unsigned p, ReadCallback done) {
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (!m_thread.joinable())
+      m_thread = std::thread([this]() { main(); });
+    uint64_t id = m_next_request++;
+    m_requests.emplace(std::make_pair(p, id), Request{key, std::move(done)});
+    m_request_priority.emplace(id, p);
+    m_wake.notify_one();
+    return id;
+  }
+
+  size_t pending() {
+    std::lock_guard<std::mutex> guard(m_lock);
+    return m_requests.size() + m_reading;
+  }
+
+  bool cancel(uint64_t id) {
+    std::lock_guard<std::mutex> guard(m_lock);
+    auto it = m_request_priority.find(id);
+    if (it == m_request_priority.end())
+      return false;
+    m_requests.erase(std::make_pair(it->second, id));
+    m_request_priority.erase(it);
+    return true;
+  }
+
+private:
+  /// Search for a file without logging if it's missing.
+  std::unique_ptr<std::istream> find(const char *key) {
     for (auto &[p, source] : m_search_path) {
       std::unique_ptr<std::istream> result =
           std::visit([=](auto &resolve) { return resolve.open(key); }, source);
       if (result) {
         assert(result->good());
+        if (Device *device = find_device(p)) {
+          device->open();
+          result =
+              std::make_unique<ThrottledStream>(std::move(result), *device);
+        }
         return result;
       }
     }
-    log_crit("Asset file not found: %s", key);
-    throw FatalError::Decode;
+    return nullptr;
+  }
+
+  Device *find_device(unsigned p) {
+    if (m_devices.empty())
+      return nullptr;
+    auto it = m_devices.find(p);
+    return it == m_devices.end() ? nullptr : it->second.get();
+  }
+
+  /// Background reading thread.
+  void main() {
+    std::unique_lock<std::mutex> guard(m_lock);
+    for (;;) {
+      m_wake.wait(guard, [this]() { return m_stop || !m_requests.empty(); });
+      if (m_stop)
+        return; // pending requests are dropped
+      auto node = m_requests.extract(m_requests.begin());
+      m_request_priority.erase(node.key().second);
+      m_reading = true;
+      guard.unlock();
+      Request &r = node.mapped();
+      size_t num = 0;
+      std::unique_ptr<uint8_t[]> data;
+      try {
+        if (auto is = find(r.key.c_str()))
+          data = read_stream(num, *is);
+      } catch (FatalError) {
+        log_warn("Can't read asset file: %s", r.key.c_str());
+      }
+      r.done(std::move(data), num);
+      guard.lock();
+      m_reading = false;
+    }
   }
 };
 
@@ -387,6 +880,25 @@ void AssetSystem::add_zip(unsigned p, std::istream &is) {
   m_data->add_zip(p, is);
 }
 
+void AssetSystem::throttle(unsigned p, const StorageProfile &storage) {
+  m_data->throttle(p, storage);
+}
+
 std::unique_ptr<std::istream> AssetSystem::open(const char *key) {
   return m_data->open(key);
 }
+
+AssetMapping AssetSystem::map(const char *key) { return m_data->map(key); }
+
+bool AssetSystem::stamp(const char *key, AssetStamp &out) {
+  return m_data->stamp(key, out);
+}
+
+uint64_t AssetSystem::read_async(const char *key, unsigned p,
+                                 ReadCallback done) {
+  return m_data->read_async(key, p, std::move(done));
+}
+
+bool AssetSystem::cancel(uint64_t id) { return m_data->cancel(id); }
+
+size_t AssetSystem::pending() const { return m_data->pending(); }
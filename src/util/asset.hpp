@@ -7,8 +7,10 @@
 #define ASSET_HPP
 
 #include <cstdint>
+#include <functional>
 #include <istream>
 #include <memory>
+#include <string_view>
 
 /**
  * \brief Read an entire file into memory.
@@ -21,6 +23,79 @@
  */
 std::unique_ptr<uint8_t[]> read_stream(size_t &num, std::istream &is);
 
+/**
+ * \brief Read-only contents of an asset file, from AssetSystem::map().
+ *
+ * Files are mapped into memory where the platform and the source allow it,
+ * and read into memory otherwise. Either way the data is aligned to at least
+ * 8 bytes and stays valid as long as the mapping.
+ */
+class AssetMapping {
+  const uint8_t *m_data = nullptr;
+  size_t m_size = 0;
+  std::unique_ptr<uint8_t[]> m_copy; ///< Data if the file wasn't mapped.
+  void *m_view = nullptr;            ///< Mapped pages, if any.
+  size_t m_view_size = 0;
+
+public:
+  AssetMapping() = default;
+  AssetMapping(AssetMapping &&other) noexcept;
+  AssetMapping &operator=(AssetMapping &&other) noexcept;
+  ~AssetMapping();
+
+  /// Use a file read into memory.
+  AssetMapping(std::unique_ptr<uint8_t[]> data, size_t size)
+      : m_data(data.get()), m_size(size), m_copy(std::move(data)) {}
+
+  /**
+   * \brief Map part of a file on disk.
+   * \return false if the platform can't map files or mapping failed
+   */
+  bool map(const char *path, size_t offset, size_t size);
+
+  const uint8_t *data() const { return m_data; }
+  size_t size() const { return m_size; }
+
+  /// Check if the data is mapped rather than copied.
+  bool mapped() const { return m_view; }
+
+private:
+  void release();
+};
+
+/// Identifies one version of an asset file, without reading it.
+struct AssetStamp {
+  uint64_t size; ///< Size of the file in bytes.
+  /// CRC-32 of a file in a zip file, or the modification time of a file in a
+  /// directory.
+  uint64_t check;
+};
+
+/**
+ * \brief Timing of a storage device, to see how loading copes with storage
+ * slower than a development machine's.
+ * \see AssetSystem::throttle()
+ */
+struct StorageProfile {
+  uint64_t open = 0; ///< Nanoseconds to find a file.
+  /// Nanoseconds to start a read that doesn't follow on from the last one.
+  uint64_t seek = 0;
+  uint64_t bandwidth = 0; ///< Bytes per second, or 0 for no limit.
+
+  /// A laptop hard disk.
+  static StorageProfile hdd() { return {12000000, 10000000, 100000000}; }
+  /// A fast SD card, as in handheld devices.
+  static StorageProfile sd_card() { return {2000000, 1000000, 25000000}; }
+  /// A file share on a 100 Mbit network.
+  static StorageProfile network() { return {30000000, 2000000, 11000000}; }
+
+  /**
+   * \brief Get a profile by name: hdd, sd_card or network.
+   * \return false if there's no such profile
+   */
+  static bool named(std::string_view name, StorageProfile &out);
+};
+
 /// Manage asset files and search paths.
 class AssetSystem {
   class Data;
@@ -66,12 +141,86 @@ public:
    */
   void add_zip(unsigned p, std::istream &is);
 
+  /**
+   * \brief Make the sources at a priority act like slower storage.
+   *
+   * Finding, opening and reading files waits as long as the storage would
+   * take. The sources at the priority share one simulated device, which
+   * serves one request at a time, so reads queue up behind each other as
+   * they would on a disk. Reads that don't continue where the last one left
+   * off pay for a seek.
+   *
+   * This is for testing, and has no cost for priorities that aren't
+   * throttled. Don't call it while reads are pending.
+   *
+   * \param p priority (lower is high priority)
+   * \param storage timing to simulate
+   */
+  void throttle(unsigned p, const StorageProfile &storage);
+
   /**
    * \brief Open an asset file for reading.
    * \param key asset file name
    * \throw FatalError::Decode if the file can't be read
    */
   std::unique_ptr<std::istream> open(const char *key);
+
+  /**
+   * \brief Get the contents of an asset file without reading it up front.
+   *
+   * Files in directories and files stored without compression in zip files
+   * on disk are mapped into memory, if they are aligned. Other files are read.
+   *
+   * \param key asset file name
+   * \throw FatalError::Decode if the file can't be read
+   */
+  AssetMapping map(const char *key);
+
+  /**
+   * \brief Get an asset file's size and checksum from the directory.
+   *
+   * This is cheap enough to check that something made from the file is up to
+   * date, before deciding whether to read it.
+   *
+   * \param key asset file name
+   * \return false if the file is missing
+   */
+  bool stamp(const char *key, AssetStamp &out);
+
+  /**
+   * \brief Receive the contents of an asset file read in the background.
+   *
+   * The data is null-terminated like read_stream(). If the file is missing or
+   * can't be read, data is null.
+   */
+  using ReadCallback =
+      std::function<void(std::unique_ptr<uint8_t[]> data, size_t num)>;
+
+  /**
+   * \brief Read an entire asset file on a background thread.
+   *
+   * Requests are served one at a time, lowest priority value first, and in
+   * order within a priority. The callback runs on the background thread.
+   * Requests still waiting when the AssetSystem is destroyed are dropped
+   * without calling their callbacks.
+   *
+   * Don't add to the search path while reads are pending.
+   *
+   * \param key asset file name
+   * \param p priority (lower is high priority)
+   * \param done called with the file contents
+   * \return request ID for cancel()
+   */
+  uint64_t read_async(const char *key, unsigned p, ReadCallback done);
+
+  /**
+   * \brief Withdraw a background read that hasn't started yet.
+   * \return true if the callback will not be called
+   */
+  bool cancel(uint64_t id);
+
+  /// Get the number of background reads waiting or in progress.
+  size_t pending() const;
 };
 
 #endif
@@ -0,0 +1,403 @@
+#include "audio.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#include <SDL3/SDL_audio.h>
+#include <SDL3/SDL_endian.h>
+#include <SDL3/SDL_error.h>
+
+#include "util.hpp"
+
+namespace {
+
+/// Samples buffered per voice (about 170 ms of stereo at 48 kHz).
+constexpr size_t ring_samples = 16384;
+
+/// Frames decoded or mixed at a time.
+constexpr size_t block_frames = 1024;
+
+uint32_t read_u32(std::istream &is) {
+  uint32_t x = 0;
+  is.read(reinterpret_cast<char *>(&x), 4);
+  return SDL_Swap32LE(x);
+}
+
+uint16_t read_u16(std::istream &is) {
+  uint16_t x = 0;
+  is.read(reinterpret_cast<char *>(&x), 2);
+  return SDL_Swap16LE(x);
+}
+
+/// Add stereo samples times (left, right) gains to the output.
+void accumulate(float *out, const float *src, size_t frames, float left,
+                float right) {
+  size_t i = 0, n = frames * 2;
+#ifdef __SSE__
+  __m128 gain = _mm_setr_ps(left, right, left, right);
+  for (; i + 4 <= n; i += 4) {
+    __m128 s = _mm_mul_ps(_mm_loadu_ps(src + i), gain);
+    _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), s));
+  }
+#endif
+  for (; i < n; i += 2) {
+    out[i] += src[i] * left;
+    out[i + 1] += src[i + 1] * right;
+  }
+}
+
+} // namespace
+
+SampleRing::SampleRing(size_t capacity) {
+  size_t n = 1;
+  while (n < capacity)
+    n *= 2;
+  m_data = std::make_unique<float[]>(n);
+  m_mask = n - 1;
+}
+
+size_t SampleRing::available() const {
+  return m_head.load(std::memory_order_acquire) -
+         m_tail.load(std::memory_order_acquire);
+}
+
+size_t SampleRing::space() const { return capacity() - available(); }
+
+size_t SampleRing::write(const float *src, size_t num) {
+  size_t head = m_head.load(std::memory_order_relaxed);
+  size_t tail = m_tail.load(std::memory_order_acquire);
+  num = std::min(num, capacity() - (head - tail));
+  size_t at = head & m_mask;
+  size_t first = std::min(num, capacity() - at);
+  memcpy(m_data.get() + at, src, first * sizeof(float));
+  memcpy(m_data.get(), src + first, (num - first) * sizeof(float));
+  m_head.store(head + num, std::memory_order_release);
+  return num;
+}
+
+size_t SampleRing::read(float *dst, size_t num) {
+  size_t tail = m_tail.load(std::memory_order_relaxed);
+  size_t head = m_head.load(std::memory_order_acquire);
+  num = std::min(num, head - tail);
+  size_t at = tail & m_mask;
+  size_t first = std::min(num, capacity() - at);
+  memcpy(dst, m_data.get() + at, first * sizeof(float));
+  memcpy(dst + first, m_data.get(), (num - first) * sizeof(float));
+  m_tail.store(tail + num, std::memory_order_release);
+  return num;
+}
+
+void SampleRing::reset() {
+  m_head.store(0, std::memory_order_relaxed);
+  m_tail.store(0, std::memory_order_relaxed);
+}
+
+WavDecoder::WavDecoder(std::unique_ptr<std::istream> is) : m_is(std::move(is)) {
+  char tag[4];
+  m_is->read(tag, 4);
+  read_u32(*m_is);
+  char wave[4];
+  m_is->read(wave, 4);
+  if (!m_is->good() || memcmp(tag, "RIFF", 4) || memcmp(wave, "WAVE", 4)) {
+    log_crit("Not a WAV file");
+    throw FatalError::Decode;
+  }
+  // Chunks can come in any order. Stop at the sample data.
+  bool has_format = false;
+  for (;;) {
+    m_is->read(tag, 4);
+    uint32_t size = read_u32(*m_is);
+    if (!m_is->good()) {
+      log_crit("WAV file has no sample data");
+      throw FatalError::Decode;
+    }
+    std::streamoff next = m_is->tellg() + std::streamoff(size + (size & 1));
+    if (!memcmp(tag, "fmt ", 4)) {
+      uint16_t format = read_u16(*m_is);
+      m_channels = read_u16(*m_is);
+      m_rate = read_u32(*m_is);
+      m_is->seekg(6, std::ios::cur);
+      uint16_t bits = read_u16(*m_is);
+      if (format != 1 || bits != 16 || m_channels < 1 || 2 < m_channels) {
+        log_crit("Unsupported WAV format: %u, %u bits, %u channels", format,
+                 bits, m_channels);
+        throw FatalError::Decode;
+      }
+      has_format = true;
+    } else if (!memcmp(tag, "data", 4)) {
+      if (!has_format) {
+        log_crit("WAV sample data comes before the format");
+        throw FatalError::Decode;
+      }
+      m_begin = m_is->tellg();
+      m_frames = size / (2 * m_channels);
+      return;
+    }
+    m_is->seekg(next, std::ios::beg);
+  }
+}
+
+size_t WavDecoder::read(float *out, size_t num) {
+  num = std::min(num, m_frames - m_pos);
+  m_buffer.resize(num * m_channels);
+  m_is->clear();
+  m_is->seekg(m_begin + std::streamoff(m_pos * 2 * m_channels), std::ios::beg);
+  m_is->read(reinterpret_cast<char *>(m_buffer.data()), num * 2 * m_channels);
+  if (size_t(m_is->gcount()) != num * 2 * m_channels) {
+    log_crit("WAV file is truncated");
+    throw FatalError::Decode;
+  }
+  for (size_t i = 0; i < num; i++) {
+    for (unsigned c = 0; c < 2; c++) {
+      uint16_t bits = m_buffer[i * m_channels + c % m_channels];
+      out[i * 2 + c] = int16_t(SDL_Swap16LE(bits)) * (1.0f / 32768);
+    }
+  }
+  m_pos += num;
+  return num;
+}
+
+class AudioMixer::Data {
+  struct Slot {
+    /// Who owns the slot: the caller when Free, then the decoding thread and
+    /// the mixer while Starting and Playing, then the decoding thread again.
+    enum State : uint8_t { Free, Starting, Playing, Finished };
+
+    std::atomic<uint8_t> state = Free;
+    std::atomic<bool> end = false;  ///< The decoder has written its last frame.
+    std::atomic<bool> stop = false; ///< The caller wants the sound to stop.
+    std::atomic<float> left = 0, right = 0;
+    SampleRing ring{ring_samples};
+    std::unique_ptr<WavDecoder> decoder;
+    bool loop = false;
+    uint32_t generation = 0; ///< Only used by the caller.
+  };
+
+  unsigned m_rate;
+  std::unique_ptr<Slot[]> m_slots;
+  std::atomic<uint64_t> m_underruns = 0;
+  float m_scratch[block_frames * 2];
+  float m_out[block_frames * 2];
+  SDL_AudioStream *m_device = nullptr;
+
+  std::mutex m_lock;
+  std::condition_variable m_wake;
+  bool m_quit = false;
+  std::thread m_thread;
+
+public:
+  explicit Data(unsigned rate)
+      : m_rate(rate), m_slots(std::make_unique<Slot[]>(max_voices)),
+        m_thread([this]() { main(); }) {}
+
+  ~Data() {
+    if (m_device)
+      SDL_DestroyAudioStream(m_device);
+    {
+      std::lock_guard<std::mutex> guard(m_lock);
+      m_quit = true;
+    }
+    m_wake.notify_one();
+    m_thread.join();
+  }
+
+  unsigned rate() const { return m_rate; }
+
+  void open_device() {
+    SDL_AudioSpec spec = {SDL_AUDIO_F32, 2, int(m_rate)};
+    m_device = SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK,
+                                         &spec, callback, this);
+    if (!m_device || !SDL_ResumeAudioStreamDevice(m_device)) {
+      log_crit("SDL_OpenAudioDeviceStream: %s", SDL_GetError());
+      throw FatalError::Platform;
+    }
+  }
+
+  Voice play(std::unique_ptr<std::istream> is, float gain, float pan,
+             bool loop) {
+    auto decoder = std::make_unique<WavDecoder>(std::move(is));
+    if (decoder->rate() != m_rate) {
+      log_crit("Sound has %u frames per second instead of %u",
+               decoder->rate(), m_rate);
+      throw FatalError::Decode;
+    }
+    for (unsigned i = 0; i < max_voices; i++) {
+      Slot &s = m_slots[i];
+      if (s.state.load(std::memory_order_acquire) != Slot::Free)
+        continue;
+      s.decoder = std::move(decoder);
+      s.loop = loop;
+      s.end.store(false, std::memory_order_relaxed);
+      s.stop.store(false, std::memory_order_relaxed);
+      set_gain(s, gain, pan);
+      s.generation++;
+      s.state.store(Slot::Starting, std::memory_order_release);
+      m_wake.notify_one();
+      return s.generation * max_voices + i;
+    }
+    log_warn("All %u voices are in use", max_voices);
+    return 0;
+  }
+
+  Slot *find(Voice voice) const {
+    if (!voice)
+      return nullptr;
+    Slot &s = m_slots[voice % max_voices];
+    return s.generation == voice / max_voices ? &s : nullptr;
+  }
+
+  bool playing(Voice voice) const {
+    Slot *s = find(voice);
+    if (!s)
+      return false;
+    auto state = s->state.load(std::memory_order_acquire);
+    return state == Slot::Starting || state == Slot::Playing;
+  }
+
+  static void set_gain(Slot &s, float gain, float pan) {
+    // Constant power panning.
+    float angle = (std::clamp(pan, -1.0f, 1.0f) + 1) * 0.785398163f;
+    s.left.store(gain * std::cos(angle), std::memory_order_relaxed);
+    s.right.store(gain * std::sin(angle), std::memory_order_relaxed);
+  }
+
+  void mix(float *out, size_t num) {
+    std::fill(out, out + num * 2, 0.0f);
+    for (unsigned i = 0; i < max_voices; i++) {
+      Slot &s = m_slots[i];
+      if (s.state.load(std::memory_order_acquire) != Slot::Playing)
+        continue;
+      if (s.stop.load(std::memory_order_relaxed)) {
+        s.state.store(Slot::Finished, std::memory_order_release);
+        continue;
+      }
+      float left = s.left.load(std::memory_order_relaxed);
+      float right = s.right.load(std::memory_order_relaxed);
+      size_t done = 0;
+      while (done < num) {
+        size_t want = std::min(num - done, block_frames);
+        size_t got = s.ring.read(m_scratch, want * 2) / 2;
+        accumulate(out + done * 2, m_scratch, got, left, right);
+        done += got;
+        if (got < want)
+          break;
+      }
+      if (done < num) {
+        // Samples written before the end flag are visible once it's set.
+        if (s.end.load(std::memory_order_acquire) && !s.ring.available())
+          s.state.store(Slot::Finished, std::memory_order_release);
+        else
+          m_underruns.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  uint64_t underruns() const {
+    return m_underruns.load(std::memory_order_relaxed);
+  }
+
+private:
+  static void SDLCALL callback(void *userdata, SDL_AudioStream *stream,
+                               int additional, int total) {
+    (void)total;
+    auto *self = static_cast<Data *>(userdata);
+    const int frame_size = 2 * sizeof(float);
+    while (0 < additional) {
+      size_t num = std::min<size_t>((additional + frame_size - 1) / frame_size,
+                                    block_frames);
+      self->mix(self->m_out, num);
+      SDL_PutAudioStreamData(stream, self->m_out, num * frame_size);
+      additional -= num * frame_size;
+    }
+  }
+
+  /// Decoding thread.
+  void main() {
+    std::unique_lock<std::mutex> lock(m_lock);
+    while (!m_quit) {
+      lock.unlock();
+      for (unsigned i = 0; i < max_voices; i++) {
+        Slot &s = m_slots[i];
+        switch (s.state.load(std::memory_order_acquire)) {
+        case Slot::Starting:
+          fill(s);
+          s.state.store(Slot::Playing, std::memory_order_release);
+          break;
+        case Slot::Playing:
+          fill(s);
+          break;
+        case Slot::Finished:
+          s.decoder.reset();
+          s.ring.reset();
+          s.state.store(Slot::Free, std::memory_order_release);
+          break;
+        }
+      }
+      lock.lock();
+      // The mixer can't signal without blocking, so poll. A block of 1024
+      // frames lasts about 20 ms, and the rings hold several.
+      m_wake.wait_for(lock, std::chrono::milliseconds(5));
+    }
+  }
+
+  /// Decode into a voice's ring until it's full.
+  void fill(Slot &s) {
+    float buffer[block_frames * 2];
+    while (!s.end.load(std::memory_order_relaxed) &&
+           block_frames * 2 <= s.ring.space()) {
+      size_t num;
+      try {
+        num = s.decoder->read(buffer, block_frames);
+        if (num < block_frames && s.loop && s.decoder->frames()) {
+          s.decoder->rewind();
+          num += s.decoder->read(buffer + num * 2, block_frames - num);
+        }
+      } catch (FatalError) {
+        s.end.store(true, std::memory_order_release);
+        return;
+      }
+      s.ring.write(buffer, num * 2);
+      if (num < block_frames && !s.loop)
+        s.end.store(true, std::memory_order_release);
+    }
+  }
+};
+
+AudioMixer::AudioMixer(unsigned rate) : m_data(new Data(rate)) {}
+AudioMixer::~AudioMixer() = default;
+
+unsigned AudioMixer::rate() const { return m_data->rate(); }
+
+void AudioMixer::open_device() { m_data->open_device(); }
+
+AudioMixer::Voice AudioMixer::play(std::unique_ptr<std::istream> is,
+                                   float gain, float pan, bool loop) {
+  return m_data->play(std::move(is), gain, pan, loop);
+}
+
+void AudioMixer::set(Voice voice, float gain, float pan) {
+  if (auto *s = m_data->find(voice))
+    Data::set_gain(*s, gain, pan);
+}
+
+void AudioMixer::stop(Voice voice) {
+  if (auto *s = m_data->find(voice))
+    s->stop.store(true, std::memory_order_relaxed);
+}
+
+bool AudioMixer::playing(Voice voice) const {
+  return m_data->playing(voice);
+}
+
+void AudioMixer::mix(float *out, size_t num) { m_data->mix(out, num); }
+
+uint64_t AudioMixer::underruns() const { return m_data->underruns(); }
@@ -0,0 +1,176 @@
+/**
+ * \file
+ * \brief Stream and mix sounds.
+ */
+
+#ifndef AUDIO_HPP
+#define AUDIO_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <vector>
+
+/**
+ * \brief Lock-free ring buffer of samples with one reader and one writer.
+ *
+ * The reader and the writer can be different threads. Neither side blocks or
+ * allocates.
+ */
+class SampleRing {
+  std::unique_ptr<float[]> m_data;
+  size_t m_mask;
+  // Counters only increase. Keep them apart so the two sides don't fight over
+  // a cache line.
+  alignas(64) std::atomic<size_t> m_head = 0; ///< Total samples written.
+  alignas(64) std::atomic<size_t> m_tail = 0; ///< Total samples read.
+
+public:
+  /// Create a ring that holds at least the given number of samples.
+  explicit SampleRing(size_t capacity);
+
+  /// Get the number of samples that fit in the ring.
+  size_t capacity() const { return m_mask + 1; }
+
+  /// Get the number of samples that can be read.
+  size_t available() const;
+
+  /// Get the number of samples that can be written.
+  size_t space() const;
+
+  /// Write as many samples as fit and return the number written.
+  size_t write(const float *src, size_t num);
+
+  /// Read as many samples as are available, up to num, and return the number.
+  size_t read(float *dst, size_t num);
+
+  /// Discard all samples. Neither side may be using the ring.
+  void reset();
+};
+
+/**
+ * \brief Decode a PCM WAV file a piece at a time.
+ *
+ * Only 16-bit mono and stereo files are supported. Output is always stereo.
+ */
+class WavDecoder {
+  std::unique_ptr<std::istream> m_is;
+  std::streamoff m_begin; ///< Start of the sample data.
+  size_t m_frames;
+  size_t m_pos = 0;
+  unsigned m_channels;
+  unsigned m_rate;
+  std::vector<int16_t> m_buffer;
+
+public:
+  /**
+   * \brief Read the file header.
+   * \param is WAV file
+   * \throw FatalError::Decode if the file is invalid or unsupported
+   */
+  explicit WavDecoder(std::unique_ptr<std::istream> is);
+
+  /// Get the number of frames per second.
+  unsigned rate() const { return m_rate; }
+
+  /// Get the number of channels in the file.
+  unsigned channels() const { return m_channels; }
+
+  /// Get the total number of frames.
+  size_t frames() const { return m_frames; }
+
+  /**
+   * \brief Decode the next frames.
+   * \param[out] out interleaved stereo samples (2 * num floats)
+   * \param num maximum number of frames
+   * \return number of frames decoded, which is less than num at the end
+   * \throw FatalError::Decode if the file can't be read
+   */
+  size_t read(float *out, size_t num);
+
+  /// Go back to the first frame.
+  void rewind() { m_pos = 0; }
+};
+
+/**
+ * \brief Play streaming sounds on the default audio device.
+ *
+ * A background thread decodes each playing sound into its own SampleRing a
+ * few thousand frames ahead. The mixer reads the rings, applies gain and pan
+ * with SSE, and adds the voices together. Mixing never blocks or allocates,
+ * so it's safe on the audio device thread. If a ring runs dry before its sound
+ * ends, the rest of the block is silent and the underrun is counted.
+ *
+ * Sounds must use the mixer's sample rate. Output is 32-bit float stereo.
+ */
+class AudioMixer {
+  class Data;
+  std::unique_ptr<Data> m_data;
+
+public:
+  /// Maximum number of sounds that can play at once.
+  static constexpr unsigned max_voices = 32;
+
+  /// Identifies a playing sound. IDs are not reused.
+  using Voice = uint32_t;
+
+  /**
+   * \brief Start the decoding thread. Doesn't open an audio device.
+   * \param rate output frames per second
+   */
+  explicit AudioMixer(unsigned rate = 48000);
+
+  /// Close the device and stop the decoding thread.
+  ~AudioMixer();
+
+  /// Get the number of frames per second.
+  unsigned rate() const;
+
+  /**
+   * \brief Start playing on the default audio device.
+   *
+   * The SDL audio subsystem must be initialized. Don't call mix() afterwards.
+   *
+   * \throw FatalError::Platform if the device can't be opened
+   */
+  void open_device();
+
+  /**
+   * \brief Start playing a sound.
+   * \param is WAV file, e.g. from AssetSystem::open()
+   * \param gain volume multiplier
+   * \param pan -1 is left, 0 is center and 1 is right
+   * \param loop restart at the end instead of stopping
+   * \return the new voice, or 0 if all voices are in use
+   * \throw FatalError::Decode if the file is invalid or has the wrong rate
+   */
+  Voice play(std::unique_ptr<std::istream> is, float gain = 1, float pan = 0,
+             bool loop = false);
+
+  /// Change the gain and pan of a sound. Does nothing if it has ended.
+  void set(Voice voice, float gain, float pan);
+
+  /// Stop a sound. Does nothing if it has ended.
+  void stop(Voice voice);
+
+  /// Check if a sound is still playing.
+  bool playing(Voice voice) const;
+
+  /**
+   * \brief Mix the next block of output.
+   *
+   * This is what the audio device calls. It's public for tests and offline
+   * rendering.
+   *
+   * \param[out] out interleaved stereo samples (2 * num floats)
+   * \param num number of frames
+   */
+  void mix(float *out, size_t num);
+
+  /// Get the number of times a voice ran out of decoded samples.
+  uint64_t underruns() const;
+};
+
+#endif
@@ -0,0 +1,374 @@
+#include "cache.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cinttypes>
+#include <cstring>
+#include <fstream>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <SDL3/SDL_filesystem.h>
+#include <SDL3/SDL_stdinc.h>
+
+#include "serial.hpp"
+#include "util.hpp"
+#include "version.hpp"
+
+namespace {
+
+constexpr uint32_t entry_magic = 0x31434744; // "DGC1"
+constexpr uint32_t index_magic = 0x49434744; // "DGCI"
+constexpr uint32_t image_magic = 0x31494744; // "DGI1"
+
+/// Entries start with this, then the key and the data aligned to 16 bytes.
+struct EntryHeader {
+  uint32_t magic;
+  uint32_t key_size;
+  uint64_t data_size;
+};
+
+/// A converted image, followed by its rows of pixels.
+struct ImageHeader {
+  uint32_t magic;
+  uint8_t kind; ///< ImageType
+  uint8_t pad[3];
+  uint32_t width;
+  uint32_t height;
+};
+
+static_assert(sizeof(EntryHeader) == 16 && sizeof(ImageHeader) == 16);
+
+size_t data_offset(size_t key_size) {
+  return (sizeof(EntryHeader) + key_size + 15) & ~size_t(15);
+}
+
+/// Get the full key of an entry, which is stored in it to rule out
+/// collisions.
+std::string key_text(const DerivedKey &key) {
+  ByteWriter out;
+  out.put(key.stamp.size);
+  out.put(key.stamp.check);
+  out.string(key.source);
+  out.string(key.params);
+  out.string(DGENRS_VERSION);
+  return std::string(reinterpret_cast<const char *>(out.data()), out.size());
+}
+
+uint64_t hash(std::string_view text) {
+  uint64_t h = 0xcbf29ce484222325; // FNV-1a
+  for (char c : text)
+    h = (h ^ uint8_t(c)) * 0x100000001b3;
+  // Mix the result so that the file names spread out (MurmurHash3 fmix64).
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccd;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53;
+  h ^= h >> 33;
+  return h;
+}
+
+/// Parse the name of an entry file, which is its hash in hex.
+bool parse_name(const char *name, uint64_t &hash) {
+  if (strlen(name) != 20 || strcmp(name + 16, ".bin"))
+    return false;
+  hash = 0;
+  for (int i = 0; i < 16; i++) {
+    char c = name[i];
+    int digit = '0' <= c && c <= '9'   ? c - '0'
+                : 'a' <= c && c <= 'f' ? c - 'a' + 10
+                                       : -1;
+    if (digit < 0)
+      return false;
+    hash = hash << 4 | digit;
+  }
+  return true;
+}
+
+/// Write a file under a temporary name, to be moved into place when it's
+/// complete.
+bool write_file(const std::string &path, const ByteWriter &head,
+                const void *data, size_t size) {
+  std::ofstream out(path, std::ios::binary);
+  out.write(reinterpret_cast<const char *>(head.data()), head.size());
+  out.write(static_cast<const char *>(data), size);
+  out.close();
+  if (!out.good()) {
+    log_warn("Can't write cache file: %s", path.c_str());
+    SDL_RemovePath(path.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool rename_file(const std::string &from, const std::string &to) {
+  if (!SDL_RenamePath(from.c_str(), to.c_str())) {
+    log_warn("SDL_RenamePath: %s", SDL_GetError());
+    SDL_RemovePath(from.c_str());
+    return false;
+  }
+  return true;
+}
+
+/// Check a cached image and get its pixels.
+ConstImageView view_file(const AssetMapping &file) {
+  ImageHeader header;
+  if (file.size() < sizeof header) {
+    log_crit("Cached image is too small");
+    throw FatalError::Decode;
+  }
+  memcpy(&header, file.data(), sizeof header);
+  auto kind = ImageType(header.kind);
+  if (header.magic != image_magic || ImageType::RGBA < kind) {
+    log_crit("Invalid cached image header");
+    throw FatalError::Decode;
+  }
+  uint64_t stride = uint64_t(header.width) * bytes_per_pixel(kind);
+  if (file.size() != sizeof header + stride * header.height) {
+    log_crit("Wrong size for cached image");
+    throw FatalError::Decode;
+  }
+  return ConstImageView(kind, header.width, header.height, unsigned(stride),
+                        file.data() + sizeof header);
+}
+
+} // namespace
+
+DerivedCache::DerivedCache(const char *path, uint64_t capacity)
+    : m_path(path), m_capacity(capacity) {
+  if (!SDL_CreateDirectory(path)) {
+    log_crit("SDL_CreateDirectory: %s", SDL_GetError());
+    throw FatalError::Platform;
+  }
+
+  struct Scan {
+    std::vector<std::string> stale;                   ///< Unfinished files.
+    std::vector<std::pair<uint64_t, uint64_t>> found; ///< Hash and size.
+  } scan;
+  auto visit = [](void *p, const char *dir, const char *name) {
+    Scan &scan = *static_cast<Scan *>(p);
+    std::string full = std::string(dir) + name;
+    size_t length = strlen(name);
+    uint64_t hash;
+    SDL_PathInfo info;
+    if (4 < length && !strcmp(name + length - 4, ".tmp"))
+      scan.stale.push_back(full);
+    else if (parse_name(name, hash) && SDL_GetPathInfo(full.c_str(), &info))
+      scan.found.emplace_back(hash, info.size);
+    return SDL_ENUM_CONTINUE;
+  };
+  if (!SDL_EnumerateDirectory(path, visit, &scan)) {
+    log_crit("SDL_EnumerateDirectory: %s", SDL_GetError());
+    throw FatalError::Platform;
+  }
+  for (const std::string &name : scan.stale)
+    SDL_RemovePath(name.c_str());
+  for (auto [hash, size] : scan.found) {
+    m_entries.emplace(hash, Entry{size, 0});
+    m_size += size;
+  }
+
+  // Read the order of use. Entries missing from the index come first, so
+  // they're evicted first.
+  std::vector<std::pair<uint64_t, uint64_t>> order; // Time of use and hash.
+  std::ifstream is(m_path + "/index.bin", std::ios::binary);
+  if (is.good()) {
+    try {
+      size_t num;
+      std::unique_ptr<uint8_t[]> data = read_stream(num, is);
+      ByteReader in(data.get(), num);
+      if (in.get<uint32_t>() != index_magic)
+        throw FatalError::Decode;
+      for (uint32_t n = in.get<uint32_t>(); n; n--) {
+        uint64_t hash = in.get<uint64_t>();
+        uint64_t used = in.get<uint64_t>();
+        order.emplace_back(used, hash);
+      }
+    } catch (FatalError) {
+      log_warn("Invalid cache index: %s", path);
+      order.clear();
+    }
+  }
+  std::sort(order.begin(), order.end());
+  std::unordered_set<uint64_t> indexed;
+  for (auto [used, hash] : order)
+    indexed.insert(hash);
+  for (auto &[hash, entry] : m_entries)
+    if (!indexed.count(hash))
+      touch(hash);
+  for (auto [used, hash] : order)
+    if (m_entries.count(hash))
+      touch(hash);
+  log_info("Cache %s has %zu entries, %" PRIu64 " bytes", path,
+           m_entries.size(), m_size);
+}
+
+DerivedCache::~DerivedCache() { flush(); }
+
+bool DerivedCache::find(const DerivedKey &key, AssetMapping &out) {
+  std::string text = key_text(key);
+  uint64_t h = hash(text);
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (!m_entries.count(h))
+      return false;
+  }
+  std::string path = file_name(h);
+  // Remove invalid entries, so they don't take space or hide a valid one.
+  auto invalid = [&]() {
+    log_warn("Invalid cache file: %s", path.c_str());
+    std::lock_guard<std::mutex> guard(m_lock);
+    remove(h);
+    return false;
+  };
+
+  // Check the stored key, in case another key has the same hash.
+  std::ifstream is(path, std::ios::binary);
+  EntryHeader header;
+  is.read(reinterpret_cast<char *>(&header), sizeof header);
+  if (!is.good() || header.magic != entry_magic ||
+      header.key_size != text.size())
+    return invalid();
+  std::string stored(text.size(), '\0');
+  is.read(stored.data(), stored.size());
+  if (!is.good() || stored != text)
+    return invalid();
+  size_t offset = data_offset(text.size());
+  is.seekg(0, std::ios::end);
+  if (uint64_t(is.tellg()) != offset + header.data_size)
+    return invalid();
+  if (!out.map(path.c_str(), offset, header.data_size)) {
+    auto data = std::make_unique<uint8_t[]>(header.data_size);
+    is.seekg(offset, std::ios::beg);
+    is.read(reinterpret_cast<char *>(data.get()), header.data_size);
+    if (!is.good())
+      return invalid();
+    out = AssetMapping(std::move(data), header.data_size);
+  }
+
+  std::lock_guard<std::mutex> guard(m_lock);
+  if (m_entries.count(h))
+    touch(h);
+  return true;
+}
+
+void DerivedCache::store(const DerivedKey &key, const void *data,
+                         size_t size) {
+  std::string text = key_text(key);
+  uint64_t h = hash(text);
+  ByteWriter head;
+  head.put(EntryHeader{entry_magic, uint32_t(text.size()), size});
+  head.write(text.data(), text.size());
+  size_t pad = data_offset(text.size()) - head.size();
+  memset(head.grow(pad), 0, pad);
+  std::string path = file_name(h);
+
+  // Files are written under a unique name, so that they can be written
+  // without holding the lock.
+  std::string temporary;
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    temporary = path + "." + std::to_string(m_temporary++) + ".tmp";
+  }
+  if (!write_file(temporary, head, data, size))
+    return;
+  std::lock_guard<std::mutex> guard(m_lock);
+  if (!rename_file(temporary, path))
+    return;
+  uint64_t file_size = head.size() + size;
+  auto [it, added] = m_entries.emplace(h, Entry{file_size, 0});
+  if (!added) {
+    m_size -= it->second.size;
+    it->second.size = file_size;
+  }
+  m_size += file_size;
+  touch(h);
+
+  while (m_capacity < m_size && m_order.begin()->second != h)
+    remove(m_order.begin()->second);
+}
+
+uint64_t DerivedCache::size() const {
+  std::lock_guard<std::mutex> guard(m_lock);
+  return m_size;
+}
+
+void DerivedCache::flush() {
+  ByteWriter out;
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    out.put(index_magic);
+    out.put(uint32_t(m_order.size()));
+    for (auto [used, hash] : m_order) {
+      out.put(hash);
+      out.put(used);
+    }
+  }
+  std::string path = m_path + "/index.bin";
+  if (write_file(path + ".tmp", out, nullptr, 0))
+    rename_file(path + ".tmp", path);
+}
+
+std::string DerivedCache::touch(uint64_t hash) {
+  Entry &e = m_entries.at(hash);
+  if (e.used)
+    m_order.erase(e.used);
+  e.used = ++m_clock;
+  m_order.emplace(e.used, hash);
+  return file_name(hash);
+}
+
+void DerivedCache::remove(uint64_t hash) {
+  auto it = m_entries.find(hash);
+  if (it == m_entries.end())
+    return;
+  std::string path = file_name(hash);
+  if (!SDL_RemovePath(path.c_str()))
+    log_warn("SDL_RemovePath: %s", SDL_GetError());
+  m_size -= it->second.size;
+  if (it->second.used)
+    m_order.erase(it->second.used);
+  m_entries.erase(it);
+}
+
+std::string DerivedCache::file_name(uint64_t hash) const {
+  char name[24];
+  SDL_snprintf(name, sizeof name, "/%016" PRIx64 ".bin", hash);
+  return m_path + name;
+}
+
+CachedImage::CachedImage(AssetMapping file)
+    : m_file(std::move(file)), m_view(view_file(m_file)) {}
+
+CachedImage::CachedImage(Image image)
+    : m_image(std::move(image)), m_view(m_image) {}
+
+CachedImage load_image(AssetSystem &assets, DerivedCache &cache,
+                       const char *key, std::string_view params,
+                       const std::function<Image(Image)> &convert) {
+  DerivedKey derived = {key, {}, params};
+  if (!assets.stamp(key, derived.stamp)) {
+    log_crit("Asset file not found: %s", key);
+    throw FatalError::Decode;
+  }
+  AssetMapping file;
+  if (cache.find(derived, file)) {
+    try {
+      return CachedImage(std::move(file));
+    } catch (FatalError) {
+      log_warn("Converting %s again", key);
+    }
+  }
+
+  Image image = convert(Image::read(*assets.open(key)));
+  ByteWriter out;
+  ImageHeader header = {image_magic, uint8_t(image.kind()), {},
+                        image.width(), image.height()};
+  out.put(header);
+  size_t row = size_t(image.width()) * bytes_per_pixel(image.kind());
+  for (unsigned y = 0; row && y < image.height(); y++)
+    out.write(image.pixel(0, y), row);
+  cache.store(derived, out.data(), out.size());
+  return CachedImage(std::move(image));
+}
@@ -0,0 +1,137 @@
+/**
+ * \file
+ * \brief Keep data made from asset files between runs.
+ */
+
+#ifndef CACHE_HPP
+#define CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "asset.hpp"
+#include "image.hpp"
+
+/// Identifies data made from an asset file.
+struct DerivedKey {
+  std::string_view source; ///< Asset file name.
+  AssetStamp stamp;        ///< Version of the asset file.
+  /// Describes how the data was made from the file, such as the parameters
+  /// of an image conversion.
+  std::string_view params;
+};
+
+/**
+ * \brief A directory of data made from asset files, such as converted
+ * textures, so it can be loaded instead of made again.
+ *
+ * Entries are identified by a DerivedKey and by DGENRS_VERSION, so they're
+ * made again when the asset file changes or a new build might make them
+ * differently. They're stored in the form they're used, and found entries are
+ * mapped into memory where the platform allows it.
+ *
+ * When the total size goes over the capacity, the least recently used entries
+ * are deleted. The order of use is saved in the directory by flush() and by
+ * the destructor. Entries left out of the index, such as after a crash, are
+ * kept but treated as the oldest.
+ *
+ * The cache may be used from several threads. Only one DerivedCache should
+ * use a directory at a time.
+ */
+class DerivedCache {
+  struct Entry {
+    uint64_t size; ///< File size.
+    uint64_t used; ///< Time of last use, from m_clock.
+  };
+
+  std::string m_path;
+  uint64_t m_capacity;
+  mutable std::mutex m_lock;
+  std::unordered_map<uint64_t, Entry> m_entries; ///< By hash of the key.
+  std::map<uint64_t, uint64_t> m_order;          ///< Time of use to hash.
+  uint64_t m_clock = 0;
+  uint64_t m_size = 0;      ///< Total size of the entries.
+  uint64_t m_temporary = 0; ///< For unique names of files being written.
+
+public:
+  /**
+   * \brief Open a cache directory, creating it if it doesn't exist.
+   * \param path directory path
+   * \param capacity total size to keep, in bytes
+   * \throw FatalError::Platform if the directory can't be created or read
+   */
+  DerivedCache(const char *path, uint64_t capacity);
+  DerivedCache(const DerivedCache &other) = delete;
+  DerivedCache &operator=(const DerivedCache &other) = delete;
+
+  /// Save the order of use.
+  ~DerivedCache();
+
+  /**
+   * \brief Look up an entry.
+   * \param out the entry's contents, aligned to 16 bytes
+   * \return false if there's no entry, or it can't be read (and is removed)
+   */
+  bool find(const DerivedKey &key, AssetMapping &out);
+
+  /**
+   * \brief Add or replace an entry.
+   *
+   * Errors are logged and otherwise ignored, since the data can be made
+   * again.
+   */
+  void store(const DerivedKey &key, const void *data, size_t size);
+
+  /// Get the total size of the entries.
+  uint64_t size() const;
+
+  /// Save the order of use, so the next run evicts the same entries.
+  void flush();
+
+private:
+  /// Mark an entry used, and get its file name.
+  std::string touch(uint64_t hash);
+  void remove(uint64_t hash);
+  std::string file_name(uint64_t hash) const;
+};
+
+/// An image loaded by load_image(), either from the cache or made again.
+class CachedImage {
+  AssetMapping m_file;
+  Image m_image;
+  ConstImageView m_view;
+
+public:
+  /**
+   * \brief Use an image stored by load_image().
+   * \throw FatalError::Decode if the file is invalid
+   */
+  explicit CachedImage(AssetMapping file);
+  explicit CachedImage(Image image);
+  CachedImage(CachedImage &&other) = default;
+  CachedImage &operator=(CachedImage &&other) = default;
+
+  /// Get the pixels.
+  ConstImageView view() const { return m_view; }
+};
+
+/**
+ * \brief Load a PNG or JPEG asset file and convert it, or get the result of
+ * doing so from the cache.
+ *
+ * \param key asset file name
+ * \param params identifies the conversion
+ * \param convert changes the decoded image, such as to premultiply alpha
+ * \throw FatalError::Decode if the file is missing or can't be decoded
+ */
+CachedImage load_image(AssetSystem &assets, DerivedCache &cache,
+                       const char *key, std::string_view params,
+                       const std::function<Image(Image)> &convert);
+
+#endif
@@ -0,0 +1,446 @@
+#include "data.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <memory>
+
+#include "json.hpp"
+#include "util.hpp"
+
+namespace {
+
+using Kind = DataSchema::Kind;
+
+uint32_t read32(const uint8_t *p) {
+  uint32_t x;
+  memcpy(&x, p, sizeof x);
+  return x;
+}
+
+[[noreturn]] void corrupt(const char *what) {
+  log_crit("Invalid data file: %s", what);
+  throw FatalError::Decode;
+}
+
+/// Call a function with a zero of the C++ type of a number or bool kind.
+template <typename F> void with_type(Kind kind, F f) {
+  switch (kind) {
+  case Kind::Bool:
+    return f(bool());
+  case Kind::Int8:
+    return f(int8_t());
+  case Kind::UInt8:
+    return f(uint8_t());
+  case Kind::Int16:
+    return f(int16_t());
+  case Kind::UInt16:
+    return f(uint16_t());
+  case Kind::Int32:
+    return f(int32_t());
+  case Kind::UInt32:
+    return f(uint32_t());
+  case Kind::Int64:
+    return f(int64_t());
+  case Kind::UInt64:
+    return f(uint64_t());
+  case Kind::Float:
+    return f(float());
+  case Kind::Double:
+    return f(double());
+  case Kind::String:
+  case Kind::Table:
+    break;
+  }
+  assert(false);
+}
+
+/// Convert a JSON value to a number or bool type, checking the range.
+template <typename T> T number(JsonValue value) {
+  if constexpr (std::is_same_v<T, bool>) {
+    return value.as_bool();
+  } else if constexpr (std::is_floating_point_v<T>) {
+    return T(value.as_number());
+  } else {
+    // JSON numbers are read as int64_t, so that's the limit for uint64_t.
+    int64_t x = value.as_int();
+    using limits = std::numeric_limits<T>;
+    if (x < int64_t(limits::min()) ||
+        (sizeof(T) < 8 && int64_t(limits::max()) < x)) {
+      log_crit("Number out of range: %lld", static_cast<long long>(x));
+      throw FatalError::Decode;
+    }
+    return T(x);
+  }
+}
+
+const std::pair<const char *, Kind> kind_names[] = {
+    {"bool", Kind::Bool},     {"int8", Kind::Int8},
+    {"uint8", Kind::UInt8},   {"int16", Kind::Int16},
+    {"uint16", Kind::UInt16}, {"int32", Kind::Int32},
+    {"uint32", Kind::UInt32}, {"int64", Kind::Int64},
+    {"uint64", Kind::UInt64}, {"float", Kind::Float},
+    {"double", Kind::Double}, {"string", Kind::String},
+};
+
+} // namespace
+
+DataTable DataTable::root(const void *data, size_t size, uint32_t schema) {
+  auto base = static_cast<const uint8_t *>(data);
+  if (reinterpret_cast<uintptr_t>(base) % 8) {
+    log_crit("Data file is not aligned");
+    throw FatalError::Decode;
+  }
+  DataHeader header;
+  if (size < sizeof header) {
+    log_crit("Data file is truncated");
+    throw FatalError::Decode;
+  }
+  memcpy(&header, base, sizeof header);
+  if (header.magic != data_magic) {
+    log_crit("Not a data file");
+    throw FatalError::Decode;
+  }
+  if (header.schema != schema) {
+    log_crit("Data file has schema %u, expected %u", unsigned(header.schema),
+             unsigned(schema));
+    throw FatalError::Decode;
+  }
+  if (size < header.size || header.size < sizeof header) {
+    log_crit("Data file is truncated");
+    throw FatalError::Decode;
+  }
+  return DataTable(base, header.size, header.root);
+}
+
+DataTable::DataTable(const uint8_t *base, uint32_t size, uint32_t offset)
+    : m_base(base), m_size(size), m_offset(offset) {
+  if (size < 4 || size - 4 < offset)
+    corrupt("table out of bounds");
+  uint32_t vtable = read32(base + offset);
+  if (size < 4 || size - 4 < vtable)
+    corrupt("vtable out of bounds");
+  memcpy(&m_fields, base + vtable, 2);
+  memcpy(&m_table_size, base + vtable + 2, 2);
+  if ((size - vtable - 4) / 2 < m_fields || m_table_size < 4 ||
+      size - offset < m_table_size)
+    corrupt("invalid vtable");
+  m_vtable = base + vtable + 4;
+}
+
+std::string_view DataTable::string(unsigned field) const {
+  uint32_t r = reference(field);
+  return r ? string_at(m_base, m_size, r) : std::string_view();
+}
+
+DataTable DataTable::table(unsigned field) const {
+  uint32_t r = reference(field);
+  return r ? DataTable(m_base, m_size, r) : DataTable();
+}
+
+DataList DataTable::list(unsigned field) const {
+  uint32_t count;
+  const uint8_t *p = elements(field, sizeof(uint32_t), count);
+  return {m_base, m_size, p, count};
+}
+
+const uint8_t *DataTable::locate(unsigned field, size_t size) const {
+  uint16_t off = offset(field);
+  if (!off)
+    return nullptr;
+  if (m_table_size < off + size)
+    corrupt("field out of bounds");
+  return m_base + m_offset + off;
+}
+
+uint32_t DataTable::reference(unsigned field) const {
+  const uint8_t *p = locate(field, sizeof(uint32_t));
+  if (!p)
+    return 0;
+  uint32_t r = read32(p);
+  if (!r || m_size <= r)
+    corrupt("reference out of bounds");
+  return r;
+}
+
+const uint8_t *DataTable::elements(unsigned field, size_t size,
+                                   uint32_t &count) const {
+  count = 0;
+  uint32_t r = reference(field);
+  if (!r)
+    return nullptr;
+  if (m_size - r < 4)
+    corrupt("array out of bounds");
+  count = read32(m_base + r);
+  size_t start = (size_t(r) + 4 + 7) & ~size_t(7);
+  if (m_size < start || (m_size - start) / size < count)
+    corrupt("array out of bounds");
+  return m_base + start;
+}
+
+std::string_view DataTable::string_at(const uint8_t *base, uint32_t size,
+                                      uint32_t offset) {
+  if (size - offset < 4)
+    corrupt("string out of bounds");
+  uint32_t length = read32(base + offset);
+  // The length doesn't include the null character after the string.
+  if (size - offset - 4 <= length)
+    corrupt("string out of bounds");
+  return {reinterpret_cast<const char *>(base + offset + 4), length};
+}
+
+std::string_view DataList::string(size_t i) const {
+  return DataTable::string_at(m_base, m_size, item(i));
+}
+
+DataTable DataList::table(size_t i) const {
+  return DataTable(m_base, m_size, item(i));
+}
+
+uint32_t DataList::item(size_t i) const {
+  assert(i < m_count);
+  uint32_t r = read32(m_items + 4 * i);
+  if (!r || m_size <= r)
+    corrupt("reference out of bounds");
+  return r;
+}
+
+DataBuilder::DataBuilder() { reset(); }
+
+uint32_t DataBuilder::string(std::string_view s) {
+  uint32_t offset = align(4);
+  m_out.put(uint32_t(s.size()));
+  m_out.write(s.data(), s.size());
+  m_out.put('\0');
+  return offset;
+}
+
+void DataBuilder::begin() {
+  assert(!m_open);
+  m_open = true;
+  m_fields.clear();
+}
+
+uint32_t DataBuilder::end() {
+  assert(m_open);
+  m_open = false;
+  // Place larger fields first, so each is aligned to its size.
+  std::stable_sort(
+      m_fields.begin(), m_fields.end(),
+      [](const Field &a, const Field &b) { return a.size > b.size; });
+  size_t count = 0;
+  for (const Field &f : m_fields)
+    count = std::max<size_t>(count, f.index + 1);
+  std::vector<uint16_t> vtable(2 + count);
+  size_t size = sizeof(uint32_t);
+  for (const Field &f : m_fields) {
+    size = (size + f.size - 1) / f.size * f.size;
+    vtable[2 + f.index] = size;
+    size += f.size;
+  }
+  if (0xffff < size) {
+    log_crit("Data table is too large: %zu bytes", size);
+    throw FatalError::Encode;
+  }
+  vtable[0] = count;
+  vtable[1] = size;
+
+  std::string key(reinterpret_cast<const char *>(vtable.data()),
+                  vtable.size() * 2);
+  auto it = m_vtables.find(key);
+  if (it == m_vtables.end()) {
+    it = m_vtables.emplace(std::move(key), align(4)).first;
+    m_out.write(it->first.data(), it->first.size());
+  }
+  uint32_t table = align(8);
+  uint8_t *p = m_out.grow(size);
+  memset(p, 0, size);
+  memcpy(p, &it->second, sizeof(uint32_t));
+  for (const Field &f : m_fields)
+    memcpy(p + vtable[2 + f.index], f.value, f.size);
+  return table;
+}
+
+ByteWriter DataBuilder::finish(uint32_t schema, uint32_t root) {
+  assert(!m_open);
+  if (std::numeric_limits<uint32_t>::max() < m_out.size()) {
+    log_crit("Data file is too large: %zu bytes", m_out.size());
+    throw FatalError::Encode;
+  }
+  DataHeader header = {data_magic, schema, uint32_t(m_out.size()), root};
+  ByteWriter file;
+  file.reserve(m_out.size());
+  file.put(header);
+  file.write(m_out.data() + sizeof header, m_out.size() - sizeof header);
+  reset();
+  return file;
+}
+
+uint32_t DataBuilder::write_array(const void *p, size_t num, size_t size) {
+  // The count goes 4 bytes before a multiple of 8, where the elements start.
+  uint32_t offset = align(4);
+  if (offset % 8 == 0) {
+    m_out.put(uint32_t(0));
+    offset += 4;
+  }
+  m_out.put(uint32_t(num));
+  m_out.write(p, num * size);
+  return offset;
+}
+
+void DataBuilder::add_bytes(unsigned field, const void *p, size_t size) {
+  assert(m_open && field < 0xfffe);
+  Field f = {uint16_t(field), uint16_t(size), {}};
+  memcpy(f.value, p, size);
+  m_fields.push_back(f);
+}
+
+void DataBuilder::reset() {
+  m_out.clear();
+  m_vtables.clear();
+  // Leave room for the header.
+  memset(m_out.grow(sizeof(DataHeader)), 0, sizeof(DataHeader));
+}
+
+uint32_t DataBuilder::align(size_t alignment) {
+  size_t n = (alignment - m_out.size() % alignment) % alignment;
+  if (n)
+    memset(m_out.grow(n), 0, n);
+  return m_out.size();
+}
+
+DataSchema DataSchema::parse(JsonValue description) {
+  DataSchema schema;
+  schema.m_id = number<uint32_t>(description["id"]);
+
+  // Collect the names first, so fields can refer to tables listed later.
+  std::unordered_map<std::string_view, uint32_t> names;
+  JsonValue tables = description["tables"];
+  for (auto [name, fields] : tables.members()) {
+    if (!names.emplace(name, schema.m_tables.size()).second) {
+      log_crit("Duplicate data table %.*s", int(name.size()), name.data());
+      throw FatalError::Decode;
+    }
+    schema.m_tables.push_back({std::string(name), {}});
+  }
+
+  for (auto [name, fields] : tables.members()) {
+    Table &table = schema.m_tables[names[name]];
+    for (auto [field, type] : fields.members()) {
+      Field f = {std::string(field), Kind::Table, false, 0};
+      std::string_view t = type.as_string();
+      if (2 < t.size() && t.front() == '[' && t.back() == ']') {
+        f.array = true;
+        t = t.substr(1, t.size() - 2);
+      }
+      auto kind = std::find_if(
+          std::begin(kind_names), std::end(kind_names),
+          [t](const std::pair<const char *, Kind> &k) { return t == k.first; });
+      auto other = names.find(t);
+      if (kind != std::end(kind_names)) {
+        f.kind = kind->second;
+      } else if (other != names.end()) {
+        f.table = other->second;
+      } else {
+        log_crit("Unknown type %.*s of %s.%s", int(t.size()), t.data(),
+                 table.name.c_str(), f.name.c_str());
+        throw FatalError::Decode;
+      }
+      table.fields.push_back(std::move(f));
+    }
+  }
+
+  std::string_view root = description["root"].as_string();
+  auto it = names.find(root);
+  if (it == names.end()) {
+    log_crit("Unknown root table %.*s", int(root.size()), root.data());
+    throw FatalError::Decode;
+  }
+  schema.m_root = it->second;
+  return schema;
+}
+
+ByteWriter DataSchema::compile(JsonValue value) const {
+  DataBuilder out;
+  uint32_t root = compile_table(m_root, value, out);
+  return out.finish(m_id, root);
+}
+
+uint32_t DataSchema::compile_table(uint32_t index, JsonValue value,
+                                   DataBuilder &out) const {
+  const Table &table = m_tables[index];
+  for (auto [name, member] : value.members()) {
+    auto same = [name = name](const Field &f) { return f.name == name; };
+    if (std::none_of(table.fields.begin(), table.fields.end(), same)) {
+      log_crit("%s has no field %.*s", table.name.c_str(), int(name.size()),
+               name.data());
+      throw FatalError::Decode;
+    }
+  }
+
+  // Write what the table refers to before the table itself. Null is the same
+  // as leaving a field out.
+  std::vector<JsonValue> values(table.fields.size());
+  std::vector<bool> present(table.fields.size());
+  std::vector<uint32_t> references(table.fields.size());
+  for (size_t i = 0; i < table.fields.size(); i++) {
+    const Field &f = table.fields[i];
+    present[i] = value.find(f.name, values[i]) && !values[i].is_null();
+    if (!present[i])
+      continue;
+    try {
+      if (f.array)
+        references[i] = compile_array(f, values[i], out);
+      else if (f.kind == Kind::String)
+        references[i] = out.string(values[i].as_string());
+      else if (f.kind == Kind::Table)
+        references[i] = compile_table(f.table, values[i], out);
+    } catch (FatalError) {
+      log_crit("In %s.%s", table.name.c_str(), f.name.c_str());
+      throw;
+    }
+  }
+
+  out.begin();
+  for (size_t i = 0; i < table.fields.size(); i++) {
+    const Field &f = table.fields[i];
+    if (references[i]) {
+      out.add_reference(i, references[i]);
+    } else if (present[i]) {
+      try {
+        with_type(f.kind, [&](auto zero) {
+          out.add(i, number<decltype(zero)>(values[i]));
+        });
+      } catch (FatalError) {
+        log_crit("In %s.%s", table.name.c_str(), f.name.c_str());
+        throw;
+      }
+    }
+  }
+  return out.end();
+}
+
+uint32_t DataSchema::compile_array(const Field &field, JsonValue value,
+                                   DataBuilder &out) const {
+  size_t num = value.size();
+  if (field.kind == Kind::String || field.kind == Kind::Table) {
+    std::vector<uint32_t> items;
+    items.reserve(num);
+    for (JsonValue item : value.items()) {
+      items.push_back(field.kind == Kind::String
+                          ? out.string(item.as_string())
+                          : compile_table(field.table, item, out));
+    }
+    return out.list(items.data(), items.size());
+  }
+  uint32_t offset = 0;
+  with_type(field.kind, [&](auto zero) {
+    using T = decltype(zero);
+    auto items = std::make_unique<T[]>(num);
+    size_t i = 0;
+    for (JsonValue item : value.items())
+      items[i++] = number<T>(item);
+    offset = out.array(items.get(), num);
+  });
+  return offset;
+}
@@ -0,0 +1,325 @@
+/**
+ * \file
+ * \brief Compiled data files that are read in place.
+ *
+ * Data tables are compiled ahead of time, usually from JSON with a
+ * DataSchema by the compile-data tool, into a binary file that the game reads
+ * without a parse step. Loading one is AssetSystem::map() and
+ * DataTable::root(), which only checks the header. Fields are then read
+ * straight from the mapped file.
+ *
+ * The file starts with a DataHeader. Everything else is tables, vtables,
+ * strings and arrays, referred to by their offset from the start of the file:
+ *
+ * - A table starts with the offset of its vtable, followed by its fields.
+ *   Tables are aligned to 8 bytes, and so are fields of 8 bytes.
+ * - A vtable has the number of fields, the size of the table, and the offset
+ *   of each field in the table, or 0 if the field is missing. Tables with the
+ *   same layout share a vtable.
+ * - A string has a 32-bit length, then the bytes and a null character.
+ * - An array has a 32-bit count, then elements that start at a multiple of
+ *   8 bytes. Arrays of strings or tables hold 32-bit offsets.
+ *
+ * Fields are identified by their index in the table, and missing fields read
+ * as a default. New fields can be added at the end of a table without
+ * breaking old files or old code. Values are little-endian, like the rest of
+ * serial.hpp.
+ *
+ * Offsets are checked against the size of the file as they are followed, so
+ * a corrupt file throws FatalError::Decode instead of reading out of bounds.
+ */
+
+#ifndef DATA_HPP
+#define DATA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "serial.hpp"
+
+class JsonValue;
+
+/// Identifies a compiled data file.
+constexpr uint32_t data_magic = 0x31444744; // "DGD1"
+
+/// The start of a compiled data file.
+struct DataHeader {
+  uint32_t magic;  ///< data_magic
+  uint32_t schema; ///< Identifies the layout, chosen by the application.
+  uint32_t size;   ///< Size of the file in bytes.
+  uint32_t root;   ///< Offset of the root table.
+};
+
+class DataList;
+
+/**
+ * \brief A table in a compiled data file.
+ *
+ * A default-constructed table has no fields.
+ */
+class DataTable {
+  const uint8_t *m_base = nullptr; ///< Start of the file.
+  uint32_t m_size = 0;             ///< Size of the file.
+  uint32_t m_offset = 0;
+  const uint8_t *m_vtable = nullptr; ///< Field offsets.
+  uint16_t m_fields = 0;             ///< Number of fields in the vtable.
+  uint16_t m_table_size = 0;
+
+public:
+  DataTable() = default;
+
+  /**
+   * \brief Check the header of a compiled data file and get its root table.
+   *
+   * The data must stay valid as long as the tables read from it.
+   *
+   * \param data file contents, aligned to 8 bytes like AssetMapping
+   * \param size file size
+   * \param schema expected DataHeader::schema
+   * \throw FatalError::Decode if the header doesn't match
+   */
+  static DataTable root(const void *data, size_t size, uint32_t schema);
+
+  /// Check if a field is present.
+  bool has(unsigned field) const { return offset(field); }
+
+  /// Read a number or bool field, or get a default if it's missing.
+  template <typename T> T get(unsigned field, T fallback = T()) const {
+    static_assert(std::is_arithmetic_v<T>);
+    const uint8_t *p = locate(field, sizeof(T));
+    if (!p)
+      return fallback;
+    T value;
+    memcpy(&value, p, sizeof value);
+    return value;
+  }
+
+  /// Read a string field, or get an empty string if it's missing.
+  std::string_view string(unsigned field) const;
+
+  /// Read a table field, or get an empty table if it's missing.
+  DataTable table(unsigned field) const;
+
+  /// Read an array of numbers in place, or get an empty array.
+  template <typename T> ArrayView<T> array(unsigned field) const {
+    static_assert(std::is_arithmetic_v<T>);
+    uint32_t count;
+    const uint8_t *p = elements(field, sizeof(T), count);
+    return {reinterpret_cast<const T *>(p), count};
+  }
+
+  /// Read an array of strings or tables, or get an empty list.
+  DataList list(unsigned field) const;
+
+private:
+  friend class DataList;
+
+  DataTable(const uint8_t *base, uint32_t size, uint32_t offset);
+
+  /// Get the offset of a field in the table, or 0 if it's missing.
+  uint16_t offset(unsigned field) const {
+    if (field >= m_fields)
+      return 0;
+    uint16_t off;
+    memcpy(&off, m_vtable + 2 * field, 2);
+    return off;
+  }
+
+  /// Get a field of some size, or null if it's missing.
+  const uint8_t *locate(unsigned field, size_t size) const;
+
+  /// Follow a reference field, or get 0 if it's missing.
+  uint32_t reference(unsigned field) const;
+
+  /// Check an array and get its elements.
+  const uint8_t *elements(unsigned field, size_t size, uint32_t &count) const;
+
+  static std::string_view string_at(const uint8_t *base, uint32_t size,
+                                    uint32_t offset);
+};
+
+/// An array of strings or tables in a compiled data file.
+class DataList {
+  const uint8_t *m_base = nullptr;
+  uint32_t m_size = 0;
+  const uint8_t *m_items = nullptr;
+  uint32_t m_count = 0;
+
+public:
+  DataList() = default;
+  DataList(const uint8_t *base, uint32_t size, const uint8_t *items,
+           uint32_t count)
+      : m_base(base), m_size(size), m_items(items), m_count(count) {}
+
+  size_t size() const { return m_count; }
+
+  /// Get an element that is a string.
+  std::string_view string(size_t i) const;
+
+  /// Get an element that is a table.
+  DataTable table(size_t i) const;
+
+private:
+  uint32_t item(size_t i) const;
+};
+
+/**
+ * \brief Write a compiled data file.
+ *
+ * Strings, arrays and tables are written first, and return their offsets for
+ * the tables that refer to them. A table's fields are added between begin()
+ * and end(), so anything the table refers to must be written before begin().
+ */
+class DataBuilder {
+  /// A field of the open table.
+  struct Field {
+    uint16_t index;
+    uint16_t size;
+    uint8_t value[8];
+  };
+
+  ByteWriter m_out;
+  std::vector<Field> m_fields;
+  std::unordered_map<std::string, uint32_t> m_vtables; ///< Bytes to offset.
+  bool m_open = false;
+
+public:
+  DataBuilder();
+
+  /// Write a string.
+  uint32_t string(std::string_view s);
+
+  /// Write an array of numbers.
+  template <typename T> uint32_t array(const T *p, size_t num) {
+    static_assert(std::is_arithmetic_v<T>);
+    return write_array(p, num, sizeof(T));
+  }
+
+  /// Write an array of strings or tables, given their offsets.
+  uint32_t list(const uint32_t *p, size_t num) {
+    return write_array(p, num, sizeof(uint32_t));
+  }
+
+  /// Start a table.
+  void begin();
+
+  /// Add a number or bool field to the open table.
+  template <typename T> void add(unsigned field, T value) {
+    static_assert(std::is_arithmetic_v<T> && sizeof(T) <= 8);
+    add_bytes(field, &value, sizeof value);
+  }
+
+  /// Add a string, array or table field to the open table.
+  void add_reference(unsigned field, uint32_t offset) {
+    add_bytes(field, &offset, sizeof offset);
+  }
+
+  /// Finish the open table and get its offset.
+  uint32_t end();
+
+  /**
+   * \brief Write the header and take the file.
+   * \param schema identifies the layout for DataTable::root()
+   * \param root offset of the root table
+   * \throw FatalError::Encode if the file is 4 GiB or more
+   */
+  ByteWriter finish(uint32_t schema, uint32_t root);
+
+private:
+  /// Start a new file.
+  void reset();
+  uint32_t write_array(const void *p, size_t num, size_t size);
+  void add_bytes(unsigned field, const void *p, size_t size);
+  /// Pad with zeros to a multiple of some alignment, and get the offset.
+  uint32_t align(size_t alignment);
+};
+
+/**
+ * \brief Table layouts for compiling JSON into data files.
+ *
+ * A schema is itself described in JSON:
+ *
+ *     {
+ *       "id": 1,
+ *       "root": "Level",
+ *       "tables": {
+ *         "Level": {"name": "string", "gravity": "float", "spawns": "[Spawn]"},
+ *         "Spawn": {"x": "int32", "y": "int32", "tags": "[string]"}
+ *       }
+ *     }
+ *
+ * Field types are bool, int8, uint8, int16, uint16, int32, uint32, int64,
+ * uint64, float, double, string, the name of a table, or an array of any of
+ * those in brackets. Fields are numbered in the order they're listed, which
+ * is the index to read them with, so new fields go at the end.
+ */
+class DataSchema {
+public:
+  enum class Kind : uint8_t {
+    Bool,
+    Int8,
+    UInt8,
+    Int16,
+    UInt16,
+    Int32,
+    UInt32,
+    Int64,
+    UInt64,
+    Float,
+    Double,
+    String,
+    Table,
+  };
+
+  struct Field {
+    std::string name;
+    Kind kind;
+    bool array;
+    uint32_t table; ///< Index of the table type, for Kind::Table.
+  };
+
+  struct Table {
+    std::string name;
+    std::vector<Field> fields;
+  };
+
+private:
+  uint32_t m_id = 0;
+  uint32_t m_root = 0;
+  std::vector<Table> m_tables;
+
+public:
+  /**
+   * \brief Read a schema description.
+   * \throw FatalError::Decode if the description is invalid
+   */
+  static DataSchema parse(JsonValue description);
+
+  uint32_t id() const { return m_id; }
+  const std::vector<Table> &tables() const { return m_tables; }
+
+  /**
+   * \brief Compile a JSON value of the root table type.
+   *
+   * Members that the table doesn't have are an error, so that typos don't go
+   * unnoticed. Missing members are left out and read as defaults.
+   *
+   * \return the file contents
+   * \throw FatalError::Decode if the value doesn't match the schema
+   */
+  ByteWriter compile(JsonValue value) const;
+
+private:
+  uint32_t compile_table(uint32_t table, JsonValue value,
+                         DataBuilder &out) const;
+  uint32_t compile_array(const Field &field, JsonValue value,
+                         DataBuilder &out) const;
+};
+
+#endif
@@ -0,0 +1,580 @@
+#include "font.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include <hb-aat.h>
+#include <hb-ft.h>
+#include <hb-ot.h>
+#include <hb.h>
+
+#include "util.hpp"
+
+namespace {
+
+/// Pixels between glyphs in the atlas, so that filtering doesn't bleed.
+constexpr unsigned padding = 1;
+
+/// Convert from 26.6 fixed point.
+float from_26_6(long x) { return x * (1.0f / 64); }
+
+/// Kerning for pairs that haven't been shaped yet.
+constexpr int16_t kern_unknown = std::numeric_limits<int16_t>::min();
+/// Kerning for pairs that can't be laid out without shaping.
+constexpr int16_t kern_complex = kern_unknown + 1;
+
+/// Index of characters that can't be laid out without shaping.
+constexpr uint8_t not_simple = 0xff;
+
+/// Features that HarfBuzz may apply to left-to-right text in the Latin or
+/// Common script, in any version.
+const hb_tag_t shaper_features[] = {
+    HB_TAG('a', 'b', 'v', 'm'), HB_TAG('b', 'l', 'w', 'm'),
+    HB_TAG('c', 'a', 'l', 't'), HB_TAG('c', 'c', 'm', 'p'),
+    HB_TAG('c', 'l', 'i', 'g'), HB_TAG('c', 'u', 'r', 's'),
+    HB_TAG('d', 'i', 's', 't'), HB_TAG('k', 'e', 'r', 'n'),
+    HB_TAG('l', 'i', 'g', 'a'), HB_TAG('l', 'o', 'c', 'l'),
+    HB_TAG('l', 't', 'r', 'a'), HB_TAG('l', 't', 'r', 'm'),
+    HB_TAG('m', 'a', 'r', 'k'), HB_TAG('m', 'k', 'm', 'k'),
+    HB_TAG('r', 'a', 'n', 'd'), HB_TAG('r', 'c', 'l', 't'),
+    HB_TAG('r', 'l', 'i', 'g'), HB_TAG('r', 'v', 'r', 'n'),
+    HB_TAG('t', 'r', 'a', 'k'), HB_TAG('H', 'a', 'r', 'f'),
+    HB_TAG('H', 'A', 'R', 'F'), HB_TAG('B', 'u', 'z', 'z'),
+    HB_TAG('B', 'U', 'Z', 'Z'), HB_TAG_NONE,
+};
+
+/// Encode a character below U+0100 as UTF-8.
+int encode_latin1(uint32_t c, char *out) {
+  if (c < 0x80) {
+    out[0] = char(c);
+    return 1;
+  }
+  out[0] = char(0xc0 | c >> 6);
+  out[1] = char(0x80 | (c & 0x3f));
+  return 2;
+}
+
+/// A font table, read as big-endian values.
+class Table {
+  hb_blob_t *m_blob;
+  const uint8_t *m_data;
+  unsigned m_size;
+
+public:
+  bool valid = true; ///< Cleared by reading past the end.
+
+  Table(hb_face_t *face, hb_tag_t tag)
+      : m_blob(hb_face_reference_table(face, tag)) {
+    m_data = reinterpret_cast<const uint8_t *>(
+        hb_blob_get_data(m_blob, &m_size));
+  }
+  ~Table() { hb_blob_destroy(m_blob); }
+  Table(const Table &other) = delete;
+  Table &operator=(const Table &other) = delete;
+
+  /// Get the size, which is 0 if the font doesn't have the table.
+  unsigned size() const { return m_size; }
+
+  uint32_t u16(uint64_t offset) {
+    if (m_size < offset + 2) {
+      valid = false;
+      return 0;
+    }
+    return uint32_t(m_data[offset]) << 8 | m_data[offset + 1];
+  }
+
+  uint32_t u32(uint64_t offset) { return u16(offset) << 16 | u16(offset + 2); }
+};
+
+/// Add the glyphs of an OpenType coverage table to a set.
+void add_coverage(Table &table, uint64_t offset, hb_set_t *glyphs) {
+  unsigned format = table.u16(offset);
+  if (format != 1 && format != 2) {
+    table.valid = false;
+    return;
+  }
+  unsigned count = table.u16(offset + 2);
+  for (unsigned i = 0; i < count && table.valid; i++) {
+    if (format == 1) {
+      hb_set_add(glyphs, table.u16(offset + 4 + 2 * i));
+    } else {
+      uint64_t range = offset + 4 + 6 * i;
+      hb_set_add_range(glyphs, table.u16(range), table.u16(range + 2));
+    }
+  }
+}
+
+/// Check that a kern table only has horizontal kerning between pairs of
+/// glyphs, or that there isn't one.
+bool pair_kerning(hb_face_t *face) {
+  Table kern(face, HB_TAG('k', 'e', 'r', 'n'));
+  if (!kern.size())
+    return true;
+  // Apple's version of the table starts with a 32-bit version number.
+  if (kern.u16(0) != 0)
+    return false;
+  uint64_t offset = 4;
+  for (unsigned n = kern.u16(2); n && kern.valid; n--) {
+    // Formats 0 and 2 are pair kerning. The low bits flag horizontal
+    // kerning, and then minimum, cross-stream and override values.
+    unsigned coverage = kern.u16(offset + 4);
+    unsigned format = coverage >> 8;
+    if ((format != 0 && format != 2) || (coverage & 0xff) != 1)
+      return false;
+    // The length of a large last subtable may have overflowed.
+    if (1 < n)
+      offset += kern.u16(offset + 2);
+  }
+  return kern.valid;
+}
+
+/**
+ * \brief Find the glyphs that GPOS lookups may move in ways that a table of
+ * advances and pair kerning can't reproduce.
+ *
+ * Single adjustments are included in the advances. Pair adjustments are
+ * included in the kerning, unless they skip glyphs or move the second glyph
+ * of a pair, which stops it being kerned with the glyph after it. Mark
+ * attachment only moves the marks. Anything else may move any of its glyphs.
+ *
+ * \return false if the table is invalid
+ */
+bool scan_gpos(hb_face_t *face, const hb_set_t *lookups, hb_set_t *moved) {
+  Table gpos(face, HB_OT_TAG_GPOS);
+  if (!gpos.size())
+    return true;
+  uint64_t list = gpos.u16(8);
+  hb_codepoint_t index = HB_SET_VALUE_INVALID;
+  while (gpos.valid && hb_set_next(lookups, &index)) {
+    uint64_t lookup = list + gpos.u16(list + 2 + 2 * uint64_t(index));
+    unsigned type = gpos.u16(lookup);
+    bool ignore_base = gpos.u16(lookup + 2) & 2;
+    bool other = false;
+    for (unsigned i = 0, n = gpos.u16(lookup + 4); i < n; i++) {
+      uint64_t subtable = lookup + gpos.u16(lookup + 6 + 2 * i);
+      unsigned subtype = type;
+      if (type == 9) { // Extension
+        subtype = gpos.u16(subtable + 2);
+        subtable += gpos.u32(subtable + 4);
+      }
+      if (subtype == 2) // valueFormat2 is after the coverage and valueFormat1.
+        other |= ignore_base || gpos.u16(subtable + 6);
+      else if (4 <= subtype && subtype <= 6)
+        add_coverage(gpos, subtable + gpos.u16(subtable + 2), moved);
+      else if (subtype != 1)
+        other = true;
+    }
+    if (other)
+      hb_ot_layout_lookup_collect_glyphs(face, HB_OT_TAG_GPOS, index, nullptr,
+                                         moved, nullptr, nullptr);
+  }
+  return gpos.valid;
+}
+
+} // namespace
+
+class Font::Data {
+public:
+  std::unique_ptr<uint8_t[]> file;
+  FT_Library library = nullptr;
+  FT_Face face = nullptr;
+  hb_font_t *hb_font = nullptr;
+  hb_buffer_t *buffer = nullptr;
+
+  Image atlas;
+  uint64_t version = 0;
+  /// Free space starts at (shelf_x, shelf_y) on a row of height shelf_h.
+  unsigned shelf_x = 0, shelf_y = 0, shelf_h = 0;
+  std::unordered_map<uint32_t, Glyph> glyphs;
+  std::vector<Placement> placements; ///< Scratch space for measure().
+
+  /// A character that can be laid out without shaping.
+  struct SimpleChar {
+    uint32_t glyph;
+    hb_position_t advance;
+    uint8_t index; ///< Row and column in the kerning tables, or not_simple.
+    bool latin;    ///< In the Latin script, rather than Common.
+  };
+
+  enum class FastPath : uint8_t { Unknown, Ready, Off };
+  FastPath fast_path = FastPath::Unknown;
+  SimpleChar simple[256];  ///< By character, from U+0000 to U+00FF.
+  unsigned num_simple = 0; ///< Number of simple characters.
+  /// Kerning between pairs of simple characters, filled in as they're used,
+  /// for text without and with Latin letters.
+  std::vector<int16_t> kerning[2];
+  std::vector<uint8_t> run; ///< Scratch space for lay_out_simple().
+
+  Data(std::unique_ptr<uint8_t[]> f, size_t num, unsigned size,
+       unsigned atlas_size)
+      : file(std::move(f)), atlas(ImageType::Luminance, atlas_size,
+                                  atlas_size) {
+    if (FT_Error err = FT_Init_FreeType(&library)) {
+      log_crit("FT_Init_FreeType: error %d", err);
+      throw FatalError::Platform;
+    }
+    try {
+      if (FT_Error err = FT_New_Memory_Face(library, file.get(), num, 0,
+                                            &face)) {
+        log_crit("FT_New_Memory_Face: error %d", err);
+        throw FatalError::Decode;
+      }
+      if (FT_Error err = FT_Set_Pixel_Sizes(face, 0, size)) {
+        log_crit("FT_Set_Pixel_Sizes: error %d", err);
+        throw FatalError::Decode;
+      }
+    } catch (FatalError) {
+      if (face)
+        FT_Done_Face(face);
+      FT_Done_FreeType(library);
+      throw;
+    }
+    hb_font = hb_ft_font_create_referenced(face);
+    buffer = hb_buffer_create();
+    for (unsigned y = 0; y < atlas_size; y++)
+      memset(atlas.pixel(0, y), 0, atlas_size);
+    for (unsigned y = 0; y < 2; y++)
+      memset(atlas.pixel(0, y), 255, 2);
+    shelf_x = 2 + padding;
+    shelf_h = 2;
+  }
+
+  ~Data() {
+    hb_buffer_destroy(buffer);
+    hb_font_destroy(hb_font);
+    FT_Done_Face(face);
+    FT_Done_FreeType(library);
+  }
+
+  Data(const Data &other) = delete;
+  Data &operator=(const Data &other) = delete;
+
+  /// Rasterize a glyph and copy it into the atlas.
+  Glyph rasterize(uint32_t index) {
+    if (FT_Error err = FT_Load_Glyph(face, index, FT_LOAD_RENDER)) {
+      log_warn("FT_Load_Glyph: error %d", err);
+      return {0, 0, 0, 0, 0, 0};
+    }
+    const FT_GlyphSlot slot = face->glyph;
+    const FT_Bitmap &bitmap = slot->bitmap;
+    Glyph g = {0, 0, uint16_t(bitmap.width), uint16_t(bitmap.rows),
+               int16_t(slot->bitmap_left), int16_t(slot->bitmap_top)};
+    if (!g.w || !g.h)
+      return g;
+    if (atlas.width() < shelf_x + g.w) {
+      shelf_x = 0;
+      shelf_y += shelf_h + padding;
+      shelf_h = 0;
+    }
+    if (atlas.width() < g.w || atlas.height() < shelf_y + g.h) {
+      log_crit("Glyph atlas is full");
+      throw FatalError::ResourceLimit;
+    }
+    g.x = shelf_x;
+    g.y = shelf_y;
+    shelf_x += g.w + padding;
+    shelf_h = std::max<unsigned>(shelf_h, g.h);
+    for (unsigned y = 0; y < g.h; y++)
+      memcpy(atlas.pixel(g.x, g.y + y), bitmap.buffer + y * bitmap.pitch,
+             g.w);
+    version++;
+    return g;
+  }
+
+  /// Shape text with the properties hb_buffer_guess_segment_properties()
+  /// gives simple text, in the Latin script or with no script.
+  void shape_simple(const char *text, int size, bool latin) {
+    hb_buffer_clear_contents(buffer);
+    hb_buffer_add_utf8(buffer, text, size, 0, size);
+    hb_buffer_set_direction(buffer, HB_DIRECTION_LTR);
+    hb_buffer_set_script(buffer, latin ? HB_SCRIPT_LATIN : HB_SCRIPT_INVALID);
+    hb_buffer_set_language(buffer, hb_language_get_default());
+    hb_shape(hb_font, buffer, nullptr, 0);
+  }
+
+  /**
+   * \brief Check whether a character can be laid out without shaping.
+   *
+   * It must shape on its own into one glyph, with the same advance whether
+   * or not the text is Latin, and the glyph mustn't be changed by shaping.
+   *
+   * \param excluded glyphs that GSUB or GPOS may change
+   */
+  bool find_simple(uint32_t c, const hb_set_t *excluded, SimpleChar &out) {
+    hb_unicode_funcs_t *funcs = hb_unicode_funcs_get_default();
+    hb_script_t script = hb_unicode_script(funcs, c);
+    switch (hb_unicode_general_category(funcs, c)) {
+    case HB_UNICODE_GENERAL_CATEGORY_CONTROL:
+    case HB_UNICODE_GENERAL_CATEGORY_FORMAT:
+    case HB_UNICODE_GENERAL_CATEGORY_UNASSIGNED:
+    case HB_UNICODE_GENERAL_CATEGORY_SPACING_MARK:
+    case HB_UNICODE_GENERAL_CATEGORY_ENCLOSING_MARK:
+    case HB_UNICODE_GENERAL_CATEGORY_NON_SPACING_MARK:
+    case HB_UNICODE_GENERAL_CATEGORY_LINE_SEPARATOR:
+    case HB_UNICODE_GENERAL_CATEGORY_PARAGRAPH_SEPARATOR:
+      return false;
+    default:
+      break;
+    }
+    if (script != HB_SCRIPT_LATIN && script != HB_SCRIPT_COMMON)
+      return false;
+    char text[2];
+    int size = encode_latin1(c, text);
+    for (bool latin : {false, true}) {
+      shape_simple(text, size, latin);
+      unsigned num;
+      const hb_glyph_info_t *info = hb_buffer_get_glyph_infos(buffer, &num);
+      const hb_glyph_position_t *pos =
+          hb_buffer_get_glyph_positions(buffer, &num);
+      if (num != 1 || pos->x_offset || pos->y_offset || pos->y_advance)
+        return false;
+      if (!latin)
+        out = {info->codepoint, pos->x_advance, 0,
+               script == HB_SCRIPT_LATIN};
+      else if (info->codepoint != out.glyph || pos->x_advance != out.advance)
+        return false;
+    }
+    hb_ot_layout_glyph_class_t kind =
+        hb_ot_layout_get_glyph_class(hb_font_get_face(hb_font), out.glyph);
+    return !hb_set_has(excluded, out.glyph) &&
+           (kind == HB_OT_LAYOUT_GLYPH_CLASS_UNCLASSIFIED ||
+            kind == HB_OT_LAYOUT_GLYPH_CLASS_BASE_GLYPH);
+  }
+
+  /// Work out which characters can be laid out without shaping.
+  void prepare_simple() {
+    fast_path = FastPath::Off;
+    hb_face_t *hb_face = hb_font_get_face(hb_font);
+    if (hb_aat_layout_has_substitution(hb_face) ||
+        hb_aat_layout_has_positioning(hb_face) ||
+        hb_aat_layout_has_tracking(hb_face) || !pair_kerning(hb_face))
+      return;
+
+    // Glyphs that may be substituted, and glyphs that may be moved other
+    // than by kerning, are left to HarfBuzz.
+    hb_set_t *lookups = hb_set_create();
+    hb_set_t *excluded = hb_set_create();
+    hb_ot_layout_collect_lookups(hb_face, HB_OT_TAG_GSUB, nullptr, nullptr,
+                                 shaper_features, lookups);
+    hb_codepoint_t index = HB_SET_VALUE_INVALID;
+    while (hb_set_next(lookups, &index))
+      hb_ot_layout_lookup_collect_glyphs(hb_face, HB_OT_TAG_GSUB, index,
+                                         nullptr, excluded, nullptr, nullptr);
+    hb_set_clear(lookups);
+    hb_ot_layout_collect_lookups(hb_face, HB_OT_TAG_GPOS, nullptr, nullptr,
+                                 shaper_features, lookups);
+    bool valid = scan_gpos(hb_face, lookups, excluded);
+    for (uint32_t c = 0; c < 256; c++) {
+      SimpleChar &s = simple[c];
+      if (valid && num_simple < not_simple && find_simple(c, excluded, s))
+        s.index = uint8_t(num_simple++);
+      else
+        s.index = not_simple;
+    }
+    hb_set_destroy(excluded);
+    hb_set_destroy(lookups);
+    if (!valid) {
+      log_warn("Invalid GPOS table, shaping all text");
+      return;
+    }
+    for (std::vector<int16_t> &table : kerning)
+      table.assign(num_simple * num_simple, kern_unknown);
+    fast_path = FastPath::Ready;
+  }
+
+  /**
+   * \brief Get the kerning between two simple characters by shaping them.
+   *
+   * HarfBuzz splits kerning from kern tables between the first glyph's
+   * advance and the second glyph's advance and offset. That puts every glyph
+   * where it would be if the first advance had all of it, so the kerning
+   * table only needs the total.
+   *
+   * \return kern_complex if the pair shapes into other glyphs, or the second
+   * glyph moves apart from the rest of the line
+   */
+  int16_t shape_pair(uint32_t a, uint32_t b, bool latin) {
+    char text[4];
+    int first = encode_latin1(a, text);
+    shape_simple(text, first + encode_latin1(b, text + first), latin);
+    unsigned num;
+    const hb_glyph_info_t *info = hb_buffer_get_glyph_infos(buffer, &num);
+    const hb_glyph_position_t *pos =
+        hb_buffer_get_glyph_positions(buffer, &num);
+    const SimpleChar &sa = simple[a], &sb = simple[b];
+    if (num != 2 || info[0].codepoint != sa.glyph ||
+        info[1].codepoint != sb.glyph || info[1].cluster != unsigned(first) ||
+        pos[0].x_offset || pos[0].y_offset || pos[0].y_advance ||
+        pos[1].y_offset || pos[1].y_advance ||
+        pos[1].x_advance - sb.advance != pos[1].x_offset)
+      return kern_complex;
+    hb_position_t kern = pos[0].x_advance - sa.advance + pos[1].x_offset;
+    if (kern <= kern_complex || std::numeric_limits<int16_t>::max() < kern)
+      return kern_complex;
+    return int16_t(kern);
+  }
+
+  /**
+   * \brief Lay out a line from the tables of simple characters, if it only
+   * has simple characters.
+   *
+   * The result is the same as shaping it, in less time.
+   *
+   * \param[out] out glyph positions, or nullptr to only measure the line
+   * \param[out] width horizontal advance of the line
+   * \return false if the text needs shaping
+   */
+  bool lay_out_simple(std::string_view text, std::vector<Placement> *out,
+                      hb_position_t &width) {
+    if (fast_path == FastPath::Unknown)
+      prepare_simple();
+    if (fast_path == FastPath::Off)
+      return false;
+
+    // Decode the text, which is simple if it's ASCII and two-byte sequences
+    // for U+0080 to U+00FF, and has a script of Latin if any character does.
+    const auto *p = reinterpret_cast<const uint8_t *>(text.data());
+    size_t size = text.size();
+    run.clear();
+    bool latin = false;
+    for (size_t i = 0; i < size; i++) {
+      uint32_t c = p[i];
+      if (0x80 <= c) {
+        if ((c & 0xfe) != 0xc2 || i + 1 == size || (p[i + 1] & 0xc0) != 0x80)
+          return false;
+        c = (c & 0x1f) << 6 | (p[++i] & 0x3f);
+      }
+      if (simple[c].index == not_simple)
+        return false;
+      latin |= simple[c].latin;
+      run.push_back(uint8_t(c));
+    }
+
+    std::vector<int16_t> &kern = kerning[latin];
+    if (out)
+      out->resize(run.size());
+    // The same as shape_full() gives glyphs with no vertical offset.
+    const float y = -from_26_6(0);
+    hb_position_t x = 0;
+    uint32_t cluster = 0;
+    for (size_t i = 0; i < run.size(); i++) {
+      const SimpleChar &s = simple[run[i]];
+      if (i) {
+        uint8_t prev = run[i - 1];
+        int16_t &k = kern[simple[prev].index * num_simple + s.index];
+        if (k == kern_unknown)
+          k = shape_pair(prev, run[i], latin);
+        if (k == kern_complex)
+          return false;
+        x += k;
+      }
+      if (out)
+        (*out)[i] = {s.glyph, cluster, from_26_6(x), y};
+      cluster += run[i] < 0x80 ? 1 : 2;
+      x += s.advance;
+    }
+    width = x;
+    return true;
+  }
+};
+
+Font::Font(std::unique_ptr<uint8_t[]> file, size_t num, unsigned size,
+           unsigned atlas_size)
+    : m_data(new Data(std::move(file), num, size, atlas_size)) {}
+Font::Font(Font &&other) = default;
+Font &Font::operator=(Font &&other) = default;
+Font::~Font() = default;
+
+float Font::ascent() const {
+  return from_26_6(m_data->face->size->metrics.ascender);
+}
+
+float Font::descent() const {
+  return -from_26_6(m_data->face->size->metrics.descender);
+}
+
+float Font::line_height() const {
+  return from_26_6(m_data->face->size->metrics.height);
+}
+
+float Font::shape(std::string_view text, std::vector<Placement> &out) {
+  hb_position_t width;
+  if (m_data->lay_out_simple(text, &out, width))
+    return from_26_6(width);
+  return shape_full(text, out);
+}
+
+float Font::shape_full(std::string_view text, std::vector<Placement> &out) {
+  hb_buffer_t *buffer = m_data->buffer;
+  hb_buffer_clear_contents(buffer);
+  hb_buffer_add_utf8(buffer, text.data(), text.size(), 0, text.size());
+  hb_buffer_guess_segment_properties(buffer);
+  hb_shape(m_data->hb_font, buffer, nullptr, 0);
+  unsigned num;
+  const hb_glyph_info_t *info = hb_buffer_get_glyph_infos(buffer, &num);
+  const hb_glyph_position_t *pos =
+      hb_buffer_get_glyph_positions(buffer, &num);
+  out.resize(num);
+  hb_position_t x = 0, y = 0;
+  for (unsigned i = 0; i < num; i++) {
+    out[i] = {info[i].codepoint, info[i].cluster,
+              from_26_6(x + pos[i].x_offset),
+              -from_26_6(y + pos[i].y_offset)};
+    x += pos[i].x_advance;
+    y += pos[i].y_advance;
+  }
+  return from_26_6(x);
+}
+
+float Font::measure(std::string_view text) {
+  hb_position_t width;
+  if (m_data->lay_out_simple(text, nullptr, width))
+    return from_26_6(width);
+  return shape_full(text, m_data->placements);
+}
+
+const Font::Glyph &Font::glyph(uint32_t index) {
+  auto it = m_data->glyphs.find(index);
+  if (it == m_data->glyphs.end())
+    it = m_data->glyphs.emplace(index, m_data->rasterize(index)).first;
+  return it->second;
+}
+
+ConstImageView Font::atlas() const { return m_data->atlas; }
+
+uint64_t Font::atlas_version() const { return m_data->version; }
+
+void Font::draw(ImageView target, float x, float y, std::string_view text,
+                const uint8_t color[4]) {
+  assert(target.kind() == ImageType::RGBA);
+  std::vector<Placement> &placements = m_data->placements;
+  shape(text, placements);
+  for (const Placement &p : placements) {
+    const Glyph &g = glyph(p.glyph);
+    // Clip the glyph to the target.
+    long left = std::lround(x + p.x) + g.left;
+    long top = std::lround(y + p.y) - g.top;
+    long x0 = std::max(0l, -left), y0 = std::max(0l, -top);
+    long x1 = std::min<long>(g.w, long(target.width()) - left);
+    long y1 = std::min<long>(g.h, long(target.height()) - top);
+    if (x1 <= x0)
+      continue;
+    for (long gy = y0; gy < y1; gy++) {
+      const uint8_t *src = m_data->atlas.pixel(g.x, g.y + gy);
+      uint8_t *dst = target.pixel(left + x0, top + gy);
+      for (long gx = x0; gx < x1; gx++, dst += 4) {
+        unsigned a = div255(src[gx] * color[3]);
+        unsigned na = 255 - a;
+        for (int c = 0; c < 3; c++)
+          dst[c] = div255(color[c] * a + dst[c] * na);
+        dst[3] = div255(255 * a + dst[3] * na);
+      }
+    }
+  }
+}
@@ -0,0 +1,113 @@
+/**
+ * \file
+ * \brief Shape and rasterize text.
+ */
+
+#ifndef FONT_HPP
+#define FONT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "image.hpp"
+
+/**
+ * \brief A font face at one pixel size.
+ *
+ * Text is shaped with HarfBuzz and glyphs are rasterized with FreeType into a
+ * coverage atlas (a Luminance image) the first time they're used. The atlas
+ * can be uploaded as a texture to draw text as textured quads, or text can be
+ * drawn straight into an image with draw().
+ *
+ * The top left 2×2 pixels of the atlas are always opaque, so that solid
+ * rectangles can be drawn in the same batch as text.
+ *
+ * Most text is made of characters below U+0100 that shape into one glyph
+ * each, only kerned in pairs. Such text is laid out from tables of glyph
+ * advances and pair kerning instead of being shaped. The tables are filled
+ * in by shaping each character, and each pair the first time it's seen, so
+ * the result is the same as shaping. Characters whose glyphs the font
+ * substitutes or moves in other ways are always shaped.
+ */
+class Font {
+  class Data;
+  std::unique_ptr<Data> m_data;
+
+public:
+  /// A glyph's place in the atlas.
+  struct Glyph {
+    uint16_t x, y;     ///< Top left corner in the atlas.
+    uint16_t w, h;     ///< Size in pixels (0 for blank glyphs).
+    int16_t left, top; ///< Offset from the pen position (y is up).
+  };
+
+  /// A glyph positioned by shaping.
+  struct Placement {
+    uint32_t glyph;   ///< Glyph index in the font.
+    uint32_t cluster; ///< Byte offset of the character in the text.
+    float x, y;       ///< Pen position relative to the origin (y is down).
+  };
+
+  /**
+   * \brief Load a font file from memory.
+   * \param file contents of a TrueType or OpenType file
+   * \param num file size
+   * \param size height of the em square in pixels
+   * \param atlas_size width and height of the glyph atlas
+   * \throw FatalError::Decode if the font can't be loaded
+   */
+  Font(std::unique_ptr<uint8_t[]> file, size_t num, unsigned size,
+       unsigned atlas_size = 512);
+  Font(Font &&other);
+  Font &operator=(Font &&other);
+  ~Font();
+
+  /// Get the distance from the baseline to the top of the tallest glyphs.
+  float ascent() const;
+  /// Get the distance from the baseline to the bottom of the lowest glyphs.
+  float descent() const;
+  /// Get the distance between baselines.
+  float line_height() const;
+
+  /**
+   * \brief Lay out one line of text.
+   * \param text UTF-8 text
+   * \param[out] out glyph positions (replaced)
+   * \return horizontal advance of the whole line
+   */
+  float shape(std::string_view text, std::vector<Placement> &out);
+
+  /// Lay out one line of text with HarfBuzz, even if it's simple enough to
+  /// be laid out from tables. The result is the same as shape().
+  float shape_full(std::string_view text, std::vector<Placement> &out);
+
+  /// Get the horizontal advance of one line of text.
+  float measure(std::string_view text);
+
+  /**
+   * \brief Get a glyph's image, adding it to the atlas if needed.
+   * \throw FatalError::ResourceLimit if the atlas is full
+   */
+  const Glyph &glyph(uint32_t index);
+
+  /// Get the atlas of rasterized glyphs.
+  ConstImageView atlas() const;
+
+  /// Get a number that changes whenever glyphs are added to the atlas.
+  uint64_t atlas_version() const;
+
+  /**
+   * \brief Draw one line of text into an image.
+   * \param target RGBA image
+   * \param x, y position of the start of the baseline
+   * \param text UTF-8 text
+   * \param color straight-alpha RGBA color
+   */
+  void draw(ImageView target, float x, float y, std::string_view text,
+            const uint8_t color[4]);
+};
+
+#endif
@@ -1,10 +1,26 @@
 #include "image.hpp"
 
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
 #include <iterator>
+
+#include <jpeglib.h>
+#include <jerror.h>
 #include <png.h>
 
 #include "util.hpp"
 
+namespace {
+
+/// Largest width or height of a decoded image.
+const unsigned max_side = 65535;
+/// Largest size of a decoded image in bytes, at 4 bytes per pixel. Row
+/// offsets are unsigned.
+const uint64_t max_pixels_size = uint64_t(1) << 30;
+
+} // namespace
+
 unsigned bytes_per_pixel(ImageType kind) {
   const unsigned table[] = {1, 3, 4};
   auto ikind = static_cast<unsigned>(kind);
@@ -26,6 +42,14 @@ void libpng_on_warning(png_structp png, png_const_charp msg) {
   log_warn("%s", msg);
 }
 
+/// Check if a file's image is too large to decode, and log it if so.
+bool too_large(const char *format, unsigned w, unsigned h) {
+  if (w <= max_side && h <= max_side && uint64_t(w) * h * 4 <= max_pixels_size)
+    return false;
+  log_crit("%s image is too large: %u by %u", format, w, h);
+  return true;
+}
+
 /// Convert image_type enum to libpng bit depth and color type.
 void native_to_libpng(int &bit_depth, int &color_type, ImageType kind) {
   const struct {
@@ -96,6 +120,141 @@ ImageType libpng_to_native(png_structp png, png_infop info) {
   }
 }
 
+/// Error handling for libjpeg, which longjmp()s back to the decoder.
+struct JpegError {
+  jpeg_error_mgr mgr;
+  jmp_buf jump;
+};
+
+void libjpeg_on_error(j_common_ptr jpeg) {
+  char message[JMSG_LENGTH_MAX];
+  jpeg->err->format_message(jpeg, message);
+  log_crit("%s", message);
+  longjmp(reinterpret_cast<JpegError *>(jpeg->err)->jump, 1);
+}
+
+void libjpeg_on_message(j_common_ptr jpeg, int level) {
+  // Only warnings (level -1) are worth logging. Others are trace messages.
+  if (level < 0) {
+    char message[JMSG_LENGTH_MAX];
+    jpeg->err->format_message(jpeg, message);
+    log_warn("%s", message);
+  }
+}
+
+/// Feed libjpeg from a stream.
+struct JpegSource {
+  jpeg_source_mgr mgr;
+  std::istream *is;
+  JOCTET buffer[4096];
+};
+
+boolean libjpeg_fill(j_decompress_ptr jpeg) {
+  auto src = reinterpret_cast<JpegSource *>(jpeg->src);
+  src->is->read(reinterpret_cast<char *>(src->buffer), sizeof src->buffer);
+  size_t num = src->is->gcount();
+  if (!num) {
+    // Insert an end of image marker, so truncated files decode as far as
+    // they go (with a warning) instead of failing.
+    WARNMS(jpeg, JWRN_JPEG_EOF);
+    src->buffer[0] = 0xff;
+    src->buffer[1] = JPEG_EOI;
+    num = 2;
+  }
+  src->mgr.next_input_byte = src->buffer;
+  src->mgr.bytes_in_buffer = num;
+  return TRUE;
+}
+
+void libjpeg_skip(j_decompress_ptr jpeg, long num) {
+  auto src = reinterpret_cast<JpegSource *>(jpeg->src);
+  while (num > long(src->mgr.bytes_in_buffer)) {
+    num -= long(src->mgr.bytes_in_buffer);
+    libjpeg_fill(jpeg);
+  }
+  if (0 < num) {
+    src->mgr.next_input_byte += num;
+    src->mgr.bytes_in_buffer -= num;
+  }
+}
+
+/// Choose where to decode a JPEG, given its scaled size.
+using JpegTarget = ImageView (*)(void *context, bool gray, unsigned w,
+                                 unsigned h);
+
+/// Decode a JPEG file, converting to the type of the target.
+ImageView read_jpeg(std::istream &is, unsigned scale, JpegTarget target,
+                    void *context) {
+  assert(scale == 1 || scale == 2 || scale == 4 || scale == 8);
+  jpeg_decompress_struct jpeg;
+  JpegError error;
+  JpegSource src;
+  jpeg.err = jpeg_std_error(&error.mgr);
+  error.mgr.error_exit = libjpeg_on_error;
+  error.mgr.emit_message = libjpeg_on_message;
+  // libjpeg will jump to this block without unwinding the stack if there's an
+  // error. Nothing here needs to be destroyed except the decoder.
+  if (setjmp(error.jump)) {
+    jpeg_destroy_decompress(&jpeg);
+    throw FatalError::Decode;
+  }
+  jpeg_create_decompress(&jpeg);
+  src.is = &is;
+  src.mgr.next_input_byte = nullptr;
+  src.mgr.bytes_in_buffer = 0;
+  src.mgr.init_source = [](j_decompress_ptr) {};
+  src.mgr.fill_input_buffer = libjpeg_fill;
+  src.mgr.skip_input_data = libjpeg_skip;
+  src.mgr.resync_to_restart = jpeg_resync_to_restart;
+  src.mgr.term_source = [](j_decompress_ptr) {};
+  jpeg.src = &src.mgr;
+  jpeg_read_header(&jpeg, TRUE);
+
+  // Scaling happens in the inverse DCT, so smaller sizes are faster.
+  jpeg.scale_num = 1;
+  jpeg.scale_denom = scale;
+  jpeg_calc_output_dimensions(&jpeg);
+  if (too_large("JPEG", jpeg.output_width, jpeg.output_height)) {
+    jpeg_destroy_decompress(&jpeg);
+    throw FatalError::ResourceLimit;
+  }
+  ImageView dst = target(context, jpeg.jpeg_color_space == JCS_GRAYSCALE,
+                         jpeg.output_width, jpeg.output_height);
+  if (dst.width() != jpeg.output_width ||
+      dst.height() != jpeg.output_height) {
+    jpeg_destroy_decompress(&jpeg);
+    throw FatalError::Decode;
+  }
+  switch (dst.kind()) {
+  case ImageType::Luminance:
+    jpeg.out_color_space = JCS_GRAYSCALE;
+    break;
+  case ImageType::RGB:
+    jpeg.out_color_space = JCS_RGB;
+    break;
+  case ImageType::RGBA:
+#ifdef JCS_EXTENSIONS
+    jpeg.out_color_space = JCS_EXT_RGBA; // libjpeg-turbo fills in alpha
+    break;
+#else
+    log_crit("This libjpeg can't decode to RGBA");
+    jpeg_destroy_decompress(&jpeg);
+    throw FatalError::Decode;
+#endif
+  }
+  jpeg_start_decompress(&jpeg);
+  while (jpeg.output_scanline < jpeg.output_height) {
+    JSAMPROW rows[8];
+    unsigned num = std::min(jpeg.output_height - jpeg.output_scanline, 8u);
+    for (unsigned i = 0; i < num; i++)
+      rows[i] = dst.pixel(0, jpeg.output_scanline + i);
+    jpeg_read_scanlines(&jpeg, rows, num);
+  }
+  jpeg_finish_decompress(&jpeg);
+  jpeg_destroy_decompress(&jpeg);
+  return dst;
+}
+
 } // namespace detail::image
 
 Image Image::read_png(std::istream &is) {
@@ -124,8 +283,13 @@ Image Image::read_png(std::istream &is) {
   int passes = png_set_interlace_handling(png);
   png_read_update_info(png, info);
   // Read all image data from libpng into main memory.
-  dst = Image(libpng_to_native(png, info), png_get_image_width(png, info),
-              png_get_image_height(png, info));
+  unsigned w = png_get_image_width(png, info);
+  unsigned h = png_get_image_height(png, info);
+  if (too_large("PNG", w, h)) {
+    png_destroy_read_struct(&png, &info, nullptr);
+    throw FatalError::ResourceLimit;
+  }
+  dst = Image(libpng_to_native(png, info), w, h);
   for (int pass = 0; pass < passes; pass++)
     for (unsigned y = 0; y < dst.height(); y++)
       png_read_row(png, reinterpret_cast<png_bytep>(dst.pixel(0, y)), nullptr);
@@ -143,3 +307,46 @@ Image::Image(ImageType kind, unsigned w, unsigned h) {
   m_stride = remain ? m_stride - remain + 4 : m_stride;
   m_pixels = std::make_unique<uint8_t[]>(h * m_stride);
 }
+
+Image Image::read_jpeg(std::istream &is, unsigned scale) {
+  Image dst;
+  detail::image::read_jpeg(
+      is, scale,
+      [](void *context, bool gray, unsigned w, unsigned h) {
+        Image &dst = *static_cast<Image *>(context);
+        dst = Image(gray ? ImageType::Luminance : ImageType::RGB, w, h);
+        ImageView view = dst;
+        return view;
+      },
+      &dst);
+  return dst;
+}
+
+ImageView Image::read_jpeg(std::istream &is, unsigned scale, ImageView dst) {
+  return detail::image::read_jpeg(
+      is, scale,
+      [](void *context, bool gray, unsigned w, unsigned h) {
+        (void)gray;
+        ImageView dst = *static_cast<ImageView *>(context);
+        if (dst.width() < w || dst.height() < h) {
+          log_crit("JPEG is %ux%u, larger than the destination %ux%u", w, h,
+                   dst.width(), dst.height());
+          return dst.subview(0, 0, 0, 0);
+        }
+        return dst.subview(0, 0, w, h);
+      },
+      &dst);
+}
+
+Image Image::read(std::istream &is) {
+  // The first byte tells the formats apart. Peek at it instead of seeking
+  // back, so that streams that can't seek work too.
+  switch (is.peek()) {
+  case 0xff:
+    return read_jpeg(is, 1);
+  case 0x89:
+    return read_png(is);
+  }
+  log_crit("Unknown image format");
+  throw FatalError::Decode;
+}
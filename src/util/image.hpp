@@ -11,6 +11,7 @@
 #include <istream>
 #include <memory>
 #include <ostream>
+#include <type_traits>
 #include <utility>
 
 /// List of supported pixel formats.
@@ -55,6 +56,7 @@ private:
 
 public:
   PixelReference(AllocatePixels &px) : m_data(px.get()) {}
+  explicit PixelReference(PixelType *data) : m_data(data) {}
   PixelType *get() const { return m_data; }
 };
 
@@ -72,9 +74,19 @@ private:
 public:
   ConstPixelReference(const AllocatePixels &px) : m_data(px.get()) {}
   ConstPixelReference(const PixelReference &px) : m_data(px.get()) {}
+  explicit ConstPixelReference(PixelType *data) : m_data(data) {}
   PixelType *get() const { return m_data; }
 };
 
+/**
+ * \internal
+ * \brief Reference to the pixels of buffer T, with the same constness.
+ */
+template <typename T>
+using ReferenceTo =
+    std::conditional_t<std::is_const_v<typename T::PixelType>,
+                       ConstPixelReference, PixelReference>;
+
 } // namespace detail::image
 
 /// A reference to an image in main memory.
@@ -120,6 +132,20 @@ public:
     return m_pixels.get() + y * m_stride + x * bytes_per_pixel(m_kind);
   }
 
+  /**
+   * \brief Get a view of part of the image, without copying.
+   * \param x, y top left corner
+   * \param w, h size in pixels
+   */
+  BasicImageView<detail::image::ReferenceTo<T>>
+  subview(unsigned x, unsigned y, unsigned w, unsigned h) const {
+    assert(x <= m_width && w <= m_width - x);
+    assert(y <= m_height && h <= m_height - y);
+    return BasicImageView<detail::image::ReferenceTo<T>>(
+        m_kind, w, h, m_stride,
+        m_pixels.get() + y * m_stride + x * bytes_per_pixel(m_kind));
+  }
+
   /// Write this image to the given PNG file.
   void write_png(std::ostream &os) const;
 };
@@ -154,9 +180,42 @@ void BasicImageView<T>::write_png(std::ostream &os) const {
 /// An image that owns its pixel buffer memory.
 class Image : public BasicImageView<detail::image::AllocatePixels> {
 public:
-  /// Read a PNG file from the given stream.
+  /**
+   * \brief Read a PNG file from the given stream.
+   * \throw FatalError::Decode if the file is invalid
+   * \throw FatalError::ResourceLimit if the image is too large
+   */
   static Image read_png(std::istream &is);
 
+  /**
+   * \brief Read a JPEG file from the given stream.
+   *
+   * Grayscale files are read as Luminance and others as RGB.
+   *
+   * \param scale 1, 2, 4 or 8 to divide the size by, rounding up. Smaller
+   * sizes decode faster, since they're scaled before the inverse DCT.
+   * \throw FatalError::Decode if the file is invalid
+   * \throw FatalError::ResourceLimit if the image is too large
+   */
+  static Image read_jpeg(std::istream &is, unsigned scale);
+
+  /**
+   * \brief Read a JPEG file into an existing image.
+   *
+   * The pixels are converted to the type of dst, which can be Luminance, RGB
+   * or RGBA (with opaque alpha, if libjpeg supports it).
+   *
+   * \param scale 1, 2, 4 or 8 to divide the size by, rounding up
+   * \param dst at least as big as the scaled image
+   * \return the part of dst that was written, at its top left
+   * \throw FatalError::Decode if the file is invalid or too big for dst
+   * \throw FatalError::ResourceLimit if the image is too large
+   */
+  static ImageView read_jpeg(std::istream &is, unsigned scale, ImageView dst);
+
+  /// Read a PNG or JPEG file at full size, depending on its contents.
+  static Image read(std::istream &is);
+
   Image() = default;
   /// Create a new image and allocate its pixel buffer.
   Image(ImageType kind, unsigned w, unsigned h);
@@ -170,6 +229,18 @@ public:
   uint8_t *pixel(unsigned x, unsigned y) {
     return const_cast<uint8_t *>(BasicImageView::pixel(x, y));
   }
+
+  /// Get a mutable view of part of the image, see BasicImageView::subview().
+  ImageView subview(unsigned x, unsigned y, unsigned w, unsigned h) {
+    ImageView view = *this;
+    return view.subview(x, y, w, h);
+  }
+
+  /// Get a view of part of the image, see BasicImageView::subview().
+  ConstImageView subview(unsigned x, unsigned y, unsigned w,
+                         unsigned h) const {
+    return BasicImageView::subview(x, y, w, h);
+  }
 };
 
 #endif
@@ -0,0 +1,143 @@
+#include "job.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <SDL3/SDL_cpuinfo.h>
+
+#include "util.hpp"
+
+class JobPool::Data {
+  /// Shared state of one call to run().
+  struct Batch {
+    const std::function<void(size_t)> *job;
+    size_t num;
+    std::atomic<size_t> next = 0;
+    std::atomic<size_t> done = 0;
+    std::mutex lock;
+    std::condition_variable finished;
+    std::exception_ptr error;
+
+    /// Claim indices until there are none left.
+    void work() {
+      for (size_t i; (i = next.fetch_add(1)) < num;) {
+        try {
+          (*job)(i);
+        } catch (...) {
+          std::lock_guard<std::mutex> guard(lock);
+          if (!error)
+            error = std::current_exception();
+        }
+        if (done.fetch_add(1) + 1 == num) {
+          std::lock_guard<std::mutex> guard(lock);
+          finished.notify_all();
+        }
+      }
+    }
+  };
+
+  std::mutex m_lock;
+  std::condition_variable m_wake;
+  std::deque<std::function<void()>> m_queue;
+  bool m_stop = false;
+  std::vector<std::thread> m_threads;
+
+public:
+  explicit Data(unsigned num) {
+    if (!num) {
+      int cores = SDL_GetNumLogicalCPUCores();
+      num = cores > 1 ? cores - 1 : 1;
+    }
+    m_threads.reserve(num);
+    for (unsigned i = 0; i < num; i++)
+      m_threads.emplace_back([this]() { main(); });
+  }
+
+  Data(const Data &other) = delete;
+  Data &operator=(const Data &other) = delete;
+
+  ~Data() {
+    {
+      std::lock_guard<std::mutex> guard(m_lock);
+      m_stop = true;
+    }
+    m_wake.notify_all();
+    for (auto &t : m_threads)
+      t.join();
+  }
+
+  unsigned concurrency() const { return m_threads.size() + 1; }
+
+  void submit(std::function<void()> job) {
+    // Notify under the lock. A job that submits the last piece of work might
+    // otherwise let the pool be destroyed before the notification finishes.
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_queue.push_back(std::move(job));
+    m_wake.notify_one();
+  }
+
+  void run(size_t num, const std::function<void(size_t)> &job) {
+    if (num == 1) {
+      job(0);
+      return;
+    }
+    auto batch = std::make_shared<Batch>();
+    batch->job = &job;
+    batch->num = num;
+    // Wake up helpers, but no more than there is work for. Helpers that arrive
+    // after the work is done find no indices left and return immediately.
+    size_t helpers = std::min<size_t>(num - 1, m_threads.size());
+    {
+      std::lock_guard<std::mutex> guard(m_lock);
+      for (size_t i = 0; i < helpers; i++)
+        m_queue.emplace_back([batch]() { batch->work(); });
+    }
+    m_wake.notify_all();
+    batch->work();
+    std::unique_lock<std::mutex> guard(batch->lock);
+    batch->finished.wait(guard, [&]() { return batch->done == num; });
+    if (batch->error)
+      std::rethrow_exception(batch->error);
+  }
+
+private:
+  void main() {
+    for (;;) {
+      std::function<void()> job;
+      {
+        std::unique_lock<std::mutex> guard(m_lock);
+        m_wake.wait(guard, [this]() { return m_stop || !m_queue.empty(); });
+        if (m_queue.empty())
+          return; // stopped and drained
+        job = std::move(m_queue.front());
+        m_queue.pop_front();
+      }
+      try {
+        job();
+      } catch (FatalError) {
+        log_crit("Background job failed");
+      }
+    }
+  }
+};
+
+JobPool::JobPool(unsigned num) : m_data(new Data(num)) {}
+JobPool::JobPool(JobPool &&other) = default;
+JobPool &JobPool::operator=(JobPool &&other) = default;
+JobPool::~JobPool() = default;
+
+unsigned JobPool::concurrency() const { return m_data->concurrency(); }
+
+void JobPool::submit(std::function<void()> job) {
+  m_data->submit(std::move(job));
+}
+
+void JobPool::run(size_t num, const std::function<void(size_t)> &job) {
+  if (num)
+    m_data->run(num, job);
+}
@@ -0,0 +1,83 @@
+/**
+ * \file
+ * \brief Run jobs on a pool of worker threads.
+ */
+
+#ifndef JOB_HPP
+#define JOB_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+/// A fixed set of worker threads that execute jobs.
+class JobPool {
+  class Data;
+  std::unique_ptr<Data> m_data;
+
+public:
+  /**
+   * \brief Start the worker threads.
+   * \param num number of worker threads (0 means one less than the number of
+   *            logical CPU cores, because the calling thread also does work)
+   */
+  explicit JobPool(unsigned num = 0);
+  JobPool(JobPool &&other);
+  JobPool &operator=(JobPool &&other);
+
+  /**
+   * \brief Stop the worker threads.
+   *
+   * Jobs that were already submitted are allowed to finish first.
+   */
+  ~JobPool();
+
+  /// Get the number of threads that run() can use, including the caller.
+  unsigned concurrency() const;
+
+  /**
+   * \brief Run a job in the background.
+   *
+   * The job must not throw. If it does, the error is logged and discarded.
+   */
+  void submit(std::function<void()> job);
+
+  /**
+   * \brief Run a job many times in parallel and wait for all of them.
+   *
+   * The calling thread takes part in the work, so it's safe to call run() from
+   * inside another job.
+   *
+   * \param num number of times to run the job
+   * \param job called with each index in [0, num)
+   * \throw FatalError rethrown from the first job that failed
+   */
+  void run(size_t num, const std::function<void(size_t)> &job);
+
+  /**
+   * \brief Split a range of indices into batches and process them in parallel.
+   * \param num size of the range
+   * \param grain minimum batch size
+   * \param fn called with each batch as a half-open range [begin, end)
+   */
+  template <typename F> void parallel_for(size_t num, size_t grain, F &&fn) {
+    grain = std::max<size_t>(grain, 1);
+    // A few batches per thread keeps everyone busy if the work is uneven.
+    size_t batches = std::min((num + grain - 1) / grain,
+                              size_t(concurrency()) * 4);
+    if (batches <= 1) {
+      if (num)
+        fn(size_t(0), num);
+      return;
+    }
+    size_t step = (num + batches - 1) / batches;
+    run(batches, [&](size_t i) {
+      size_t begin = i * step;
+      if (begin < num)
+        fn(begin, std::min(begin + step, num));
+    });
+  }
+};
+
+#endif
@@ -0,0 +1,496 @@
+#include "json.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "util.hpp"
+
+namespace {
+
+using Type = JsonValue::Type;
+
+/// Characters of one 64-byte block, one bit per byte.
+struct Block {
+  uint64_t quote, backslash, op, space;
+};
+
+Block classify(const char *p) {
+  Block b = {};
+#ifdef __SSE2__
+  for (int k = 0; k < 4; k++) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p) + k);
+    auto eq = [](__m128i x, char c) {
+      int bits = _mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8(c)));
+      return uint64_t(uint16_t(bits));
+    };
+    // Setting bit 5 turns [ and ] into { and }.
+    __m128i folded = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    int shift = 16 * k;
+    b.quote |= eq(v, '"') << shift;
+    b.backslash |= eq(v, '\\') << shift;
+    b.op |= (eq(folded, '{') | eq(folded, '}') | eq(v, ':') | eq(v, ','))
+            << shift;
+    b.space |= (eq(v, ' ') | eq(v, '\t') | eq(v, '\n') | eq(v, '\r'))
+               << shift;
+  }
+#else
+  for (int i = 0; i < 64; i++) {
+    uint64_t bit = uint64_t(1) << i;
+    switch (p[i]) {
+    case '"':
+      b.quote |= bit;
+      break;
+    case '\\':
+      b.backslash |= bit;
+      break;
+    case '{':
+    case '}':
+    case '[':
+    case ']':
+    case ':':
+    case ',':
+      b.op |= bit;
+      break;
+    case ' ':
+    case '\t':
+    case '\n':
+    case '\r':
+      b.space |= bit;
+      break;
+    }
+  }
+#endif
+  return b;
+}
+
+/// Set each bit to the XOR of itself and all the bits below it.
+uint64_t prefix_xor(uint64_t x) {
+  for (int shift = 1; shift < 64; shift *= 2)
+    x ^= x << shift;
+  return x;
+}
+
+unsigned trailing_zeros(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctzll(x);
+#else
+  unsigned n = 0;
+  for (; !(x & 1); x >>= 1)
+    n++;
+  return n;
+#endif
+}
+
+bool is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool is_digit(char c) { return '0' <= c && c <= '9'; }
+
+[[noreturn]] void fail(const char *what, size_t pos) {
+  log_crit("JSON: %s at byte %zu", what, pos);
+  throw FatalError::Decode;
+}
+
+const char *type_name(Type type) {
+  const char *names[] = {"null",     "a boolean", "a number",
+                         "a string", "an array",  "an object"};
+  return names[unsigned(type)];
+}
+
+/// Parse 4 hex digits.
+bool hex4(const char *p, uint32_t &out) {
+  out = 0;
+  for (int i = 0; i < 4; i++) {
+    char c = p[i], lower = c | 0x20;
+    unsigned d;
+    if (is_digit(c))
+      d = c - '0';
+    else if ('a' <= lower && lower <= 'f')
+      d = lower - 'a' + 10;
+    else
+      return false;
+    out = out << 4 | d;
+  }
+  return true;
+}
+
+void append_utf8(std::string &out, uint32_t c) {
+  if (c < 0x80) {
+    out += char(c);
+  } else if (c < 0x800) {
+    out += char(0xc0 | c >> 6);
+    out += char(0x80 | (c & 0x3f));
+  } else if (c < 0x10000) {
+    out += char(0xe0 | c >> 12);
+    out += char(0x80 | (c >> 6 & 0x3f));
+    out += char(0x80 | (c & 0x3f));
+  } else {
+    out += char(0xf0 | c >> 18);
+    out += char(0x80 | (c >> 12 & 0x3f));
+    out += char(0x80 | (c >> 6 & 0x3f));
+    out += char(0x80 | (c & 0x3f));
+  }
+}
+
+} // namespace
+
+void JsonDocument::parse(const char *data, size_t size) {
+  if (size >= UINT32_MAX) {
+    log_crit("JSON text is too large");
+    throw FatalError::ResourceLimit;
+  }
+  m_data = data;
+  index(data, size);
+  m_nodes.clear();
+  m_nodes.reserve(m_index.size());
+  m_stack.clear();
+  m_strings.clear();
+
+  // Walk the structural characters. The last one is the null at the end.
+  enum { Value, Key, After } state = Value;
+  size_t i = 0;
+  uint32_t pos = m_index[i++];
+  for (;;) {
+    if (state == Key) {
+      if (data[pos] != '"')
+        fail("expected a key", pos);
+      string(pos, m_index[i]);
+      pos = m_index[i++];
+      if (data[pos] != ':')
+        fail("expected ':'", pos);
+      pos = m_index[i++];
+      state = Value;
+      continue;
+    }
+    if (state == Value) {
+      if (pos == size)
+        fail("expected a value", pos);
+      char c = data[pos];
+      if (c == '{' || c == '[') {
+        m_stack.push_back(m_nodes.size());
+        m_nodes.push_back({c == '{' ? Type::Object : Type::Array, false, pos,
+                           0, 0});
+        pos = m_index[i++];
+        if (data[pos] == c + 2) {
+          // Empty. The closing bracket is 2 after the opening one.
+          m_nodes.back().next = m_nodes.size();
+          m_stack.pop_back();
+          state = After;
+        } else {
+          state = c == '{' ? Key : Value;
+          continue;
+        }
+      } else if (c == '"') {
+        string(pos, m_index[i]);
+      } else {
+        scalar(pos, m_index[i]);
+      }
+    }
+
+    // A value is done. Count it in its array or object, then continue it or
+    // close it.
+    if (m_stack.empty()) {
+      if (i != m_index.size() - 1)
+        fail("expected the end", m_index[i]);
+      break;
+    }
+    Node &top = m_nodes[m_stack.back()];
+    top.length++;
+    pos = m_index[i++];
+    if (data[pos] == ',') {
+      pos = m_index[i++];
+      state = top.type == Type::Object ? Key : Value;
+    } else if (data[pos] == (top.type == Type::Object ? '}' : ']')) {
+      top.next = m_nodes.size();
+      m_stack.pop_back();
+      state = After;
+    } else {
+      fail("expected ',' or a closing bracket", pos);
+    }
+  }
+}
+
+void JsonDocument::index(const char *data, size_t size) {
+  size_t count = 0;
+  uint64_t prev_escaped = 0, prev_in_string = 0, prev_scalar = 0;
+  const uint64_t even = 0x5555555555555555;
+  for (size_t base = 0; base < size; base += 64) {
+    // The last block is padded with spaces.
+    char padded[64];
+    const char *p = data + base;
+    if (size - base < 64) {
+      memset(padded, ' ', 64);
+      memcpy(padded, p, size - base);
+      p = padded;
+    }
+    Block b = classify(p);
+
+    // Find escaped characters. A run of backslashes escapes the character
+    // after it if it has an odd length. Adding the starts of the runs that
+    // begin on odd bits to the runs carries past the end of exactly those
+    // runs, which tells runs on even and odd bits apart.
+    uint64_t backslash = b.backslash & ~prev_escaped;
+    uint64_t follows_escape = backslash << 1 | prev_escaped;
+    uint64_t odd_starts = backslash & ~even & ~follows_escape;
+    uint64_t sum = odd_starts + backslash;
+    uint64_t carry = sum < backslash;
+    uint64_t escaped = (even ^ sum << 1) & follows_escape;
+    prev_escaped = carry;
+
+    // Quotes toggle between inside and outside of strings. The mask
+    // includes the opening quote but not the closing one.
+    uint64_t quote = b.quote & ~escaped;
+    uint64_t in_string = prefix_xor(quote) ^ prev_in_string;
+    prev_in_string = uint64_t(int64_t(in_string) >> 63);
+
+    // Other values (numbers, true, false, null) start where a run of
+    // non-space, non-operator characters does.
+    uint64_t scalar = ~(b.op | b.space | quote | in_string);
+    uint64_t scalar_start = scalar & ~(scalar << 1 | prev_scalar);
+    prev_scalar = scalar >> 63;
+
+    uint64_t bits = (b.op & ~in_string) | scalar_start | (quote & in_string);
+    if (m_index.size() < count + 64)
+      m_index.resize(std::max(m_index.size() * 2, count + 64));
+    uint32_t *out = m_index.data() + count;
+    for (; bits; bits &= bits - 1)
+      *out++ = base + trailing_zeros(bits);
+    count = out - m_index.data();
+  }
+  if (prev_in_string)
+    fail("unterminated string", size);
+  m_index.resize(count);
+  m_index.push_back(size);
+}
+
+void JsonDocument::string(uint32_t pos, uint32_t end) {
+  // The closing quote is the last character before the next structural one.
+  while (pos < end && is_space(m_data[end - 1]))
+    end--;
+  if (end - pos < 2 || m_data[end - 1] != '"')
+    fail("unterminated string", pos);
+  const char *p = m_data + pos + 1, *stop = m_data + end - 1;
+  if (!memchr(p, '\\', stop - p)) {
+    m_nodes.push_back({Type::String, false, pos + 1, end - pos - 2,
+                       uint32_t(m_nodes.size() + 1)});
+    return;
+  }
+
+  uint32_t offset = m_strings.size();
+  while (p < stop) {
+    auto slash = static_cast<const char *>(memchr(p, '\\', stop - p));
+    if (!slash) {
+      m_strings.append(p, stop);
+      break;
+    }
+    m_strings.append(p, slash);
+    p = slash + 2;
+    switch (slash[1]) {
+    case '"':
+    case '\\':
+    case '/':
+      m_strings += slash[1];
+      break;
+    case 'b':
+      m_strings += '\b';
+      break;
+    case 'f':
+      m_strings += '\f';
+      break;
+    case 'n':
+      m_strings += '\n';
+      break;
+    case 'r':
+      m_strings += '\r';
+      break;
+    case 't':
+      m_strings += '\t';
+      break;
+    case 'u': {
+      uint32_t c, low;
+      if (stop - p < 4 || !hex4(p, c))
+        fail("invalid \\u escape", p - m_data);
+      p += 4;
+      // Characters past U+FFFF are written as a pair of surrogates.
+      if (0xd800 <= c && c < 0xdc00 && stop - p >= 6 && p[0] == '\\' &&
+          p[1] == 'u' && hex4(p + 2, low) && 0xdc00 <= low && low < 0xe000) {
+        c = 0x10000 + ((c - 0xd800) << 10) + (low - 0xdc00);
+        p += 6;
+      } else if (0xd800 <= c && c < 0xe000) {
+        fail("unpaired surrogate", p - m_data);
+      }
+      append_utf8(m_strings, c);
+      break;
+    }
+    default:
+      fail("invalid escape", slash - m_data);
+    }
+  }
+  m_nodes.push_back({Type::String, true, offset,
+                     uint32_t(m_strings.size() - offset),
+                     uint32_t(m_nodes.size() + 1)});
+}
+
+void JsonDocument::scalar(uint32_t pos, uint32_t end) {
+  while (pos < end && is_space(m_data[end - 1]))
+    end--;
+  std::string_view text(m_data + pos, end - pos);
+  uint32_t next = m_nodes.size() + 1;
+  if (text == "true" || text == "false") {
+    m_nodes.push_back({Type::Bool, false, pos, text == "true", next});
+    return;
+  }
+  if (text == "null") {
+    m_nodes.push_back({Type::Null, false, pos, 0, next});
+    return;
+  }
+  // Check the syntax now. The value is converted when it's read.
+  const char *p = m_data + pos, *stop = m_data + end;
+  auto digits = [&]() {
+    const char *start = p;
+    while (p < stop && is_digit(*p))
+      p++;
+    return p != start;
+  };
+  if (p < stop && *p == '-')
+    p++;
+  if (p < stop && *p == '0')
+    p++;
+  else if (!digits())
+    fail("invalid value", pos);
+  if (p < stop && *p == '.') {
+    p++;
+    if (!digits())
+      fail("invalid number", pos);
+  }
+  if (p < stop && (*p == 'e' || *p == 'E')) {
+    p++;
+    if (p < stop && (*p == '+' || *p == '-'))
+      p++;
+    if (!digits())
+      fail("invalid number", pos);
+  }
+  if (p != stop)
+    fail("invalid number", pos);
+  m_nodes.push_back({Type::Number, false, pos, end - pos, next});
+}
+
+JsonValue::Type JsonValue::type() const {
+  return m_doc->m_nodes[m_node].type;
+}
+
+bool JsonValue::as_bool() const {
+  expect(Type::Bool);
+  return m_doc->m_nodes[m_node].length;
+}
+
+double JsonValue::as_number() const {
+  expect(Type::Number);
+  std::string_view text = m_doc->text(m_node);
+  double value;
+  auto result =
+      std::from_chars(text.data(), text.data() + text.size(), value);
+  if (result.ec != std::errc()) {
+    log_crit("JSON number out of range: %.*s", int(text.size()),
+             text.data());
+    throw FatalError::Decode;
+  }
+  return value;
+}
+
+int64_t JsonValue::as_int() const {
+  expect(Type::Number);
+  std::string_view text = m_doc->text(m_node);
+  int64_t value;
+  auto result =
+      std::from_chars(text.data(), text.data() + text.size(), value);
+  if (result.ec != std::errc() || result.ptr != text.data() + text.size()) {
+    log_crit("JSON number is not an integer: %.*s", int(text.size()),
+             text.data());
+    throw FatalError::Decode;
+  }
+  return value;
+}
+
+std::string_view JsonValue::as_string() const {
+  expect(Type::String);
+  return m_doc->text(m_node);
+}
+
+size_t JsonValue::size() const {
+  Type t = type();
+  if (t != Type::Object)
+    expect(Type::Array);
+  return m_doc->m_nodes[m_node].length;
+}
+
+JsonValue::Range<JsonValue::Iterator> JsonValue::items() const {
+  expect(Type::Array);
+  return {{m_doc, m_node + 1}, {m_doc, m_doc->m_nodes[m_node].next}};
+}
+
+JsonValue JsonValue::operator[](size_t index) const {
+  expect(Type::Array);
+  if (index >= size()) {
+    log_crit("JSON array index %zu out of range", index);
+    throw FatalError::Decode;
+  }
+  uint32_t node = m_node + 1;
+  for (; index; index--)
+    node = m_doc->m_nodes[node].next;
+  return {m_doc, node};
+}
+
+JsonValue::Range<JsonValue::MemberIterator> JsonValue::members() const {
+  expect(Type::Object);
+  return {{m_doc, m_node + 1}, {m_doc, m_doc->m_nodes[m_node].next}};
+}
+
+bool JsonValue::find(std::string_view key, JsonValue &value) const {
+  for (auto [k, v] : members()) {
+    if (k == key) {
+      value = v;
+      return true;
+    }
+  }
+  return false;
+}
+
+JsonValue JsonValue::operator[](std::string_view key) const {
+  JsonValue value;
+  if (!find(key, value)) {
+    log_crit("JSON object has no member \"%.*s\"", int(key.size()),
+             key.data());
+    throw FatalError::Decode;
+  }
+  return value;
+}
+
+void JsonValue::expect(Type type) const {
+  if (this->type() != type) {
+    log_crit("JSON value is %s, not %s", type_name(this->type()),
+             type_name(type));
+    throw FatalError::Decode;
+  }
+}
+
+JsonValue::Iterator &JsonValue::Iterator::operator++() {
+  m_node = m_doc->m_nodes[m_node].next;
+  return *this;
+}
+
+std::pair<std::string_view, JsonValue>
+JsonValue::MemberIterator::operator*() const {
+  return {m_doc->text(m_node), {m_doc, m_node + 1}};
+}
+
+JsonValue::MemberIterator &JsonValue::MemberIterator::operator++() {
+  m_node = m_doc->m_nodes[m_node + 1].next;
+  return *this;
+}
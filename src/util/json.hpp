@@ -0,0 +1,168 @@
+/**
+ * \file
+ * \brief Parse JSON data files.
+ */
+
+#ifndef JSON_HPP
+#define JSON_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+class JsonDocument;
+
+/**
+ * \brief A value in a JsonDocument.
+ *
+ * Values are small handles that stay valid until the document is parsed
+ * again or destroyed. Numbers are converted when they're read. Accessors
+ * check the type and throw FatalError::Decode on a mismatch, so loaders can
+ * treat a wrongly typed field like any other invalid file.
+ */
+class JsonValue {
+public:
+  enum class Type : uint8_t { Null, Bool, Number, String, Array, Object };
+
+  class Iterator;
+  class MemberIterator;
+
+  /// A pair of iterators for range-based for loops.
+  template <typename I> struct Range {
+    I first, last;
+    I begin() const { return first; }
+    I end() const { return last; }
+  };
+
+private:
+  const JsonDocument *m_doc = nullptr;
+  uint32_t m_node = 0;
+
+public:
+  JsonValue() = default;
+  JsonValue(const JsonDocument *doc, uint32_t node)
+      : m_doc(doc), m_node(node) {}
+
+  Type type() const;
+  bool is_null() const { return type() == Type::Null; }
+
+  bool as_bool() const;
+  double as_number() const;
+  /// Get a number that must be an integer that fits in 64 bits.
+  int64_t as_int() const;
+  /// Get a string, valid as long as the document and its input.
+  std::string_view as_string() const;
+
+  /// Get the number of elements of an array or members of an object.
+  size_t size() const;
+
+  /// Get the elements of an array.
+  Range<Iterator> items() const;
+  /// Get the element of an array at an index (linear time).
+  JsonValue operator[](size_t index) const;
+
+  /// Get the members of an object as (key, value) pairs, in file order.
+  Range<MemberIterator> members() const;
+  /**
+   * \brief Look up a member of an object (linear time).
+   * \return false if there is no such member
+   */
+  bool find(std::string_view key, JsonValue &value) const;
+  /// Get a member of an object that must exist.
+  JsonValue operator[](std::string_view key) const;
+
+private:
+  void expect(Type type) const;
+};
+
+/// Walks the elements of an array.
+class JsonValue::Iterator {
+  const JsonDocument *m_doc;
+  uint32_t m_node;
+
+public:
+  Iterator(const JsonDocument *doc, uint32_t node)
+      : m_doc(doc), m_node(node) {}
+  JsonValue operator*() const { return {m_doc, m_node}; }
+  Iterator &operator++();
+  bool operator!=(const Iterator &rhs) const { return m_node != rhs.m_node; }
+};
+
+/// Walks the members of an object.
+class JsonValue::MemberIterator {
+  const JsonDocument *m_doc;
+  uint32_t m_node; ///< The key.
+
+public:
+  MemberIterator(const JsonDocument *doc, uint32_t node)
+      : m_doc(doc), m_node(node) {}
+  std::pair<std::string_view, JsonValue> operator*() const;
+  MemberIterator &operator++();
+  bool operator!=(const MemberIterator &rhs) const {
+    return m_node != rhs.m_node;
+  }
+};
+
+/**
+ * \brief A parsed JSON file.
+ *
+ * Parsing takes two passes. The first finds the structural characters
+ * (brackets, colons, commas, and the starts of strings and other values) 64
+ * bytes at a time with bit masks, using SIMD compares where available. The
+ * second walks only those positions and records the values in a flat array,
+ * where each value is followed by its children.
+ *
+ * Strings without escapes point into the input, and numbers are converted
+ * when they're read, so parsing copies very little. The arrays are kept when
+ * the document is parsed again, so a reused document doesn't allocate once
+ * it has grown to size.
+ */
+class JsonDocument {
+  friend class JsonValue;
+  friend class JsonValue::Iterator;
+  friend class JsonValue::MemberIterator;
+
+  struct Node {
+    JsonValue::Type type;
+    bool escaped;    ///< String decoded into m_strings.
+    uint32_t offset; ///< Text of numbers and strings.
+    uint32_t length; ///< Length of the text, or number of children.
+    uint32_t next;   ///< The node after this one's children.
+  };
+
+  const char *m_data = nullptr;
+  std::vector<uint32_t> m_index; ///< Positions of structural characters.
+  std::vector<Node> m_nodes;
+  std::vector<uint32_t> m_stack; ///< Open arrays and objects.
+  std::string m_strings;         ///< Strings that had escapes.
+
+public:
+  /**
+   * \brief Parse a JSON text, replacing the previous contents.
+   *
+   * The data is used in place and must stay valid as long as the document.
+   *
+   * \param data text followed by a null character, as from read_stream()
+   * \param size length of the text, not counting the null
+   * \throw FatalError::Decode if the text isn't valid JSON
+   * \throw FatalError::ResourceLimit if the text is 4 GiB or more
+   */
+  void parse(const char *data, size_t size);
+
+  /// Get the top-level value.
+  JsonValue root() const { return {this, 0}; }
+
+private:
+  std::string_view text(uint32_t node) const {
+    const Node &n = m_nodes[node];
+    return {(n.escaped ? m_strings.data() : m_data) + n.offset, n.length};
+  }
+  void index(const char *data, size_t size);
+  void string(uint32_t pos, uint32_t end);
+  void scalar(uint32_t pos, uint32_t end);
+};
+
+#endif
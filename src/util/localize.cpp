@@ -0,0 +1,267 @@
+#include "localize.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "util.hpp"
+
+namespace {
+
+constexpr uint32_t strings_magic = 0x31534744; // "DGS1"
+
+/// Seeds tried per bucket before giving up. Only reached if two keys have the
+/// same 64-bit hash.
+constexpr uint32_t max_seed = 1 << 28;
+
+struct Header {
+  uint32_t magic;
+  uint32_t count;   ///< Number of strings, and of slots.
+  uint32_t buckets; ///< Number of seeds.
+  uint32_t size;    ///< Size of the file in bytes.
+};
+
+/// A slot, holding one string.
+struct Slot {
+  uint32_t key;   ///< Offset of the key.
+  uint32_t value; ///< Offset of the text.
+  uint32_t value_size;
+  uint16_t key_size;
+  uint8_t hints;
+  uint8_t pad;
+};
+
+static_assert(sizeof(Header) == 16 && sizeof(Slot) == 16);
+
+uint32_t read32(const uint8_t *p) {
+  uint32_t x;
+  memcpy(&x, p, sizeof x);
+  return x;
+}
+
+[[noreturn]] void corrupt(const char *what) {
+  log_crit("Invalid string table: %s", what);
+  throw FatalError::Decode;
+}
+
+/// Finish a hash so that every bit depends on every input bit (MurmurHash3
+/// fmix64).
+uint64_t mix(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccd;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53;
+  x ^= x >> 33;
+  return x;
+}
+
+/// Hash a key. This is part of the file format, so it must not change.
+uint64_t hash_key(std::string_view key) {
+  uint64_t h = 0xcbf29ce484222325; // FNV-1a
+  for (char c : key)
+    h = (h ^ uint8_t(c)) * 0x100000001b3;
+  return mix(h);
+}
+
+/// Map 32 bits of hash onto [0, n) without a division.
+uint32_t reduce(uint64_t h, uint32_t n) {
+  return uint32_t((h >> 32) * n >> 32);
+}
+
+uint32_t bucket(uint64_t h, uint32_t buckets) { return reduce(h, buckets); }
+
+uint32_t slot(uint64_t h, uint32_t seed, uint32_t count) {
+  return reduce(mix(h ^ (seed * 0x9e3779b97f4a7c15)), count);
+}
+
+} // namespace
+
+StringTable::StringTable(AssetMapping file) : m_file(std::move(file)) {
+  const uint8_t *data = m_file.data();
+  Header header;
+  if (m_file.size() < sizeof header)
+    corrupt("file is too small");
+  if (reinterpret_cast<uintptr_t>(data) % 4)
+    corrupt("data is not aligned");
+  memcpy(&header, data, sizeof header);
+  if (header.magic != strings_magic)
+    corrupt("wrong magic number");
+  if (header.size != m_file.size())
+    corrupt("wrong size");
+  if (!header.count != !header.buckets || header.count < header.buckets)
+    corrupt("wrong number of buckets");
+  uint64_t end = sizeof header + uint64_t(header.buckets) * 4 +
+                 uint64_t(header.count) * sizeof(Slot);
+  if (header.size < end)
+    corrupt("slots are past the end");
+  m_count = header.count;
+  m_buckets = header.buckets;
+  m_seeds = data + sizeof header;
+  m_slots = m_seeds + 4 * m_buckets;
+}
+
+bool StringTable::find(std::string_view key, String &out) const {
+  if (!m_count)
+    return false;
+  uint64_t h = hash_key(key);
+  uint32_t seed = read32(m_seeds + 4 * bucket(h, m_buckets));
+  Slot s;
+  memcpy(&s, m_slots + sizeof s * slot(h, seed, m_count), sizeof s);
+  // Values are followed by a null character.
+  size_t size = m_file.size();
+  if (size < uint64_t(s.key) + s.key_size ||
+      size <= uint64_t(s.value) + s.value_size)
+    corrupt("string is past the end");
+  const char *base = reinterpret_cast<const char *>(m_file.data());
+  if (key != std::string_view(base + s.key, s.key_size))
+    return false;
+  out.text = std::string_view(base + s.value, s.value_size);
+  out.hints = s.hints;
+  return true;
+}
+
+std::string_view StringTable::get(std::string_view key) const {
+  String s;
+  return find(key, s) ? s.text : key;
+}
+
+uint8_t StringTable::classify(std::string_view text) {
+  uint8_t hints = Basic;
+  const auto *p = reinterpret_cast<const uint8_t *>(text.data());
+  const uint8_t *end = p + text.size();
+  while (p < end) {
+    uint32_t c = *p++;
+    if (c < 0x80)
+      continue;
+    // Decode the rest of the sequence. Malformed text isn't Basic, but is
+    // otherwise left for the font code to deal with.
+    int extra = c >= 0xf0 ? 3 : c >= 0xe0 ? 2 : c >= 0xc0 ? 1 : -1;
+    if (extra < 0 || end - p < extra) {
+      hints &= ~Basic;
+      break;
+    }
+    c &= 0x3f >> extra;
+    for (int i = 0; i < extra; i++)
+      c = c << 6 | (*p++ & 0x3f);
+    if (c >= 0x300)
+      hints &= ~Basic;
+    if ((c >= 0x590 && c < 0x900) || (c >= 0xfb1d && c < 0xfe00) ||
+        (c >= 0xfe70 && c < 0xff00) || (c >= 0x10800 && c < 0x10fff) ||
+        (c >= 0x1e800 && c < 0x1efff))
+      hints |= RightToLeft;
+  }
+  return hints;
+}
+
+ByteWriter StringTable::compile(
+    const std::vector<std::pair<std::string, std::string>> &strings) {
+  using limits = std::numeric_limits<uint32_t>;
+  // About four keys per bucket keeps the seeds small and quick to find.
+  size_t n = strings.size();
+  if (limits::max() / sizeof(Slot) < n) {
+    log_crit("Too many strings: %zu", n);
+    throw FatalError::Encode;
+  }
+  uint32_t count = uint32_t(n);
+  uint32_t buckets = uint32_t((n + 3) / 4);
+
+  std::vector<uint64_t> hashes(count);
+  std::vector<std::vector<uint32_t>> members(buckets);
+  for (uint32_t i = 0; i < count; i++) {
+    const std::string &key = strings[i].first;
+    if (std::numeric_limits<uint16_t>::max() < key.size()) {
+      log_crit("String key is too long: %zu bytes", key.size());
+      throw FatalError::Encode;
+    }
+    hashes[i] = hash_key(key);
+    members[bucket(hashes[i], buckets)].push_back(i);
+  }
+
+  // Equal keys always share a bucket, so duplicates are found here.
+  for (const std::vector<uint32_t> &keys : members) {
+    for (size_t i = 0; i < keys.size(); i++) {
+      for (size_t j = 0; j < i; j++) {
+        if (hashes[keys[i]] != hashes[keys[j]])
+          continue;
+        const std::string &key = strings[keys[i]].first;
+        if (key == strings[keys[j]].first)
+          log_crit("Duplicate string key: %s", key.c_str());
+        else
+          log_crit("String keys have the same hash: %s, %s", key.c_str(),
+                   strings[keys[j]].first.c_str());
+        throw FatalError::Encode;
+      }
+    }
+  }
+
+  // Place the largest buckets first, while most slots are free.
+  std::vector<uint32_t> order(buckets);
+  for (uint32_t i = 0; i < buckets; i++)
+    order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return members[a].size() > members[b].size();
+  });
+  std::vector<uint32_t> seeds(buckets);
+  std::vector<uint32_t> slot_of(count);
+  std::vector<bool> taken(count);
+  std::vector<uint32_t> picked;
+  for (uint32_t b : order) {
+    const std::vector<uint32_t> &keys = members[b];
+    if (keys.empty())
+      break;
+    uint32_t seed = 0;
+    for (;; seed++) {
+      if (seed == max_seed) {
+        log_crit("Could not build string table");
+        throw FatalError::Encode;
+      }
+      picked.clear();
+      for (uint32_t key : keys) {
+        uint32_t s = slot(hashes[key], seed, count);
+        if (taken[s] || std::find(picked.begin(), picked.end(), s) !=
+                            picked.end())
+          break;
+        picked.push_back(s);
+      }
+      if (picked.size() == keys.size())
+        break;
+    }
+    seeds[b] = seed;
+    for (size_t i = 0; i < keys.size(); i++) {
+      taken[picked[i]] = true;
+      slot_of[keys[i]] = picked[i];
+    }
+  }
+
+  // Strings follow the slots, in the order they were given.
+  uint64_t offset = sizeof(Header) + uint64_t(buckets) * 4 +
+                    uint64_t(count) * sizeof(Slot);
+  std::vector<Slot> slots(count);
+  for (uint32_t i = 0; i < count; i++) {
+    const auto &[key, value] = strings[i];
+    Slot &s = slots[slot_of[i]];
+    s.key = uint32_t(offset);
+    s.key_size = uint16_t(key.size());
+    offset += key.size();
+    s.value = uint32_t(offset);
+    s.value_size = uint32_t(value.size());
+    offset += value.size() + 1;
+    s.hints = classify(value);
+    s.pad = 0;
+    if (limits::max() < offset) {
+      log_crit("String table is too large");
+      throw FatalError::Encode;
+    }
+  }
+
+  ByteWriter file;
+  file.reserve(offset);
+  file.put(Header{strings_magic, count, buckets, uint32_t(offset)});
+  file.write(seeds.data(), seeds.size() * 4);
+  file.write(slots.data(), slots.size() * sizeof(Slot));
+  for (const auto &[key, value] : strings) {
+    file.write(key.data(), key.size());
+    file.write(value.c_str(), value.size() + 1);
+  }
+  return file;
+}
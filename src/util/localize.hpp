@@ -0,0 +1,97 @@
+/**
+ * \file
+ * \brief Look up localized strings in compiled tables.
+ */
+
+#ifndef LOCALIZE_HPP
+#define LOCALIZE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "asset.hpp"
+#include "serial.hpp"
+
+/**
+ * \brief The strings of one language, read in place from a compiled file.
+ *
+ * Files are made with compile() and loaded with AssetSystem::map(), so
+ * switching languages is mapping a different file. Nothing is copied or
+ * indexed at load time.
+ *
+ * Keys are found with a minimal perfect hash: each key hashes to a bucket,
+ * and each bucket stores a small seed chosen when the file was compiled so
+ * that its keys land in distinct slots. The slots are exactly as many as the
+ * keys. A lookup is one hash, one seed and one slot, whose key is compared to
+ * rule out keys that aren't in the table. Offsets are checked against the
+ * size of the file as they're read.
+ *
+ * Each string also has hints about its text, worked out when the file is
+ * compiled, so text layout can skip work it doesn't need.
+ */
+class StringTable {
+public:
+  /// Facts about the text of a string.
+  enum Hint : uint8_t {
+    /// Only characters below U+0300, so no combining marks or scripts that
+    /// need complex shaping.
+    Basic = 1,
+    /// Some characters from right-to-left scripts.
+    RightToLeft = 2,
+  };
+
+  /// A string found in the table.
+  struct String {
+    std::string_view text; ///< UTF-8, followed by a null character.
+    uint8_t hints;         ///< Hint flags.
+  };
+
+private:
+  AssetMapping m_file;
+  uint32_t m_count = 0;   ///< Number of strings.
+  uint32_t m_buckets = 0; ///< Number of seeds.
+  const uint8_t *m_seeds = nullptr;
+  const uint8_t *m_slots = nullptr;
+
+public:
+  /// Create an empty table, where every lookup fails.
+  StringTable() = default;
+
+  /**
+   * \brief Use a compiled file.
+   * \throw FatalError::Decode if the header is invalid
+   */
+  explicit StringTable(AssetMapping file);
+
+  /**
+   * \brief Compile a table.
+   * \param strings pairs of key and UTF-8 text
+   * \return the file contents
+   * \throw FatalError::Encode if there are duplicate keys or the file would
+   * be 4 GiB or more
+   */
+  static ByteWriter
+  compile(const std::vector<std::pair<std::string, std::string>> &strings);
+
+  /// Get the number of strings.
+  size_t size() const { return m_count; }
+
+  /**
+   * \brief Look up a string.
+   * \return false if there's no such key
+   * \throw FatalError::Decode if the file is corrupt
+   */
+  bool find(std::string_view key, String &out) const;
+
+  /// Get a string's text, or the key itself if it's missing.
+  std::string_view get(std::string_view key) const;
+
+  /// Work out the Hint flags for UTF-8 text.
+  static uint8_t classify(std::string_view text);
+};
+
+#endif
@@ -0,0 +1,142 @@
+#include "mask.hpp"
+
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+unsigned popcount(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_popcountll(v);
+#else
+  v -= v >> 1 & 0x5555555555555555;
+  v = (v & 0x3333333333333333) + (v >> 2 & 0x3333333333333333);
+  v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0f;
+  return v * 0x0101010101010101 >> 56;
+#endif
+}
+
+#ifdef __SSE2__
+
+/// Get a bit for each of 16 bytes that is at least the threshold.
+unsigned threshold16(__m128i v, __m128i threshold) {
+  // There's no unsigned compare, but max(v, t) == v means v >= t.
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, threshold), v));
+}
+
+/// Get the alpha of 16 RGBA pixels.
+__m128i alpha16(const uint8_t *src) {
+  auto load = [src](int i) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src) + i);
+    return _mm_srli_epi32(v, 24);
+  };
+  __m128i lo = _mm_packs_epi32(load(0), load(1));
+  __m128i hi = _mm_packs_epi32(load(2), load(3));
+  return _mm_packus_epi16(lo, hi);
+}
+
+#endif
+
+} // namespace
+
+BitMask::BitMask(unsigned w, unsigned h)
+    : m_width(w), m_height(h), m_words((w + 63) / 64),
+      m_bits(size_t(m_words) * h) {}
+
+BitMask BitMask::from_alpha(ConstImageView image, uint8_t threshold) {
+  assert(image.kind() == ImageType::RGBA ||
+         image.kind() == ImageType::Luminance);
+  BitMask mask(image.width(), image.height());
+  unsigned step = bytes_per_pixel(image.kind());
+  bool rgba = image.kind() == ImageType::RGBA;
+#ifdef __SSE2__
+  __m128i t = _mm_set1_epi8(char(threshold));
+#endif
+  for (unsigned y = 0; y < image.height(); y++) {
+    if (!image.width())
+      break;
+    const uint8_t *src = image.pixel(0, y);
+    uint64_t *dst = &mask.m_bits[size_t(y) * mask.m_words];
+    unsigned x = 0;
+#ifdef __SSE2__
+    for (; x + 16 <= image.width(); x += 16, src += 16 * step) {
+      __m128i v =
+          rgba ? alpha16(src)
+               : _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+      dst[x / 64] |= uint64_t(threshold16(v, t)) << (x % 64);
+    }
+#endif
+    for (; x < image.width(); x++, src += step)
+      if (src[rgba ? 3 : 0] >= threshold)
+        dst[x / 64] |= uint64_t(1) << (x % 64);
+  }
+  return mask;
+}
+
+void BitMask::set(unsigned x, unsigned y, bool value) {
+  assert(x < m_width && y < m_height);
+  uint64_t &word = m_bits[size_t(y) * m_words + x / 64];
+  uint64_t bit = uint64_t(1) << (x % 64);
+  word = value ? word | bit : word & ~bit;
+}
+
+size_t BitMask::count() const {
+  size_t n = 0;
+  for (uint64_t word : m_bits)
+    n += popcount(word);
+  return n;
+}
+
+bool BitMask::overlaps(const BitMask &other, int32_t dx, int32_t dy) const {
+  bool found = false;
+  each_word(other, dx, dy, [&](uint64_t a, uint64_t b) {
+    found = a & b;
+    return found;
+  });
+  return found;
+}
+
+size_t BitMask::overlap(const BitMask &other, int32_t dx, int32_t dy) const {
+  size_t n = 0;
+  each_word(other, dx, dy, [&](uint64_t a, uint64_t b) {
+    n += popcount(a & b);
+    return false;
+  });
+  return n;
+}
+
+uint64_t BitMask::bits(unsigned y, int64_t x) const {
+  // Split into a whole word and a shift, rounding down for negative x.
+  int64_t i = x >= 0 ? x / 64 : -((63 - x) / 64);
+  unsigned shift = x - i * 64;
+  const uint64_t *r = row(y);
+  auto word = [&](int64_t k) {
+    return 0 <= k && k < m_words ? r[k] : 0;
+  };
+  uint64_t v = word(i) >> shift;
+  if (shift)
+    v |= word(i + 1) << (64 - shift);
+  return v;
+}
+
+template <typename F>
+void BitMask::each_word(const BitMask &other, int32_t dx, int32_t dy,
+                        F fn) const {
+  // Only the rows and words where the masks intersect.
+  int64_t x0 = std::max<int64_t>(0, dx);
+  int64_t x1 = std::min<int64_t>(m_width, int64_t(dx) + other.m_width);
+  int64_t y0 = std::max<int64_t>(0, dy);
+  int64_t y1 = std::min<int64_t>(m_height, int64_t(dy) + other.m_height);
+  if (x1 <= x0 || y1 <= y0)
+    return;
+  int64_t w0 = x0 / 64, w1 = (x1 + 63) / 64;
+  for (int64_t y = y0; y < y1; y++) {
+    const uint64_t *a = row(y);
+    for (int64_t w = w0; w < w1; w++)
+      if (fn(a[w], other.bits(y - dy, w * 64 - dx)))
+        return;
+  }
+}
@@ -0,0 +1,82 @@
+/**
+ * \file
+ * \brief Pack images into one bit per pixel for collision tests.
+ */
+
+#ifndef MASK_HPP
+#define MASK_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "image.hpp"
+
+/**
+ * \brief An image with one bit per pixel.
+ *
+ * Each row is stored as 64-bit words, with pixel x in bit x % 64 of word
+ * x / 64. Bits past the width of a row are always clear. Overlap tests shift
+ * and AND whole words, so comparing two 64×64 masks takes a few hundred word
+ * operations instead of thousands of pixel comparisons.
+ */
+class BitMask {
+  unsigned m_width = 0, m_height = 0;
+  unsigned m_words = 0; ///< Words per row.
+  std::vector<uint64_t> m_bits;
+
+public:
+  BitMask() = default;
+  /// Create a mask with all bits clear.
+  BitMask(unsigned w, unsigned h);
+
+  /**
+   * \brief Set the bits of pixels that are opaque enough.
+   *
+   * RGBA images are tested by alpha and luminance images by value. Pass a
+   * subview to make a mask of one sprite in an atlas.
+   *
+   * \param image RGBA or luminance image
+   * \param threshold lowest value that sets a bit
+   */
+  static BitMask from_alpha(ConstImageView image, uint8_t threshold = 128);
+
+  /// Get the number of columns of pixels.
+  unsigned width() const { return m_width; }
+  /// Get the number of rows of pixels.
+  unsigned height() const { return m_height; }
+  /// Get the words of row y.
+  const uint64_t *row(unsigned y) const {
+    assert(y < m_height);
+    return &m_bits[size_t(y) * m_words];
+  }
+
+  bool get(unsigned x, unsigned y) const {
+    assert(x < m_width);
+    return row(y)[x / 64] >> (x % 64) & 1;
+  }
+  void set(unsigned x, unsigned y, bool value);
+
+  /// Count the set bits.
+  size_t count() const;
+
+  /**
+   * \brief Check if any set bits touch when another mask is placed on this.
+   * \param other mask with its top left corner at (dx, dy) on this one
+   */
+  bool overlaps(const BitMask &other, int32_t dx, int32_t dy) const;
+
+  /// Count the pixels set in both masks, placed as for overlaps().
+  size_t overlap(const BitMask &other, int32_t dx, int32_t dy) const;
+
+private:
+  /// Get 64 bits of row y, starting at column x (may be outside the mask).
+  uint64_t bits(unsigned y, int64_t x) const;
+
+  /// Call fn(a, b) on each pair of words that line up, until it's true.
+  template <typename F>
+  void each_word(const BitMask &other, int32_t dx, int32_t dy, F fn) const;
+};
+
+#endif
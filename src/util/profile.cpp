@@ -0,0 +1,186 @@
+#include "profile.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+#include <SDL3/SDL_stdinc.h>
+#include <SDL3/SDL_timer.h>
+
+#include "util.hpp"
+
+namespace {
+
+/**
+ * \brief Get the histogram bucket of a time in microseconds.
+ *
+ * Times under 16 µs get a bucket each. Above that, each power of two is split
+ * into 8 buckets.
+ */
+size_t bucket(uint32_t us) {
+  if (us < 16)
+    return us;
+  unsigned e = 1;
+  while (us >> (e + 4))
+    e++;
+  return 16 + (e - 1) * 8 + (us >> e & 7);
+}
+
+/// Append a JSON string with the characters that need it escaped.
+void append_json(std::string &out, const std::string &s) {
+  out += '"';
+  for (char c : s) {
+    if (c == '"' || c == '\\')
+      out += '\\';
+    if (0 <= c && c < ' ')
+      out += '?';
+    else
+      out += c;
+  }
+  out += '"';
+}
+
+} // namespace
+
+FrameProfiler::FrameProfiler(const Params &params)
+    : m_params(params), m_frames(params.before + params.after + 1) {
+  m_params.window = std::max(m_params.window, 1u);
+  phase("frame");
+}
+
+unsigned FrameProfiler::phase(const char *name) {
+  for (unsigned i = 0; i < m_phases.size(); i++)
+    if (m_phases[i].name == name)
+      return i;
+  // Count the phase as unused in the frames before it was added.
+  Phase &p = m_phases.emplace_back();
+  p.name = name;
+  p.recent.resize(m_params.window);
+  p.counts[0] = std::min<uint64_t>(m_count, m_params.window);
+  return m_phases.size() - 1;
+}
+
+void FrameProfiler::begin_frame(uint64_t time) {
+  m_current.begin = time;
+  m_current.spans.clear();
+}
+
+void FrameProfiler::add(unsigned phase, uint64_t begin, uint64_t end) {
+  m_current.spans.push_back({phase, begin, end});
+  m_phases[phase].total += end - begin;
+}
+
+void FrameProfiler::end_frame(uint64_t time) {
+  m_current.end = time;
+  m_phases[0].total = time - m_current.begin;
+  size_t slot = m_count % m_params.window;
+  for (Phase &p : m_phases) {
+    auto us = uint32_t(std::min<uint64_t>(p.total / 1000, UINT32_MAX));
+    if (m_params.window <= m_count)
+      p.counts[bucket(p.recent[slot])]--;
+    p.recent[slot] = us;
+    p.counts[bucket(us)]++;
+  }
+
+  uint64_t number = m_count++;
+  std::swap(m_frames[number % m_frames.size()], m_current);
+  if (m_params.hitch < m_phases[0].total) {
+    m_hitches++;
+    log_hitch(m_frames[number % m_frames.size()]);
+    if (!m_dump_pending) {
+      m_dump_pending = true;
+      m_dump_at = number + m_params.after;
+    }
+  }
+  for (Phase &p : m_phases)
+    p.total = 0;
+  if (m_dump_pending && m_dump_at <= number) {
+    m_dump_pending = false;
+    if (m_params.dump)
+      dump();
+  }
+}
+
+uint64_t FrameProfiler::recent(unsigned phase, size_t age) const {
+  assert(age < frames());
+  size_t slot = (m_count - 1 - age) % m_params.window;
+  return uint64_t(m_phases[phase].recent[slot]) * 1000;
+}
+
+FrameProfiler::Stats FrameProfiler::stats(unsigned phase) const {
+  const Phase &p = m_phases[phase];
+  Stats s;
+  s.frames = frames();
+  if (!s.frames)
+    return s;
+  uint32_t max = 0;
+  for (size_t i = 0; i < s.frames; i++)
+    max = std::max(max, p.recent[i]);
+  // Buckets only give an upper bound, which could be more than the maximum.
+  s.max = uint64_t(max) * 1000;
+  uint64_t *out[] = {&s.p50, &s.p90, &s.p99};
+  const unsigned percents[] = {50, 90, 99};
+  size_t seen = 0, b = 0;
+  for (int i = 0; i < 3; i++) {
+    size_t rank = (s.frames * percents[i] + 99) / 100;
+    for (; seen + p.counts[b] < rank; b++)
+      seen += p.counts[b];
+    *out[i] = std::min(bucket_limit(b), s.max + 999);
+  }
+  return s;
+}
+
+uint64_t FrameProfiler::bucket_limit(size_t bucket) {
+  if (bucket < 16)
+    return bucket * 1000 + 999;
+  unsigned e = (bucket - 16) / 8 + 1;
+  uint64_t lower = uint64_t(8 + (bucket - 16) % 8) << e;
+  return (lower + (uint64_t(1) << e)) * 1000 - 1;
+}
+
+uint64_t FrameProfiler::now() { return SDL_GetTicksNS(); }
+
+void FrameProfiler::log_hitch(const Frame &frame) const {
+  // List the phases that took the most time first.
+  std::vector<std::pair<uint64_t, unsigned>> totals;
+  for (unsigned i = 1; i < m_phases.size(); i++)
+    if (m_phases[i].total)
+      totals.emplace_back(m_phases[i].total, i);
+  std::sort(totals.rbegin(), totals.rend());
+  char buf[256];
+  size_t n = SDL_snprintf(buf, sizeof buf, "Hitch: %.1f ms",
+                          (frame.end - frame.begin) * 1e-6);
+  for (auto [total, i] : totals) {
+    if (sizeof buf <= n)
+      break;
+    n += SDL_snprintf(buf + n, sizeof buf - n, ", %s %.1f ms",
+                      m_phases[i].name.c_str(), total * 1e-6);
+  }
+  log_warn("%s", buf);
+}
+
+void FrameProfiler::dump() const {
+  std::string out = "{\"traceEvents\":[\n";
+  char buf[128];
+  auto event = [&](const std::string &name, uint64_t begin, uint64_t end) {
+    out += "{\"name\":";
+    append_json(out, name);
+    SDL_snprintf(buf, sizeof buf,
+                 ",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+                 begin * 1e-3, (end - begin) * 1e-3);
+    out += buf;
+    out += ",\n";
+  };
+  size_t num = std::min<uint64_t>(m_count, m_frames.size());
+  for (uint64_t i = m_count - num; i < m_count; i++) {
+    const Frame &f = m_frames[i % m_frames.size()];
+    event(m_phases[0].name, f.begin, f.end);
+    for (const Span &s : f.spans)
+      event(m_phases[s.phase].name, s.begin, s.end);
+  }
+  if (num) {
+    out.pop_back();
+    out.pop_back();
+  }
+  out += "\n]}\n";
+  m_params.dump(out);
+}
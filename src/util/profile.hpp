@@ -0,0 +1,165 @@
+/**
+ * \file
+ * \brief Measure where each frame's time goes and catch hitches.
+ */
+
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * \brief Frame time profiler for the main thread.
+ *
+ * Each frame is split into named phases (input, simulation, rendering, etc.)
+ * that are timed with Scope. For the frame as a whole and for each phase, the
+ * profiler keeps a histogram of the last few seconds of frames, from which it
+ * computes percentiles. Rare spikes show up in the high percentiles even
+ * when the average looks fine.
+ *
+ * When a frame takes longer than the hitch threshold, the profiler logs where
+ * its time went. It then waits for a few more frames and dumps the frames
+ * around the hitch as a trace in Chrome's JSON format, which can be opened in
+ * Perfetto or chrome://tracing.
+ *
+ * Times are in nanoseconds from SDL_GetTicksNS().
+ */
+class FrameProfiler {
+public:
+  /// Number of histogram buckets.
+  static constexpr size_t buckets = 256;
+
+  /// Receives a trace in Chrome's JSON format.
+  using Dump = std::function<void(const std::string &trace)>;
+
+  /// Tuning parameters.
+  struct Params {
+    uint64_t hitch = 50000000; ///< Frames longer than this are hitches.
+    unsigned before = 30;      ///< Frames before a hitch to include in a dump.
+    unsigned after = 10;       ///< Frames after a hitch to include in a dump.
+    unsigned window = 1024;    ///< Frames in the histograms.
+    Dump dump;                 ///< Receives traces of hitches (optional).
+  };
+
+  /// Summary of recent frames, in nanoseconds.
+  struct Stats {
+    uint64_t p50 = 0, p90 = 0, p99 = 0; ///< Percentiles (within 12.5%).
+    uint64_t max = 0;
+    size_t frames = 0; ///< Number of frames in the window.
+  };
+
+  /// Time a phase from construction to destruction.
+  class Scope {
+    FrameProfiler &m_profiler;
+    unsigned m_phase;
+    uint64_t m_begin;
+
+  public:
+    Scope(FrameProfiler &profiler, unsigned phase)
+        : m_profiler(profiler), m_phase(phase), m_begin(now()) {}
+    ~Scope() { m_profiler.add(m_phase, m_begin, now()); }
+
+    Scope(const Scope &other) = delete;
+    Scope &operator=(const Scope &other) = delete;
+  };
+
+private:
+  /// A timed interval within a frame.
+  struct Span {
+    unsigned phase;
+    uint64_t begin, end;
+  };
+
+  /// Recent frames, kept for dumps.
+  struct Frame {
+    uint64_t begin = 0, end = 0;
+    std::vector<Span> spans;
+  };
+
+  /// Histogram of one phase.
+  struct Phase {
+    std::string name;
+    uint64_t total = 0;           ///< Time in the current frame.
+    std::vector<uint32_t> recent; ///< Ring of totals in microseconds.
+    std::array<uint32_t, buckets> counts = {};
+  };
+
+  Params m_params;
+  std::vector<Phase> m_phases;
+  Frame m_current;
+  std::vector<Frame> m_frames; ///< Ring of recent frames.
+  uint64_t m_count = 0;        ///< Number of finished frames.
+  uint64_t m_hitches = 0;
+  bool m_dump_pending = false;
+  uint64_t m_dump_at = 0; ///< Frame number to dump after.
+
+public:
+  /// Create a profiler with the phase "frame" for whole frames.
+  explicit FrameProfiler(const Params &params);
+
+  /**
+   * \brief Get the index of a phase, adding it if it's new.
+   * \param name label for stats and traces
+   */
+  unsigned phase(const char *name);
+
+  /// Get the name of a phase.
+  const std::string &name(unsigned phase) const {
+    return m_phases[phase].name;
+  }
+
+  /// Get the number of phases, including "frame".
+  size_t phases() const { return m_phases.size(); }
+
+  /// Start a frame. Call once per frame, before any phases.
+  void begin_frame(uint64_t time = now());
+
+  /// Record time spent in a phase during the current frame.
+  void add(unsigned phase, uint64_t begin, uint64_t end);
+
+  /// Finish a frame, update the histograms and check for a hitch.
+  void end_frame(uint64_t time = now());
+
+  /// Get percentiles of a phase's time per frame.
+  Stats stats(unsigned phase) const;
+
+  /**
+   * \brief Get a phase's histogram over recent frames.
+   *
+   * Use bucket_limit() to get the range of each bucket.
+   */
+  const std::array<uint32_t, buckets> &histogram(unsigned phase) const {
+    return m_phases[phase].counts;
+  }
+
+  /// Get the number of frames in the histograms.
+  size_t frames() const {
+    return m_count < m_params.window ? m_count : m_params.window;
+  }
+
+  /**
+   * \brief Get a phase's time in a recent frame, in nanoseconds.
+   * \param age 0 for the last finished frame, up to frames() - 1
+   */
+  uint64_t recent(unsigned phase, size_t age) const;
+
+  /// Get the largest time in nanoseconds that falls into a bucket.
+  static uint64_t bucket_limit(size_t bucket);
+
+  /// Get the number of hitches so far.
+  uint64_t hitches() const { return m_hitches; }
+
+  /// Get the current time.
+  static uint64_t now();
+
+private:
+  void log_hitch(const Frame &frame) const;
+  void dump() const;
+};
+
+#endif
@@ -0,0 +1,188 @@
+#include "serial.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+
+#include <SDL3/SDL_endian.h>
+#include <zlib.h>
+
+#include "job.hpp"
+#include "util.hpp"
+
+static_assert(SDL_BYTEORDER == SDL_LIL_ENDIAN,
+              "Serialized data is little-endian");
+
+namespace {
+
+/// Uncompressed size of each block in compress_blocks().
+constexpr size_t block_size = size_t(1) << 20;
+
+/// Identifies the output of compress_blocks().
+constexpr uint32_t compress_magic = 0x315a4744; // "DGZ1"
+
+/// Largest output that decompress_blocks() accepts.
+constexpr uint64_t max_decompressed = uint64_t(1) << 32;
+
+/// Deflate can't compress data by more than this ratio.
+constexpr uint64_t max_deflate_ratio = 1032;
+
+} // namespace
+
+void ByteWriter::reserve(size_t n) {
+  if (n <= m_capacity - m_size)
+    return;
+  size_t capacity = std::max({m_size + n, m_capacity * 2, size_t(256)});
+  auto data = std::unique_ptr<uint8_t[]>(new uint8_t[capacity]);
+  if (m_size)
+    memcpy(data.get(), m_data.get(), m_size);
+  m_data = std::move(data);
+  m_capacity = capacity;
+}
+
+void ByteWriter::varint(uint64_t x) {
+  uint8_t buf[10];
+  size_t n = 0;
+  for (; 0x80 <= x; x >>= 7)
+    buf[n++] = uint8_t(x) | 0x80;
+  buf[n++] = uint8_t(x);
+  write(buf, n);
+}
+
+void ByteWriter::begin(uint32_t tag) {
+  varint(tag);
+  m_fields.push_back(m_size);
+  put(uint64_t(0));
+}
+
+void ByteWriter::end() {
+  size_t slot = m_fields.back();
+  m_fields.pop_back();
+  uint64_t size = m_size - slot - sizeof(uint64_t);
+  memcpy(m_data.get() + slot, &size, sizeof size);
+}
+
+void ByteWriter::pad() {
+  size_t n = (serial_align - m_size % serial_align) % serial_align;
+  if (n)
+    memset(grow(n), 0, n);
+}
+
+const uint8_t *ByteReader::read(size_t n) {
+  if (remaining() < n)
+    truncated();
+  const uint8_t *p = m_pos;
+  m_pos += n;
+  return p;
+}
+
+uint64_t ByteReader::varint() {
+  uint64_t x = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    uint8_t b = *read(1);
+    x |= uint64_t(b & 0x7f) << shift;
+    if (!(b & 0x80))
+      return x;
+  }
+  log_crit("Invalid varint");
+  throw FatalError::Decode;
+}
+
+std::string_view ByteReader::string() {
+  size_t n = varint();
+  return {reinterpret_cast<const char *>(read(n)), n};
+}
+
+bool ByteReader::field(uint32_t &tag, ByteReader &body) {
+  if (empty())
+    return false;
+  tag = varint();
+  size_t n = get<uint64_t>();
+  const uint8_t *p = read(n);
+  body = ByteReader(m_base, p, p + n);
+  return true;
+}
+
+void ByteReader::skip_padding() {
+  size_t off = m_pos - m_base;
+  read((serial_align - off % serial_align) % serial_align);
+}
+
+void ByteReader::truncated() {
+  log_crit("Serialized data is truncated");
+  throw FatalError::Decode;
+}
+
+void compress_blocks(const void *src, size_t num, ByteWriter &out,
+                     JobPool &pool, int level) {
+  auto bytes = static_cast<const uint8_t *>(src);
+  size_t blocks = (num + block_size - 1) / block_size;
+  // Compress each block into its own buffer, then concatenate them.
+  std::vector<std::unique_ptr<uint8_t[]>> packed(blocks);
+  std::vector<uint32_t> sizes(blocks);
+  pool.run(blocks, [&](size_t i) {
+    size_t n = std::min(block_size, num - i * block_size);
+    uLongf size = compressBound(n);
+    packed[i].reset(new uint8_t[size]);
+    int status = compress2(packed[i].get(), &size, bytes + i * block_size, n,
+                           level);
+    if (status != Z_OK) {
+      log_crit("compress2: code %d", status);
+      throw FatalError::Encode;
+    }
+    sizes[i] = size;
+  });
+  out.put(compress_magic);
+  out.put(uint64_t(num));
+  // No arrays, since the output may start at any alignment.
+  for (uint32_t n : sizes)
+    out.put(n);
+  for (size_t i = 0; i < blocks; i++)
+    out.write(packed[i].get(), sizes[i]);
+}
+
+void decompress_blocks(const void *src, size_t num, ByteWriter &out,
+                       JobPool &pool) {
+  ByteReader in(src, num);
+  if (in.get<uint32_t>() != compress_magic) {
+    log_crit("Not compressed data");
+    throw FatalError::Decode;
+  }
+  auto total = in.get<uint64_t>();
+  if (total > max_decompressed) {
+    log_crit("Decompressed size is too large: %" PRIu64, total);
+    throw FatalError::Decode;
+  }
+  size_t num_blocks = (total + block_size - 1) / block_size;
+  if (in.remaining() / 4 < num_blocks) {
+    log_crit("Compressed data is truncated");
+    throw FatalError::Decode;
+  }
+  std::vector<uint32_t> sizes(num_blocks);
+  uint64_t packed = 0;
+  for (auto &n : sizes) {
+    n = in.get<uint32_t>();
+    packed += n;
+  }
+  // Check before allocating the output, since the sizes aren't checksummed.
+  if (packed > in.remaining()) {
+    log_crit("Compressed data is truncated");
+    throw FatalError::Decode;
+  }
+  if (total > packed * max_deflate_ratio) {
+    log_crit("Decompressed size doesn't match the blocks");
+    throw FatalError::Decode;
+  }
+  std::vector<const uint8_t *> blocks;
+  for (uint32_t n : sizes)
+    blocks.push_back(in.read(n));
+  uint8_t *dst = out.grow(total);
+  pool.run(blocks.size(), [&](size_t i) {
+    uLongf n = std::min<uint64_t>(block_size, total - i * block_size);
+    uLongf expect = n;
+    int status = uncompress(dst + i * block_size, &n, blocks[i], sizes[i]);
+    if (status != Z_OK || n != expect) {
+      log_crit("uncompress: code %d", status);
+      throw FatalError::Decode;
+    }
+  });
+}
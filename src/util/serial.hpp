@@ -0,0 +1,220 @@
+/**
+ * \file
+ * \brief Binary serialization with tagged fields.
+ *
+ * Values are stored in native byte order, which is little-endian on every
+ * platform the game ships on. Readers check bounds and throw
+ * FatalError::Decode on truncated data.
+ *
+ * Structures are written as a list of fields, each with a tag and a size. A
+ * reader skips fields with tags it doesn't know, and uses defaults for fields
+ * that are missing, so new fields can be added without breaking old files.
+ */
+
+#ifndef SERIAL_HPP
+#define SERIAL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+class JobPool;
+
+/// Arrays are padded to this alignment so they can be read in place.
+constexpr size_t serial_align = 8;
+
+/// Growable output buffer.
+class ByteWriter {
+  std::unique_ptr<uint8_t[]> m_data;
+  size_t m_size = 0;
+  size_t m_capacity = 0;
+  /// Positions of the size slots of fields that are still open.
+  std::vector<size_t> m_fields;
+
+public:
+  /// Get the written bytes.
+  const uint8_t *data() const { return m_data.get(); }
+
+  /// Get the number of bytes written.
+  size_t size() const { return m_size; }
+
+  /// Discard the contents but keep the memory.
+  void clear() {
+    m_size = 0;
+    m_fields.clear();
+  }
+
+  /// Make room for at least n more bytes.
+  void reserve(size_t n);
+
+  /**
+   * \brief Append uninitialized bytes.
+   * \return pointer to fill in, valid until the next write
+   */
+  uint8_t *grow(size_t n) {
+    if (m_capacity - m_size < n)
+      reserve(n);
+    uint8_t *p = m_data.get() + m_size;
+    m_size += n;
+    return p;
+  }
+
+  /// Append raw bytes.
+  void write(const void *p, size_t n) {
+    if (n)
+      memcpy(grow(n), p, n);
+  }
+
+  /// Append a plain data value.
+  template <typename T> void put(const T &value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    write(&value, sizeof value);
+  }
+
+  /// Append an unsigned integer in 1 to 10 bytes (LEB128).
+  void varint(uint64_t x);
+
+  /// Append a length-prefixed string.
+  void string(std::string_view s) {
+    varint(s.size());
+    write(s.data(), s.size());
+  }
+
+  /**
+   * \brief Append an array of plain data that can be read without copying.
+   * \see ByteReader::array()
+   */
+  template <typename T> void array(const T *p, size_t num) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    static_assert(alignof(T) <= serial_align);
+    varint(num);
+    pad();
+    write(p, num * sizeof(T));
+  }
+
+  /// Start a field. Fields can be nested.
+  void begin(uint32_t tag);
+
+  /// Finish the innermost open field.
+  void end();
+
+private:
+  /// Pad with zeros to a multiple of serial_align.
+  void pad();
+};
+
+/// A read-only array that points into a ByteReader's buffer.
+template <typename T> struct ArrayView {
+  const T *data = nullptr;
+  size_t size = 0;
+
+  const T *begin() const { return data; }
+  const T *end() const { return data + size; }
+  const T &operator[](size_t i) const { return data[i]; }
+};
+
+/**
+ * \brief Bounds-checked input from a buffer.
+ *
+ * The buffer must stay valid while views into it are used. To read arrays in
+ * place, it must be aligned to serial_align, as with memory from new[] or
+ * ByteWriter.
+ */
+class ByteReader {
+  const uint8_t *m_base; ///< Start of the outermost buffer, for alignment.
+  const uint8_t *m_pos;
+  const uint8_t *m_end;
+
+public:
+  /// Read from a buffer.
+  ByteReader(const void *p, size_t n)
+      : m_base(static_cast<const uint8_t *>(p)), m_pos(m_base),
+        m_end(m_base + n) {}
+
+  /// Get the number of bytes left.
+  size_t remaining() const { return m_end - m_pos; }
+
+  /// Check if everything has been read.
+  bool empty() const { return m_pos == m_end; }
+
+  /**
+   * \brief Consume raw bytes.
+   * \return pointer to the bytes in the buffer
+   * \throw FatalError::Decode if there aren't enough bytes
+   */
+  const uint8_t *read(size_t n);
+
+  /// Read a plain data value.
+  template <typename T> T get() {
+    static_assert(std::is_trivially_copyable_v<T>);
+    T value;
+    memcpy(&value, read(sizeof value), sizeof value);
+    return value;
+  }
+
+  /// Read an unsigned integer written by ByteWriter::varint().
+  uint64_t varint();
+
+  /// Read a string written by ByteWriter::string(). Points into the buffer.
+  std::string_view string();
+
+  /// Read an array written by ByteWriter::array(). Points into the buffer.
+  template <typename T> ArrayView<T> array() {
+    static_assert(std::is_trivially_copyable_v<T>);
+    size_t num = varint();
+    skip_padding();
+    if (remaining() / sizeof(T) < num)
+      truncated();
+    return {reinterpret_cast<const T *>(read(num * sizeof(T))), num};
+  }
+
+  /**
+   * \brief Read the next field.
+   * \param[out] tag field tag
+   * \param[out] body reader for the field's contents
+   * \return false if there are no more fields
+   */
+  bool field(uint32_t &tag, ByteReader &body);
+
+private:
+  ByteReader(const uint8_t *base, const uint8_t *pos, const uint8_t *end)
+      : m_base(base), m_pos(pos), m_end(end) {}
+
+  void skip_padding();
+
+  /// Log and throw FatalError::Decode.
+  [[noreturn]] static void truncated();
+};
+
+/**
+ * \brief Compress data as independent blocks.
+ *
+ * Blocks are compressed in parallel, and can be decompressed in parallel. The
+ * output is self-describing and includes checksums.
+ *
+ * \param src data to compress
+ * \param num size of the data
+ * \param[out] out compressed data is appended
+ * \param pool compresses blocks
+ * \param level 1 (fastest) to 9 (smallest)
+ * \throw FatalError::Encode if compression fails
+ */
+void compress_blocks(const void *src, size_t num, ByteWriter &out,
+                     JobPool &pool, int level = 1);
+
+/**
+ * \brief Decompress data from compress_blocks().
+ * \param src compressed data
+ * \param num size of the compressed data
+ * \param[out] out decompressed data is appended
+ * \param pool decompresses blocks
+ * \throw FatalError::Decode if the data is invalid
+ */
+void decompress_blocks(const void *src, size_t num, ByteWriter &out,
+                       JobPool &pool);
+
+#endif
@@ -0,0 +1,167 @@
+#include "sprite.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "job.hpp"
+#include "util.hpp"
+
+namespace {
+
+/// Pixel range [begin, end) whose centers fall inside [lo, lo + size).
+void cover(long &begin, long &end, float lo, float size) {
+  begin = std::lround(std::ceil(lo - 0.5f));
+  end = std::lround(std::ceil(lo + size - 0.5f));
+}
+
+/// Blend one straight-alpha texel (after tint) over one target pixel.
+void blend1(uint8_t *dst, const uint8_t *src, const uint8_t *tint) {
+  unsigned a = div255(src[3] * tint[3]);
+  unsigned na = 255 - a;
+  for (int c = 0; c < 3; c++)
+    dst[c] = div255(div255(src[c] * tint[c]) * a + dst[c] * na);
+  dst[3] = div255(255 * a + dst[3] * na);
+}
+
+#ifdef __SSE2__
+
+/// Divide eight 16-bit lanes by 255, rounding down (exact for x <= 255 * 255).
+__m128i div255(__m128i x) {
+  x = _mm_add_epi16(x, _mm_add_epi16(_mm_set1_epi16(1), _mm_srli_epi16(x, 8)));
+  return _mm_srli_epi16(x, 8);
+}
+
+/// Blend two pixels in 16-bit lanes.
+__m128i blend2(__m128i s, __m128i d, __m128i tint) {
+  s = div255(_mm_mullo_epi16(s, tint));
+  // Copy each pixel's alpha to all four of its lanes.
+  __m128i a = _mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3));
+  a = _mm_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+  // The output alpha is a + d * (1 - a), which is the color formula with 255
+  // in place of the source alpha.
+  const __m128i alpha = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+  s = _mm_or_si128(_mm_andnot_si128(_mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0), s),
+                   alpha);
+  __m128i na = _mm_sub_epi16(_mm_set1_epi16(255), a);
+  return div255(_mm_add_epi16(_mm_mullo_epi16(s, a), _mm_mullo_epi16(d, na)));
+}
+
+/// Blend four texels over four consecutive target pixels.
+void blend4(uint8_t *dst, const uint32_t *texels, __m128i tint) {
+  const __m128i zero = _mm_setzero_si128();
+  __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(texels));
+  __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst));
+  __m128i lo = blend2(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero),
+                      tint);
+  __m128i hi = blend2(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero),
+                      tint);
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_packus_epi16(lo, hi));
+}
+
+#endif
+
+/// Draw the part of a sprite that falls inside a clip rectangle.
+void draw_clipped(ImageView target, const ConstImageView &atlas,
+                  const Sprite &s, long cx0, long cy0, long cx1, long cy1) {
+  long x0, x1, y0, y1;
+  cover(x0, x1, s.x, s.w);
+  cover(y0, y1, s.y, s.h);
+  x0 = std::max(x0, cx0);
+  y0 = std::max(y0, cy0);
+  x1 = std::min(x1, cx1);
+  y1 = std::min(y1, cy1);
+  if (x1 <= x0 || y1 <= y0)
+    return;
+  // Source column of each destination column. Tiles are at most 256 wide.
+  unsigned columns[256];
+  float du = s.src_w / s.w;
+  for (long x = x0; x < x1; x++) {
+    long u = std::lround(std::floor((x + 0.5f - s.x) * du));
+    columns[x - x0] = s.src_x + std::clamp<long>(u, 0, s.src_w - 1);
+  }
+  float dv = s.src_h / s.h;
+#ifdef __SSE2__
+  // Source columns are consecutive at 1:1 scale, so they can be loaded at once.
+  bool unscaled = s.src_w == s.w;
+  __m128i tint = _mm_setr_epi16(s.tint[0], s.tint[1], s.tint[2], s.tint[3],
+                                s.tint[0], s.tint[1], s.tint[2], s.tint[3]);
+#endif
+  for (long y = y0; y < y1; y++) {
+    long v = std::lround(std::floor((y + 0.5f - s.y) * dv));
+    v = s.src_y + std::clamp<long>(v, 0, s.src_h - 1);
+    const uint8_t *row = atlas.pixel(0, v);
+    uint8_t *out = target.pixel(x0, y);
+    long n = x1 - x0;
+    long i = 0;
+#ifdef __SSE2__
+    for (; i + 4 <= n; i += 4, out += 16) {
+      uint32_t texels[4];
+      if (unscaled) {
+        memcpy(texels, row + columns[i] * 4, 16);
+      } else {
+        for (int k = 0; k < 4; k++)
+          memcpy(&texels[k], row + columns[i + k] * 4, 4);
+      }
+      blend4(out, texels, tint);
+    }
+#endif
+    for (; i < n; i++, out += 4)
+      blend1(out, row + columns[i] * 4, s.tint);
+  }
+}
+
+} // namespace
+
+SpriteRenderer::SpriteRenderer(JobPool &pool, unsigned tile_size)
+    : m_pool(pool), m_tile_size(tile_size) {
+  assert(0 < tile_size && tile_size <= 256);
+}
+
+void SpriteRenderer::draw(ImageView target, const ConstImageView *atlases,
+                          const Sprite *sprites, size_t num) {
+  assert(target.kind() == ImageType::RGBA);
+  long ts = m_tile_size;
+  long cols = (target.width() + ts - 1) / ts;
+  long rows = (target.height() + ts - 1) / ts;
+  m_bins.resize(cols * rows);
+  for (auto &bin : m_bins)
+    bin.clear();
+  // Sort sprites into tiles. Sprites are appended in order, so each tile's list
+  // is already in drawing order.
+  for (size_t i = 0; i < num; i++) {
+    const Sprite &s = sprites[i];
+    assert(atlases[s.atlas].kind() == ImageType::RGBA);
+    assert(s.src_x + s.src_w <= atlases[s.atlas].width());
+    assert(s.src_y + s.src_h <= atlases[s.atlas].height());
+    if (!s.src_w || !s.src_h || !(0 < s.w) || !(0 < s.h) || !s.tint[3])
+      continue;
+    long x0, x1, y0, y1;
+    cover(x0, x1, s.x, s.w);
+    cover(y0, y1, s.y, s.h);
+    x0 = std::max(x0, 0L);
+    y0 = std::max(y0, 0L);
+    x1 = std::min<long>(x1, target.width());
+    y1 = std::min<long>(y1, target.height());
+    if (x1 <= x0 || y1 <= y0)
+      continue;
+    for (long ty = y0 / ts; ty <= (y1 - 1) / ts; ty++)
+      for (long tx = x0 / ts; tx <= (x1 - 1) / ts; tx++)
+        m_bins[ty * cols + tx].push_back(i);
+  }
+  m_pool.run(m_bins.size(), [&](size_t t) {
+    long cx0 = t % cols * ts;
+    long cy0 = t / cols * ts;
+    long cx1 = std::min<long>(cx0 + ts, target.width());
+    long cy1 = std::min<long>(cy0 + ts, target.height());
+    for (uint32_t i : m_bins[t]) {
+      const Sprite &s = sprites[i];
+      draw_clipped(target, atlases[s.atlas], s, cx0, cy0, cx1, cy1);
+    }
+  });
+}
@@ -0,0 +1,63 @@
+/**
+ * \file
+ * \brief Draw sprites into images without a GPU.
+ */
+
+#ifndef SPRITE_HPP
+#define SPRITE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "image.hpp"
+
+class JobPool;
+
+/// A textured rectangle to draw. The source rectangle must be inside the
+/// atlas.
+struct Sprite {
+  unsigned atlas;        ///< Index into the list of atlas images.
+  unsigned src_x, src_y; ///< Top left corner of the source rectangle.
+  unsigned src_w, src_h; ///< Size of the source rectangle.
+  float x, y;            ///< Top left corner of the destination rectangle.
+  float w, h;            ///< Size of the destination rectangle.
+  uint8_t tint[4];       ///< RGBA multiplier (255 is unchanged).
+};
+
+/**
+ * \brief Software sprite renderer.
+ *
+ * The target is divided into square tiles. Sprites are sorted into the tiles
+ * they touch, and then the tiles are drawn in parallel. Within a tile, sprites
+ * are drawn in the order they were given.
+ *
+ * Sprites use nearest-neighbor sampling and alpha blending with straight
+ * (not premultiplied) alpha. Atlases and the target must be RGBA images.
+ */
+class SpriteRenderer {
+  JobPool &m_pool;
+  unsigned m_tile_size;
+  /// Sprite indices for each tile (reused between frames).
+  std::vector<std::vector<uint32_t>> m_bins;
+
+public:
+  /**
+   * \brief Create a renderer.
+   * \param pool worker threads that draw tiles
+   * \param tile_size width and height of each tile in pixels (at most 256)
+   */
+  explicit SpriteRenderer(JobPool &pool, unsigned tile_size = 64);
+
+  /**
+   * \brief Draw a batch of sprites.
+   * \param target image to draw on
+   * \param atlases source images referenced by Sprite::atlas
+   * \param sprites sprites in drawing order
+   * \param num number of sprites
+   */
+  void draw(ImageView target, const ConstImageView *atlases,
+            const Sprite *sprites, size_t num);
+};
+
+#endif
@@ -42,6 +42,10 @@ template <typename... Args> auto overload(Args &&...args) {
   return result{std::forward<Args>(args)...};
 }
 
+/// Divide by 255, rounding down (exact for x <= 255 * 255), as when blending
+/// 8-bit colors.
+inline unsigned div255(unsigned x) { return (x + 1 + (x >> 8)) >> 8; }
+
 /// A stream that writes one message to the log.
 class Logger {
   static std::ostream &out;
@@ -0,0 +1,245 @@
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <zlib.h>
+
+#include "animation.hpp"
+#include "image.hpp"
+#include "util.hpp"
+
+namespace {
+
+/// A frame to write with make_apng().
+struct TestFrame {
+  Animation::Frame info;
+  uint8_t color[4];
+};
+
+void put32(std::string &out, uint32_t v) {
+  for (int i = 0; i < 4; i++)
+    out.push_back(char(v >> (24 - 8 * i)));
+}
+
+void put_chunk(std::string &out, const char *type, const std::string &data) {
+  put32(out, data.size());
+  std::string body = type + data;
+  out += body;
+  put32(out, crc32(0, reinterpret_cast<const Bytef *>(body.data()),
+                   body.size()));
+}
+
+using Chunk = std::pair<std::string, std::string>;
+
+/// Get the chunks of a PNG file as (type, data) pairs.
+std::vector<Chunk> chunks(const std::string &png) {
+  std::vector<Chunk> result;
+  for (size_t pos = 8; pos < png.size();) {
+    auto b = reinterpret_cast<const uint8_t *>(&png[pos]);
+    uint32_t len = b[0] << 24 | b[1] << 16 | b[2] << 8 | b[3];
+    result.emplace_back(png.substr(pos + 4, 4), png.substr(pos + 8, len));
+    pos += len + 12;
+  }
+  return result;
+}
+
+/// Write a PNG file from chunks, with their CRCs.
+std::string join(const std::vector<Chunk> &chunks) {
+  std::string out("\x89PNG\r\n\x1a\n", 8);
+  for (auto &[type, data] : chunks)
+    put_chunk(out, type.c_str(), data);
+  return out;
+}
+
+/// Write an APNG file where each frame is filled with one color.
+std::string make_apng(unsigned w, unsigned h,
+                      const std::vector<TestFrame> &frames) {
+  std::string out("\x89PNG\r\n\x1a\n", 8), actl, seq;
+  unsigned sequence = 0;
+  put32(actl, frames.size());
+  put32(actl, 0);
+  for (size_t i = 0; i < frames.size(); i++) {
+    const Animation::Frame &f = frames[i].info;
+    Image image(ImageType::RGBA, f.w, f.h);
+    for (unsigned y = 0; y < f.h; y++)
+      for (unsigned x = 0; x < f.w; x++)
+        memcpy(image.pixel(x, y), frames[i].color, 4);
+    std::ostringstream os;
+    image.write_png(os);
+    std::string fctl;
+    put32(fctl, sequence++);
+    for (unsigned v : {f.w, f.h, f.x, f.y})
+      put32(fctl, v);
+    fctl += {0, char(f.delay * 100), 0, 100, char(f.dispose), char(f.blend)};
+    for (auto &[type, data] : chunks(os.str())) {
+      if (type == "IHDR" && !i) {
+        std::string header = data;
+        header.replace(0, 8, std::string(8, 0));
+        for (int k = 0; k < 4; k++) {
+          header[k] = char(w >> (24 - 8 * k));
+          header[4 + k] = char(h >> (24 - 8 * k));
+        }
+        put_chunk(out, "IHDR", header);
+        put_chunk(out, "acTL", actl);
+        put_chunk(out, "fcTL", fctl);
+      } else if (type == "IDAT" && !i) {
+        put_chunk(out, "IDAT", data);
+      } else if (type == "IDAT") {
+        if (!fctl.empty())
+          put_chunk(out, "fcTL", fctl);
+        fctl.clear();
+        std::string fdat;
+        put32(fdat, sequence++);
+        put_chunk(out, "fdAT", fdat + data);
+      }
+    }
+  }
+  put_chunk(out, "IEND", "");
+  return out;
+}
+
+Animation read(const std::string &data) {
+  MemoryBuffer is(data.data(), data.size());
+  return Animation::read_png(is);
+}
+
+using Dispose = Animation::Dispose;
+using Blend = Animation::Blend;
+
+/// Frames that use every dispose and blend operation on an 8×8 canvas.
+const std::vector<TestFrame> test_frames = {
+    {{0, 0, 8, 8, 0.5f, Dispose::None, Blend::Source}, {255, 0, 0, 255}},
+    {{2, 2, 3, 3, 0.1f, Dispose::Background, Blend::Over}, {0, 0, 255, 128}},
+    {{0, 0, 2, 2, 0.1f, Dispose::Previous, Blend::Source}, {0, 255, 0, 255}},
+    {{6, 6, 2, 2, 0.2f, Dispose::None, Blend::Over}, {0, 0, 0, 0}},
+    {{1, 1, 1, 1, 0.2f, Dispose::None, Blend::Source}, {9, 9, 9, 0}},
+};
+
+/// Check the color of a pixel, within one step of rounding.
+void check(ConstImageView canvas, unsigned x, unsigned y,
+           std::vector<int> color) {
+  for (int c = 0; c < 4; c++)
+    ASSERT_NEAR(canvas.pixel(x, y)[c], color[c], 1) << x << ", " << y;
+}
+
+/// Check the canvas of each frame of test_frames.
+void check_frame(ConstImageView canvas, size_t frame) {
+  const std::vector<int> red = {255, 0, 0, 255}, clear = {0, 0, 0, 0};
+  switch (frame) {
+  case 0:
+    check(canvas, 0, 0, red);
+    check(canvas, 7, 7, red);
+    break;
+  case 1:
+    check(canvas, 2, 2, {127, 0, 128, 255});
+    check(canvas, 4, 4, {127, 0, 128, 255});
+    check(canvas, 5, 5, red);
+    break;
+  case 2:
+    check(canvas, 1, 1, {0, 255, 0, 255});
+    check(canvas, 2, 2, clear);
+    check(canvas, 4, 4, clear);
+    check(canvas, 5, 5, red);
+    break;
+  case 3:
+  case 4:
+    check(canvas, 0, 0, red);
+    check(canvas, 1, 1, frame == 3 ? red : std::vector<int>{9, 9, 9, 0});
+    check(canvas, 3, 3, clear);
+    check(canvas, 6, 6, red);
+    break;
+  }
+}
+
+} // namespace
+
+TEST(Animation, Index) {
+  Animation a = read(make_apng(8, 8, test_frames));
+  ASSERT_EQ(a.width(), 8u);
+  ASSERT_EQ(a.height(), 8u);
+  ASSERT_EQ(a.plays(), 0u);
+  ASSERT_EQ(a.frames(), test_frames.size());
+  for (size_t i = 0; i < a.frames(); i++) {
+    const Animation::Frame &f = a.info(i), &expect = test_frames[i].info;
+    ASSERT_EQ(f.x, expect.x);
+    ASSERT_EQ(f.w, expect.w);
+    ASSERT_FLOAT_EQ(f.delay, expect.delay);
+    ASSERT_EQ(f.dispose, expect.dispose);
+    ASSERT_EQ(f.blend, expect.blend);
+  }
+
+  // A plain PNG is a single frame.
+  Image still(ImageType::RGB, 3, 2);
+  std::ostringstream os;
+  still.write_png(os);
+  Animation b = read(os.str());
+  ASSERT_EQ(b.frames(), 1u);
+  ASSERT_EQ(b.info(0).w, 3u);
+  check(b.frame(0), 2, 1, {still.pixel(2, 1)[0], still.pixel(2, 1)[1],
+                           still.pixel(2, 1)[2], 255});
+
+  std::string bad = make_apng(8, 8, test_frames);
+  ASSERT_THROW(read(bad.substr(0, bad.size() / 2)), FatalError);
+  ASSERT_THROW(read("not a png"), FatalError);
+}
+
+TEST(Animation, Compose) {
+  Animation a = read(make_apng(8, 8, test_frames));
+  for (size_t i = 0; i < a.frames(); i++)
+    check_frame(a.frame(i), i);
+  // Going back starts over.
+  for (size_t i : {2, 1, 4, 0, 3, 3})
+    check_frame(a.frame(i), i);
+}
+
+TEST(Animation, Cache) {
+  Animation a = read(make_apng(8, 8, test_frames));
+  a.set_cache(2);
+  for (size_t i : {3, 1, 4, 2, 0, 4, 1, 3, 2, 2, 0})
+    check_frame(a.frame(i), i);
+  a.set_cache(0);
+  for (size_t i : {4, 1, 3})
+    check_frame(a.frame(i), i);
+}
+
+TEST(Animation, Limits) {
+  std::string data = make_apng(8, 8, test_frames);
+  // Make the canvas too large to allocate.
+  std::vector<Chunk> large = chunks(data);
+  large[0].second.replace(0, 8, "\x00\x0f\x42\x40\x00\x0f\x42\x40", 8);
+  ASSERT_THROW(read(join(large)), FatalError);
+  large[0].second.replace(0, 8, "\x00\x0f\x42\x41\x00\x00\x00\x01", 8);
+  ASSERT_THROW(read(join(large)), FatalError);
+  // Move the second frame past the right edge of the canvas.
+  std::vector<TestFrame> frames = test_frames;
+  frames[1].info.x = 6;
+  ASSERT_THROW(read(make_apng(8, 8, frames)), FatalError);
+}
+
+TEST(Animation, Corrupt) {
+  std::string data = make_apng(8, 8, test_frames);
+  ASSERT_NO_THROW(read(join(chunks(data))));
+
+  // Frame data is checked against its CRC when the file is read, not only
+  // when the frame is decoded.
+  std::vector<Chunk> parts = chunks(data);
+  size_t fdat = 0;
+  while (parts[fdat].first != "fdAT")
+    fdat++;
+  std::string bad = data;
+  size_t pos = bad.find("fdAT") + 10;
+  bad[pos] ^= 1;
+  ASSERT_THROW(read(bad), FatalError);
+
+  // Frame chunks must be in sequence.
+  std::vector<Chunk> swapped = parts;
+  std::swap(swapped[fdat], swapped[fdat - 1]);
+  ASSERT_THROW(read(join(swapped)), FatalError);
+  std::vector<Chunk> skipped = parts;
+  skipped[fdat].second[3]++;
+  ASSERT_THROW(read(join(skipped)), FatalError);
+}
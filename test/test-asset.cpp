@@ -1,4 +1,9 @@
+#include <chrono>
 #include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
 
 #include <gtest/gtest.h>
 
@@ -41,9 +46,125 @@ TEST(Asset, ZipSource) {
   AssetSystem assets;
   assets.add_zip(0, is);
   size_t num;
-  auto is2 = assets.open("2.txt");
-  std::cerr << is2->rdbuf() << std::endl;
   std::unique_ptr<uint8_t[]> data = read_stream(num, *assets.open("1.txt"));
-  log_info("1.txt size: %zu", num);
-  log_info("1.txt data: %s", data.get());
+  ASSERT_EQ(std::string(reinterpret_cast<char *>(data.get()), num),
+            "Hello there\n");
+  // 2.txt is deflated.
+  const std::string text = "as;dlfjasd'fol aks\ndfpkas\ndf;k a\nsd'fkas\n"
+                           "d'fkas\n'd;fka\nsdl;fk\n";
+  data = read_stream(num, *assets.open("2.txt"));
+  ASSERT_EQ(std::string(reinterpret_cast<char *>(data.get()), num), text);
+  auto is2 = assets.open("2.txt");
+  is2->seekg(20);
+  ASSERT_EQ(is2->get(), text[20]);
+  ASSERT_EQ(is2->tellg(), 21);
+  is2->seekg(3);
+  ASSERT_EQ(is2->get(), text[3]);
+  is2->seekg(-1, std::ios::end);
+  ASSERT_EQ(is2->get(), '\n');
+  ASSERT_EQ(is2->get(), EOF);
+  // Deflated entries are mapped by decompressing them.
+  AssetMapping mapping = assets.map("2.txt");
+  ASSERT_EQ(std::string(reinterpret_cast<const char *>(mapping.data()),
+                        mapping.size()),
+            text);
+}
+
+TEST(Asset, Map) {
+  auto dir = std::filesystem::path(testing::TempDir()) / "test-asset";
+  std::filesystem::create_directories(dir / "sub");
+  {
+    std::ofstream os(dir / "sub/data.bin", std::ios::binary);
+    for (int i = 0; i < 10000; i++)
+      os << i << '\n';
+    std::ofstream empty(dir / "empty.bin", std::ios::binary);
+  }
+  AssetSystem assets;
+  assets.add_directory(0, dir.string().c_str());
+  AssetMapping mapping = assets.map("sub/data.bin");
+  size_t num;
+  std::unique_ptr<uint8_t[]> data =
+      read_stream(num, *assets.open("sub/data.bin"));
+  ASSERT_EQ(mapping.size(), num);
+  ASSERT_EQ(memcmp(mapping.data(), data.get(), num), 0);
+  ASSERT_EQ(reinterpret_cast<uintptr_t>(mapping.data()) % 8, 0u);
+#if defined(__unix__) || defined(__APPLE__)
+  ASSERT_TRUE(mapping.mapped());
+#endif
+
+  // Empty files can't be mapped, so they're read.
+  AssetMapping empty = assets.map("empty.bin");
+  ASSERT_EQ(empty.size(), 0u);
+  ASSERT_FALSE(empty.mapped());
+
+  AssetMapping moved = std::move(mapping);
+  ASSERT_EQ(moved.size(), num);
+  ASSERT_EQ(moved.data()[0], '0');
+  ASSERT_THROW(assets.map("missing.bin"), FatalError);
+  std::filesystem::remove_all(dir);
+}
+
+TEST(Asset, Stamp) {
+  auto dir = std::filesystem::path(testing::TempDir()) / "test-asset-stamp";
+  std::filesystem::create_directories(dir);
+  {
+    std::ofstream os(dir / "a.txt", std::ios::binary);
+    os << "hello";
+  }
+  AssetSystem assets;
+  assets.add_directory(0, dir.string().c_str());
+  AssetStamp stamp;
+  ASSERT_TRUE(assets.stamp("a.txt", stamp));
+  ASSERT_EQ(stamp.size, 5u);
+  ASSERT_FALSE(assets.stamp("missing.txt", stamp));
+  std::filesystem::remove_all(dir);
+}
+
+TEST(Asset, Throttle) {
+  auto dir = std::filesystem::path(testing::TempDir()) / "test-asset-slow";
+  std::filesystem::create_directories(dir);
+  std::string text(1 << 20, 'x');
+  for (size_t i = 0; i < text.size(); i += 1000)
+    text[i] = char('a' + i % 26);
+  {
+    std::ofstream os(dir / "big.bin", std::ios::binary);
+    os << text;
+  }
+  AssetSystem assets;
+  assets.add_directory(0, dir.string().c_str());
+  using clock = std::chrono::steady_clock;
+  using ms = std::chrono::milliseconds;
+
+  // 20 ms to open, then 100 ms to read at 10 MB/s.
+  assets.throttle(0, {20000000, 0, 10000000});
+  auto start = clock::now();
+  size_t num;
+  std::unique_ptr<uint8_t[]> data = read_stream(num, *assets.open("big.bin"));
+  ASSERT_GE(clock::now() - start, ms(120));
+  ASSERT_EQ(std::string(reinterpret_cast<char *>(data.get()), num), text);
+  start = clock::now();
+  AssetMapping mapping = assets.map("big.bin");
+  ASSERT_GE(clock::now() - start, ms(120));
+  ASSERT_EQ(mapping.size(), text.size());
+
+  // Each seek takes the seek time.
+  assets.throttle(0, {0, 30000000, 0});
+  auto is = assets.open("big.bin");
+  char c;
+  start = clock::now();
+  is->get(c);
+  ASSERT_EQ(c, 'a');
+  is->seekg(500000);
+  is->get(c);
+  ASSERT_EQ(c, 'a' + 500000 % 26);
+  ASSERT_GE(clock::now() - start, ms(60));
+  is->ignore(200000);
+  is->get(c);
+  ASSERT_EQ(c, 'x');
+
+  StorageProfile storage;
+  ASSERT_TRUE(StorageProfile::named("sd_card", storage));
+  ASSERT_EQ(storage.bandwidth, StorageProfile::sd_card().bandwidth);
+  ASSERT_FALSE(StorageProfile::named("floppy", storage));
+  std::filesystem::remove_all(dir);
 }
@@ -0,0 +1,209 @@
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "audio.hpp"
+#include "util.hpp"
+
+namespace {
+
+void put16(std::string &s, uint16_t x) {
+  s += char(x);
+  s += char(x >> 8);
+}
+
+void put32(std::string &s, uint32_t x) {
+  put16(s, x);
+  put16(s, x >> 16);
+}
+
+/// Build a 16-bit WAV file where every frame has the same samples.
+std::string make_wav(unsigned rate, std::vector<int16_t> frame, size_t num) {
+  unsigned channels = frame.size();
+  std::string data;
+  for (size_t i = 0; i < num; i++)
+    for (int16_t s : frame)
+      put16(data, s);
+  std::string s = "RIFF";
+  put32(s, 36 + data.size());
+  s += "WAVEfmt ";
+  put32(s, 16);
+  put16(s, 1);
+  put16(s, channels);
+  put32(s, rate);
+  put32(s, rate * channels * 2);
+  put16(s, channels * 2);
+  put16(s, 16);
+  s += "data";
+  put32(s, data.size());
+  return s + data;
+}
+
+std::unique_ptr<std::istream> open(std::string data) {
+  return std::make_unique<std::istringstream>(std::move(data));
+}
+
+/// A stream that blocks reads past a limit until the limit is raised.
+class GatedStream : public std::istream {
+  class StreamBuffer : public std::streambuf {
+    std::string m_data;
+    const std::atomic<size_t> &m_limit;
+    size_t m_pos = 0;
+    char m_storage[256];
+
+  public:
+    StreamBuffer(std::string data, const std::atomic<size_t> &limit)
+        : m_data(std::move(data)), m_limit(limit) {}
+
+    int_type underflow() override {
+      while (m_limit <= m_pos && m_pos < m_data.size())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      size_t n = std::min({sizeof m_storage, m_data.size() - m_pos,
+                           m_limit - m_pos});
+      if (!n)
+        return traits_type::eof();
+      memcpy(m_storage, m_data.data() + m_pos, n);
+      setg(m_storage, m_storage, m_storage + n);
+      m_pos += n;
+      return traits_type::to_int_type(m_storage[0]);
+    }
+
+    pos_type seekoff(off_type off, seekdir dir, openmode which) override {
+      off_type base = dir == beg   ? 0
+                      : dir == end ? off_type(m_data.size())
+                                   : off_type(m_pos - (egptr() - gptr()));
+      return seekpos(base + off, which);
+    }
+
+    pos_type seekpos(pos_type pos, openmode) override {
+      if (size_t(pos) > m_data.size())
+        return pos_type(off_type(-1));
+      setg(nullptr, nullptr, nullptr);
+      m_pos = pos;
+      return pos;
+    }
+  };
+
+  StreamBuffer m_underlying;
+
+public:
+  GatedStream(std::string data, const std::atomic<size_t> &limit)
+      : m_underlying(std::move(data), limit) {
+    rdbuf(&m_underlying);
+  }
+};
+
+/// Mix one frame at a time until the voice has started producing output.
+void wait_for_output(AudioMixer &mixer) {
+  for (int i = 0; i < 1000; i++) {
+    float out[2];
+    mixer.mix(out, 1);
+    if (out[0] != 0 || out[1] != 0)
+      return;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  FAIL() << "Voice never started";
+}
+
+} // namespace
+
+TEST(Audio, SampleRing) {
+  SampleRing ring(1000);
+  ASSERT_EQ(ring.capacity(), 1024u);
+  const size_t total = 100000;
+  std::thread producer([&]() {
+    float chunk[100];
+    size_t next = 0;
+    while (next < total) {
+      size_t n = std::min<size_t>(next % 97 + 1, total - next);
+      for (size_t i = 0; i < n; i++)
+        chunk[i] = float(next + i);
+      size_t written = ring.write(chunk, n);
+      if (!written)
+        std::this_thread::yield();
+      next += written;
+    }
+  });
+  float chunk[100];
+  size_t next = 0;
+  while (next < total) {
+    size_t n = ring.read(chunk, next % 89 + 1);
+    if (!n)
+      std::this_thread::yield();
+    for (size_t i = 0; i < n; i++)
+      ASSERT_EQ(chunk[i], float(next + i));
+    next += n;
+  }
+  producer.join();
+  ASSERT_EQ(ring.available(), 0u);
+}
+
+TEST(Audio, WavDecoder) {
+  WavDecoder wav(open(make_wav(22050, {16384}, 3000)));
+  ASSERT_EQ(wav.rate(), 22050u);
+  ASSERT_EQ(wav.channels(), 1u);
+  ASSERT_EQ(wav.frames(), 3000u);
+  std::vector<float> out(2048 * 2);
+  ASSERT_EQ(wav.read(out.data(), 2048), 2048u);
+  ASSERT_EQ(out[0], 0.5f);
+  ASSERT_EQ(out[4095], 0.5f);
+  ASSERT_EQ(wav.read(out.data(), 2048), 952u);
+  ASSERT_EQ(wav.read(out.data(), 2048), 0u);
+  wav.rewind();
+  ASSERT_EQ(wav.read(out.data(), 10), 10u);
+  ASSERT_THROW(WavDecoder(open("RIFF....WAVE")), FatalError);
+}
+
+TEST(Audio, Mix) {
+  AudioMixer mixer(48000);
+  auto v = mixer.play(open(make_wav(48000, {16384, 8192}, 1000)), 1, -1);
+  ASSERT_NE(v, 0u);
+  ASSERT_TRUE(mixer.playing(v));
+  wait_for_output(mixer);
+  // Hard left.
+  std::vector<float> out(2000 * 2);
+  mixer.mix(out.data(), 4);
+  ASSERT_FLOAT_EQ(out[0], 0.5f);
+  ASSERT_NEAR(out[1], 0, 1e-6);
+  mixer.set(v, 2, 0);
+  mixer.mix(out.data(), 4);
+  ASSERT_FLOAT_EQ(out[0], 0.5f * std::sqrt(2.0f));
+  ASSERT_FLOAT_EQ(out[1], 0.25f * std::sqrt(2.0f));
+  // The sound ends cleanly.
+  mixer.mix(out.data(), 2000);
+  ASSERT_EQ(out[3999], 0.0f);
+  ASSERT_FALSE(mixer.playing(v));
+  ASSERT_EQ(mixer.underruns(), 0u);
+  ASSERT_THROW(mixer.play(open(make_wav(44100, {0}, 10))), FatalError);
+}
+
+TEST(Audio, Underrun) {
+  std::string wav = make_wav(48000, {1000, 1000}, 100000);
+  // Let the decoder fill the ring once, then hold it back.
+  std::atomic<size_t> limit = 44 + 8192 * 4;
+  AudioMixer mixer(48000);
+  struct Release {
+    std::atomic<size_t> &limit;
+    ~Release() { limit = SIZE_MAX; }
+  } release{limit};
+  auto v = mixer.play(std::make_unique<GatedStream>(wav, limit), 1, 0, true);
+  wait_for_output(mixer);
+  std::vector<float> out(8192 * 2);
+  mixer.mix(out.data(), 8192);
+  ASSERT_EQ(mixer.underruns(), 1u);
+  ASSERT_EQ(out[8191 * 2 - 1], out[0]);
+  ASSERT_EQ(out[8191 * 2], 0.0f);
+  // The voice recovers once decoding catches up.
+  limit = SIZE_MAX;
+  wait_for_output(mixer);
+  mixer.stop(v);
+  mixer.mix(out.data(), 1);
+  ASSERT_FALSE(mixer.playing(v));
+}
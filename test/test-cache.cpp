@@ -0,0 +1,183 @@
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "cache.hpp"
+#include "util.hpp"
+
+namespace {
+
+/// Make an empty cache directory for a test.
+std::filesystem::path cache_dir(const char *name) {
+  auto dir = std::filesystem::path(testing::TempDir()) / name;
+  std::filesystem::remove_all(dir);
+  return dir;
+}
+
+std::string contents(const AssetMapping &mapping) {
+  return std::string(reinterpret_cast<const char *>(mapping.data()),
+                     mapping.size());
+}
+
+} // namespace
+
+TEST(Cache, StoreFind) {
+  auto dir = cache_dir("test-cache-store");
+  {
+    DerivedCache cache(dir.string().c_str(), 1 << 20);
+    DerivedKey key = {"a.png", {100, 1234}, "premultiply"};
+    AssetMapping out;
+    ASSERT_FALSE(cache.find(key, out));
+    std::string data(1000, 'x');
+    cache.store(key, data.data(), data.size());
+    ASSERT_TRUE(cache.find(key, out));
+    ASSERT_EQ(contents(out), data);
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(out.data()) % 16, 0u);
+
+    // Every part of the key matters.
+    for (DerivedKey other : {
+             DerivedKey{"b.png", {100, 1234}, "premultiply"},
+             DerivedKey{"a.png", {101, 1234}, "premultiply"},
+             DerivedKey{"a.png", {100, 1235}, "premultiply"},
+             DerivedKey{"a.png", {100, 1234}, "swizzle"},
+         })
+      ASSERT_FALSE(cache.find(other, out));
+
+    // Replace the entry, and read it again from a new cache.
+    cache.store(key, "short", 5);
+    ASSERT_TRUE(cache.find(key, out));
+    ASSERT_EQ(contents(out), "short");
+    cache.store({"empty", {}, ""}, nullptr, 0);
+    ASSERT_TRUE(cache.find({"empty", {}, ""}, out));
+    ASSERT_EQ(out.size(), 0u);
+    cache.flush();
+    DerivedCache reopened(dir.string().c_str(), 1 << 20);
+    ASSERT_EQ(reopened.size(), cache.size());
+    ASSERT_TRUE(reopened.find(key, out));
+    ASSERT_EQ(contents(out), "short");
+  }
+  std::filesystem::remove_all(dir);
+}
+
+TEST(Cache, Invalid) {
+  auto dir = cache_dir("test-cache-invalid");
+  {
+    DerivedCache cache(dir.string().c_str(), 1 << 20);
+    DerivedKey key = {"a.png", {}, ""};
+    std::string data(1000, 'x');
+    cache.store(key, data.data(), data.size());
+    ASSERT_GT(cache.size(), 0u);
+
+    // Truncate the entry's file.
+    std::filesystem::path file;
+    for (auto &entry : std::filesystem::directory_iterator(dir))
+      if (entry.path().filename() != "index.bin")
+        file = entry.path();
+    ASSERT_FALSE(file.empty());
+    std::filesystem::resize_file(file, 500);
+
+    AssetMapping out;
+    ASSERT_FALSE(cache.find(key, out));
+    ASSERT_EQ(cache.size(), 0u);
+    ASSERT_FALSE(std::filesystem::exists(file));
+    cache.store(key, data.data(), data.size());
+    ASSERT_TRUE(cache.find(key, out));
+    ASSERT_EQ(contents(out), data);
+  }
+  std::filesystem::remove_all(dir);
+}
+
+TEST(Cache, Evict) {
+  auto dir = cache_dir("test-cache-evict");
+  std::vector<std::string> names;
+  for (int i = 0; i < 10; i++)
+    names.push_back("file" + std::to_string(i));
+  // Each entry is 4096 bytes of data and less than 100 of header.
+  std::string data(4096, 'x');
+  AssetMapping out;
+  {
+    DerivedCache cache(dir.string().c_str(), 5 * 4200);
+    for (int i = 0; i < 5; i++)
+      cache.store({names[i], {}, ""}, data.data(), data.size());
+    // Use the first one, so the second is the oldest.
+    ASSERT_TRUE(cache.find({names[0], {}, ""}, out));
+    ASSERT_LE(cache.size(), 5u * 4200);
+  }
+  {
+    // The order of use is kept by the next run.
+    DerivedCache cache(dir.string().c_str(), 5 * 4200);
+    cache.store({names[5], {}, ""}, data.data(), data.size());
+    ASSERT_FALSE(cache.find({names[1], {}, ""}, out));
+    for (int i : {0, 2, 3, 4, 5})
+      ASSERT_TRUE(cache.find({names[i], {}, ""}, out)) << i;
+  }
+  {
+    // Shrinking the capacity evicts on the next store.
+    DerivedCache cache(dir.string().c_str(), 2 * 4200);
+    cache.store({names[6], {}, ""}, data.data(), data.size());
+    ASSERT_LE(cache.size(), 2u * 4200);
+    ASSERT_TRUE(cache.find({names[6], {}, ""}, out));
+    ASSERT_TRUE(cache.find({names[5], {}, ""}, out));
+    ASSERT_FALSE(cache.find({names[0], {}, ""}, out));
+  }
+  std::filesystem::remove_all(dir);
+}
+
+TEST(Cache, LoadImage) {
+  auto assets_dir = cache_dir("test-cache-assets");
+  auto dir = cache_dir("test-cache-images");
+  std::filesystem::create_directories(assets_dir);
+  Image source(ImageType::RGBA, 3, 2);
+  for (unsigned y = 0; y < 2; y++)
+    for (unsigned x = 0; x < 3; x++)
+      for (unsigned c = 0; c < 4; c++)
+        source.pixel(x, y)[c] = uint8_t(x * 50 + y * 20 + c);
+  {
+    std::ofstream os(assets_dir / "sprite.png", std::ios::binary);
+    source.write_png(os);
+  }
+  AssetSystem assets;
+  assets.add_directory(0, assets_dir.string().c_str());
+
+  int converted = 0;
+  auto invert = [&](Image image) {
+    converted++;
+    for (unsigned y = 0; y < image.height(); y++)
+      for (unsigned x = 0; x < image.width(); x++)
+        image.pixel(x, y)[0] = ~image.pixel(x, y)[0];
+    return image;
+  };
+  for (int run = 0; run < 2; run++) {
+    DerivedCache cache(dir.string().c_str(), 1 << 20);
+    CachedImage image = load_image(assets, cache, "sprite.png", "invert",
+                                   invert);
+    ASSERT_EQ(converted, 1);
+    ConstImageView view = image.view();
+    ASSERT_EQ(view.kind(), ImageType::RGBA);
+    ASSERT_EQ(view.width(), 3u);
+    ASSERT_EQ(view.height(), 2u);
+    for (unsigned y = 0; y < 2; y++) {
+      for (unsigned x = 0; x < 3; x++) {
+        ASSERT_EQ(view.pixel(x, y)[0], uint8_t(~source.pixel(x, y)[0]));
+        ASSERT_EQ(view.pixel(x, y)[3], source.pixel(x, y)[3]);
+      }
+    }
+  }
+
+  // A different conversion is made separately.
+  {
+    DerivedCache cache(dir.string().c_str(), 1 << 20);
+    load_image(assets, cache, "sprite.png", "copy",
+               [&](Image image) { return invert(std::move(image)); });
+    ASSERT_EQ(converted, 2);
+    ASSERT_THROW(load_image(assets, cache, "missing.png", "", invert),
+                 FatalError);
+  }
+  std::filesystem::remove_all(dir);
+  std::filesystem::remove_all(assets_dir);
+}
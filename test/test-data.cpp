@@ -0,0 +1,245 @@
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "data.hpp"
+#include "json.hpp"
+#include "util.hpp"
+
+namespace {
+
+/// Copy a file to memory aligned like an AssetMapping.
+std::unique_ptr<uint64_t[]> aligned_copy(const ByteWriter &file) {
+  auto copy = std::make_unique<uint64_t[]>(file.size() / 8 + 1);
+  memcpy(copy.get(), file.data(), file.size());
+  return copy;
+}
+
+const char schema_text[] = R"({
+  "id": 7,
+  "root": "Level",
+  "tables": {
+    "Level": {
+      "name": "string",
+      "width": "uint16",
+      "gravity": "float",
+      "seed": "int64",
+      "spawns": "[Spawn]",
+      "heights": "[int8]",
+      "music": "Track"
+    },
+    "Spawn": {"x": "int32", "y": "int32", "tags": "[string]", "boss": "bool"},
+    "Track": {"file": "string", "volume": "double"}
+  }
+})";
+
+} // namespace
+
+TEST(Data, Builder) {
+  DataBuilder builder;
+  uint32_t name = builder.string("forest");
+  const double weights[] = {0.5, 0.25, 0.125};
+  uint32_t array = builder.array(weights, 3);
+  uint32_t names[] = {builder.string("a"), builder.string("")};
+  uint32_t list = builder.list(names, 2);
+
+  std::vector<uint32_t> children;
+  for (int i = 0; i < 3; i++) {
+    builder.begin();
+    builder.add<int32_t>(0, i * 10);
+    builder.add<uint8_t>(1, i);
+    children.push_back(builder.end());
+  }
+  uint32_t child_list = builder.list(children.data(), children.size());
+
+  builder.begin();
+  builder.add<uint8_t>(0, 200);
+  builder.add_reference(1, name);
+  builder.add<int64_t>(2, -1234567890123);
+  builder.add_reference(3, array);
+  builder.add<float>(4, 2.5f);
+  builder.add_reference(5, list);
+  builder.add_reference(6, child_list);
+  builder.add_reference(7, children[1]);
+  builder.add<bool>(8, true);
+  uint32_t root = builder.end();
+  ByteWriter file = builder.finish(3, root);
+  auto copy = aligned_copy(file);
+
+  DataTable table = DataTable::root(copy.get(), file.size(), 3);
+  ASSERT_EQ(table.get<uint8_t>(0), 200);
+  ASSERT_EQ(table.string(1), "forest");
+  ASSERT_EQ(table.get<int64_t>(2), -1234567890123);
+  ArrayView<double> view = table.array<double>(3);
+  ASSERT_EQ(view.size, 3u);
+  ASSERT_EQ(reinterpret_cast<uintptr_t>(view.data) % 8, 0u);
+  ASSERT_EQ(view[2], 0.125);
+  ASSERT_EQ(table.get<float>(4), 2.5f);
+  DataList strings = table.list(5);
+  ASSERT_EQ(strings.size(), 2u);
+  ASSERT_EQ(strings.string(0), "a");
+  ASSERT_EQ(strings.string(1), "");
+  DataList tables = table.list(6);
+  ASSERT_EQ(tables.size(), 3u);
+  ASSERT_EQ(tables.table(2).get<int32_t>(0), 20);
+  ASSERT_EQ(tables.table(2).get<uint8_t>(1), 2);
+  ASSERT_EQ(table.table(7).get<int32_t>(0), 10);
+  ASSERT_TRUE(table.get<bool>(8));
+
+  // Fields past the end of the vtable are missing, as in files written
+  // before the field was added.
+  ASSERT_FALSE(table.has(9));
+  ASSERT_EQ(table.get<int32_t>(9, -1), -1);
+  ASSERT_EQ(table.string(9), "");
+  ASSERT_EQ(table.array<float>(9).size, 0u);
+  ASSERT_EQ(table.list(9).size(), 0u);
+  ASSERT_FALSE(table.table(9).has(0));
+}
+
+TEST(Data, SharedVtables) {
+  DataBuilder builder;
+  std::vector<uint32_t> tables;
+  for (int i = 0; i < 100; i++) {
+    builder.begin();
+    builder.add<int32_t>(0, i);
+    builder.add<int32_t>(1, -i);
+    tables.push_back(builder.end());
+  }
+  // A table is 4 bytes for the vtable offset and 8 for the fields, aligned to
+  // 8. Only the first has a vtable written before it.
+  ASSERT_EQ(tables[2] - tables[1], 16u);
+  uint32_t list = builder.list(tables.data(), tables.size());
+  builder.begin();
+  builder.add_reference(0, list);
+  ByteWriter file = builder.finish(1, builder.end());
+  auto copy = aligned_copy(file);
+  DataList items = DataTable::root(copy.get(), file.size(), 1).list(0);
+  for (int i = 0; i < 100; i++)
+    ASSERT_EQ(items.table(i).get<int32_t>(1), -i);
+}
+
+TEST(Data, Header) {
+  DataBuilder builder;
+  builder.begin();
+  builder.add<int32_t>(0, 1);
+  ByteWriter file = builder.finish(5, builder.end());
+  auto copy = aligned_copy(file);
+  ASSERT_EQ(DataTable::root(copy.get(), file.size(), 5).get<int32_t>(0), 1);
+  ASSERT_THROW(DataTable::root(copy.get(), file.size(), 6), FatalError);
+  ASSERT_THROW(DataTable::root(copy.get(), file.size() - 1, 5), FatalError);
+  ASSERT_THROW(DataTable::root(copy.get(), 8, 5), FatalError);
+  auto misaligned = reinterpret_cast<uint8_t *>(copy.get()) + 1;
+  ASSERT_THROW(DataTable::root(misaligned, file.size(), 5), FatalError);
+  copy[0] ^= 1;
+  ASSERT_THROW(DataTable::root(copy.get(), file.size(), 5), FatalError);
+}
+
+TEST(Data, Corrupt) {
+  DataBuilder builder;
+  uint32_t name = builder.string("abc");
+  builder.begin();
+  builder.add_reference(0, name);
+  ByteWriter file = builder.finish(1, builder.end());
+
+  // Point the string past the end of the file.
+  auto copy = aligned_copy(file);
+  auto bytes = reinterpret_cast<uint8_t *>(copy.get());
+  DataHeader header;
+  memcpy(&header, bytes, sizeof header);
+  uint32_t bad = file.size() + 100;
+  memcpy(bytes + header.root + 4, &bad, 4);
+  DataTable table = DataTable::root(copy.get(), file.size(), 1);
+  ASSERT_THROW(table.string(0), FatalError);
+
+  // Make the string longer than the file.
+  copy = aligned_copy(file);
+  bytes = reinterpret_cast<uint8_t *>(copy.get());
+  uint32_t length = 1000;
+  memcpy(bytes + name, &length, 4);
+  table = DataTable::root(copy.get(), file.size(), 1);
+  ASSERT_THROW(table.string(0), FatalError);
+
+  // Point the root past the end.
+  copy = aligned_copy(file);
+  bytes = reinterpret_cast<uint8_t *>(copy.get());
+  header.root = file.size() - 2;
+  memcpy(bytes, &header, sizeof header);
+  ASSERT_THROW(DataTable::root(copy.get(), file.size(), 1), FatalError);
+}
+
+TEST(Data, Compile) {
+  JsonDocument doc;
+  std::string text = schema_text;
+  doc.parse(text.c_str(), text.size());
+  DataSchema schema = DataSchema::parse(doc.root());
+  ASSERT_EQ(schema.id(), 7u);
+  ASSERT_EQ(schema.tables().size(), 3u);
+  ASSERT_EQ(schema.tables()[0].fields[4].name, "spawns");
+
+  std::string level = R"({
+    "name": "cave",
+    "width": 640,
+    "gravity": 9.5,
+    "spawns": [
+      {"x": 1, "y": -2, "tags": ["slime", "small"]},
+      {"x": 30, "y": 40, "boss": true, "tags": []}
+    ],
+    "heights": [-3, 0, 7],
+    "music": {"file": "cave.ogg", "volume": null}
+  })";
+  doc.parse(level.c_str(), level.size());
+  ByteWriter file = schema.compile(doc.root());
+  auto copy = aligned_copy(file);
+
+  DataTable root = DataTable::root(copy.get(), file.size(), 7);
+  ASSERT_EQ(root.string(0), "cave");
+  ASSERT_EQ(root.get<uint16_t>(1), 640);
+  ASSERT_EQ(root.get<float>(2), 9.5f);
+  ASSERT_FALSE(root.has(3));
+  DataList spawns = root.list(4);
+  ASSERT_EQ(spawns.size(), 2u);
+  ASSERT_EQ(spawns.table(0).get<int32_t>(1), -2);
+  ASSERT_EQ(spawns.table(0).list(2).string(1), "small");
+  ASSERT_FALSE(spawns.table(0).get<bool>(3));
+  ASSERT_TRUE(spawns.table(1).get<bool>(3));
+  ASSERT_EQ(spawns.table(1).list(2).size(), 0u);
+  ArrayView<int8_t> heights = root.array<int8_t>(5);
+  ASSERT_EQ(heights.size, 3u);
+  ASSERT_EQ(heights[0], -3);
+  ASSERT_EQ(root.table(6).string(0), "cave.ogg");
+  ASSERT_FALSE(root.table(6).has(1));
+  ASSERT_EQ(root.table(6).get<double>(1, 0.75), 0.75);
+}
+
+TEST(Data, CompileErrors) {
+  JsonDocument doc;
+  std::string text = schema_text;
+  doc.parse(text.c_str(), text.size());
+  DataSchema schema = DataSchema::parse(doc.root());
+  for (std::string level : {
+           R"({"name": "x", "typo": 1})",
+           R"({"width": 70000})",
+           R"({"width": -1})",
+           R"({"width": 1.5})",
+           R"({"name": 3})",
+           R"({"heights": [1, 200]})",
+           R"({"spawns": [{"x": "1"}]})",
+           R"({"music": []})",
+       }) {
+    doc.parse(level.c_str(), level.size());
+    ASSERT_THROW(schema.compile(doc.root()), FatalError) << level;
+  }
+
+  for (std::string bad : {
+           R"({"id": 1, "root": "A", "tables": {"A": {"x": "int"}}})",
+           R"({"id": 1, "root": "B", "tables": {"A": {"x": "int8"}}})",
+           R"({"id": 1, "root": "A", "tables": {"A": {"x": "[B]"}}})",
+           R"({"id": -1, "root": "A", "tables": {"A": {}}})",
+       }) {
+    doc.parse(bad.c_str(), bad.size());
+    ASSERT_THROW(DataSchema::parse(doc.root()), FatalError) << bad;
+  }
+}
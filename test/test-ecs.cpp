@@ -0,0 +1,144 @@
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "ecs.hpp"
+#include "job.hpp"
+
+namespace {
+
+struct Position {
+  float x, y;
+};
+
+struct Velocity {
+  float x, y;
+};
+
+struct Health {
+  int value;
+};
+
+struct Flags {
+  unsigned bits;
+};
+
+} // namespace
+
+TEST(ECS, CreateDestroy) {
+  World world;
+  Entity a = world.create(Position{1, 2});
+  Entity b = world.create(Position{3, 4}, Velocity{5, 6});
+  ASSERT_EQ(world.size(), 2u);
+  ASSERT_TRUE(world.has<Position>(a));
+  ASSERT_FALSE(world.has<Velocity>(a));
+  ASSERT_EQ(world.get<Velocity>(b)->y, 6);
+  world.destroy(a);
+  ASSERT_FALSE(world.alive(a));
+  ASSERT_EQ(world.get<Position>(a), nullptr);
+  // The slot is reused with a new generation.
+  Entity c = world.create();
+  ASSERT_EQ(c.index, a.index);
+  ASSERT_NE(c, a);
+  ASSERT_EQ(world.get<Position>(b)->x, 3);
+}
+
+TEST(ECS, AddRemove) {
+  World world;
+  std::vector<Entity> list;
+  for (int i = 0; i < 5000; i++)
+    list.push_back(world.create(Health{i}));
+  for (int i = 0; i < 5000; i += 2)
+    world.add(list[i], Position{float(i), 0});
+  for (int i = 0; i < 5000; i += 4)
+    world.remove<Health>(list[i]);
+  for (int i = 0; i < 5000; i++) {
+    ASSERT_EQ(world.has<Position>(list[i]), i % 2 == 0);
+    ASSERT_EQ(world.has<Health>(list[i]), i % 4 != 0);
+    if (i % 2 == 0) {
+      ASSERT_EQ(world.get<Position>(list[i])->x, i);
+    }
+    if (i % 4 != 0) {
+      ASSERT_EQ(world.get<Health>(list[i])->value, i);
+    }
+  }
+  ASSERT_EQ(world.query<Health>().size(), 3750u);
+  ASSERT_EQ((world.query<Health, Position>().size()), 1250u);
+}
+
+TEST(ECS, Query) {
+  World world;
+  JobPool pool(3);
+  for (int i = 0; i < 10000; i++) {
+    if (i % 3)
+      world.create(Position{0, 0}, Velocity{1, float(i)});
+    else
+      world.create(Position{0, 0}, Velocity{1, float(i)}, Health{i});
+  }
+  auto q = world.query<Position, const Velocity>();
+  q.parallel_each(pool, [](Position &p, const Velocity &v) {
+    p.x += v.x;
+    p.y += v.y;
+  });
+  q.each([](Position &p, const Velocity &v) {
+    ASSERT_EQ(p.x, 1);
+    ASSERT_EQ(p.y, v.y);
+  });
+  // Archetypes created after the query are picked up by the cache.
+  world.create(Position{0, 0}, Velocity{0, 0}, Flags{1});
+  ASSERT_EQ(q.size(), 10001u);
+}
+
+TEST(ECS, CommandBuffer) {
+  World world;
+  Entity a = world.create(Health{1});
+  Entity b = world.create(Health{2});
+  CommandBuffer cmd;
+  cmd.create(Velocity{7, 8}, Health{3});
+  cmd.add(a, Position{9, 10});
+  cmd.destroy(b);
+  cmd.destroy(b); // stale handles are ignored
+  cmd.remove<Health>(a);
+  ASSERT_EQ(world.size(), 2u);
+  cmd.apply(world);
+  ASSERT_TRUE(cmd.empty());
+  ASSERT_EQ(world.size(), 2u);
+  ASSERT_FALSE(world.alive(b));
+  ASSERT_EQ(world.get<Position>(a)->y, 10);
+  ASSERT_FALSE(world.has<Health>(a));
+  world.query<const Velocity, const Health>().each(
+      [](const Velocity &v, const Health &h) {
+        ASSERT_EQ(v.x, 7);
+        ASSERT_EQ(h.value, 3);
+      });
+}
+
+TEST(ECS, Schedule) {
+  World world;
+  JobPool pool(3);
+  for (int i = 0; i < 1000; i++)
+    world.create(Position{0, 0}, Velocity{1, 1}, Health{100});
+  Schedule s;
+  s.add<Position, const Velocity>("move", [](World &w, CommandBuffer &) {
+    w.query<Position, const Velocity>().each(
+        [](Position &p, const Velocity &v) { p.x += v.x; });
+  });
+  s.add<Health>("damage", [](World &w, CommandBuffer &) {
+    w.query<Health>().each([](Health &h) { h.value -= 10; });
+  });
+  s.add<const Health>("reap", [](World &w, CommandBuffer &cmd) {
+    w.query<const Health>().each_chunk(
+        [&](uint32_t n, const Entity *e, const Health *h) {
+          for (uint32_t i = 0; i < n; i++)
+            if (h[i].value <= 50)
+              cmd.destroy(e[i]);
+        });
+  });
+  // "move" and "damage" don't conflict. "reap" reads what "damage" writes.
+  ASSERT_EQ(s.stages(), 2u);
+  for (int i = 0; i < 4; i++)
+    s.run(world, pool);
+  ASSERT_EQ(world.size(), 1000u);
+  s.run(world, pool);
+  ASSERT_EQ(world.size(), 0u);
+}
@@ -0,0 +1,116 @@
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+#include "test-font.hpp"
+
+namespace {
+
+/// Contents of the font described in test-font.hpp.
+const uint8_t font_data[] = {
+    0x00, 0x01, 0x00, 0x00, 0x00, 0x0b, 0x00, 0x80, 0x00, 0x03, 0x00, 0x30,
+    0x4f, 0x53, 0x2f, 0x32, 0x45, 0x02, 0x44, 0x72, 0x00, 0x00, 0x01, 0x38,
+    0x00, 0x00, 0x00, 0x60, 0x63, 0x6d, 0x61, 0x70, 0x01, 0xbf, 0x03, 0x0f,
+    0x00, 0x00, 0x01, 0xd0, 0x00, 0x00, 0x00, 0x84, 0x67, 0x6c, 0x79, 0x66,
+    0x16, 0xb6, 0x3f, 0x45, 0x00, 0x00, 0x02, 0x74, 0x00, 0x00, 0x01, 0x4c,
+    0x68, 0x65, 0x61, 0x64, 0x2f, 0xf9, 0xff, 0x6e, 0x00, 0x00, 0x00, 0xbc,
+    0x00, 0x00, 0x00, 0x36, 0x68, 0x68, 0x65, 0x61, 0x06, 0x10, 0x02, 0x67,
+    0x00, 0x00, 0x00, 0xf4, 0x00, 0x00, 0x00, 0x24, 0x68, 0x6d, 0x74, 0x78,
+    0x1a, 0xf4, 0x02, 0x8a, 0x00, 0x00, 0x01, 0x98, 0x00, 0x00, 0x00, 0x38,
+    0x6b, 0x65, 0x72, 0x6e, 0xff, 0xb1, 0xff, 0xbe, 0x00, 0x00, 0x03, 0xc0,
+    0x00, 0x00, 0x00, 0x1e, 0x6c, 0x6f, 0x63, 0x61, 0x02, 0x75, 0x02, 0x27,
+    0x00, 0x00, 0x02, 0x54, 0x00, 0x00, 0x00, 0x1e, 0x6d, 0x61, 0x78, 0x70,
+    0x00, 0x10, 0x00, 0x06, 0x00, 0x00, 0x01, 0x18, 0x00, 0x00, 0x00, 0x20,
+    0x6e, 0x61, 0x6d, 0x65, 0x61, 0x4c, 0x79, 0x6a, 0x00, 0x00, 0x03, 0xe0,
+    0x00, 0x00, 0x00, 0x57, 0x70, 0x6f, 0x73, 0x74, 0x01, 0x58, 0x00, 0xf4,
+    0x00, 0x00, 0x04, 0x38, 0x00, 0x00, 0x00, 0x3e, 0x00, 0x01, 0x00, 0x00,
+    0x00, 0x01, 0x00, 0x00, 0x13, 0x90, 0x10, 0x16, 0x5f, 0x0f, 0x3c, 0xf5,
+    0x00, 0x03, 0x03, 0xe8, 0x00, 0x00, 0x00, 0x00, 0xe6, 0xfa, 0xdd, 0xe9,
+    0x00, 0x00, 0x00, 0x00, 0xe6, 0xfa, 0xdd, 0xe9, 0x00, 0x32, 0x00, 0x00,
+    0x02, 0xbc, 0x02, 0xbc, 0x00, 0x00, 0x00, 0x03, 0x00, 0x02, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x03, 0x20, 0xff, 0x38,
+    0x00, 0x00, 0x02, 0xee, 0x00, 0x32, 0x00, 0x32, 0x02, 0xbc, 0x00, 0x01,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x0e, 0x00, 0x01, 0x00, 0x00, 0x00, 0x0e, 0x00, 0x04,
+    0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x03, 0x01, 0xed, 0x01, 0x90, 0x00, 0x05, 0x00, 0x04, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3f, 0x3f,
+    0x3f, 0x3f, 0x00, 0x00, 0x00, 0x20, 0x00, 0xe9, 0x03, 0x20, 0xff, 0x38,
+    0x00, 0x00, 0x03, 0x20, 0x00, 0xc8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00,
+    0x01, 0xf4, 0x00, 0x32, 0x00, 0xfa, 0x00, 0x00, 0x02, 0x58, 0x00, 0x32,
+    0x02, 0x26, 0x00, 0x32, 0x02, 0x58, 0x00, 0x32, 0x01, 0xf4, 0x00, 0x32,
+    0x01, 0xf4, 0x00, 0x32, 0x01, 0xf4, 0x00, 0x32, 0x00, 0xfa, 0x00, 0x32,
+    0x02, 0xbc, 0x00, 0x32, 0x00, 0xfa, 0x00, 0x32, 0x02, 0xee, 0x00, 0x32,
+    0x01, 0xc2, 0x00, 0x32, 0x01, 0xf4, 0x00, 0x32, 0x00, 0x00, 0x00, 0x02,
+    0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x14, 0x00, 0x03, 0x00, 0x01,
+    0x00, 0x00, 0x00, 0x14, 0x00, 0x04, 0x00, 0x70, 0x00, 0x00, 0x00, 0x18,
+    0x00, 0x10, 0x00, 0x03, 0x00, 0x08, 0x00, 0x20, 0x00, 0x25, 0x00, 0x2e,
+    0x00, 0x31, 0x00, 0x3a, 0x00, 0x42, 0x00, 0x56, 0x00, 0x61, 0x00, 0x6d,
+    0x00, 0x73, 0x00, 0xe9, 0xff, 0xff, 0x00, 0x00, 0x00, 0x20, 0x00, 0x25,
+    0x00, 0x2e, 0x00, 0x30, 0x00, 0x3a, 0x00, 0x41, 0x00, 0x56, 0x00, 0x61,
+    0x00, 0x6d, 0x00, 0x73, 0x00, 0xe9, 0xff, 0xff, 0xff, 0xe1, 0xff, 0xe4,
+    0xff, 0xda, 0xff, 0xd6, 0xff, 0xd0, 0xff, 0xc1, 0xff, 0xae, 0xff, 0xa4,
+    0xff, 0x9e, 0xff, 0x99, 0xff, 0x24, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0d,
+    0x00, 0x0d, 0x00, 0x1a, 0x00, 0x27, 0x00, 0x34, 0x00, 0x41, 0x00, 0x4e,
+    0x00, 0x5b, 0x00, 0x66, 0x00, 0x73, 0x00, 0x7f, 0x00, 0x8c, 0x00, 0x99,
+    0x00, 0xa6, 0x00, 0x00, 0x00, 0x01, 0x00, 0x32, 0x00, 0x00, 0x01, 0xc2,
+    0x02, 0xbc, 0x00, 0x03, 0x00, 0x00, 0x33, 0x11, 0x21, 0x11, 0x32, 0x01,
+    0x90, 0x02, 0xbc, 0xfd, 0x44, 0x00, 0x00, 0x01, 0x00, 0x32, 0x00, 0x00,
+    0x02, 0x26, 0x02, 0xbc, 0x00, 0x03, 0x00, 0x00, 0x33, 0x11, 0x21, 0x11,
+    0x32, 0x01, 0xf4, 0x02, 0xbc, 0xfd, 0x44, 0x00, 0x00, 0x01, 0x00, 0x32,
+    0x00, 0x00, 0x01, 0xf4, 0x02, 0xbc, 0x00, 0x03, 0x00, 0x00, 0x33, 0x11,
+    0x21, 0x11, 0x32, 0x01, 0xc2, 0x02, 0xbc, 0xfd, 0x44, 0x00, 0x00, 0x01,
+    0x00, 0x32, 0x00, 0x00, 0x02, 0x26, 0x02, 0xbc, 0x00, 0x03, 0x00, 0x00,
+    0x33, 0x11, 0x21, 0x11, 0x32, 0x01, 0xf4, 0x02, 0xbc, 0xfd, 0x44, 0x00,
+    0x00, 0x01, 0x00, 0x32, 0x00, 0x00, 0x01, 0xc2, 0x01, 0xf4, 0x00, 0x03,
+    0x00, 0x00, 0x33, 0x11, 0x21, 0x11, 0x32, 0x01, 0x90, 0x01, 0xf4, 0xfe,
+    0x0c, 0x00, 0x00, 0x01, 0x00, 0x32, 0x00, 0x00, 0x01, 0xc2, 0x02, 0xbc,
+    0x00, 0x03, 0x00, 0x00, 0x33, 0x11, 0x21, 0x11, 0x32, 0x01, 0x90, 0x02,
+    0xbc, 0xfd, 0x44, 0x00, 0x00, 0x01, 0x00, 0x32, 0x00, 0x00, 0x01, 0xc2,
+    0x02, 0xbc, 0x00, 0x03, 0x00, 0x00, 0x33, 0x11, 0x21, 0x11, 0x32, 0x01,
+    0x90, 0x02, 0xbc, 0xfd, 0x44, 0x00, 0x00, 0x01, 0x00, 0x32, 0x00, 0x00,
+    0x00, 0xc8, 0x00, 0x64, 0x00, 0x03, 0x00, 0x00, 0x33, 0x35, 0x33, 0x15,
+    0x32, 0x96, 0x64, 0x64, 0x00, 0x01, 0x00, 0x32, 0x00, 0x00, 0x02, 0x8a,
+    0x02, 0xbc, 0x00, 0x03, 0x00, 0x00, 0x33, 0x11, 0x21, 0x11, 0x32, 0x02,
+    0x58, 0x02, 0xbc, 0xfd, 0x44, 0x00, 0x00, 0x01, 0x00, 0x32, 0x00, 0x00,
+    0x00, 0xc8, 0x01, 0xf4, 0x00, 0x03, 0x00, 0x00, 0x33, 0x11, 0x33, 0x11,
+    0x32, 0x96, 0x01, 0xf4, 0xfe, 0x0c, 0x00, 0x01, 0x00, 0x32, 0x00, 0x00,
+    0x02, 0xbc, 0x01, 0xf4, 0x00, 0x03, 0x00, 0x00, 0x33, 0x11, 0x21, 0x11,
+    0x32, 0x02, 0x8a, 0x01, 0xf4, 0xfe, 0x0c, 0x00, 0x00, 0x01, 0x00, 0x32,
+    0x00, 0x00, 0x01, 0x90, 0x01, 0xf4, 0x00, 0x03, 0x00, 0x00, 0x33, 0x11,
+    0x21, 0x11, 0x32, 0x01, 0x5e, 0x01, 0xf4, 0xfe, 0x0c, 0x00, 0x00, 0x01,
+    0x00, 0x32, 0x00, 0x00, 0x01, 0xc2, 0x01, 0xf4, 0x00, 0x03, 0x00, 0x00,
+    0x33, 0x11, 0x21, 0x11, 0x32, 0x01, 0x90, 0x01, 0xf4, 0xfe, 0x0c, 0x00,
+    0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x1a, 0x00, 0x01, 0x00, 0x02,
+    0x00, 0x0c, 0x00, 0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x04, 0xff, 0x9c,
+    0x00, 0x04, 0x00, 0x02, 0xff, 0x9c, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04,
+    0x00, 0x36, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x04,
+    0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x07,
+    0x00, 0x04, 0x00, 0x03, 0x00, 0x01, 0x04, 0x09, 0x00, 0x01, 0x00, 0x08,
+    0x00, 0x0b, 0x00, 0x03, 0x00, 0x01, 0x04, 0x09, 0x00, 0x02, 0x00, 0x0e,
+    0x00, 0x13, 0x54, 0x65, 0x73, 0x74, 0x52, 0x65, 0x67, 0x75, 0x6c, 0x61,
+    0x72, 0x00, 0x54, 0x00, 0x65, 0x00, 0x73, 0x00, 0x74, 0x00, 0x52, 0x00,
+    0x65, 0x00, 0x67, 0x00, 0x75, 0x00, 0x6c, 0x00, 0x61, 0x00, 0x72, 0x00,
+    0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0e, 0x00, 0x00,
+    0x00, 0x03, 0x00, 0x24, 0x00, 0x25, 0x00, 0x39, 0x00, 0x44, 0x00, 0x13,
+    0x00, 0x14, 0x00, 0x11, 0x00, 0x08, 0x00, 0x1d, 0x00, 0x50, 0x00, 0x56,
+    0x00, 0x70, 0x00, 0x00,
+};
+
+} // namespace
+
+Font test_font(unsigned size, unsigned atlas_size) {
+  std::unique_ptr<uint8_t[]> file(new uint8_t[sizeof font_data]);
+  memcpy(file.get(), font_data, sizeof font_data);
+  return Font(std::move(file), sizeof font_data, size, atlas_size);
+}
@@ -0,0 +1,118 @@
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "test-font.hpp"
+#include "util.hpp"
+
+TEST(Font, Metrics) {
+  Font font = test_font(20);
+  ASSERT_EQ(font.ascent(), 16);
+  ASSERT_EQ(font.descent(), 4);
+  ASSERT_GE(font.line_height(), 20);
+  ASSERT_THROW(Font(std::make_unique<uint8_t[]>(100), 100, 20), FatalError);
+}
+
+TEST(Font, Shape) {
+  Font font = test_font(20);
+  std::vector<Font::Placement> out;
+  ASSERT_EQ(font.shape("", out), 0);
+  ASSERT_TRUE(out.empty());
+  ASSERT_EQ(font.shape("AB", out), 23);
+  ASSERT_EQ(out.size(), 2u);
+  ASSERT_EQ(out[0].x, 0);
+  ASSERT_EQ(out[1].x, 12);
+  ASSERT_EQ(out[1].cluster, 1u);
+  // Kerning.
+  ASSERT_EQ(font.measure("AVA"), 32);
+  // Clusters are byte offsets.
+  font.shape("\xc3\xa9" "a", out);
+  ASSERT_EQ(out.size(), 2u);
+  ASSERT_EQ(out[1].cluster, 2u);
+}
+
+TEST(Font, SimpleText) {
+  Font font = test_font(20);
+  const char *lines[] = {
+      "",
+      "A",
+      "AVA VAV",
+      "VAVAVAVA 100%",
+      "Vamos: 0.1 s",
+      "caf\xc3\xa9 AV\xc3\xa9",
+      "\xc2\xa0\xc3\x97", // No-break space, multiplication sign
+      "xyz",              // Not in the font
+      "AV\xe2\x80\x94VA", // Em dash, which is shaped
+      "Ae\xcc\x81",       // Combining acute, which is shaped
+      "AV\xc3",           // Malformed
+      "AV\x01",
+  };
+  std::vector<Font::Placement> fast, full;
+  for (int pass = 0; pass < 2; pass++) {
+    for (const char *line : lines) {
+      float width = font.shape(line, fast);
+      ASSERT_EQ(width, font.shape_full(line, full)) << line;
+      ASSERT_EQ(font.measure(line), width) << line;
+      ASSERT_EQ(fast.size(), full.size()) << line;
+      for (size_t i = 0; i < fast.size(); i++) {
+        ASSERT_EQ(fast[i].glyph, full[i].glyph) << line;
+        ASSERT_EQ(fast[i].cluster, full[i].cluster) << line;
+        ASSERT_EQ(memcmp(&fast[i].x, &full[i].x, sizeof(float)), 0) << line;
+        ASSERT_EQ(memcmp(&fast[i].y, &full[i].y, sizeof(float)), 0) << line;
+      }
+    }
+  }
+  ASSERT_EQ(font.measure("AVA"), 32);
+}
+
+TEST(Font, Atlas) {
+  Font font = test_font(20, 64);
+  ConstImageView atlas = font.atlas();
+  ASSERT_EQ(atlas.kind(), ImageType::Luminance);
+  // The corner is solid.
+  ASSERT_EQ(*atlas.pixel(1, 1), 255);
+  ASSERT_EQ(*atlas.pixel(2, 2), 0);
+  uint64_t version = font.atlas_version();
+  std::vector<Font::Placement> out;
+  font.shape("A", out);
+  Font::Glyph a = font.glyph(out[0].glyph);
+  ASSERT_EQ(a.w, 10);
+  ASSERT_EQ(a.h, 14);
+  ASSERT_EQ(a.left, 1);
+  ASSERT_EQ(a.top, 14);
+  ASSERT_EQ(*atlas.pixel(a.x + 5, a.y + 7), 255);
+  ASSERT_GT(font.atlas_version(), version);
+  // Cached glyphs don't change the atlas.
+  version = font.atlas_version();
+  ASSERT_EQ(font.glyph(out[0].glyph).x, a.x);
+  ASSERT_EQ(font.atlas_version(), version);
+  // Blank glyphs take no space.
+  font.shape(" ", out);
+  ASSERT_EQ(font.glyph(out[0].glyph).w, 0);
+  ASSERT_EQ(font.atlas_version(), version);
+  // Fill the atlas.
+  Font big = test_font(90, 64);
+  big.shape("AB", out);
+  big.glyph(out[0].glyph);
+  ASSERT_THROW(big.glyph(out[1].glyph), FatalError);
+}
+
+TEST(Font, Draw) {
+  Font font = test_font(20);
+  Image image(ImageType::RGBA, 40, 30);
+  for (unsigned y = 0; y < 30; y++)
+    memset(image.pixel(0, y), 0, 40 * 4);
+  const uint8_t red[4] = {255, 0, 0, 255};
+  // Partly off the left edge.
+  font.draw(image, -5, 20, "AB", red);
+  ASSERT_EQ(image.pixel(0, 10)[0], 255);
+  ASSERT_EQ(image.pixel(0, 10)[3], 255);
+  ASSERT_EQ(image.pixel(7, 10)[3], 0);
+  ASSERT_EQ(image.pixel(9, 10)[0], 255);
+  ASSERT_EQ(image.pixel(0, 22)[3], 0);
+  // Off the image entirely.
+  font.draw(image, 100, 100, "A", red);
+  font.draw(image, -100, -100, "A", red);
+}
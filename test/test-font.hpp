@@ -0,0 +1,20 @@
+/**
+ * \file
+ * \brief Font for tests that draw text.
+ */
+
+#ifndef TEST_FONT_HPP
+#define TEST_FONT_HPP
+
+#include "font.hpp"
+
+/**
+ * \brief Load a small font that's embedded in the tests and benchmarks.
+ *
+ * The font has the characters " %.01:ABVamsé". Glyphs are filled rectangles
+ * 100 units narrower than their advance, and "AV" and "VA" are kerned by -100
+ * units. The em square is 1000 units.
+ */
+Font test_font(unsigned size, unsigned atlas_size = 512);
+
+#endif
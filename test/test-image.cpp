@@ -1,12 +1,87 @@
 #include <cstdint>
 #include <random>
 #include <sstream>
+#include <string>
+#include <utility>
 
 #include <gtest/gtest.h>
+#include <zlib.h>
 
 #include "image.hpp"
 #include "util.hpp"
 
+namespace {
+
+/// A stream buffer that can't seek, like a pipe's.
+class PipeBuffer : public std::streambuf {
+  std::string m_data;
+
+public:
+  explicit PipeBuffer(std::string data) : m_data(std::move(data)) {
+    setg(m_data.data(), m_data.data(), m_data.data() + m_data.size());
+  }
+};
+
+/// A 32×32 JPEG of red, green, blue and white quadrants.
+const uint8_t quadrants_jpeg[] = {
+    0xff, 0xd8, 0xff, 0xe0, 0x00, 0x10, 0x4a, 0x46, 0x49, 0x46, 0x00, 0x01,
+    0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0xff, 0xdb, 0x00, 0x43,
+    0x00, 0x03, 0x02, 0x02, 0x03, 0x02, 0x02, 0x03, 0x03, 0x03, 0x03, 0x04,
+    0x03, 0x03, 0x04, 0x05, 0x08, 0x05, 0x05, 0x04, 0x04, 0x05, 0x0a, 0x07,
+    0x07, 0x06, 0x08, 0x0c, 0x0a, 0x0c, 0x0c, 0x0b, 0x0a, 0x0b, 0x0b, 0x0d,
+    0x0e, 0x12, 0x10, 0x0d, 0x0e, 0x11, 0x0e, 0x0b, 0x0b, 0x10, 0x16, 0x10,
+    0x11, 0x13, 0x14, 0x15, 0x15, 0x15, 0x0c, 0x0f, 0x17, 0x18, 0x16, 0x14,
+    0x18, 0x12, 0x14, 0x15, 0x14, 0xff, 0xdb, 0x00, 0x43, 0x01, 0x03, 0x04,
+    0x04, 0x05, 0x04, 0x05, 0x09, 0x05, 0x05, 0x09, 0x14, 0x0d, 0x0b, 0x0d,
+    0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14,
+    0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14,
+    0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14,
+    0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14,
+    0x14, 0x14, 0xff, 0xc0, 0x00, 0x11, 0x08, 0x00, 0x20, 0x00, 0x20, 0x03,
+    0x01, 0x22, 0x00, 0x02, 0x11, 0x01, 0x03, 0x11, 0x01, 0xff, 0xc4, 0x00,
+    0x17, 0x00, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x07, 0x09, 0xff, 0xc4,
+    0x00, 0x14, 0x10, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0xc4, 0x00, 0x17,
+    0x01, 0x00, 0x03, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0x08, 0x09, 0x06, 0xff, 0xc4, 0x00,
+    0x14, 0x11, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0xda, 0x00, 0x0c, 0x03,
+    0x01, 0x00, 0x02, 0x11, 0x03, 0x11, 0x00, 0x3f, 0x00, 0xc0, 0x80, 0x0c,
+    0x8f, 0x1a, 0x82, 0x00, 0x37, 0x45, 0xf4, 0x4e, 0x02, 0xbc, 0x19, 0x87,
+    0x7f, 0x80, 0x23, 0x8d, 0x2b, 0xff, 0xd9,
+};
+
+/// A 16×8 grayscale JPEG, dark on the left and light on the right.
+const uint8_t gray_jpeg[] = {
+    0xff, 0xd8, 0xff, 0xe0, 0x00, 0x10, 0x4a, 0x46, 0x49, 0x46, 0x00, 0x01,
+    0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0xff, 0xdb, 0x00, 0x43,
+    0x00, 0x03, 0x02, 0x02, 0x03, 0x02, 0x02, 0x03, 0x03, 0x03, 0x03, 0x04,
+    0x03, 0x03, 0x04, 0x05, 0x08, 0x05, 0x05, 0x04, 0x04, 0x05, 0x0a, 0x07,
+    0x07, 0x06, 0x08, 0x0c, 0x0a, 0x0c, 0x0c, 0x0b, 0x0a, 0x0b, 0x0b, 0x0d,
+    0x0e, 0x12, 0x10, 0x0d, 0x0e, 0x11, 0x0e, 0x0b, 0x0b, 0x10, 0x16, 0x10,
+    0x11, 0x13, 0x14, 0x15, 0x15, 0x15, 0x0c, 0x0f, 0x17, 0x18, 0x16, 0x14,
+    0x18, 0x12, 0x14, 0x15, 0x14, 0xff, 0xc0, 0x00, 0x0b, 0x08, 0x00, 0x08,
+    0x00, 0x10, 0x01, 0x01, 0x11, 0x00, 0xff, 0xc4, 0x00, 0x15, 0x00, 0x01,
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x08, 0x09, 0xff, 0xc4, 0x00, 0x14, 0x10, 0x01, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0xff, 0xda, 0x00, 0x08, 0x01, 0x01, 0x00, 0x00, 0x3f,
+    0x00, 0x0a, 0x2f, 0x03, 0xff, 0xd9,
+};
+
+/// Check that a quadrant of the test image has the right color.
+void expect_quadrant(ConstImageView image, unsigned x, unsigned y,
+                     unsigned quadrant) {
+  const uint8_t colors[4][3] = {
+      {200, 30, 30}, {30, 200, 30}, {30, 30, 200}, {240, 240, 240}};
+  const uint8_t *p = image.pixel(x, y);
+  for (int c = 0; c < 3; c++)
+    ASSERT_NEAR(p[c], colors[quadrant][c], 8) << x << ", " << y;
+}
+
+} // namespace
+
 TEST(Image, PalettePNG) {
   const uint8_t png_data[] = {
       0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
@@ -176,3 +251,115 @@ TEST(Image, View) {
   (void)iv2;
   (void)iv3;
 }
+
+TEST(Image, Subview) {
+  Image i(ImageType::RGB, 16, 8);
+  ImageView part = i.subview(3, 2, 5, 4);
+  ASSERT_EQ(part.width(), 5u);
+  ASSERT_EQ(part.height(), 4u);
+  ASSERT_EQ(part.stride(), i.stride());
+  ASSERT_EQ(part.pixel(0, 0), i.pixel(3, 2));
+  ASSERT_EQ(part.pixel(4, 3), i.pixel(7, 5));
+  // Views of views add up their offsets.
+  const Image &ci = i;
+  ConstImageView inner = ConstImageView(part).subview(1, 1, 2, 2);
+  ASSERT_EQ(inner.pixel(1, 1), ci.subview(5, 4, 1, 1).pixel(0, 0));
+  ASSERT_EQ(i.subview(16, 8, 0, 0).width(), 0u);
+}
+
+TEST(Image, JPEG) {
+  for (unsigned scale : {1, 2, 4, 8}) {
+    MemoryBuffer is(quadrants_jpeg, sizeof quadrants_jpeg);
+    Image image = Image::read_jpeg(is, scale);
+    unsigned size = 32 / scale, half = size / 2;
+    ASSERT_EQ(image.kind(), ImageType::RGB);
+    ASSERT_EQ(image.width(), size);
+    ASSERT_EQ(image.height(), size);
+    expect_quadrant(image, half / 2, half / 2, 0);
+    expect_quadrant(image, half + half / 2, half / 2, 1);
+    expect_quadrant(image, half / 2, half + half / 2, 2);
+    expect_quadrant(image, half + half / 2, half + half / 2, 3);
+  }
+
+  MemoryBuffer is(gray_jpeg, sizeof gray_jpeg);
+  Image gray = Image::read_jpeg(is, 1);
+  ASSERT_EQ(gray.kind(), ImageType::Luminance);
+  ASSERT_EQ(gray.width(), 16u);
+  ASSERT_EQ(gray.height(), 8u);
+  ASSERT_NEAR(gray.pixel(2, 3)[0], 40, 8);
+  ASSERT_NEAR(gray.pixel(13, 3)[0], 220, 8);
+}
+
+TEST(Image, JPEGIntoView) {
+  // Decode into the middle of a bigger RGBA image.
+  Image page(ImageType::RGBA, 40, 40);
+  MemoryBuffer is(quadrants_jpeg, sizeof quadrants_jpeg);
+  ImageView part = Image::read_jpeg(is, 2, page.subview(10, 10, 30, 30));
+  ASSERT_EQ(part.width(), 16u);
+  ASSERT_EQ(part.height(), 16u);
+  ASSERT_EQ(part.pixel(0, 0), page.pixel(10, 10));
+  expect_quadrant(part, 12, 12, 3);
+  ASSERT_EQ(part.pixel(12, 12)[3], 255);
+  ASSERT_EQ(page.pixel(26, 10)[3], 0);
+  ASSERT_EQ(page.pixel(10, 26)[3], 0);
+
+  // Grayscale files can be read as color.
+  Image rgb(ImageType::RGB, 16, 8);
+  MemoryBuffer gray(gray_jpeg, sizeof gray_jpeg);
+  Image::read_jpeg(gray, 1, rgb);
+  ASSERT_NEAR(rgb.pixel(13, 3)[1], 220, 8);
+
+  Image small(ImageType::RGB, 31, 32);
+  MemoryBuffer again(quadrants_jpeg, sizeof quadrants_jpeg);
+  ASSERT_THROW(Image::read_jpeg(again, 1, small), FatalError);
+}
+
+TEST(Image, ReadAnyFormat) {
+  MemoryBuffer jpeg(quadrants_jpeg, sizeof quadrants_jpeg);
+  Image image = Image::read(jpeg);
+  ASSERT_EQ(image.width(), 32u);
+  expect_quadrant(image, 24, 24, 3);
+
+  std::ostringstream os;
+  image.write_png(os);
+  std::istringstream png(os.str());
+  Image copy = Image::read(png);
+  ASSERT_EQ(copy.kind(), ImageType::RGB);
+  ASSERT_EQ(copy.pixel(5, 20)[2], image.pixel(5, 20)[2]);
+
+  // Streams that can't seek work too.
+  PipeBuffer pipe(os.str());
+  std::istream piped(&pipe);
+  ASSERT_EQ(Image::read(piped).pixel(5, 20)[2], image.pixel(5, 20)[2]);
+
+  std::istringstream text("GIF89a");
+  ASSERT_THROW(Image::read(text), FatalError);
+  MemoryBuffer truncated(quadrants_jpeg, 20);
+  ASSERT_THROW(Image::read_jpeg(truncated, 1), FatalError);
+}
+
+TEST(Image, TooLarge) {
+  // A JPEG header of 65500 by 21860 wraps the size of the pixel buffer if
+  // it's computed in 32 bits.
+  std::string jpeg(reinterpret_cast<const char *>(quadrants_jpeg),
+                   sizeof quadrants_jpeg);
+  size_t sof = jpeg.find("\xff\xc0");
+  ASSERT_NE(sof, std::string::npos);
+  jpeg.replace(sof + 5, 4, std::string("\x55\x64\xff\xdc", 4));
+  std::istringstream is(jpeg);
+  ASSERT_THROW(Image::read_jpeg(is, 1), FatalError);
+  jpeg.resize(sof + 200);
+  std::istringstream truncated(jpeg);
+  ASSERT_THROW(Image::read(truncated), FatalError);
+
+  // The same goes for PNG, with a valid checksum on the header.
+  std::ostringstream os;
+  Image(ImageType::RGBA, 1, 1).write_png(os);
+  std::string png = os.str();
+  png.replace(16, 8, std::string("\x00\x01\x11\x70\x00\x00\x00\x01", 8));
+  uint32_t crc = crc32(0, reinterpret_cast<const Bytef *>(png.data() + 12), 17);
+  for (int i = 0; i < 4; i++)
+    png[29 + i] = char(crc >> (24 - 8 * i));
+  std::istringstream large(png);
+  ASSERT_THROW(Image::read_png(large), FatalError);
+}
@@ -0,0 +1,110 @@
+#include <cstring>
+
+#include <gtest/gtest.h>
+
+#include "input.hpp"
+
+namespace {
+
+SDL_Event motion(uint64_t time, float x, float xrel,
+                 SDL_MouseButtonFlags state) {
+  SDL_Event e;
+  memset(&e, 0, sizeof e);
+  e.type = SDL_EVENT_MOUSE_MOTION;
+  e.motion.timestamp = time;
+  e.motion.state = state;
+  e.motion.x = x;
+  e.motion.xrel = xrel;
+  return e;
+}
+
+SDL_Event button(uint64_t time, uint8_t button, bool down) {
+  SDL_Event e;
+  memset(&e, 0, sizeof e);
+  e.type = down ? SDL_EVENT_MOUSE_BUTTON_DOWN : SDL_EVENT_MOUSE_BUTTON_UP;
+  e.button.timestamp = time;
+  e.button.button = button;
+  e.button.down = down;
+  return e;
+}
+
+} // namespace
+
+TEST(Input, Coalesce) {
+  InputSampler input({});
+  input.begin(100);
+  for (int i = 0; i < 10; i++)
+    input.add(motion(10 + i, float(i), 1, 0));
+  input.add(button(20, SDL_BUTTON_LEFT, true));
+  input.add(motion(21, 20, 2, SDL_BUTTON_MASK(SDL_BUTTON_LEFT)));
+  input.add(motion(22, 30, 3, SDL_BUTTON_MASK(SDL_BUTTON_LEFT)));
+  auto &events = input.events();
+  ASSERT_EQ(events.size(), 3u);
+  ASSERT_EQ(events[0].motion.x, 9);
+  ASSERT_EQ(events[0].motion.xrel, 10);
+  ASSERT_EQ(events[0].motion.timestamp, 19u);
+  ASSERT_EQ(events[1].type, SDL_EVENT_MOUSE_BUTTON_DOWN);
+  ASSERT_EQ(events[2].motion.xrel, 5);
+  const InputState &state = input.state();
+  ASSERT_EQ(state.mouse_x, 30);
+  ASSERT_EQ(state.mouse_dx, 15);
+  ASSERT_EQ(state.buttons, SDL_BUTTON_MASK(SDL_BUTTON_LEFT));
+
+  // Held state carries over and per-frame motion doesn't.
+  input.begin(200);
+  ASSERT_TRUE(input.events().empty());
+  ASSERT_EQ(state.mouse_dx, 0);
+  ASSERT_EQ(state.buttons, SDL_BUTTON_MASK(SDL_BUTTON_LEFT));
+  input.add(button(150, SDL_BUTTON_LEFT, false));
+  ASSERT_EQ(state.buttons, 0u);
+}
+
+TEST(Input, Latency) {
+  InputSampler input({});
+  // Frames without input don't count.
+  input.begin(0);
+  input.submit(5);
+  input.presented(10);
+  ASSERT_EQ(input.latency().frames, 0u);
+  for (int i = 0; i < 200; i++) {
+    uint64_t t = 1000 + i * 100;
+    input.begin(t);
+    input.add(motion(t - 30, 0, 1, 0));
+    input.add(motion(t - 10, 0, 1, 0));
+    input.submit(t + 20);
+    input.presented(t + 20 + i % 10);
+  }
+  InputSampler::Latency l = input.latency();
+  ASSERT_EQ(l.frames, 128u);
+  ASSERT_EQ(l.last, 59u);
+  ASSERT_EQ(l.max, 59u);
+  ASSERT_GT(l.mean, 50u);
+  ASSERT_LT(l.mean, 59u);
+}
+
+TEST(Input, Pacing) {
+  const uint64_t ms = 1000000;
+  InputSampler input({100, ms}); // 10 ms refresh interval
+  ASSERT_EQ(input.delay(0), 0u);
+  input.begin(0);
+  input.submit(3 * ms);
+  input.presented(10 * ms);
+  // 3 ms of work and 1 ms of margin leave 6 ms to wait.
+  ASSERT_EQ(input.delay(10 * ms), 6 * ms);
+  ASSERT_EQ(input.delay(17 * ms), 0u);
+  // A slow frame is taken into account at once.
+  input.begin(16 * ms);
+  input.submit(21 * ms);
+  input.presented(30 * ms);
+  ASSERT_EQ(input.delay(30 * ms), 4 * ms);
+  // A fast frame only shortens the estimate a little.
+  input.begin(34 * ms);
+  input.submit(35 * ms);
+  input.presented(40 * ms);
+  uint64_t wait = input.delay(40 * ms);
+  ASSERT_GT(wait, 4 * ms);
+  ASSERT_LT(wait, 5 * ms);
+  // Sampling as soon as possible.
+  input.set_refresh_rate(0);
+  ASSERT_EQ(input.delay(40 * ms), 0u);
+}
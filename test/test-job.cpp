@@ -0,0 +1,54 @@
+#include <atomic>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "job.hpp"
+#include "util.hpp"
+
+TEST(Job, Run) {
+  JobPool pool(3);
+  std::vector<int> hits(1000, 0);
+  pool.run(hits.size(), [&](size_t i) { hits[i]++; });
+  for (int n : hits)
+    ASSERT_EQ(n, 1);
+}
+
+TEST(Job, ParallelFor) {
+  JobPool pool(3);
+  std::atomic<size_t> sum = 0;
+  pool.parallel_for(10000, 64, [&](size_t begin, size_t end) {
+    size_t local = 0;
+    for (size_t i = begin; i < end; i++)
+      local += i;
+    sum += local;
+  });
+  ASSERT_EQ(sum, size_t(10000) * 9999 / 2);
+}
+
+TEST(Job, Nested) {
+  JobPool pool(2);
+  std::atomic<int> count = 0;
+  pool.run(8, [&](size_t) { pool.run(8, [&](size_t) { count++; }); });
+  ASSERT_EQ(count, 64);
+}
+
+TEST(Job, Error) {
+  JobPool pool(2);
+  ASSERT_THROW(pool.run(16,
+                        [](size_t i) {
+                          if (i == 5)
+                            throw FatalError::Decode;
+                        }),
+               FatalError);
+}
+
+TEST(Job, Submit) {
+  std::atomic<int> count = 0;
+  {
+    JobPool pool(2);
+    for (int i = 0; i < 100; i++)
+      pool.submit([&]() { count++; });
+  } // the destructor waits for submitted jobs
+  ASSERT_EQ(count, 100);
+}
@@ -0,0 +1,182 @@
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "json.hpp"
+#include "util.hpp"
+
+namespace {
+
+JsonValue parse(JsonDocument &doc, const std::string &text) {
+  doc.parse(text.c_str(), text.size());
+  return doc.root();
+}
+
+} // namespace
+
+TEST(Json, Scalars) {
+  JsonDocument doc;
+  std::string text = "[null, true, false, 0, -12, 3.5, 1e3, -2.5E-2, \"hi\"]";
+  JsonValue root = parse(doc, text);
+  ASSERT_EQ(root.type(), JsonValue::Type::Array);
+  ASSERT_EQ(root.size(), 9u);
+  EXPECT_TRUE(root[0].is_null());
+  EXPECT_TRUE(root[1].as_bool());
+  EXPECT_FALSE(root[2].as_bool());
+  EXPECT_EQ(root[3].as_int(), 0);
+  EXPECT_EQ(root[4].as_int(), -12);
+  EXPECT_EQ(root[5].as_number(), 3.5);
+  EXPECT_EQ(root[6].as_number(), 1000);
+  EXPECT_EQ(root[7].as_number(), -0.025);
+  EXPECT_EQ(root[8].as_string(), "hi");
+  EXPECT_EQ(root[4].as_number(), -12);
+
+  // Top-level values don't have to be arrays or objects.
+  std::string number = " 42 ", string = "\"42\"", null = "null";
+  EXPECT_EQ(parse(doc, number).as_int(), 42);
+  EXPECT_EQ(parse(doc, string).as_string(), "42");
+  EXPECT_TRUE(parse(doc, null).is_null());
+}
+
+TEST(Json, Nested) {
+  JsonDocument doc;
+  std::string text = R"({
+    "name": "level 1",
+    "size": {"w": 64, "h": 32},
+    "empty": {},
+    "layers": [[1, 2], [], [3, [4, 5]], {"a": []}],
+    "last": true
+  })";
+  JsonValue root = parse(doc, text);
+  ASSERT_EQ(root.size(), 5u);
+  EXPECT_EQ(root["name"].as_string(), "level 1");
+  EXPECT_EQ(root["size"]["w"].as_int(), 64);
+  EXPECT_EQ(root["size"]["h"].as_int(), 32);
+  EXPECT_EQ(root["empty"].size(), 0u);
+  EXPECT_TRUE(root["last"].as_bool());
+
+  JsonValue layers = root["layers"];
+  ASSERT_EQ(layers.size(), 4u);
+  EXPECT_EQ(layers[1].size(), 0u);
+  EXPECT_EQ(layers[2][1][1].as_int(), 5);
+  EXPECT_EQ(layers[3]["a"].size(), 0u);
+  std::vector<size_t> sizes;
+  for (JsonValue layer : layers.items())
+    sizes.push_back(layer.size());
+  EXPECT_EQ(sizes, (std::vector<size_t>{2, 0, 2, 1}));
+
+  std::vector<std::string> keys;
+  for (auto [key, value] : root.members())
+    keys.emplace_back(key);
+  EXPECT_EQ(keys, (std::vector<std::string>{"name", "size", "empty",
+                                            "layers", "last"}));
+  JsonValue value;
+  EXPECT_FALSE(root.find("missing", value));
+  EXPECT_TRUE(root.find("size", value));
+  EXPECT_EQ(value.size(), 2u);
+}
+
+TEST(Json, Escapes) {
+  JsonDocument doc;
+  std::string text = R"(["a\"b", "\\", "\/\b\f\n\r\t", "\u00e9\u20ac",
+    "\ud83d\ude00", "x\\\"y", "\\\\", "plain"])";
+  JsonValue root = parse(doc, text);
+  ASSERT_EQ(root.size(), 8u);
+  EXPECT_EQ(root[0].as_string(), "a\"b");
+  EXPECT_EQ(root[1].as_string(), "\\");
+  EXPECT_EQ(root[2].as_string(), "/\b\f\n\r\t");
+  EXPECT_EQ(root[3].as_string(), "\xc3\xa9\xe2\x82\xac");
+  EXPECT_EQ(root[4].as_string(), "\xf0\x9f\x98\x80");
+  EXPECT_EQ(root[5].as_string(), "x\\\"y");
+  EXPECT_EQ(root[6].as_string(), "\\\\");
+  EXPECT_EQ(root[7].as_string(), "plain");
+
+  // Strings without escapes point into the input.
+  EXPECT_EQ(root[7].as_string().data(), text.c_str() + text.rfind("plain"));
+}
+
+TEST(Json, BlockBoundaries) {
+  // Move strings with escapes and structural characters across the 64-byte
+  // blocks of the first pass.
+  JsonDocument doc;
+  for (size_t pad = 0; pad < 130; pad++) {
+    for (size_t slashes = 0; slashes < 5; slashes++) {
+      std::string s = std::string(pad, 'a') + std::string(2 * slashes, '\\') +
+                      "\\\"{[,:]}";
+      std::string text = "{\"k\": [\"" + s + "\", 1]}";
+      JsonValue root = parse(doc, text);
+      std::string expected = std::string(pad, 'a') +
+                             std::string(slashes, '\\') + "\"{[,:]}";
+      ASSERT_EQ(root["k"][0].as_string(), expected) << pad << " " << slashes;
+      ASSERT_EQ(root["k"][1].as_int(), 1);
+    }
+  }
+}
+
+TEST(Json, Invalid) {
+  const char *cases[] = {
+      "",
+      "   ",
+      "[",
+      "]",
+      "{",
+      "[1,]",
+      "[1 2]",
+      "{\"a\" 1}",
+      "{\"a\": }",
+      "{\"a\": 1,}",
+      "{1: 2}",
+      "[1] [2]",
+      "[1]]",
+      "{\"a\": 1]",
+      "\"abc",
+      "[\"a\\\"]",
+      "[\"\\x\"]",
+      "[\"\\u12\"]",
+      "[\"\\ud800\"]",
+      "[tru]",
+      "[nulls]",
+      "[01]",
+      "[1.]",
+      "[.5]",
+      "[-]",
+      "[1e]",
+      "[+1]",
+      "[1 x]",
+  };
+  JsonDocument doc;
+  for (const char *text : cases) {
+    EXPECT_THROW(parse(doc, text), FatalError) << text;
+  }
+}
+
+TEST(Json, Types) {
+  JsonDocument doc;
+  std::string text = R"({"a": [1.5, "2", 99999999999999999999]})";
+  JsonValue root = parse(doc, text);
+  EXPECT_THROW(root.as_string(), FatalError);
+  EXPECT_THROW(root[0], FatalError);
+  EXPECT_THROW(root["b"], FatalError);
+  JsonValue a = root["a"];
+  EXPECT_THROW(a[3], FatalError);
+  EXPECT_THROW(a[0].as_int(), FatalError);
+  EXPECT_THROW(a[1].as_number(), FatalError);
+  EXPECT_THROW(a[2].as_int(), FatalError);
+  EXPECT_EQ(a[2].as_number(), 1e20);
+}
+
+TEST(Json, Reuse) {
+  JsonDocument doc;
+  std::string big = "[";
+  for (int i = 0; i < 1000; i++)
+    big += std::to_string(i) + ", \"s\\n\", ";
+  big += "{}]";
+  EXPECT_EQ(parse(doc, big).size(), 2001u);
+  std::string small = "{\"x\": \"\\t\"}";
+  JsonValue root = parse(doc, small);
+  EXPECT_EQ(root.size(), 1u);
+  EXPECT_EQ(root["x"].as_string(), "\t");
+  EXPECT_THROW(parse(doc, "[1,"), FatalError);
+  EXPECT_EQ(parse(doc, big)[1998].as_int(), 999);
+}
@@ -0,0 +1,177 @@
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <SDL3/SDL_render.h>
+#include <SDL3/SDL_surface.h>
+
+#include "label.hpp"
+#include "render.hpp"
+#include "test-font.hpp"
+#include "util.hpp"
+
+namespace {
+
+using Lines = std::vector<std::string_view>;
+
+constexpr SDL_FColor white = {1, 1, 1, 1};
+
+} // namespace
+
+TEST(Label, Wrap) {
+  Font font = test_font(20);
+  Lines lines;
+  LabelCache::wrap(font, "", 0, lines);
+  ASSERT_EQ(lines, Lines({""}));
+  LabelCache::wrap(font, "AB VA\n\nsa\n", 0, lines);
+  ASSERT_EQ(lines, Lines({"AB VA", "", "sa", ""}));
+
+  float width = font.measure("AAA AAA");
+  LabelCache::wrap(font, "AAA AAA AAA", width, lines);
+  ASSERT_EQ(lines, Lines({"AAA AAA", "AAA"}));
+  LabelCache::wrap(font, "AAA AAA AAA", width - 1, lines);
+  ASSERT_EQ(lines, Lines({"AAA", "AAA", "AAA"}));
+  // Long words aren't broken, and spaces at breaks are dropped.
+  LabelCache::wrap(font, "A AAAAAAAAAA   A\nAAA A", width, lines);
+  ASSERT_EQ(lines, Lines({"A", "AAAAAAAAAA", "A", "AAA A"}));
+}
+
+TEST(Label, Draw) {
+  SDL_Surface *surface = SDL_CreateSurface(320, 240, SDL_PIXELFORMAT_RGBA32);
+  SDL_Renderer *renderer = SDL_CreateSoftwareRenderer(surface);
+  ASSERT_NE(renderer, nullptr);
+  Font font = test_font(20);
+  RenderQueue queue;
+  {
+    LabelCache cache({});
+    // "A" is 10 by 14 pixels, 1 pixel right of the pen and with its top 14
+    // pixels above the baseline, which is 16 pixels down.
+    LabelCache::Key key = {"A", &font};
+    const LabelCache::Block &a = cache.draw(renderer, queue, key, 10, 20, 0,
+                                            white);
+    ASSERT_EQ(a.width, 12);
+    ASSERT_EQ(a.height, std::ceil(font.line_height()));
+    ASSERT_EQ(a.left, 1);
+    ASSERT_EQ(a.top, 2);
+    ASSERT_EQ(a.w, 10);
+    ASSERT_EQ(a.h, 14);
+    unsigned x = a.x, y = a.y;
+    ASSERT_EQ(cache.size(), 1u);
+    ASSERT_EQ(queue.size(), 1u);
+
+    // Drawing it again uses the same image.
+    const LabelCache::Block &again = cache.draw(renderer, queue, key, 50, 20,
+                                                0, white);
+    ASSERT_EQ(again.x, x);
+    ASSERT_EQ(again.y, y);
+    ASSERT_EQ(cache.size(), 1u);
+    ASSERT_EQ(queue.size(), 2u);
+
+    // Each part of the key makes a different block.
+    key.align = LabelCache::Align::Right;
+    key.width = 100;
+    const LabelCache::Block &right = cache.get(renderer, key);
+    ASSERT_EQ(right.width, 100);
+    ASSERT_EQ(right.left, 89);
+    ASSERT_EQ(cache.size(), 2u);
+    key.align = LabelCache::Align::Center;
+    ASSERT_EQ(cache.get(renderer, key).left, 45);
+    key.text = "AAA AAA\nAB";
+    key.width = 40;
+    const LabelCache::Block &lines = cache.get(renderer, key);
+    ASSERT_EQ(lines.height, 3 * std::ceil(font.line_height()));
+    ASSERT_EQ(cache.size(), 4u);
+
+    // Blank blocks have a size but aren't drawn.
+    const LabelCache::Block &blank =
+        cache.draw(renderer, queue, {"  ", &font}, 0, 0, 0, white);
+    ASSERT_GT(blank.width, 0);
+    ASSERT_EQ(blank.w, 0);
+    ASSERT_EQ(queue.size(), 2u);
+
+    queue.flush(renderer);
+    ASSERT_EQ(queue.draw_calls(), 1u);
+  }
+  SDL_DestroyRenderer(renderer);
+  SDL_DestroySurface(surface);
+}
+
+TEST(Label, MatchesFontDraw) {
+  SDL_Surface *surface = SDL_CreateSurface(320, 240, SDL_PIXELFORMAT_RGBA32);
+  SDL_Renderer *renderer = SDL_CreateSoftwareRenderer(surface);
+  ASSERT_NE(renderer, nullptr);
+  Font font = test_font(20);
+  {
+    LabelCache cache({});
+    const char *text = "VA sAm";
+    const LabelCache::Block &block = cache.get(renderer, {text, &font});
+    ConstImageView staged = cache.staged();
+    ASSERT_EQ(staged.width(), block.w + 2u);
+    ASSERT_EQ(staged.height(), block.h + 2u);
+
+    // Draw the same text in white over transparent white, so that the
+    // image is placed like the staged one.
+    Image expect(ImageType::RGBA, staged.width(), staged.height());
+    for (unsigned y = 0; y < expect.height(); y++) {
+      for (unsigned x = 0; x < expect.width(); x++) {
+        uint8_t *p = expect.pixel(x, y);
+        p[0] = p[1] = p[2] = 255;
+        p[3] = 0;
+      }
+    }
+    const uint8_t white8[4] = {255, 255, 255, 255};
+    font.draw(expect, 1 - block.left, 1 - block.top + std::round(font.ascent()),
+              text, white8);
+    for (unsigned y = 0; y < expect.height(); y++)
+      for (unsigned x = 0; x < expect.width(); x++)
+        for (int c = 0; c < 4; c++)
+          ASSERT_EQ(staged.pixel(x, y)[c], expect.pixel(x, y)[c])
+              << x << ", " << y;
+  }
+  SDL_DestroyRenderer(renderer);
+  SDL_DestroySurface(surface);
+}
+
+TEST(Label, Evict) {
+  SDL_Surface *surface = SDL_CreateSurface(320, 240, SDL_PIXELFORMAT_RGBA32);
+  SDL_Renderer *renderer = SDL_CreateSoftwareRenderer(surface);
+  ASSERT_NE(renderer, nullptr);
+  Font font = test_font(20);
+  LabelCache::Params params;
+  params.atlas_size = 64;
+  LabelCache cache(params);
+  // Images of "A" and "V" are 12 by 16 pixels with their borders, so a shelf
+  // holds 5 and the atlas has 4 shelves.
+  std::vector<std::string> labels;
+  for (const char *a : {"A", "V", "A ", "V "})
+    for (const char *b : {"", " ", "  ", "   ", "    "})
+      labels.push_back(std::string(b) + a);
+  for (const std::string &label : labels)
+    cache.get(renderer, {label, &font});
+  ASSERT_EQ(cache.size(), 20u);
+  // Blocks drawn this frame are never evicted.
+  ASSERT_THROW(cache.get(renderer, {"1", &font}), FatalError);
+
+  // The least recently used shelf is emptied for a new block.
+  cache.begin_frame();
+  for (size_t i = 5; i < labels.size(); i++)
+    cache.get(renderer, {labels[i], &font});
+  const LabelCache::Block &one = cache.get(renderer, {"1", &font});
+  ASSERT_EQ(one.x, 1);
+  ASSERT_EQ(cache.size(), 16u);
+  cache.get(renderer, {labels[0], &font});
+  ASSERT_EQ(cache.size(), 17u);
+
+  // Too large for the atlas.
+  cache.begin_frame();
+  ASSERT_THROW(cache.get(renderer, {"AAAAAAAAAA", &font}), FatalError);
+  cache.clear();
+  ASSERT_EQ(cache.size(), 0u);
+  cache.get(renderer, {"A", &font});
+  ASSERT_EQ(cache.size(), 1u);
+
+  SDL_DestroyRenderer(renderer);
+  SDL_DestroySurface(surface);
+}
@@ -0,0 +1,121 @@
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "localize.hpp"
+#include "util.hpp"
+
+namespace {
+
+using Strings = std::vector<std::pair<std::string, std::string>>;
+
+/// Load a compiled file as if it were read from disk.
+StringTable load(const ByteWriter &file) {
+  auto copy = std::make_unique<uint8_t[]>(file.size());
+  memcpy(copy.get(), file.data(), file.size());
+  return StringTable(AssetMapping(std::move(copy), file.size()));
+}
+
+} // namespace
+
+TEST(Localize, Lookup) {
+  Strings strings;
+  for (int i = 0; i < 1000; i++)
+    strings.emplace_back("key." + std::to_string(i),
+                         "value " + std::to_string(i * 7));
+  strings.emplace_back("empty", "");
+  StringTable table = load(StringTable::compile(strings));
+  ASSERT_EQ(table.size(), strings.size());
+  for (const auto &[key, value] : strings) {
+    StringTable::String s;
+    ASSERT_TRUE(table.find(key, s)) << key;
+    ASSERT_EQ(s.text, value);
+    ASSERT_EQ(s.text.data()[s.text.size()], '\0');
+  }
+
+  StringTable::String s;
+  for (int i = 1000; i < 2000; i++)
+    ASSERT_FALSE(table.find("key." + std::to_string(i), s));
+  ASSERT_FALSE(table.find("", s));
+  ASSERT_EQ(table.get("key.3"), "value 21");
+  ASSERT_EQ(table.get("missing"), "missing");
+}
+
+TEST(Localize, Empty) {
+  StringTable none;
+  StringTable::String s;
+  ASSERT_FALSE(none.find("a", s));
+  ASSERT_EQ(none.get("a"), "a");
+
+  StringTable table = load(StringTable::compile({}));
+  ASSERT_EQ(table.size(), 0u);
+  ASSERT_FALSE(table.find("a", s));
+
+  table = load(StringTable::compile({{"", "nothing"}}));
+  ASSERT_EQ(table.get(""), "nothing");
+  ASSERT_EQ(table.get("a"), "a");
+}
+
+TEST(Localize, Hints) {
+  using Hint = StringTable::Hint;
+  ASSERT_EQ(StringTable::classify("Hello, world"), Hint::Basic);
+  ASSERT_EQ(StringTable::classify("Gr\xc3\xbc\xc3\x9f"
+                                  "e"),
+            Hint::Basic); // Grüße
+  ASSERT_EQ(StringTable::classify("e\xcc\x81"), 0); // e, combining acute
+  ASSERT_EQ(StringTable::classify("\xe6\x97\xa5\xe6\x9c\xac"), 0); // 日本
+  ASSERT_EQ(StringTable::classify("\xd7\xa9\xd7\x9c\xd7\x95\xd7\x9d"),
+            Hint::RightToLeft); // שלום
+  ASSERT_EQ(StringTable::classify("\xd9\x85\xd8\xb1\xd8\xad\xd8\xa8\xd8\xa7"),
+            Hint::RightToLeft); // مرحبا
+  ASSERT_EQ(StringTable::classify("ab\xc3"), 0);
+  ASSERT_EQ(StringTable::classify("\x80"), 0);
+
+  StringTable table = load(StringTable::compile({
+      {"latin", "caf\xc3\xa9"},
+      {"hebrew", "\xd7\xa9\xd7\x9c\xd7\x95\xd7\x9d"},
+  }));
+  StringTable::String s;
+  ASSERT_TRUE(table.find("latin", s));
+  ASSERT_EQ(s.hints, Hint::Basic);
+  ASSERT_TRUE(table.find("hebrew", s));
+  ASSERT_EQ(s.hints, Hint::RightToLeft);
+}
+
+TEST(Localize, Errors) {
+  ASSERT_THROW(StringTable::compile({{"a", "1"}, {"b", "2"}, {"a", "3"}}),
+               FatalError);
+  ASSERT_THROW(StringTable::compile({{std::string(70000, 'k'), "v"}}),
+               FatalError);
+
+  ByteWriter file = StringTable::compile({{"a", "1"}, {"b", "2"}});
+  ASSERT_THROW(
+      StringTable(AssetMapping(std::make_unique<uint8_t[]>(8), 8)),
+      FatalError);
+  for (size_t i = 0; i < 16; i++) {
+    auto copy = std::make_unique<uint8_t[]>(file.size());
+    memcpy(copy.get(), file.data(), file.size());
+    copy[i] ^= 0x40;
+    ASSERT_THROW(StringTable(AssetMapping(std::move(copy), file.size())),
+                 FatalError)
+        << i;
+  }
+
+  // Point both strings past the end of the file.
+  auto copy = std::make_unique<uint8_t[]>(file.size());
+  memcpy(copy.get(), file.data(), file.size());
+  uint32_t buckets;
+  memcpy(&buckets, copy.get() + 8, 4);
+  for (int i = 0; i < 2; i++) {
+    uint32_t bad = file.size();
+    memcpy(copy.get() + 16 + 4 * buckets + 16 * i + 4, &bad, 4);
+  }
+  StringTable table(AssetMapping(std::move(copy), file.size()));
+  StringTable::String s;
+  ASSERT_THROW(table.find("a", s), FatalError);
+}
@@ -0,0 +1,98 @@
+#include <cstdint>
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include "image.hpp"
+#include "mask.hpp"
+
+namespace {
+
+BitMask random_mask(unsigned w, unsigned h, double density,
+                    std::mt19937 &prand) {
+  std::bernoulli_distribution bit(density);
+  BitMask mask(w, h);
+  for (unsigned y = 0; y < h; y++)
+    for (unsigned x = 0; x < w; x++)
+      mask.set(x, y, bit(prand));
+  return mask;
+}
+
+/// Count overlapping pixels one at a time.
+size_t reference(const BitMask &a, const BitMask &b, int32_t dx, int32_t dy) {
+  size_t n = 0;
+  for (unsigned y = 0; y < b.height(); y++) {
+    for (unsigned x = 0; x < b.width(); x++) {
+      int32_t ax = x + dx, ay = y + dy;
+      if (0 <= ax && unsigned(ax) < a.width() && 0 <= ay &&
+          unsigned(ay) < a.height())
+        n += a.get(ax, ay) && b.get(x, y);
+    }
+  }
+  return n;
+}
+
+} // namespace
+
+TEST(Mask, FromAlpha) {
+  std::mt19937 prand(1);
+  std::uniform_int_distribution<unsigned> value(0, 255);
+  // Widths that aren't a multiple of 16 or 64 test the edges.
+  Image rgba(ImageType::RGBA, 150, 7), gray(ImageType::Luminance, 150, 7);
+  for (unsigned y = 0; y < 7; y++) {
+    for (unsigned x = 0; x < 150; x++) {
+      for (int c = 0; c < 4; c++)
+        rgba.pixel(x, y)[c] = value(prand);
+      gray.pixel(x, y)[0] = rgba.pixel(x, y)[3];
+    }
+  }
+  for (unsigned threshold : {0u, 1u, 128u, 255u}) {
+    BitMask a = BitMask::from_alpha(rgba, threshold);
+    BitMask b = BitMask::from_alpha(gray, threshold);
+    ASSERT_EQ(a.width(), 150u);
+    ASSERT_EQ(a.height(), 7u);
+    size_t count = 0;
+    for (unsigned y = 0; y < 7; y++) {
+      for (unsigned x = 0; x < 150; x++) {
+        bool expect = rgba.pixel(x, y)[3] >= threshold;
+        ASSERT_EQ(a.get(x, y), expect);
+        ASSERT_EQ(b.get(x, y), expect);
+        count += expect;
+      }
+      // Bits past the width stay clear.
+      ASSERT_EQ(a.row(y)[2] >> 22, 0u);
+    }
+    ASSERT_EQ(a.count(), count);
+  }
+
+  // Masks of subviews start at the corner of the subview.
+  BitMask part = BitMask::from_alpha(rgba.subview(70, 2, 40, 3));
+  ASSERT_EQ(part.width(), 40u);
+  for (unsigned y = 0; y < 3; y++)
+    for (unsigned x = 0; x < 40; x++)
+      ASSERT_EQ(part.get(x, y), rgba.pixel(70 + x, 2 + y)[3] >= 128);
+}
+
+TEST(Mask, Overlap) {
+  std::mt19937 prand(2);
+  BitMask a = random_mask(150, 40, 0.3, prand);
+  BitMask b = random_mask(70, 20, 0.3, prand);
+  std::uniform_int_distribution<int32_t> x(-80, 160), y(-30, 50);
+  for (int i = 0; i < 500; i++) {
+    int32_t dx = x(prand), dy = y(prand);
+    size_t expect = reference(a, b, dx, dy);
+    ASSERT_EQ(a.overlap(b, dx, dy), expect);
+    ASSERT_EQ(a.overlaps(b, dx, dy), expect != 0);
+  }
+
+  // Single pixels only touch when they're placed on each other.
+  BitMask dot(1, 1), big(130, 3);
+  dot.set(0, 0, true);
+  big.set(129, 2, true);
+  ASSERT_TRUE(big.overlaps(dot, 129, 2));
+  ASSERT_FALSE(big.overlaps(dot, 128, 2));
+  ASSERT_TRUE(dot.overlaps(big, -129, -2));
+  ASSERT_FALSE(dot.overlaps(big, -130, -2));
+  big.set(129, 2, false);
+  ASSERT_EQ(big.count(), 0u);
+}
@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+
+#include <SDL3/SDL_render.h>
+#include <SDL3/SDL_surface.h>
+
+#include "overlay.hpp"
+#include "profile.hpp"
+#include "render.hpp"
+#include "test-font.hpp"
+#include "util.hpp"
+
+namespace {
+
+SDL_Event key_down(SDL_Scancode scancode, bool repeat = false) {
+  SDL_Event e = {};
+  e.type = SDL_EVENT_KEY_DOWN;
+  e.key.scancode = scancode;
+  e.key.down = true;
+  e.key.repeat = repeat;
+  return e;
+}
+
+} // namespace
+
+TEST(Overlay, Toggle) {
+  FrameProfiler profiler({});
+  PerfOverlay overlay(test_font(12), profiler, {});
+  ASSERT_FALSE(overlay.visible());
+  ASSERT_FALSE(overlay.handle(key_down(SDL_SCANCODE_A)));
+  ASSERT_TRUE(overlay.handle(key_down(SDL_SCANCODE_F3)));
+  ASSERT_TRUE(overlay.visible());
+  ASSERT_FALSE(overlay.handle(key_down(SDL_SCANCODE_F3, true)));
+  ASSERT_TRUE(overlay.visible());
+  SDL_Event up = key_down(SDL_SCANCODE_F3);
+  up.type = SDL_EVENT_KEY_UP;
+  up.key.down = false;
+  ASSERT_FALSE(overlay.handle(up));
+  ASSERT_TRUE(overlay.handle(key_down(SDL_SCANCODE_F3)));
+  ASSERT_FALSE(overlay.visible());
+}
+
+TEST(Overlay, Draw) {
+  SDL_Surface *surface = SDL_CreateSurface(320, 240, SDL_PIXELFORMAT_RGBA32);
+  SDL_Renderer *renderer = SDL_CreateSoftwareRenderer(surface);
+  ASSERT_NE(renderer, nullptr);
+  FrameProfiler profiler({});
+  profiler.phase("input");
+  for (uint64_t i = 0; i < 10; i++) {
+    profiler.begin_frame(i * 20000000);
+    profiler.end_frame(i * 20000000 + 10000000);
+  }
+  RenderQueue queue;
+  {
+    PerfOverlay::Params params;
+    params.refresh = 100;
+    PerfOverlay overlay(test_font(12), profiler, params);
+    unsigned calls = 0;
+    overlay.add("queue", "%.0f", [&]() { return double(++calls); });
+    // Formats are checked, since the probe's double is passed to them.
+    for (const char *bad : {"%s", "%d", "%.1f %f", "%*f", "%lf", "no value",
+                            "%"})
+      ASSERT_THROW(overlay.add("bad", bad, []() { return 0.0; }), FatalError)
+          << bad;
+    overlay.add("percent", "%5.1f%%", []() { return 12.5; });
+
+    // Nothing is drawn while hidden.
+    overlay.draw(renderer, queue, 0);
+    ASSERT_EQ(queue.size(), 0u);
+    ASSERT_EQ(calls, 0u);
+
+    overlay.set_visible(true);
+    overlay.draw(renderer, queue, 0);
+    ASSERT_EQ(calls, 1u);
+    std::vector<std::string> text = overlay.text();
+    ASSERT_EQ(text.size(), 5u);
+    ASSERT_EQ(text[0], "frame: 10.00 / 10.00 / 10.00 ms");
+    ASSERT_EQ(text[1], "input: 0.00 / 0.00 / 0.00 ms");
+    ASSERT_EQ(text[2], "hitches: 0");
+    ASSERT_EQ(text[3], "queue: 1");
+    ASSERT_EQ(text[4], "percent:  12.5%");
+    // Background, one bar per frame, the budget line and the text.
+    ASSERT_GT(queue.size(), 12u);
+    queue.flush(renderer);
+    ASSERT_EQ(queue.draw_calls(), 1u);
+
+    // Text only changes after the refresh interval.
+    overlay.draw(renderer, queue, 99);
+    ASSERT_EQ(calls, 1u);
+    overlay.draw(renderer, queue, 100);
+    ASSERT_EQ(calls, 2u);
+    ASSERT_EQ(overlay.text()[3], "queue: 2");
+    queue.clear();
+  }
+  SDL_DestroyRenderer(renderer);
+  SDL_DestroySurface(surface);
+}
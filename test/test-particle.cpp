@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+
+#include <SDL3/SDL_render.h>
+#include <SDL3/SDL_surface.h>
+
+#include "job.hpp"
+#include "particle.hpp"
+#include "render.hpp"
+
+TEST(Particle, Lifetime) {
+  JobPool pool(2);
+  ParticleSystem particles;
+  EmitterParams p;
+  p.rate = 1000;
+  p.min_life = p.max_life = 0.5f;
+  p.max_speed = 100;
+  p.spread = 6.3f;
+  unsigned e = particles.add(p);
+  // Fractions of a particle carry over to the next update.
+  for (int i = 0; i < 30; i++)
+    particles.update(0.01f, pool);
+  ASSERT_EQ(particles.size(e), 300u);
+  // The first particles die after half a second, so the count levels off.
+  for (int i = 0; i < 50; i++)
+    particles.update(0.01f, pool);
+  ASSERT_NEAR(double(particles.size()), 500, 10);
+  particles.params(e).rate = 0;
+  particles.update(0.6f, pool);
+  ASSERT_EQ(particles.size(), 0u);
+}
+
+TEST(Particle, Limits) {
+  JobPool pool(2);
+  ParticleSystem particles;
+  EmitterParams p;
+  p.rate = 1e6f;
+  p.max_particles = 100;
+  unsigned a = particles.add(p);
+  unsigned b = particles.add(p);
+  particles.update(1, pool);
+  ASSERT_EQ(particles.size(a), 100u);
+  particles.burst(b, 50000);
+  ASSERT_EQ(particles.size(b), 50100u);
+  // Integration covers blocks of several emitters.
+  particles.update(0.5f, pool);
+  ASSERT_EQ(particles.size(b), 50100u);
+  particles.clear(b);
+  ASSERT_EQ(particles.size(), 100u);
+}
+
+TEST(Particle, Draw) {
+  JobPool pool(2);
+  SDL_Surface *surface = SDL_CreateSurface(64, 64, SDL_PIXELFORMAT_RGBA32);
+  SDL_Renderer *renderer = SDL_CreateSoftwareRenderer(surface);
+  ASSERT_NE(renderer, nullptr);
+  ParticleSystem particles;
+  EmitterParams p;
+  p.x = 20;
+  p.y = 40;
+  p.min_life = p.max_life = 10;
+  p.start_size = p.end_size = 4;
+  p.start_color = p.end_color = {1, 0, 0, 1};
+  p.key = sort_key(0, 0, BlendMode::None, 0);
+  particles.burst(particles.add(p), 10);
+  particles.add(p);
+  RenderQueue queue;
+  particles.draw(queue, pool);
+  // Empty emitters don't record anything.
+  ASSERT_EQ(queue.size(), 1u);
+  queue.flush(renderer);
+  SDL_FlushRenderer(renderer);
+  uint8_t r, g, b, a;
+  SDL_ReadSurfacePixel(surface, 20, 40, &r, &g, &b, &a);
+  ASSERT_EQ(r, 255);
+  SDL_ReadSurfacePixel(surface, 30, 40, &r, &g, &b, &a);
+  ASSERT_EQ(r, 0);
+  SDL_DestroyRenderer(renderer);
+  SDL_DestroySurface(surface);
+}
@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <queue>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "job.hpp"
+#include "path.hpp"
+
+namespace {
+
+/// Get the optimal cost with plain Dijkstra, or infinity.
+float reference(const Pathfinder &grid, GridPoint start, GridPoint goal) {
+  int32_t w = grid.width(), h = grid.height();
+  if (grid.blocked(start.x, start.y) || grid.blocked(goal.x, goal.y))
+    return Pathfinder::unreachable;
+  std::vector<double> cost(size_t(w) * h, INFINITY);
+  using Item = std::pair<double, int32_t>;
+  std::priority_queue<Item, std::vector<Item>, std::greater<Item>> open;
+  cost[start.y * w + start.x] = 0;
+  open.push({0, start.y * w + start.x});
+  while (!open.empty()) {
+    auto [c, i] = open.top();
+    open.pop();
+    int32_t x = i % w, y = i / w;
+    if (c > cost[i])
+      continue;
+    if (x == goal.x && y == goal.y)
+      return c;
+    for (int dy = -1; dy <= 1; dy++) {
+      for (int dx = -1; dx <= 1; dx++) {
+        if ((!dx && !dy) || grid.blocked(x + dx, y + dy))
+          continue;
+        if (dx && dy && (grid.blocked(x + dx, y) || grid.blocked(x, y + dy)))
+          continue;
+        double next = c + (dx && dy ? std::sqrt(2.0) : 1.0);
+        int32_t j = (y + dy) * w + x + dx;
+        if (next < cost[j]) {
+          cost[j] = next;
+          open.push({next, j});
+        }
+      }
+    }
+  }
+  return Pathfinder::unreachable;
+}
+
+/// Check that a path is walkable and has the given cost.
+void check_path(const Pathfinder &grid, GridPoint start, GridPoint goal,
+                const std::vector<GridPoint> &path, float cost) {
+  ASSERT_FALSE(path.empty());
+  ASSERT_EQ(path.front(), start);
+  ASSERT_EQ(path.back(), goal);
+  double length = 0;
+  for (size_t i = 1; i < path.size(); i++) {
+    GridPoint a = path[i - 1], b = path[i];
+    int32_t nx = std::abs(b.x - a.x), ny = std::abs(b.y - a.y);
+    ASSERT_TRUE(!nx || !ny || nx == ny);
+    int32_t n = std::max(nx, ny);
+    ASSERT_GT(n, 0);
+    int dx = (b.x > a.x) - (b.x < a.x), dy = (b.y > a.y) - (b.y < a.y);
+    for (int32_t k = 1; k <= n; k++) {
+      int32_t x = a.x + k * dx, y = a.y + k * dy;
+      ASSERT_FALSE(grid.blocked(x, y));
+      if (dx && dy) {
+        ASSERT_FALSE(grid.blocked(x - dx, y));
+        ASSERT_FALSE(grid.blocked(x, y - dy));
+      }
+    }
+    length += dx && dy ? n * std::sqrt(2.0) : n;
+  }
+  ASSERT_NEAR(length, cost, 1e-3);
+}
+
+/// Block a fraction of the cells at random.
+void scatter(Pathfinder &grid, double density, std::mt19937 &prand) {
+  std::bernoulli_distribution block(density);
+  for (unsigned y = 0; y < grid.height(); y++)
+    for (unsigned x = 0; x < grid.width(); x++)
+      grid.set_blocked(x, y, block(prand));
+}
+
+GridPoint random_point(const Pathfinder &grid, std::mt19937 &prand) {
+  std::uniform_int_distribution<int32_t> x(0, grid.width() - 1);
+  std::uniform_int_distribution<int32_t> y(0, grid.height() - 1);
+  return {x(prand), y(prand)};
+}
+
+} // namespace
+
+TEST(Path, JumpPointSearch) {
+  std::mt19937 prand(1);
+  Pathfinder grid(61, 47, {});
+  PathSearch search;
+  std::vector<GridPoint> path;
+  for (double density : {0.0, 0.2, 0.35}) {
+    scatter(grid, density, prand);
+    for (int i = 0; i < 200; i++) {
+      GridPoint a = random_point(grid, prand), b = random_point(grid, prand);
+      float expect = reference(grid, a, b);
+      float cost = grid.find_jps(a, b, search, path);
+      if (expect == Pathfinder::unreachable) {
+        ASSERT_EQ(cost, Pathfinder::unreachable);
+        ASSERT_TRUE(path.empty());
+        continue;
+      }
+      ASSERT_NEAR(cost, expect, 1e-3);
+      check_path(grid, a, b, path, cost);
+    }
+  }
+  // Straight lines need no waypoints in between.
+  scatter(grid, 0, prand);
+  ASSERT_EQ(grid.find_jps({0, 0}, {40, 40}, search, path),
+            40 * std::sqrt(2.0f));
+  ASSERT_EQ(path.size(), 2u);
+}
+
+TEST(Path, Hierarchical) {
+  std::mt19937 prand(2);
+  Pathfinder grid(61, 47, {8});
+  PathSearch search;
+  std::vector<GridPoint> path;
+  for (double density : {0.0, 0.2, 0.35}) {
+    scatter(grid, density, prand);
+    grid.update();
+    ASSERT_EQ(grid.dirty(), 0u);
+    for (int i = 0; i < 200; i++) {
+      GridPoint a = random_point(grid, prand), b = random_point(grid, prand);
+      float expect = reference(grid, a, b);
+      float cost = grid.find(a, b, search, path);
+      if (expect == Pathfinder::unreachable) {
+        ASSERT_EQ(cost, Pathfinder::unreachable);
+        ASSERT_TRUE(path.empty());
+        continue;
+      }
+      // Paths go through entrances, so they can be a little longer.
+      ASSERT_GE(cost, expect - 1e-3);
+      ASSERT_LE(cost, expect * 1.25 + 2);
+      check_path(grid, a, b, path, cost);
+    }
+  }
+}
+
+TEST(Path, Update) {
+  Pathfinder grid(64, 64, {16});
+  grid.update();
+  PathSearch search;
+  std::vector<GridPoint> path;
+  // Nearby clusters are searched directly.
+  ASSERT_FLOAT_EQ(grid.find({2, 10}, {30, 10}, search, path), 28);
+  ASSERT_EQ(path.size(), 2u);
+  ASSERT_GE(grid.find({2, 10}, {60, 10}, search, path), 58);
+
+  // A cell inside a cluster only affects that cluster.
+  grid.set_blocked(20, 20, true);
+  ASSERT_EQ(grid.dirty(), 1u);
+  grid.set_blocked(20, 20, false);
+  ASSERT_EQ(grid.dirty(), 1u);
+  // A cell on a border also affects the neighbor.
+  grid.update();
+  grid.set_blocked(31, 5, true);
+  ASSERT_EQ(grid.dirty(), 2u);
+  grid.set_blocked(31, 5, false);
+
+  // Wall off the right half, except for a gap at the bottom.
+  for (unsigned y = 0; y < 63; y++)
+    grid.set_blocked(40, y, true);
+  JobPool pool(2);
+  grid.update(&pool);
+  float cost = grid.find({2, 10}, {60, 10}, search, path);
+  ASSERT_GE(cost, reference(grid, {2, 10}, {60, 10}) - 1e-3);
+  check_path(grid, {2, 10}, {60, 10}, path, cost);
+  grid.set_blocked(40, 63, true);
+  grid.update(&pool);
+  ASSERT_EQ(grid.find({2, 10}, {60, 10}, search, path),
+            Pathfinder::unreachable);
+  ASSERT_TRUE(path.empty());
+  ASSERT_EQ(grid.find({2, 10}, {2, 10}, search, path), 0);
+  ASSERT_EQ(path.size(), 1u);
+  ASSERT_EQ(grid.find({40, 10}, {2, 10}, search, path),
+            Pathfinder::unreachable);
+}
+
+TEST(Path, Batch) {
+  std::mt19937 prand(3);
+  Pathfinder grid(200, 150, {16});
+  scatter(grid, 0.25, prand);
+  JobPool pool(3);
+  grid.update(&pool);
+  std::vector<PathQuery> queries(500);
+  for (PathQuery &q : queries)
+    q = {random_point(grid, prand), random_point(grid, prand)};
+  std::vector<PathResult> results(queries.size());
+  grid.find_batch(queries.data(), queries.size(), results.data(), pool);
+  PathSearch search;
+  std::vector<GridPoint> path;
+  for (size_t i = 0; i < queries.size(); i++) {
+    ASSERT_EQ(results[i].cost,
+              grid.find(queries[i].start, queries[i].goal, search, path));
+    ASSERT_EQ(results[i].path, path);
+  }
+}
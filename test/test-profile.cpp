@@ -0,0 +1,97 @@
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "profile.hpp"
+
+TEST(Profile, Buckets) {
+  // Every time falls into a bucket that contains it.
+  uint64_t prev = 0;
+  for (size_t b = 0; b < FrameProfiler::buckets; b++) {
+    uint64_t limit = FrameProfiler::bucket_limit(b);
+    ASSERT_GT(limit, prev);
+    if (b > 16) {
+      ASSERT_LE(limit - prev, limit / 8 + 1);
+    }
+    prev = limit;
+  }
+}
+
+TEST(Profile, Stats) {
+  const uint64_t ms = 1000000;
+  FrameProfiler::Params params;
+  params.window = 100;
+  params.hitch = 1000 * ms;
+  FrameProfiler profiler(params);
+  unsigned sim = profiler.phase("simulate");
+  ASSERT_EQ(profiler.phase("simulate"), sim);
+  ASSERT_EQ(profiler.phases(), 2u);
+  uint64_t t = 0;
+  // Old frames drop out of the window.
+  for (int i = 0; i < 50; i++) {
+    profiler.begin_frame(t);
+    profiler.end_frame(t += 100 * ms);
+  }
+  for (int i = 0; i < 100; i++) {
+    uint64_t frame = i == 42 ? 80 * ms : i < 95 ? 10 * ms : 20 * ms;
+    profiler.begin_frame(t);
+    profiler.add(sim, t, t + 2 * ms);
+    profiler.add(sim, t + 3 * ms, t + 4 * ms);
+    profiler.end_frame(t += frame);
+  }
+  FrameProfiler::Stats s = profiler.stats(0);
+  ASSERT_EQ(s.frames, 100u);
+  ASSERT_EQ(s.max, 80 * ms);
+  ASSERT_GE(s.p50, 10 * ms);
+  ASSERT_LE(s.p50, 10 * ms * 9 / 8);
+  ASSERT_GE(s.p99, 20 * ms);
+  ASSERT_LE(s.p99, 20 * ms * 9 / 8);
+  ASSERT_EQ(profiler.frames(), 100u);
+  ASSERT_EQ(profiler.recent(0, 0), 20 * ms);
+  ASSERT_EQ(profiler.recent(0, 57), 80 * ms);
+  ASSERT_EQ(profiler.recent(sim, 99), 3 * ms);
+  s = profiler.stats(sim);
+  ASSERT_EQ(s.max, 3 * ms);
+  ASSERT_GE(s.p90, 3 * ms);
+  ASSERT_EQ(profiler.hitches(), 0u);
+
+  // A phase added later counts as unused in earlier frames.
+  unsigned late = profiler.phase("late");
+  s = profiler.stats(late);
+  ASSERT_EQ(s.frames, 100u);
+  ASSERT_EQ(s.p99, FrameProfiler::bucket_limit(0));
+}
+
+TEST(Profile, Hitch) {
+  const uint64_t ms = 1000000;
+  std::vector<std::string> dumps;
+  FrameProfiler::Params params;
+  params.hitch = 50 * ms;
+  params.before = 3;
+  params.after = 2;
+  params.dump = [&](const std::string &trace) { dumps.push_back(trace); };
+  FrameProfiler profiler(params);
+  unsigned render = profiler.phase("render \"main\"");
+  uint64_t t = 0;
+  for (int i = 0; i < 20; i++) {
+    profiler.begin_frame(t);
+    uint64_t frame = i == 10 || i == 11 ? 80 * ms : 10 * ms;
+    profiler.add(render, t, t + frame / 2);
+    profiler.end_frame(t += frame);
+    // Dumps wait for the frames after the hitch.
+    ASSERT_EQ(dumps.size(), i < 12 ? 0u : 1u);
+  }
+  ASSERT_EQ(profiler.hitches(), 2u);
+  // 6 frames with 2 events each.
+  const std::string &trace = dumps[0];
+  size_t events = 0;
+  for (size_t pos = 0; (pos = trace.find("\"ph\":\"X\"", pos)) != trace.npos;
+       pos++)
+    events++;
+  ASSERT_EQ(events, 12u);
+  ASSERT_NE(trace.find("\"render \\\"main\\\"\""), trace.npos);
+  ASSERT_NE(trace.find("\"dur\":80000.000"), trace.npos);
+  ASSERT_EQ(trace.substr(0, 15), "{\"traceEvents\":");
+  ASSERT_EQ(trace.substr(trace.size() - 4), "\n]}\n");
+}
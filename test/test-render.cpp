@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <SDL3/SDL_render.h>
+#include <SDL3/SDL_surface.h>
+
+#include "render.hpp"
+
+namespace {
+
+/// Software renderer that draws into a surface.
+struct Target {
+  SDL_Surface *surface;
+  SDL_Renderer *renderer;
+
+  Target(int w, int h) {
+    surface = SDL_CreateSurface(w, h, SDL_PIXELFORMAT_RGBA32);
+    renderer = SDL_CreateSoftwareRenderer(surface);
+  }
+
+  ~Target() {
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroySurface(surface);
+  }
+
+  uint8_t red(int x, int y) {
+    SDL_FlushRenderer(renderer);
+    uint8_t r, g, b, a;
+    SDL_ReadSurfacePixel(surface, x, y, &r, &g, &b, &a);
+    return r;
+  }
+};
+
+} // namespace
+
+TEST(Render, DepthKey) {
+  std::vector<float> values = {-1e9f, -2.5f, -0.0f, 0.0f, 1e-9f, 3.0f, 1e9f};
+  for (size_t i = 1; i < values.size(); i++)
+    ASSERT_LE(depth_key(values[i - 1]), depth_key(values[i]));
+}
+
+TEST(Render, Batching) {
+  Target target(64, 64);
+  ASSERT_NE(target.renderer, nullptr);
+  SDL_Texture *textures[3];
+  for (auto &t : textures)
+    t = SDL_CreateTexture(target.renderer, SDL_PIXELFORMAT_RGBA32,
+                          SDL_TEXTUREACCESS_STATIC, 4, 4);
+  RenderQueue queue;
+  std::mt19937 prand(1);
+  std::uniform_int_distribution<int> pick(0, 2);
+  // Interleave textures. Sorting groups them into one call each.
+  for (int i = 0; i < 300; i++) {
+    uint16_t id = queue.texture(textures[pick(prand)]);
+    queue.quad(sort_key(0, id, BlendMode::Blend, i), {0, 0, 8, 8},
+               {0, 0, 1, 1}, {1, 1, 1, 1});
+  }
+  ASSERT_EQ(queue.size(), 300u);
+  queue.flush(target.renderer);
+  ASSERT_EQ(queue.draw_calls(), 3u);
+  ASSERT_EQ(queue.size(), 0u);
+  // A different blend mode breaks the batch.
+  uint16_t id = queue.texture(textures[0]);
+  queue.quad(sort_key(0, id, BlendMode::Blend, 0), {0, 0, 8, 8}, {0, 0, 1, 1},
+             {1, 1, 1, 1});
+  queue.quad(sort_key(0, id, BlendMode::Add, 0), {0, 0, 8, 8}, {0, 0, 1, 1},
+             {1, 1, 1, 1});
+  queue.flush(target.renderer);
+  ASSERT_EQ(queue.draw_calls(), 2u);
+  for (auto t : textures)
+    SDL_DestroyTexture(t);
+}
+
+TEST(Render, Order) {
+  Target target(16, 16);
+  ASSERT_NE(target.renderer, nullptr);
+  RenderQueue queue;
+  // Record back to front in the wrong order. Layers decide what's on top.
+  queue.quad(sort_key(2, 0, BlendMode::None, 0), {0, 0, 16, 16}, {},
+             {1, 0, 0, 1});
+  queue.quad(sort_key(1, 0, BlendMode::None, 0), {0, 0, 16, 16}, {},
+             {0.5f, 0, 0, 1});
+  // Within a layer, depth decides.
+  queue.quad(sort_key(3, 0, BlendMode::None, depth_key(2)), {0, 0, 8, 8}, {},
+             {0.25f, 0, 0, 1});
+  queue.quad(sort_key(3, 0, BlendMode::None, depth_key(1)), {0, 0, 8, 8}, {},
+             {0, 0, 0, 1});
+  queue.flush(target.renderer);
+  ASSERT_EQ(queue.draw_calls(), 1u);
+  ASSERT_EQ(target.red(12, 12), 255);
+  ASSERT_NEAR(target.red(4, 4), 64, 1);
+}
+
+TEST(Render, Gather) {
+  Target target(16, 16);
+  ASSERT_NE(target.renderer, nullptr);
+  RenderQueue queue;
+  // Interleave two blend modes, so neither batch's vertices are contiguous.
+  for (int i = 0; i < 4; i++) {
+    BlendMode mode = i % 2 ? BlendMode::Add : BlendMode::None;
+    queue.quad(sort_key(0, 0, mode, 0), {i * 4.0f, 0, 4, 16}, {},
+               {i / 4.0f, 0, 0, 1});
+  }
+  queue.flush(target.renderer);
+  ASSERT_EQ(queue.draw_calls(), 2u);
+  for (int i = 0; i < 4; i++)
+    ASSERT_NEAR(target.red(i * 4 + 2, 8), i * 64, 1);
+}
@@ -0,0 +1,143 @@
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "replay.hpp"
+#include "util.hpp"
+
+namespace {
+
+/// A toy simulation that depends on input, time and random numbers.
+struct Sim {
+  float x = 0, y = 0;
+  uint64_t hash = 14695981039346656037u;
+
+  void step(const ReplayFrame &frame) {
+    std::mt19937_64 prand(frame.seed);
+    for (const SDL_Event &e : frame.events) {
+      if (e.type == SDL_EVENT_MOUSE_MOTION) {
+        x += e.motion.xrel;
+        y += e.motion.yrel;
+      } else if (e.type == SDL_EVENT_KEY_DOWN) {
+        x *= float(e.key.scancode);
+      } else if (e.type == SDL_EVENT_TEXT_INPUT) {
+        y += strlen(e.text.text);
+      }
+    }
+    x += frame.dt * float(prand() % 100);
+    uint64_t bits;
+    memcpy(&bits, &x, 4);
+    memcpy(reinterpret_cast<uint8_t *>(&bits) + 4, &y, 4);
+    hash = (hash ^ bits) * 1099511628211u;
+  }
+};
+
+} // namespace
+
+TEST(Replay, RoundTrip) {
+  ReplayRecorder recorder;
+  Sim live;
+  std::mt19937 prand(1);
+  uint64_t time = 1000000000;
+  char text[] = "héllo";
+  for (int i = 0; i < 500; i++) {
+    ReplayFrame frame;
+    frame.dt = 1 / 60.0f + float(prand() % 100) * 1e-5f;
+    frame.seed = prand();
+    for (unsigned n = prand() % 4; n--;) {
+      SDL_Event e;
+      memset(&e, 0, sizeof e);
+      time += prand() % 5000000;
+      e.common.timestamp = time;
+      switch (prand() % 5) {
+      case 0:
+        e.type = SDL_EVENT_MOUSE_MOTION;
+        e.motion.x = float(prand() % 1000);
+        e.motion.xrel = float(prand() % 7) - 3;
+        e.motion.yrel = 0.5f;
+        break;
+      case 1:
+        e.type = SDL_EVENT_KEY_DOWN;
+        e.key.down = true;
+        e.key.scancode = SDL_Scancode(prand() % 100);
+        e.key.key = 0x40000000 | e.key.scancode;
+        break;
+      case 2:
+        e.type = SDL_EVENT_TEXT_INPUT;
+        e.text.text = text;
+        break;
+      case 3:
+        e.type = SDL_EVENT_GAMEPAD_AXIS_MOTION;
+        e.gaxis.axis = 2;
+        e.gaxis.value = -12345;
+        break;
+      default:
+        // Not recorded.
+        e.type = SDL_EVENT_WINDOW_RESIZED;
+        break;
+      }
+      recorder.event(e);
+      if (e.type != SDL_EVENT_WINDOW_RESIZED)
+        frame.events.push_back(e);
+    }
+    live.step(frame);
+    recorder.frame(frame.dt, frame.seed, live.hash);
+  }
+  // The recording doesn't depend on the caller's text buffer.
+  strcpy(text, "bye");
+  ASSERT_EQ(recorder.frames(), 500u);
+
+  const ByteWriter &data = recorder.data();
+  ReplayPlayer player(data.data(), data.size());
+  Sim replayed;
+  ReplayFrame frame;
+  bool keys = false, text_seen = false;
+  while (player.next(frame)) {
+    replayed.step(frame);
+    ASSERT_EQ(replayed.hash, frame.checksum);
+    for (const SDL_Event &e : frame.events) {
+      if (e.type == SDL_EVENT_KEY_DOWN) {
+        ASSERT_TRUE(e.key.down);
+        ASSERT_EQ(e.key.key, 0x40000000 | e.key.scancode);
+        keys = true;
+      } else if (e.type == SDL_EVENT_TEXT_INPUT) {
+        ASSERT_STREQ(e.text.text, "héllo");
+        text_seen = true;
+      } else if (e.type == SDL_EVENT_GAMEPAD_AXIS_MOTION) {
+        ASSERT_EQ(e.gaxis.value, -12345);
+      }
+      ASSERT_GT(e.common.timestamp, 1000000000u);
+    }
+  }
+  ASSERT_TRUE(keys && text_seen);
+  ASSERT_EQ(player.frames(), 500u);
+  ASSERT_EQ(replayed.x, live.x);
+  ASSERT_EQ(replayed.y, live.y);
+}
+
+TEST(Replay, Invalid) {
+  ReplayRecorder recorder;
+  SDL_Event e;
+  memset(&e, 0, sizeof e);
+  e.type = SDL_EVENT_MOUSE_WHEEL;
+  e.wheel.y = -1;
+  recorder.event(e);
+  recorder.frame(0.01f, 42);
+  const ByteWriter &data = recorder.data();
+  ReplayFrame frame;
+  {
+    ReplayPlayer player(data.data(), data.size());
+    ASSERT_TRUE(player.next(frame));
+    ASSERT_EQ(frame.seed, 42u);
+    ASSERT_EQ(frame.events.size(), 1u);
+    ASSERT_EQ(frame.events[0].wheel.y, -1);
+    ASSERT_FALSE(player.next(frame));
+  }
+  {
+    ReplayPlayer player(data.data(), data.size() - 1);
+    ASSERT_THROW(player.next(frame), FatalError);
+  }
+  ASSERT_THROW(ReplayPlayer(data.data(), 3), FatalError);
+}
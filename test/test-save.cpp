@@ -0,0 +1,176 @@
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "job.hpp"
+#include "save.hpp"
+#include "util.hpp"
+
+namespace {
+
+struct Position {
+  float x, y;
+};
+
+struct Health {
+  int value;
+};
+
+/// Not saved.
+struct Cache {
+  int value;
+};
+
+/// Version 1 of Stats had only a level.
+struct Stats {
+  int level;
+  int xp;
+};
+
+enum : uint32_t { PositionTag = 10, HealthTag = 11, StatsTag = 12 };
+
+SaveSchema make_schema() {
+  SaveSchema schema(1);
+  schema.add<Position>(PositionTag);
+  schema.add<Health>(HealthTag);
+  schema.add<Stats>(StatsTag, 2, [](uint32_t version, const uint8_t *src,
+                                    size_t size, size_t num, void *dst) {
+    if (version != 1 || size != sizeof(int))
+      throw FatalError::Decode;
+    auto out = static_cast<Stats *>(dst);
+    for (size_t i = 0; i < num; i++) {
+      memcpy(&out[i].level, src + i * size, sizeof(int));
+      out[i].xp = 0;
+    }
+  });
+  return schema;
+}
+
+ByteWriter save(const World &world, const SaveSchema &schema) {
+  ByteWriter out;
+  WorldSnapshot(world, schema).write(out);
+  return out;
+}
+
+} // namespace
+
+TEST(Save, RoundTrip) {
+  SaveSchema schema = make_schema();
+  World world;
+  std::vector<Entity> list;
+  for (int i = 0; i < 3000; i++) {
+    if (i % 3 == 0)
+      list.push_back(world.create(Position{float(i), 1}, Health{i}));
+    else if (i % 3 == 1)
+      list.push_back(world.create(Health{i}, Cache{i}));
+    else
+      list.push_back(world.create());
+  }
+  for (int i = 0; i < 3000; i += 5)
+    world.destroy(list[i]);
+  ByteWriter out = save(world, schema);
+
+  World copy;
+  WorldSnapshot::load(copy, schema, ByteReader(out.data(), out.size()));
+  ASSERT_EQ(copy.size(), world.size());
+  for (int i = 0; i < 3000; i++) {
+    Entity e = list[i];
+    ASSERT_EQ(copy.alive(e), i % 5 != 0);
+    if (!copy.alive(e))
+      continue;
+    ASSERT_EQ(copy.has<Position>(e), i % 3 == 0);
+    ASSERT_EQ(copy.has<Health>(e), i % 3 != 2);
+    ASSERT_FALSE(copy.has<Cache>(e));
+    if (i % 3 == 0) {
+      ASSERT_EQ(copy.get<Position>(e)->x, i);
+    }
+    if (i % 3 != 2) {
+      ASSERT_EQ(copy.get<Health>(e)->value, i);
+    }
+  }
+  // New entities get the same handles in both worlds.
+  for (int i = 0; i < 700; i++)
+    ASSERT_EQ(copy.create(), world.create());
+  // Loading needs an empty World.
+  ASSERT_THROW(
+      WorldSnapshot::load(copy, schema, ByteReader(out.data(), out.size())),
+      FatalError);
+}
+
+TEST(Save, Snapshot) {
+  SaveSchema schema = make_schema();
+  World world;
+  Entity e = world.create(Health{1});
+  WorldSnapshot snapshot(world, schema);
+  // Later changes aren't saved.
+  world.get<Health>(e)->value = 2;
+  world.create(Health{3});
+  ByteWriter out;
+  snapshot.write(out);
+  World copy;
+  WorldSnapshot::load(copy, schema, ByteReader(out.data(), out.size()));
+  ASSERT_EQ(copy.size(), 1u);
+  ASSERT_EQ(copy.get<Health>(e)->value, 1);
+}
+
+TEST(Save, Versions) {
+  // An older build that saved Stats as a single int, and Health.
+  SaveSchema old_schema(1);
+  old_schema.add<int>(StatsTag, 1);
+  old_schema.add<Health>(HealthTag);
+  World old_world;
+  Entity e = old_world.create(7, Health{5});
+  ByteWriter out = save(old_world, old_schema);
+
+  // The current build upgrades Stats.
+  SaveSchema schema = make_schema();
+  World world;
+  WorldSnapshot::load(world, schema, ByteReader(out.data(), out.size()));
+  ASSERT_EQ(world.get<Stats>(e)->level, 7);
+  ASSERT_EQ(world.get<Stats>(e)->xp, 0);
+  ASSERT_EQ(world.get<Health>(e)->value, 5);
+
+  // A build that doesn't know about Stats skips it.
+  SaveSchema partial(1);
+  partial.add<Health>(HealthTag);
+  World world2;
+  WorldSnapshot::load(world2, partial, ByteReader(out.data(), out.size()));
+  ASSERT_FALSE(world2.has<Stats>(e));
+  ASSERT_EQ(world2.get<Health>(e)->value, 5);
+
+  // Newer files are rejected.
+  SaveSchema newer(2);
+  newer.add<Health>(HealthTag);
+  out = save(old_world, newer);
+  World world3;
+  ASSERT_THROW(
+      WorldSnapshot::load(world3, partial, ByteReader(out.data(), out.size())),
+      FatalError);
+}
+
+TEST(Save, Async) {
+  SaveSchema schema = make_schema();
+  JobPool pool(2);
+  World world;
+  std::vector<Entity> list;
+  for (int i = 0; i < 100000; i++)
+    list.push_back(world.create(Position{float(i), 0}, Health{i}));
+  std::vector<uint8_t> file;
+  {
+    JobPool saver(1);
+    save_async(world, schema, saver, [&](const ByteWriter &out) {
+      file.assign(out.data(), out.data() + out.size());
+    });
+    // The game keeps going while it saves.
+    for (Entity e : list)
+      world.get<Health>(e)->value = -1;
+  }
+  ASSERT_FALSE(file.empty());
+  World copy;
+  load_save(copy, schema, file.data(), file.size(), pool);
+  for (int i = 0; i < 100000; i += 997)
+    ASSERT_EQ(copy.get<Health>(list[i])->value, i);
+  ASSERT_THROW(load_save(copy, schema, file.data(), 10, pool), FatalError);
+}
@@ -0,0 +1,140 @@
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "job.hpp"
+#include "serial.hpp"
+#include "util.hpp"
+
+TEST(Serial, Values) {
+  ByteWriter out;
+  out.put(uint16_t(0x1234));
+  out.varint(0);
+  out.varint(300);
+  out.varint(UINT64_MAX);
+  out.string("hello");
+  out.put(1.5f);
+  ASSERT_EQ(out.size(), 2u + 1 + 2 + 10 + 6 + 4);
+  ByteReader in(out.data(), out.size());
+  ASSERT_EQ(in.get<uint16_t>(), 0x1234);
+  ASSERT_EQ(in.varint(), 0u);
+  ASSERT_EQ(in.varint(), 300u);
+  ASSERT_EQ(in.varint(), UINT64_MAX);
+  ASSERT_EQ(in.string(), "hello");
+  ASSERT_EQ(in.get<float>(), 1.5f);
+  ASSERT_TRUE(in.empty());
+  ASSERT_THROW(in.get<uint8_t>(), FatalError);
+}
+
+TEST(Serial, Array) {
+  std::vector<uint64_t> values = {1, 2, 3, 1ull << 40};
+  ByteWriter out;
+  out.put(uint8_t(7));
+  out.array(values.data(), values.size());
+  out.array<uint64_t>(nullptr, 0);
+  ByteReader in(out.data(), out.size());
+  ASSERT_EQ(in.get<uint8_t>(), 7);
+  auto view = in.array<uint64_t>();
+  // Read in place, not copied.
+  ASSERT_EQ(reinterpret_cast<uintptr_t>(view.data) % alignof(uint64_t), 0u);
+  ASSERT_GE(reinterpret_cast<const uint8_t *>(view.data), out.data());
+  ASSERT_EQ(std::vector<uint64_t>(view.begin(), view.end()), values);
+  ASSERT_EQ(in.array<uint64_t>().size, 0u);
+  ASSERT_TRUE(in.empty());
+}
+
+TEST(Serial, Fields) {
+  ByteWriter out;
+  out.begin(1);
+  out.put(uint32_t(10));
+  out.begin(99); // Added by a newer version.
+  out.string("ignored");
+  out.end();
+  out.begin(2);
+  out.put(uint32_t(20));
+  out.end();
+  out.end();
+  out.begin(3);
+  out.end();
+
+  ByteReader in(out.data(), out.size());
+  uint32_t tag;
+  ByteReader body(nullptr, 0), sub(nullptr, 0);
+  ASSERT_TRUE(in.field(tag, body));
+  ASSERT_EQ(tag, 1u);
+  ASSERT_EQ(body.get<uint32_t>(), 10u);
+  std::vector<uint32_t> tags;
+  while (body.field(tag, sub)) {
+    tags.push_back(tag);
+    if (tag == 2) {
+      ASSERT_EQ(sub.get<uint32_t>(), 20u);
+    }
+  }
+  ASSERT_EQ(tags, (std::vector<uint32_t>{99, 2}));
+  ASSERT_TRUE(in.field(tag, body));
+  ASSERT_EQ(tag, 3u);
+  ASSERT_TRUE(body.empty());
+  ASSERT_FALSE(in.field(tag, body));
+}
+
+TEST(Serial, Truncated) {
+  ByteWriter out;
+  out.begin(1);
+  out.string("some text");
+  out.end();
+  for (size_t n = 0; n < out.size(); n++) {
+    ByteReader in(out.data(), n);
+    uint32_t tag;
+    ByteReader body(nullptr, 0);
+    if (n == 0) {
+      ASSERT_FALSE(in.field(tag, body));
+    } else {
+      ASSERT_THROW(in.field(tag, body), FatalError);
+    }
+  }
+}
+
+TEST(Serial, Compress) {
+  JobPool pool(2);
+  // Several blocks, with a short one at the end.
+  std::vector<uint32_t> data(700000);
+  for (size_t i = 0; i < data.size(); i++)
+    data[i] = i / 7 * 2654435761u;
+  ByteWriter packed;
+  packed.put(uint8_t(0)); // Appending works at any offset.
+  compress_blocks(data.data(), data.size() * 4, packed, pool);
+  ASSERT_LT(packed.size(), data.size() * 4);
+
+  ByteWriter unpacked;
+  decompress_blocks(packed.data() + 1, packed.size() - 1, unpacked, pool);
+  ASSERT_EQ(unpacked.size(), data.size() * 4);
+  ASSERT_EQ(memcmp(unpacked.data(), data.data(), unpacked.size()), 0);
+
+  ByteWriter empty;
+  compress_blocks(nullptr, 0, empty, pool);
+  unpacked.clear();
+  decompress_blocks(empty.data(), empty.size(), unpacked, pool);
+  ASSERT_EQ(unpacked.size(), 0u);
+
+  // Corruption is detected.
+  std::vector<uint8_t> bad(packed.data() + 1, packed.data() + packed.size());
+  bad[bad.size() / 2] ^= 0xff;
+  unpacked.clear();
+  ASSERT_THROW(decompress_blocks(bad.data(), bad.size(), unpacked, pool),
+               FatalError);
+  ASSERT_THROW(decompress_blocks(bad.data(), 20, unpacked, pool), FatalError);
+
+  // So is a size that doesn't match the blocks, before it's allocated.
+  for (uint64_t total : {uint64_t(1) << 40, uint64_t(1) << 31}) {
+    ByteWriter header;
+    header.write(packed.data() + 1, 4);
+    header.put(total);
+    header.write(packed.data() + 13, packed.size() - 13);
+    unpacked.clear();
+    ASSERT_THROW(
+        decompress_blocks(header.data(), header.size(), unpacked, pool),
+        FatalError);
+    ASSERT_EQ(unpacked.size(), 0u);
+  }
+}
@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "job.hpp"
+#include "spatial.hpp"
+
+namespace {
+
+Aabb random_box(std::mt19937 &prand) {
+  std::uniform_real_distribution<float> pos(-500, 500);
+  std::uniform_real_distribution<float> size(0, 40);
+  float x = pos(prand), y = pos(prand);
+  return {x, y, x + size(prand), y + size(prand)};
+}
+
+} // namespace
+
+TEST(Spatial, Query) {
+  std::mt19937 prand(1);
+  SpatialHash grid(16);
+  std::vector<Aabb> boxes;
+  for (int i = 0; i < 2000; i++)
+    grid.insert(boxes.emplace_back(random_box(prand)));
+  // Move half of the objects, some a little and some a lot.
+  for (uint32_t i = 0; i < boxes.size(); i += 2) {
+    Aabb &b = boxes[i];
+    if (i % 4)
+      b = {b.min_x + 3, b.min_y - 3, b.max_x + 3, b.max_y - 3};
+    else
+      b = random_box(prand);
+    grid.update(i, b);
+  }
+  for (int n = 0; n < 100; n++) {
+    Aabb q = random_box(prand);
+    std::vector<uint32_t> found;
+    grid.query(q, found);
+    std::sort(found.begin(), found.end());
+    std::vector<uint32_t> expect;
+    for (uint32_t i = 0; i < boxes.size(); i++)
+      if (q.overlaps(boxes[i]))
+        expect.push_back(i);
+    ASSERT_EQ(found, expect);
+  }
+  // A query that covers everything takes the scanning path.
+  std::vector<uint32_t> found;
+  grid.query(Aabb{-1e6, -1e6, 1e6, 1e6}, found);
+  ASSERT_EQ(found.size(), boxes.size());
+  // Coordinates beyond the range of cells are clamped to it.
+  const float inf = std::numeric_limits<float>::infinity();
+  found.clear();
+  grid.query(Aabb{-inf, -inf, inf, inf}, found);
+  ASSERT_EQ(found.size(), boxes.size());
+  found.clear();
+  grid.query(Aabb{1e30f, 1e30f, 1e30f, 1e30f}, found);
+  grid.query(Circle{0, 0, std::nanf("")}, found);
+  ASSERT_TRUE(found.empty());
+}
+
+TEST(Spatial, Radius) {
+  SpatialHash grid(10);
+  grid.insert({0, 0, 1, 1});
+  grid.insert({7, 7, 8, 8});
+  grid.insert({20, 0, 21, 1});
+  std::vector<uint32_t> found;
+  grid.query(Circle{0, 0, 9}, found);
+  ASSERT_EQ(found, std::vector<uint32_t>({0}));
+  found.clear();
+  grid.query(Circle{0, 0, 10}, found);
+  std::sort(found.begin(), found.end());
+  ASSERT_EQ(found, std::vector<uint32_t>({0, 1}));
+}
+
+TEST(Spatial, Batch) {
+  std::mt19937 prand(2);
+  JobPool pool(3);
+  SpatialHash grid(32);
+  for (int i = 0; i < 1000; i++)
+    grid.insert(random_box(prand));
+  std::vector<Aabb> queries;
+  for (int i = 0; i < 300; i++)
+    queries.push_back(random_box(prand));
+  std::vector<uint32_t> offsets, ids;
+  grid.query(queries.data(), queries.size(), offsets, ids, pool);
+  ASSERT_EQ(offsets.size(), queries.size() + 1);
+  for (size_t i = 0; i < queries.size(); i++) {
+    std::vector<uint32_t> expect;
+    grid.query(queries[i], expect);
+    std::vector<uint32_t> found(ids.begin() + offsets[i],
+                                ids.begin() + offsets[i + 1]);
+    ASSERT_EQ(found, expect);
+  }
+}
+
+TEST(Spatial, Pairs) {
+  std::mt19937 prand(3);
+  JobPool pool(3);
+  SpatialHash grid(8);
+  std::vector<Aabb> boxes;
+  for (int i = 0; i < 1500; i++)
+    grid.insert(boxes.emplace_back(random_box(prand)));
+  grid.remove(10);
+  boxes[10] = {1e9, 1e9, 1e9, 1e9};
+  std::vector<std::pair<uint32_t, uint32_t>> found;
+  grid.pairs(found, pool);
+  std::sort(found.begin(), found.end());
+  std::vector<std::pair<uint32_t, uint32_t>> expect;
+  for (uint32_t i = 0; i < boxes.size(); i++)
+    for (uint32_t j = i + 1; j < boxes.size(); j++)
+      if (boxes[i].overlaps(boxes[j]))
+        expect.emplace_back(i, j);
+  ASSERT_EQ(found, expect);
+  // Removed IDs are reused.
+  ASSERT_EQ(grid.insert({0, 0, 1, 1}), 10u);
+}
+
+TEST(Spatial, EmptyCells) {
+  std::mt19937 prand(4);
+  SpatialHash grid(16);
+  std::vector<Aabb> boxes;
+  for (int i = 0; i < 500; i++)
+    grid.insert(boxes.emplace_back(random_box(prand)));
+  // Objects that wander far away don't leave their old cells behind.
+  for (int step = 0; step < 20; step++) {
+    for (uint32_t i = 0; i < boxes.size(); i++) {
+      Aabb &b = boxes[i];
+      float dx = 1000 * (step + 1);
+      b = random_box(prand);
+      b = {b.min_x + dx, b.min_y, b.max_x + dx, b.max_y};
+      grid.update(i, b);
+    }
+    size_t cells = 0;
+    for (const Aabb &b : boxes)
+      cells += size_t(b.max_x / 16 - b.min_x / 16 + 2) *
+               size_t(b.max_y / 16 - b.min_y / 16 + 2);
+    ASSERT_LE(grid.cells(), cells);
+    for (int n = 0; n < 20; n++) {
+      Aabb q = boxes[prand() % boxes.size()];
+      std::vector<uint32_t> found;
+      grid.query(q, found);
+      std::sort(found.begin(), found.end());
+      std::vector<uint32_t> expect;
+      for (uint32_t i = 0; i < boxes.size(); i++)
+        if (q.overlaps(boxes[i]))
+          expect.push_back(i);
+      ASSERT_EQ(found, expect);
+    }
+  }
+  for (uint32_t i = 0; i < boxes.size(); i++)
+    grid.remove(i);
+  ASSERT_EQ(grid.cells(), 0u);
+}
@@ -0,0 +1,86 @@
+#include <cstdint>
+#include <cstring>
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include "image.hpp"
+#include "job.hpp"
+#include "sprite.hpp"
+
+namespace {
+
+Image random_image(unsigned w, unsigned h, std::mt19937 &prand) {
+  std::uniform_int_distribution<int> distribution(0, 255);
+  Image i(ImageType::RGBA, w, h);
+  for (unsigned y = 0; y < h; y++)
+    for (unsigned x = 0; x < w * 4; x++)
+      i.pixel(0, y)[x] = distribution(prand);
+  return i;
+}
+
+} // namespace
+
+TEST(Sprite, Copy) {
+  std::mt19937 prand(1);
+  JobPool pool(3);
+  SpriteRenderer renderer(pool, 16);
+  Image atlas = random_image(64, 64, prand);
+  // Opaque pixels are copied exactly at 1:1 scale.
+  for (unsigned y = 0; y < 64; y++)
+    for (unsigned x = 0; x < 64; x++)
+      atlas.pixel(x, y)[3] = 255;
+  Image target(ImageType::RGBA, 100, 70);
+  ConstImageView atlases[] = {atlas};
+  Sprite s = {0, 8, 4, 40, 30, 13, 21, 40, 30, {255, 255, 255, 255}};
+  renderer.draw(target, atlases, &s, 1);
+  for (unsigned y = 0; y < 30; y++)
+    for (unsigned x = 0; x < 40; x++)
+      ASSERT_EQ(memcmp(target.pixel(13 + x, 21 + y), atlas.pixel(8 + x, 4 + y),
+                       4),
+                0);
+  ASSERT_EQ(target.pixel(12, 21)[3], 0);
+  ASSERT_EQ(target.pixel(53, 21)[3], 0);
+}
+
+TEST(Sprite, Blend) {
+  std::mt19937 prand(2);
+  JobPool pool(3);
+  SpriteRenderer renderer(pool, 32);
+  Image atlas = random_image(16, 16, prand);
+  Image target = random_image(91, 77, prand);
+  Image expect(ImageType::RGBA, 91, 77);
+  for (unsigned y = 0; y < 77; y++)
+    memcpy(expect.pixel(0, y), target.pixel(0, y), 91 * 4);
+  // Overlapping, scaled, tinted and partly off-screen sprites.
+  std::vector<Sprite> list;
+  std::uniform_real_distribution<float> pos(-20, 90), size(1, 50);
+  for (int i = 0; i < 200; i++)
+    list.push_back({0, 2, 3, 11, 9, pos(prand), pos(prand), size(prand),
+                    size(prand), {200, 255, 100, 180}});
+  ConstImageView atlases[] = {atlas};
+  renderer.draw(target, atlases, list.data(), list.size());
+  // Compare with a straightforward implementation.
+  auto div255 = [](unsigned x) { return (x + 1 + (x >> 8)) >> 8; };
+  for (auto &s : list) {
+    for (int y = 0; y < 77; y++) {
+      for (int x = 0; x < 91; x++) {
+        float fu = (x + 0.5f - s.x) / s.w, fv = (y + 0.5f - s.y) / s.h;
+        if (fu < 0 || 1 <= fu || fv < 0 || 1 <= fv)
+          continue;
+        unsigned u = s.src_x + std::min<unsigned>(fu * s.src_w, s.src_w - 1);
+        unsigned v = s.src_y + std::min<unsigned>(fv * s.src_h, s.src_h - 1);
+        const uint8_t *src = atlas.pixel(u, v);
+        uint8_t *dst = expect.pixel(x, y);
+        unsigned a = div255(src[3] * s.tint[3]);
+        for (int c = 0; c < 3; c++)
+          dst[c] = div255(div255(src[c] * s.tint[c]) * a + dst[c] * (255 - a));
+        dst[3] = div255(255 * a + dst[3] * (255 - a));
+      }
+    }
+  }
+  for (unsigned y = 0; y < 77; y++)
+    for (unsigned x = 0; x < 91; x++)
+      for (int c = 0; c < 4; c++)
+        ASSERT_EQ(target.pixel(x, y)[c], expect.pixel(x, y)[c]);
+}
@@ -0,0 +1,103 @@
+#include <cstring>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "job.hpp"
+#include "sprite.hpp"
+#include "tilemap.hpp"
+
+namespace {
+
+/// A tileset with two 4x4 tiles: opaque red and half-transparent blue.
+Image make_tileset() {
+  Image i(ImageType::RGBA, 8, 4);
+  for (unsigned y = 0; y < 4; y++) {
+    for (unsigned x = 0; x < 8; x++) {
+      const uint8_t red[] = {255, 0, 0, 255}, blue[] = {0, 0, 255, 128};
+      memcpy(i.pixel(x, y), x < 4 ? red : blue, 4);
+    }
+  }
+  return i;
+}
+
+} // namespace
+
+TEST(Tilemap, Composite) {
+  JobPool pool(2);
+  SpriteRenderer renderer(pool);
+  Image tileset = make_tileset();
+  Tilemap map(tileset, 4, 2, renderer);
+  map.set(-1, -1, 0, 1);
+  map.set(5, 6, 0, 1);
+  map.set(5, 6, 1, 2);
+  ASSERT_EQ(map.get(5, 6, 1), 2);
+  ASSERT_EQ(map.get(-1, -1, 0), 1);
+  std::vector<Tilemap::Visible> out;
+  map.visible({-10, -10, 10, 10}, out);
+  ASSERT_EQ(out.size(), 2u);
+  for (auto &v : out) {
+    if (v.x < 0) {
+      ASSERT_EQ(v.x, -128);
+      ASSERT_EQ(v.image.pixel(127, 127)[0], 255);
+      ASSERT_EQ(v.image.pixel(123, 127)[3], 0);
+    } else {
+      // Blue at half opacity over red.
+      const uint8_t *p = v.image.pixel(5 * 4, 6 * 4);
+      ASSERT_NEAR(p[0], 127, 1);
+      ASSERT_NEAR(p[2], 128, 1);
+      ASSERT_EQ(p[3], 255);
+    }
+  }
+  // Changing a tile redraws its chunk.
+  map.set(5, 6, 1, 0);
+  map.visible({0, 0, 10, 10}, out);
+  ASSERT_EQ(out.size(), 1u);
+  ASSERT_EQ(out[0].image.pixel(5 * 4, 6 * 4)[0], 255);
+
+  // Tiles past the end of the tileset are drawn as empty.
+  map.set(7, 6, 0, 3);
+  map.set(8, 6, 0, 65535);
+  map.visible({0, 0, 10, 10}, out);
+  ASSERT_EQ(out[0].image.pixel(7 * 4, 6 * 4)[3], 0);
+  ASSERT_EQ(out[0].image.pixel(8 * 4, 6 * 4)[3], 0);
+  ASSERT_EQ(out[0].image.pixel(5 * 4, 6 * 4)[0], 255);
+}
+
+TEST(Tilemap, Stream) {
+  JobPool pool(2);
+  SpriteRenderer renderer(pool);
+  Image tileset = make_tileset();
+  Tilemap map(tileset, 4, 1, renderer);
+  std::map<std::pair<int32_t, int32_t>, std::vector<TileId>> disk;
+  int loads = 0;
+  map.set_loader([&](int32_t cx, int32_t cy, TileId *tiles) {
+    loads++;
+    auto it = disk.find({cx, cy});
+    if (it == disk.end())
+      return false;
+    std::copy(it->second.begin(), it->second.end(), tiles);
+    return true;
+  });
+  map.set_saver([&](int32_t cx, int32_t cy, const TileId *tiles) {
+    disk[{cx, cy}].assign(tiles, tiles + Tilemap::chunk_tiles *
+                                             Tilemap::chunk_tiles);
+  });
+  // One tile in each of ten chunks. Chunks are 128 pixels wide.
+  for (int32_t i = 0; i < 10; i++)
+    map.set(i * 32, 0, 0, 2);
+  ASSERT_EQ(map.resident(), 10u);
+  // Only the chunks within 300 pixels of the camera stay.
+  map.stream({0, 0, 100, 100}, 300);
+  ASSERT_EQ(map.resident(), 4u);
+  ASSERT_EQ(disk.size(), 6u);
+  // Evicted chunks come back from the loader.
+  loads = 0;
+  ASSERT_EQ(map.get(9 * 32, 0, 0), 2);
+  ASSERT_EQ(loads, 1);
+  map.flush();
+  ASSERT_EQ(map.resident(), 0u);
+  ASSERT_EQ(disk.size(), 10u);
+}
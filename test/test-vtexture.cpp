@@ -0,0 +1,150 @@
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "asset.hpp"
+#include "job.hpp"
+#include "vtexture.hpp"
+
+namespace {
+
+/// Update until all loads have finished.
+void settle(VirtualTexture &texture, const Aabb &view, float scale) {
+  texture.update(view, scale);
+  for (int i = 0; i < 1000 && texture.pending(); i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    texture.update(view, scale);
+  }
+  ASSERT_EQ(texture.pending(), 0u);
+  // Install the last loads.
+  texture.update(view, scale);
+}
+
+/// Write a 100×70 image as a pyramid of 16×16 tiles.
+std::filesystem::path write_test_pyramid(Image &image) {
+  image = Image(ImageType::RGBA, 100, 70);
+  for (unsigned y = 0; y < 70; y++) {
+    for (unsigned x = 0; x < 100; x++) {
+      uint8_t *p = image.pixel(x, y);
+      p[0] = x * 2;
+      p[1] = y * 3;
+      p[2] = (x + y) % 2 * 200;
+      p[3] = 255;
+    }
+  }
+  auto dir = std::filesystem::path(testing::TempDir()) / "test-vtexture";
+  std::filesystem::remove_all(dir);
+  VirtualTexture::write_pyramid(
+      image, "map", 16, [&](const std::string &name, ConstImageView tile) {
+        auto path = dir / name;
+        std::filesystem::create_directories(path.parent_path());
+        std::ofstream os(path, std::ios::binary);
+        tile.write_png(os);
+      });
+  return dir;
+}
+
+} // namespace
+
+TEST(VirtualTexture, Pyramid) {
+  Image image;
+  auto dir = write_test_pyramid(image);
+  // 100×70, 50×35, 25×18, 13×9.
+  ASSERT_TRUE(std::filesystem::exists(dir / "map/0/6_4.png"));
+  ASSERT_FALSE(std::filesystem::exists(dir / "map/0/7_0.png"));
+  ASSERT_TRUE(std::filesystem::exists(dir / "map/2/1_1.png"));
+  ASSERT_TRUE(std::filesystem::exists(dir / "map/3/0_0.png"));
+  ASSERT_FALSE(std::filesystem::exists(dir / "map/4/0_0.png"));
+  std::ifstream is(dir / "map/1/1_0.png", std::ios::binary);
+  Image tile = Image::read_png(is);
+  ASSERT_EQ(tile.width(), 16u);
+  ASSERT_EQ(tile.height(), 16u);
+  // Level 1 pixel (17, 3) averages level 0 pixels (34, 6) to (35, 7).
+  ASSERT_EQ(tile.pixel(1, 3)[0], 69);
+  ASSERT_EQ(tile.pixel(1, 3)[2], 100);
+  std::filesystem::remove_all(dir);
+}
+
+TEST(VirtualTexture, Streaming) {
+  Image image;
+  auto dir = write_test_pyramid(image);
+  std::filesystem::remove(dir / "map/0/3_3.png");
+  AssetSystem assets;
+  assets.add_directory(0, dir.string().c_str());
+  JobPool pool(2);
+  VirtualTexture::Params params;
+  params.tile_size = 16;
+  params.pages = 8;
+  params.max_pending = 4;
+  VirtualTexture texture(assets, pool, "map", 100, 70, params);
+  ASSERT_EQ(texture.levels(), 4u);
+
+  // Zoomed out, the whole image is one tile.
+  settle(texture, {0, 0, 100, 70}, 0.1f);
+  ASSERT_EQ(texture.pieces().size(), 1u);
+  const VirtualTexture::Piece &all = texture.pieces()[0];
+  ASSERT_EQ(all.level, 3u);
+  ASSERT_FLOAT_EQ(all.dst.max_x, 100);
+  ASSERT_FLOAT_EQ(all.src.max_x, 12.5f);
+
+  // Until a tile is loaded, it's drawn from a coarser level.
+  VirtualTexture::Piece piece;
+  ASSERT_TRUE(texture.lookup(0, 5, 2, piece));
+  ASSERT_EQ(piece.level, 3u);
+  ASSERT_FLOAT_EQ(piece.dst.min_x, 80);
+  ASSERT_FLOAT_EQ(piece.dst.min_y, 32);
+  ASSERT_FLOAT_EQ(piece.src.min_x, 10);
+  ASSERT_FLOAT_EQ(piece.src.min_y, 4);
+
+  // Pan across at full size. Memory stays within the pages.
+  for (float x = 0; x < 100; x += 8) {
+    settle(texture, {x, 40, x + 20, 60}, 1);
+    for (const VirtualTexture::Piece &p : texture.pieces()) {
+      if (p.dst.min_x == 48 && p.dst.min_y == 48) {
+        // The missing tile stays on a coarser level.
+        ASSERT_GT(p.level, 0u);
+        continue;
+      }
+      ASSERT_EQ(p.level, 0u);
+      ConstImageView page = *p.page;
+      const uint8_t *texel = page.pixel(p.src.min_x, p.src.min_y);
+      const uint8_t *expect = image.pixel(p.dst.min_x, p.dst.min_y);
+      ASSERT_EQ(texel[0], expect[0]);
+      ASSERT_EQ(texel[1], expect[1]);
+    }
+  }
+  size_t resident = 0;
+  for (unsigned l = 0; l < texture.levels(); l++)
+    for (unsigned y = 0; y < 5; y++)
+      for (unsigned x = 0; x < 7; x++)
+        resident += texture.resident(l, x, y);
+  ASSERT_LE(resident, params.pages);
+  ASSERT_TRUE(texture.resident(3, 0, 0));
+  ASSERT_TRUE(texture.resident(0, 6, 2));
+  ASSERT_FALSE(texture.resident(0, 0, 2));
+  std::filesystem::remove_all(dir);
+}
+
+TEST(VirtualTexture, FewPages) {
+  Image image;
+  auto dir = write_test_pyramid(image);
+  AssetSystem assets;
+  assets.add_directory(0, dir.string().c_str());
+  JobPool pool(2);
+  VirtualTexture::Params params;
+  params.tile_size = 16;
+  params.pages = 6;
+  VirtualTexture texture(assets, pool, "map", 100, 70, params);
+  // Level 0 would need 35 pages and level 1 would need 12, so the view is
+  // drawn from the 4 tiles of level 2, and loading finishes.
+  settle(texture, {0, 0, 100, 70}, 1);
+  ASSERT_EQ(texture.pieces().size(), 4u);
+  for (const VirtualTexture::Piece &p : texture.pieces())
+    ASSERT_EQ(p.level, 2u);
+  texture.update({0, 0, 100, 70}, 1);
+  ASSERT_EQ(texture.pending(), 0u);
+  std::filesystem::remove_all(dir);
+}
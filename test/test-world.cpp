@@ -0,0 +1,79 @@
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "asset.hpp"
+#include "job.hpp"
+#include "world.hpp"
+
+namespace {
+
+struct TestRegion : WorldStreamer::Region {
+  int value;
+};
+
+/// Update until all loads have finished.
+void settle(WorldStreamer &world, const Aabb &camera, float vx, float vy) {
+  world.update(camera, vx, vy);
+  for (int i = 0; i < 1000 && world.pending(); i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    world.update(camera, vx, vy);
+  }
+  ASSERT_EQ(world.pending(), 0u);
+}
+
+} // namespace
+
+TEST(World, Streaming) {
+  // A strip of regions along the x axis. Other regions have no file.
+  auto dir = std::filesystem::path(testing::TempDir()) / "test-world";
+  std::filesystem::create_directories(dir);
+  for (int x = -10; x <= 30; x++)
+    std::ofstream(dir / ("r" + std::to_string(x) + "_0")) << x;
+  AssetSystem assets;
+  assets.add_directory(0, dir.string().c_str());
+  JobPool pool(2);
+  WorldStreamer::Params params;
+  params.region_size = 100;
+  params.margin = 0;
+  params.lookahead = 1;
+  params.budget = 3000;
+  WorldStreamer world(
+      assets, pool,
+      [](int32_t rx, int32_t ry) {
+        return "r" + std::to_string(rx) + "_" + std::to_string(ry);
+      },
+      [](int32_t, int32_t, const uint8_t *data, size_t) {
+        auto r = std::make_unique<TestRegion>();
+        r->value = std::stoi(reinterpret_cast<const char *>(data));
+        r->bytes = 1000;
+        return r;
+      },
+      params);
+
+  Aabb camera = {10, -20, 60, 30};
+  settle(world, camera, 0, 0);
+  auto *r = static_cast<const TestRegion *>(world.get(0, 0));
+  ASSERT_NE(r, nullptr);
+  ASSERT_EQ(r->value, 0);
+  ASSERT_TRUE(world.loaded(0, -1));
+  ASSERT_EQ(world.get(0, -1), nullptr);
+  ASSERT_FALSE(world.loaded(5, 0));
+
+  // Moving right loads the regions ahead but not the ones behind.
+  settle(world, camera, 500, 0);
+  ASSERT_TRUE(world.loaded(5, 0));
+  ASSERT_FALSE(world.loaded(-5, 0));
+
+  // Far from the start, the old regions are evicted to stay in budget.
+  camera = {2010, -20, 2060, 30};
+  settle(world, camera, 0, 0);
+  ASSERT_TRUE(world.loaded(20, 0));
+  ASSERT_FALSE(world.loaded(0, 0));
+  ASSERT_LE(world.resident_bytes(), params.budget);
+  std::filesystem::remove_all(dir);
+}